@@ -0,0 +1,120 @@
+#include "bench_framework.hpp"
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/query.hpp>
+
+// stl
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// reads all features with all attributes over the full extent, like
+// rendering a layer which is completely in view
+struct scan_test : benchmark::test_case
+{
+    mapnik::datasource_ptr ds_;
+
+    scan_test(std::string const& name,
+              unsigned iterations,
+              unsigned threads,
+              mapnik::parameters const& params) :
+      test_case(name, iterations, threads),
+      ds_(mapnik::datasource_cache::instance().create(params))
+      {}
+
+    // number of vertices read, so the geometries are actually touched
+    std::size_t scan() const
+    {
+        mapnik::query q(ds_->envelope());
+        std::vector<mapnik::attribute_descriptor> const& desc = ds_->get_descriptor().get_descriptors();
+        for (std::size_t i = 0; i < desc.size(); ++i)
+        {
+            q.add_property_name(desc[i].get_name());
+        }
+        std::size_t vertices = 0;
+        mapnik::featureset_ptr fs = ds_->features(q);
+        mapnik::feature_ptr feature;
+        while (fs && (feature = fs->next()))
+        {
+            for (std::size_t i = 0; i < feature->num_geometries(); ++i)
+            {
+                vertices += feature->get_geometry(i).size();
+            }
+        }
+        return vertices;
+    }
+
+    bool validate() const
+    {
+        return scan() > 0;
+    }
+
+    void operator()() const
+    {
+        for (unsigned i=0;i<iterations();++i)
+        {
+            scan();
+        }
+    }
+};
+
+mapnik::parameters shape_params(std::string const& file)
+{
+    mapnik::parameters params;
+    params["type"] = "shape";
+    params["file"] = file;
+    return params;
+}
+
+// a csv of points with a few attributes, passed inline so
+// only the parsing and not the disk is measured
+mapnik::parameters csv_params(unsigned rows)
+{
+    std::ostringstream s;
+    s << "x,y,name,population\n";
+    for (unsigned i = 0; i < rows; ++i)
+    {
+        s << (i % 360) - 180.0 << "," << (i % 170) - 85.0 << ",\"place " << i << "\"," << i * 7 << "\n";
+    }
+    mapnik::parameters params;
+    params["type"] = "csv";
+    params["inline"] = s.str();
+    return params;
+}
+
+void add_scan(benchmark::test_list & tests, std::string const& name,
+              unsigned iterations, unsigned threads, mapnik::parameters const& params)
+{
+    try
+    {
+        tests.push_back(new scan_test(name, iterations, threads, params));
+    }
+    catch (std::exception const& ex)
+    {
+        // the plugin was not built
+        std::clog << "not running: '" << name << "': " << ex.what() << "\n";
+    }
+}
+
+}
+
+BENCHMARK(datasource_scans)
+{
+    add_scan(tests, "shape scan of ne_110m_admin_0_countries", 100, 0,
+             shape_params("./tests/data/shp/ne_110m_admin_0_countries.shp"));
+    add_scan(tests, "shape scan of world_merc", 100, 0,
+             shape_params("./tests/data/shp/world_merc.shp"));
+    add_scan(tests, "shape scan of world_merc", 100, 10,
+             shape_params("./tests/data/shp/world_merc.shp"));
+    add_scan(tests, "csv scan of 50000 inline points", 10, 0, csv_params(50000));
+    add_scan(tests, "csv scan of 50000 inline points", 10, 10, csv_params(50000));
+}
@@ -0,0 +1,156 @@
+#include "bench_framework.hpp"
+
+// mapnik
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_evaluator.hpp>
+#include <mapnik/filter_program.hpp>
+
+// boost
+#include <boost/make_shared.hpp>
+
+// stl
+#include <string>
+#include <vector>
+
+namespace {
+
+char const* highways[] = { "motorway", "trunk", "primary", "secondary", "tertiary", "residential", "service", "track" };
+
+// filters of a road style, which repeat the same subexpressions a lot
+char const* filters[] = {
+    "[highway]='motorway'",
+    "[highway]='motorway' and [lanes] > 2",
+    "[highway]='trunk' or [highway]='primary'",
+    "([highway]='trunk' or [highway]='primary') and [lanes] > 2",
+    "[highway]='secondary' or [highway]='tertiary'",
+    "[highway]='residential' and not ([name]='')",
+    "[highway]='service' or [highway]='track'",
+    "[lanes] * 2 + 1 > 5",
+    "[name].match('.*Street')"
+};
+
+std::size_t const num_filters = sizeof(filters) / sizeof(filters[0]);
+
+struct expression_test : benchmark::test_case
+{
+    std::vector<mapnik::feature_ptr> features_;
+    std::vector<mapnik::expression_ptr> exprs_;
+
+    expression_test(std::string const& name,
+                    unsigned iterations,
+                    unsigned threads,
+                    unsigned num_features) :
+      test_case(name, iterations, threads),
+      features_(),
+      exprs_()
+    {
+        mapnik::transcoder tr("utf-8");
+        mapnik::context_ptr ctx = boost::make_shared<mapnik::context_type>();
+        for (unsigned i = 0; i < num_features; ++i)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+            feature->put("highway", tr.transcode(highways[i % 8]));
+            feature->put("lanes", static_cast<int>(i % 5));
+            feature->put("name", tr.transcode(i % 3 ? "Main Street" : ""));
+            features_.push_back(feature);
+        }
+        for (std::size_t i = 0; i < num_filters; ++i)
+        {
+            exprs_.push_back(mapnik::parse_expression(filters[i], "utf-8"));
+        }
+    }
+
+    // number of filters matched by all features, with the tree walking evaluator
+    std::size_t evaluate_tree() const
+    {
+        std::size_t count = 0;
+        for (std::size_t f = 0; f < features_.size(); ++f)
+        {
+            mapnik::evaluate<mapnik::feature_impl,mapnik::value_type> eval(*features_[f]);
+            for (std::size_t i = 0; i < exprs_.size(); ++i)
+            {
+                if (boost::apply_visitor(eval, *exprs_[i]).to_bool()) ++count;
+            }
+        }
+        return count;
+    }
+
+    // same with the filters compiled into a shared program
+    std::size_t evaluate_program() const
+    {
+        mapnik::filter_program program;
+        std::vector<mapnik::filter_program::program_id> ids;
+        for (std::size_t i = 0; i < exprs_.size(); ++i)
+        {
+            ids.push_back(program.compile(*exprs_[i]));
+        }
+        std::size_t count = 0;
+        for (std::size_t f = 0; f < features_.size(); ++f)
+        {
+            program.bind(*features_[f]);
+            for (std::size_t i = 0; i < ids.size(); ++i)
+            {
+                if (program.evaluate(ids[i])) ++count;
+            }
+        }
+        return count;
+    }
+};
+
+struct tree_evaluation : expression_test
+{
+    tree_evaluation(std::string const& name,
+                    unsigned iterations,
+                    unsigned threads,
+                    unsigned num_features) :
+      expression_test(name, iterations, threads, num_features) {}
+
+    bool validate() const
+    {
+        return evaluate_tree() == evaluate_program();
+    }
+
+    void operator()() const
+    {
+        for (unsigned i=0;i<iterations();++i)
+        {
+            evaluate_tree();
+        }
+    }
+};
+
+struct program_evaluation : expression_test
+{
+    program_evaluation(std::string const& name,
+                       unsigned iterations,
+                       unsigned threads,
+                       unsigned num_features) :
+      expression_test(name, iterations, threads, num_features) {}
+
+    bool validate() const
+    {
+        return evaluate_program() == evaluate_tree();
+    }
+
+    void operator()() const
+    {
+        // compiling is part of the work, a style compiles once per render
+        for (unsigned i=0;i<iterations();++i)
+        {
+            evaluate_program();
+        }
+    }
+};
+
+}
+
+BENCHMARK(expression_evaluation)
+{
+    tests.push_back(new tree_evaluation("filter evaluation with the evaluate visitor",100,0,10000));
+    tests.push_back(new program_evaluation("filter evaluation with filter_program",100,0,10000));
+    tests.push_back(new tree_evaluation("filter evaluation with the evaluate visitor",100,10,10000));
+    tests.push_back(new program_evaluation("filter evaluation with filter_program",100,10,10000));
+}
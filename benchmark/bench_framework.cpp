@@ -0,0 +1,291 @@
+// boost_chrono is not among the libraries mapnik links to
+#define BOOST_CHRONO_HEADER_ONLY
+
+#include "bench_framework.hpp"
+
+// mapnik
+#include <mapnik/version.hpp>
+#include <mapnik/util/conversions.hpp>
+
+// boost
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/chrono.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace benchmark {
+
+std::vector<test_factory> & registered_factories()
+{
+    static std::vector<test_factory> factories;
+    return factories;
+}
+
+namespace {
+
+typedef boost::chrono::steady_clock wall_clock;
+
+void run_once(test_case const& test)
+{
+    test();
+}
+
+void run_sample(test_case const& test)
+{
+    if (test.threads() > 0)
+    {
+        boost::thread_group tg;
+        for (unsigned i = 0; i < test.threads(); ++i)
+        {
+            tg.create_thread(boost::bind(&run_once, boost::cref(test)));
+        }
+        tg.join_all();
+    }
+    else
+    {
+        test();
+    }
+}
+
+std::string json_string(std::string const& str)
+{
+    std::ostringstream s;
+    s << '"';
+    for (std::string::const_iterator itr = str.begin(); itr != str.end(); ++itr)
+    {
+        unsigned char c = *itr;
+        if (c == '"' || c == '\\') s << '\\' << *itr;
+        else if (c < 0x20) s << "\\u" << std::hex << std::setw(4) << std::setfill('0') << unsigned(c) << std::dec;
+        else s << *itr;
+    }
+    s << '"';
+    return s.str();
+}
+
+void write_summary(std::ostream & out, summary const& s)
+{
+    out << "{\"min\": " << s.min
+        << ", \"mean\": " << s.mean
+        << ", \"p50\": " << s.p50
+        << ", \"p95\": " << s.p95
+        << ", \"p99\": " << s.p99
+        << ", \"max\": " << s.max << "}";
+}
+
+void write_json(std::string const& filename, config const& conf, std::vector<result> const& results)
+{
+    std::ofstream out(filename.c_str());
+    if (!out)
+    {
+        std::clog << "could not write results to " << filename << "\n";
+        return;
+    }
+    out << std::setprecision(6);
+    out << "{\n"
+        << "  \"mapnik_version\": " << json_string(MAPNIK_VERSION_STRING) << ",\n"
+        << "  \"hardware_concurrency\": " << boost::thread::hardware_concurrency() << ",\n"
+        << "  \"warmup\": " << conf.warmup << ",\n"
+        << "  \"samples\": " << conf.samples << ",\n"
+        << "  \"benchmarks\": [";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        result const& r = results[i];
+        out << (i ? ",\n" : "\n")
+            << "    {\"name\": " << json_string(r.name)
+            << ", \"threads\": " << r.threads
+            << ", \"iterations\": " << r.iterations
+            << ", \"validated\": " << (r.validated ? "true" : "false")
+            << ",\n     \"wall_ms\": ";
+        write_summary(out, r.wall);
+        out << ",\n     \"cpu_ms\": ";
+        write_summary(out, r.cpu);
+        out << ",\n     \"ops_per_second\": " << r.ops_per_second
+            << ", \"ops_per_second_per_thread\": " << r.ops_per_second_per_thread << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+bool selected(config const& conf, int number, std::string const& name)
+{
+    if (conf.numbers.empty() && conf.filters.empty()) return true;
+    if (std::find(conf.numbers.begin(), conf.numbers.end(), number) != conf.numbers.end()) return true;
+    for (std::size_t i = 0; i < conf.filters.size(); ++i)
+    {
+        if (name.find(conf.filters[i]) != std::string::npos) return true;
+    }
+    return false;
+}
+
+std::string label(int number, test_case const& test)
+{
+    std::ostringstream s;
+    s << number << ") ";
+    if (test.threads() > 0) s << "threaded(" << test.threads() << ") -> ";
+    s << test.name();
+    return s.str();
+}
+
+}
+
+summary summarize(std::vector<double> samples)
+{
+    summary s = { 0, 0, 0, 0, 0, 0 };
+    if (samples.empty()) return s;
+    std::sort(samples.begin(), samples.end());
+    std::size_t count = samples.size();
+    double total = 0;
+    for (std::size_t i = 0; i < count; ++i) total += samples[i];
+    s.min = samples.front();
+    s.max = samples.back();
+    s.mean = total / count;
+    // smallest sample with at least q percent of samples at or below it
+    double const q[3] = { 50, 95, 99 };
+    double * const p[3] = { &s.p50, &s.p95, &s.p99 };
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        std::size_t rank = static_cast<std::size_t>(std::ceil(q[i] / 100 * count));
+        *p[i] = samples[rank > 0 ? rank - 1 : 0];
+    }
+    return s;
+}
+
+int run(config const& conf)
+{
+    int failures = 0;
+    int number = 0;
+    std::vector<result> results;
+    std::vector<test_factory> const& factories = registered_factories();
+    for (std::size_t f = 0; f < factories.size(); ++f)
+    {
+        test_list tests;
+        try
+        {
+            factories[f](tests);
+        }
+        catch (std::exception const& ex)
+        {
+            std::clog << "could not set up tests: " << ex.what() << "\n";
+            ++failures;
+            continue;
+        }
+        for (test_list::const_iterator itr = tests.begin(); itr != tests.end(); ++itr)
+        {
+            test_case const& test = *itr;
+            ++number;
+            if (!selected(conf, number, test.name())) continue;
+            if (conf.dry_run)
+            {
+                std::clog << label(number, test) << "\n";
+                continue;
+            }
+            try
+            {
+                result r;
+                r.name = test.name();
+                r.threads = test.threads();
+                r.iterations = test.iterations();
+                r.validated = test.validate();
+                if (!r.validated)
+                {
+                    std::clog << "test did not validate: " << test.name() << "\n";
+                    ++failures;
+                }
+                for (unsigned i = 0; i < conf.warmup; ++i)
+                {
+                    run_sample(test);
+                }
+                std::vector<double> wall;
+                std::vector<double> cpu;
+                for (unsigned i = 0; i < conf.samples; ++i)
+                {
+                    // std::clock is process cpu time, unlike process_cpu_clock
+                    // precise to more than the scheduler tick on most platforms
+                    std::clock_t cpu_start = std::clock();
+                    wall_clock::time_point wall_start = wall_clock::now();
+                    run_sample(test);
+                    wall_clock::duration wall_elapsed = wall_clock::now() - wall_start;
+                    std::clock_t cpu_elapsed = std::clock() - cpu_start;
+                    wall.push_back(boost::chrono::duration<double, boost::milli>(wall_elapsed).count());
+                    cpu.push_back(1000.0 * cpu_elapsed / CLOCKS_PER_SEC);
+                }
+                r.wall = summarize(wall);
+                r.cpu = summarize(cpu);
+                unsigned threads = std::max(1u, test.threads());
+                r.ops_per_second_per_thread = r.wall.p50 > 0 ? test.iterations() * 1000.0 / r.wall.p50 : 0;
+                r.ops_per_second = r.ops_per_second_per_thread * threads;
+                results.push_back(r);
+
+                std::clog << label(number, test) << ": "
+                          << std::fixed << std::setprecision(2)
+                          << "p50 " << r.wall.p50 << "ms p95 " << r.wall.p95 << "ms p99 " << r.wall.p99
+                          << "ms (cpu p50 " << r.cpu.p50 << "ms), "
+                          << std::setprecision(0) << r.ops_per_second << " ops/s";
+                if (test.threads() > 0)
+                {
+                    std::clog << ", " << r.ops_per_second_per_thread << " ops/s per thread";
+                }
+                std::clog << "\n" << std::resetiosflags(std::ios::floatfield) << std::setprecision(6);
+            }
+            catch (std::exception const& ex)
+            {
+                std::clog << "test runner did not complete: " << test.name() << ": " << ex.what() << "\n";
+                ++failures;
+            }
+        }
+    }
+    if (!conf.dry_run && !conf.json_file.empty())
+    {
+        write_json(conf.json_file, conf, results);
+    }
+    return failures;
+}
+
+bool parse_args(int argc, char** argv, config & conf)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string opt(argv[i]);
+        std::string value = (i + 1 < argc) ? argv[i + 1] : "";
+        int arg = 0;
+        if (opt == "-d" || opt == "--dry-run")
+        {
+            conf.dry_run = true;
+        }
+        else if (opt == "--samples" || opt == "--warmup")
+        {
+            if (!mapnik::util::string2int(value, arg) || arg < 0) return false;
+            (opt == "--samples" ? conf.samples : conf.warmup) = arg;
+            ++i;
+        }
+        else if (opt == "--json")
+        {
+            if (value.empty()) return false;
+            conf.json_file = value;
+            ++i;
+        }
+        else if (opt.empty() || opt[0] == '-')
+        {
+            return false;
+        }
+        else if (mapnik::util::string2int(opt, arg))
+        {
+            conf.numbers.push_back(arg);
+        }
+        else
+        {
+            conf.filters.push_back(opt);
+        }
+    }
+    return conf.samples > 0;
+}
+
+}
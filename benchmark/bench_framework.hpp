@@ -0,0 +1,129 @@
+#ifndef MAPNIK_BENCH_FRAMEWORK_HPP
+#define MAPNIK_BENCH_FRAMEWORK_HPP
+
+// mapnik
+#include <mapnik/noncopyable.hpp>
+
+// boost
+#include <boost/ptr_container/ptr_vector.hpp>
+
+// stl
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+/*!
+ * \brief A unit of work to time.
+ *
+ * One sample runs operator() once, or once in each of threads() threads
+ * started together when threads() is not zero. operator() should repeat
+ * the work iterations() times, so that a sample is long enough to time.
+ */
+class test_case : private mapnik::noncopyable
+{
+public:
+    test_case(std::string const& name, unsigned iterations, unsigned threads = 0)
+        : name_(name),
+          iterations_(iterations),
+          threads_(threads) {}
+
+    virtual ~test_case() {}
+
+    std::string const& name() const { return name_; }
+    unsigned iterations() const { return iterations_; }
+    unsigned threads() const { return threads_; }
+
+    // checks the result of the timed work, called once before any sample
+    virtual bool validate() const = 0;
+    virtual void operator()() const = 0;
+
+private:
+    std::string name_;
+    unsigned iterations_;
+    unsigned threads_;
+};
+
+typedef boost::ptr_vector<test_case> test_list;
+typedef void (*test_factory)(test_list & tests);
+
+// factories registered with BENCHMARK, in registration order
+std::vector<test_factory> & registered_factories();
+
+struct registrar
+{
+    explicit registrar(test_factory factory)
+    {
+        registered_factories().push_back(factory);
+    }
+};
+
+/*!
+ * \brief Registers a function adding test cases to the suite.
+ *
+ * Factories only run when the suite starts, so test data can be loaded
+ * in test case constructors:
+ *
+ *   BENCHMARK(png_encoding)
+ *   {
+ *       tests.push_back(new png_test(100));
+ *       tests.push_back(new png_test(10, 10)); // in 10 threads
+ *   }
+ */
+#define BENCHMARK(id) \
+    static void id(benchmark::test_list & tests); \
+    static benchmark::registrar id##_registrar(&id); \
+    static void id(benchmark::test_list & tests)
+
+struct config
+{
+    config()
+        : warmup(1),
+          samples(10),
+          dry_run(false),
+          json_file() {}
+
+    unsigned warmup;             // untimed runs before sampling
+    unsigned samples;            // timed runs
+    bool dry_run;                // only list the tests
+    std::string json_file;       // results are also written here unless empty
+    std::vector<int> numbers;    // run these tests only, numbered from 1
+    std::vector<std::string> filters; // run tests whose name contains one of these
+};
+
+// sample durations in milliseconds
+struct summary
+{
+    double min;
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+};
+
+struct result
+{
+    std::string name;
+    unsigned threads;
+    unsigned iterations;
+    bool validated;
+    summary wall;
+    summary cpu;              // user + system time of the whole process
+    double ops_per_second;    // iterations in all threads over the median wall time
+    double ops_per_second_per_thread;
+};
+
+// nearest rank percentiles, so p99 of fewer than 100 samples is the slowest
+summary summarize(std::vector<double> samples);
+
+// runs all registered tests selected by conf, prints progress to std::clog,
+// returns the number of tests which failed to validate or threw
+int run(config const& conf);
+
+// parses command line options into conf, returns false on bad usage
+bool parse_args(int argc, char** argv, config & conf);
+
+}
+
+#endif // MAPNIK_BENCH_FRAMEWORK_HPP
@@ -0,0 +1,135 @@
+#include "bench_framework.hpp"
+#include "bench_utils.hpp"
+
+// mapnik
+#include <mapnik/map.hpp>
+#include <mapnik/graphics.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/load_map.hpp>
+#include <mapnik/box2d.hpp>
+
+// boost
+#include <boost/filesystem/operations.hpp>
+
+// stl
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// a subset of the styles in tests/visual_tests/test.py, each at the
+// first size listed there so the reference images can be used to validate
+struct visual_test
+{
+    char const* name;
+    unsigned width;
+    unsigned height;
+    bool text_box;   // zoom to test.py's default_text_box instead of zoom_all
+};
+
+visual_test const visual_tests[] = {
+    { "list", 800, 100, true },
+    { "simple", 800, 100, true },
+    { "lines-1", 800, 800, true },
+    { "lines-2", 800, 800, true },
+    { "lines-3", 800, 800, true },
+    { "lines-shield", 800, 800, true },
+    { "collision", 600, 400, false },
+    { "marker-multi-policy", 600, 400, false },
+    { "marker-on-line-spacing-eq-width", 600, 400, false },
+    { "marker-on-line-spacing-eq-width-overlap", 600, 400, false },
+    { "marker_line_placement_on_points", 500, 100, false },
+    { "marker-with-background-image", 600, 400, false },
+    { "simple-E", 500, 100, true },
+    { "simple-N", 500, 100, true },
+    { "simple-S", 500, 100, true },
+    { "simple-W", 500, 100, true },
+    { "formatting-1", 500, 100, true },
+    { "formatting-2", 500, 100, true },
+    { "formatting-3", 500, 100, true },
+    { "formatting-4", 500, 100, true },
+    { "expressionformat", 500, 100, true },
+    { "shieldsymbolizer-1", 490, 100, true },
+    { "rtl-point", 200, 200, true },
+    { "jalign-auto", 200, 200, true },
+    { "tiff-alpha-gdal", 600, 400, false },
+    { "tiff-resampling", 600, 400, false }
+};
+
+struct render_test : benchmark::test_case
+{
+    mapnik::Map map_;
+    std::string reference_;
+
+    render_test(std::string const& name,
+                unsigned iterations,
+                visual_test const& test) :
+      test_case(name, iterations),
+      map_(test.width, test.height),
+      reference_()
+    {
+        std::string dir("./tests/visual_tests/");
+        mapnik::load_map(map_, dir + "styles/" + test.name + ".xml");
+        if (test.text_box)
+        {
+            map_.zoom_to_box(mapnik::box2d<double>(-0.05, -0.01, 0.95, 0.01));
+        }
+        else
+        {
+            map_.zoom_all();
+        }
+        std::ostringstream s;
+        s << dir << "images/" << test.name << "-" << test.width << "-reference.png";
+        if (boost::filesystem::exists(s.str()))
+        {
+            reference_ = s.str();
+        }
+    }
+
+    void render(mapnik::image_32 & im) const
+    {
+        mapnik::agg_renderer<mapnik::image_32> ren(map_, im);
+        ren.apply();
+    }
+
+    bool validate() const
+    {
+        // styles without a reference image only have to render
+        mapnik::image_32 im(map_.width(), map_.height());
+        render(im);
+        if (reference_.empty()) return true;
+        // same tolerance as tests/visual_tests/compare.py
+        return benchmark::compare_images(im.data(), benchmark::load_png(reference_)->data(), 1);
+    }
+
+    void operator()() const
+    {
+        for (unsigned i=0;i<iterations();++i)
+        {
+            mapnik::image_32 im(map_.width(), map_.height());
+            render(im);
+        }
+    }
+};
+
+}
+
+BENCHMARK(visual_test_rendering)
+{
+    for (unsigned i = 0; i < sizeof(visual_tests) / sizeof(visual_tests[0]); ++i)
+    {
+        visual_test const& test = visual_tests[i];
+        std::ostringstream name;
+        name << "rendering " << test.name << " at " << test.width << "x" << test.height;
+        try
+        {
+            tests.push_back(new render_test(name.str(), 10, test));
+        }
+        catch (std::exception const& ex)
+        {
+            // e.g. the gdal plugin or a font is not available
+            std::clog << "not running: '" << name.str() << "': " << ex.what() << "\n";
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef MAPNIK_BENCH_UTILS_HPP
+#define MAPNIK_BENCH_UTILS_HPP
+
+// mapnik
+#include <mapnik/graphics.hpp>
+#include <mapnik/image_data.hpp>
+#include <mapnik/image_reader.hpp>
+
+// boost
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+
+// stl
+#include <memory>
+#include <string>
+
+namespace benchmark {
+
+inline boost::shared_ptr<mapnik::image_32> load_png(std::string const& filename)
+{
+    std::auto_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(filename,"png"));
+    if (!reader.get())
+    {
+        throw mapnik::image_reader_exception("Failed to load: " + filename);
+    }
+    boost::shared_ptr<mapnik::image_32> image = boost::make_shared<mapnik::image_32>(reader->width(),reader->height());
+    reader->read(0,0,image->data());
+    return image;
+}
+
+// true if no channel of any pixel differs by more than threshold
+inline bool compare_images(mapnik::image_data_32 const& src, mapnik::image_data_32 const& dest, unsigned threshold = 0)
+{
+    unsigned int width = src.width();
+    unsigned int height = src.height();
+    if ((width != dest.width()) || height != dest.height()) return false;
+    for (unsigned int y = 0; y < height; ++y)
+    {
+        const unsigned int* row_from = src.getRow(y);
+        const unsigned int* row_to = dest.getRow(y);
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            if (row_from[x] == row_to[x]) continue;
+            for (unsigned shift = 0; shift < 32; shift += 8)
+            {
+                int a = (row_from[x] >> shift) & 0xff;
+                int b = (row_to[x] >> shift) & 0xff;
+                if (static_cast<unsigned>(a > b ? a - b : b - a) > threshold) return false;
+            }
+        }
+    }
+    return true;
+}
+
+inline bool compare_images(std::string const& src_fn, std::string const& dest_fn)
+{
+    return compare_images(load_png(src_fn)->data(), load_png(dest_fn)->data());
+}
+
+}
+
+#endif // MAPNIK_BENCH_UTILS_HPP
@@ -11,12 +11,11 @@ test_env.AppendUnique(LIBS='mapnik')
 #test_env.AppendUnique(LIBS='sqlite3')
 test_env.AppendUnique(CXXFLAGS='-g')
 
-for cpp_test in glob.glob('run*.cpp'):
-    name = cpp_test.replace('.cpp','')
-    source_files = [cpp_test]
-    test_env_local = test_env.Clone()
-    test_program = test_env_local.Program(name, source=source_files, LINKFLAGS=env['CUSTOM_LDFLAGS'])
-    Depends(test_program, env.subst('../src/%s' % env['MAPNIK_LIB_NAME']))
-    # build locally if installing
-    if 'install' in COMMAND_LINE_TARGETS:
-        env.Alias('install',test_program)
+# benchmarks register themselves with bench_framework.cpp, so all
+# bench_*.cpp files link into the one runner
+source_files = ['run.cpp'] + sorted(glob.glob('bench_*.cpp'))
+test_program = test_env.Program('run', source=source_files, LINKFLAGS=env['CUSTOM_LDFLAGS'])
+Depends(test_program, env.subst('../src/%s' % env['MAPNIK_LIB_NAME']))
+# build locally if installing
+if 'install' in COMMAND_LINE_TARGETS:
+    env.Alias('install',test_program)
@@ -1,176 +1,74 @@
+#include "bench_framework.hpp"
+#include "bench_utils.hpp"
+
+// mapnik
 #include <mapnik/graphics.hpp>
 #include <mapnik/image_data.hpp>
 #include <mapnik/image_util.hpp>
 #include <mapnik/image_reader.hpp>
 #include <mapnik/util/conversions.hpp>
 
-
 // stl
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <cstdio>
-#include <set>
+#include <cstdlib>
 
 // boost
 #include <boost/version.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
-#include <boost/bind.hpp>
 
-#define BOOST_CHRONO_HEADER_ONLY
-#include <boost/chrono/process_cpu_clocks.hpp>
-#include <boost/chrono.hpp>
-#include <boost/thread/thread.hpp>
-
-using namespace boost::chrono;
 using namespace mapnik;
 
-static unsigned test_num = 1;
-static bool dry_run = false;
-static std::set<int> test_set;
-
-typedef process_cpu_clock clock_type;
-typedef clock_type::duration dur;
-
-template <typename T>
-void benchmark(T test, std::string const& name)
-{
-    try {
-        bool should_run_test = true;
-        if (!test_set.empty()) {
-            should_run_test = test_set.find(test_num) != test_set.end();
-        }
-        if (should_run_test || dry_run) {
-            if (!test.validate()) {
-                std::clog << "test did not validate: " << name << "\n";
-                //throw std::runtime_error(std::string("test did not validate: ") + name);
-            }
-            if (dry_run) {
-                std::clog << test_num << ") " << (test.threads_ ? "threaded -> ": "")
-                    << name << "\n";
-            } else {
-                process_cpu_clock::time_point start;
-                dur elapsed;
-                if (test.threads_ > 0) {
-                    boost::thread_group tg;
-                    for (unsigned i=0;i<test.threads_;++i)
-                    {
-                        tg.create_thread(test);
-                    }
-                    start = process_cpu_clock::now();
-                    tg.join_all();
-                    elapsed = process_cpu_clock::now() - start;
-                } else {
-                    start = process_cpu_clock::now();
-                    test();
-                    elapsed = process_cpu_clock::now() - start;
-                }
-                std::clog << test_num << ") " << (test.threads_ ? "threaded -> ": "")
-                    << name << ": "
-                    << boost::chrono::duration_cast<milliseconds>(elapsed) << "\n";
-            }
-        }
-    } catch (std::exception const& ex) {
-        std::clog << "test runner did not complete: " << ex.what() << "\n";
-    }
-    test_num++;
-}
-
-bool compare_images(std::string const& src_fn,std::string const& dest_fn)
+struct test1 : benchmark::test_case
 {
-    std::auto_ptr<mapnik::image_reader> reader1(mapnik::get_image_reader(dest_fn,"png"));
-    if (!reader1.get())
-    {
-        throw mapnik::image_reader_exception("Failed to load: " + dest_fn);
-    }
-    boost::shared_ptr<image_32> image_ptr1 = boost::make_shared<image_32>(reader1->width(),reader1->height());
-    reader1->read(0,0,image_ptr1->data());
-
-    std::auto_ptr<mapnik::image_reader> reader2(mapnik::get_image_reader(src_fn,"png"));
-    if (!reader2.get())
-    {
-        throw mapnik::image_reader_exception("Failed to load: " + src_fn);
-    }
-    boost::shared_ptr<image_32> image_ptr2 = boost::make_shared<image_32>(reader2->width(),reader2->height());
-    reader2->read(0,0,image_ptr2->data());
-
-    image_data_32 const& dest = image_ptr1->data();
-    image_data_32 const& src = image_ptr2->data();
-
-    unsigned int width = src.width();
-    unsigned int height = src.height();
-    if ((width != dest.width()) || height != dest.height()) return false;
-    for (unsigned int y = 0; y < height; ++y)
-    {
-        const unsigned int* row_from = src.getRow(y);
-        const unsigned int* row_to = dest.getRow(y);
-        for (unsigned int x = 0; x < width; ++x)
-        {
-           if (row_from[x] != row_to[x]) return false;
-        }
-    }
-    return true;
-}
-
-struct test1
-{
-    unsigned iter_;
-    unsigned threads_;
-    explicit test1(unsigned iterations, unsigned threads=0) :
-      iter_(iterations),
-      threads_(threads)
+    test1(std::string const& name,
+          unsigned iterations, unsigned threads=0) :
+      test_case(name, iterations, threads)
       {}
 
-    bool validate()
+    bool validate() const
     {
         return true;
     }
 
-    void operator()()
+    void operator()() const
     {
         mapnik::image_data_32 im(256,256);
         std::string out;
-        for (unsigned i=0;i<iter_;++i) {
+        for (unsigned i=0;i<iterations();++i) {
             out.clear();
             out = mapnik::save_to_string(im,"png");
         }
     }
 };
 
-struct test2
+struct test2 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     boost::shared_ptr<image_32> im_;
-    explicit test2(unsigned iterations, unsigned threads=0) :
-      iter_(iterations),
-      threads_(threads),
+    test2(std::string const& name,
+          unsigned iterations, unsigned threads=0) :
+      test_case(name, iterations, threads),
       im_()
     {
-        std::string filename("./benchmark/data/multicolor.png");
-        std::auto_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(filename,"png"));
-        if (!reader.get())
-        {
-            throw mapnik::image_reader_exception("Failed to load: " + filename);
-        }
-        im_ = boost::make_shared<image_32>(reader->width(),reader->height());
-        reader->read(0,0,im_->data());
+        im_ = benchmark::load_png("./benchmark/data/multicolor.png");
     }
 
-    bool validate()
+    bool validate() const
     {
         std::string expected("./benchmark/data/multicolor-hextree-expected.png");
         std::string actual("./benchmark/data/multicolor-hextree-actual.png");
         mapnik::save_to_file(im_->data(),actual, "png8:m=h");
-        return compare_images(actual,expected);
+        return benchmark::compare_images(actual,expected);
     }
 
-    void operator()()
+    void operator()() const
     {
         std::string out;
-        for (unsigned i=0;i<iter_;++i) {
+        for (unsigned i=0;i<iterations();++i) {
             out.clear();
             out = mapnik::save_to_string(im_->data(),"png8:m=h");
         }
@@ -178,25 +76,23 @@ struct test2
 };
 
 
-struct test3
+struct test3 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     double val_;
-    explicit test3(unsigned iterations, unsigned threads=0) :
-      iter_(iterations),
-      threads_(threads),
+    test3(std::string const& name,
+          unsigned iterations, unsigned threads=0) :
+      test_case(name, iterations, threads),
       val_(-0.123) {}
-    bool validate()
+    bool validate() const
     {
         std::ostringstream s;
         s << val_;
         return (s.str() == "-0.123");
     }
-    void operator()()
+    void operator()() const
     {
         std::string out;
-        for (unsigned i=0;i<iter_;++i) {
+        for (unsigned i=0;i<iterations();++i) {
             std::ostringstream s;
             s << val_;
             out = s.str();
@@ -204,26 +100,24 @@ struct test3
     }
 };
 
-struct test4
+struct test4 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     double val_;
-    explicit test4(unsigned iterations, unsigned threads=0) :
-      iter_(iterations),
-      threads_(threads),
+    test4(std::string const& name,
+          unsigned iterations, unsigned threads=0) :
+      test_case(name, iterations, threads),
       val_(-0.123) {}
 
-    bool validate()
+    bool validate() const
     {
         std::string s;
         mapnik::util::to_string(s,val_);
         return (s == "-0.123");
     }
-    void operator()()
+    void operator()() const
     {
         std::string out;
-        for (unsigned i=0;i<iter_;++i) {
+        for (unsigned i=0;i<iterations();++i) {
             out.clear();
             mapnik::util::to_string(out,val_);
         }
@@ -231,23 +125,21 @@ struct test4
 };
 
 
-struct test5
+struct test5 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     double val_;
-    explicit test5(unsigned iterations, unsigned threads=0) :
-      iter_(iterations),
-      threads_(threads),
+    test5(std::string const& name,
+          unsigned iterations, unsigned threads=0) :
+      test_case(name, iterations, threads),
       val_(-0.123) {}
 
-    bool validate()
+    bool validate() const
     {
         std::string s;
         to_string_impl(s,val_);
         return (s == "-0.123");
     }
-    bool to_string_impl(std::string &s , double val)
+    bool to_string_impl(std::string &s , double val) const
     {
         s.resize(s.capacity());
         while (true)
@@ -262,10 +154,10 @@ struct test5
         }
         return true;
     }
-    void operator()()
+    void operator()() const
     {
         std::string out;
-        for (unsigned i=0;i<iter_;++i)
+        for (unsigned i=0;i<iterations();++i)
         {
             out.clear();
             to_string_impl(out , val_);
@@ -278,31 +170,29 @@ struct test5
 #include <mapnik/projection.hpp>
 #include <mapnik/proj_transform.hpp>
 
-struct test6
+struct test6 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     std::string src_;
     std::string dest_;
     mapnik::box2d<double> from_;
     mapnik::box2d<double> to_;
     bool defer_proj4_init_;
-    explicit test6(unsigned iterations,
-                   unsigned threads,
-                   std::string const& src,
-                   std::string const& dest,
-                   mapnik::box2d<double> from,
-                   mapnik::box2d<double> to,
-                   bool defer_proj) :
-      iter_(iterations),
-      threads_(threads),
+    test6(std::string const& name,
+          unsigned iterations,
+          unsigned threads,
+          std::string const& src,
+          std::string const& dest,
+          mapnik::box2d<double> from,
+          mapnik::box2d<double> to,
+          bool defer_proj) :
+      test_case(name, iterations, threads),
       src_(src),
       dest_(dest),
       from_(from),
       to_(to),
       defer_proj4_init_(defer_proj) {}
 
-    bool validate()
+    bool validate() const
     {
         mapnik::projection src(src_,defer_proj4_init_);
         mapnik::projection dest(dest_,defer_proj4_init_);
@@ -315,19 +205,21 @@ struct test6
                 (std::fabs(bbox.maxy() - to_.maxy()) < .5)
                );
     }
-    void operator()()
+    // one iteration transforms every integer lon/lat in -180..180, -85..85
+    void operator()() const
     {
-        unsigned count=0;
-        for (int i=-180;i<180;++i)
+        for (unsigned n=0;n<iterations();++n)
         {
-            for (int j=-85;j<85;++j)
+            for (int i=-180;i<180;++i)
             {
-                mapnik::projection src(src_,defer_proj4_init_);
-                mapnik::projection dest(dest_,defer_proj4_init_);
-                mapnik::proj_transform tr(src,dest);
-                mapnik::box2d<double> box(i,j,i,j);
-                if (!tr.forward(box)) throw std::runtime_error("could not transform coords");
-                ++count;
+                for (int j=-85;j<85;++j)
+                {
+                    mapnik::projection src(src_,defer_proj4_init_);
+                    mapnik::projection dest(dest_,defer_proj4_init_);
+                    mapnik::proj_transform tr(src,dest);
+                    mapnik::box2d<double> box(i,j,i,j);
+                    if (!tr.forward(box)) throw std::runtime_error("could not transform coords");
+                }
             }
         }
     }
@@ -337,27 +229,25 @@ struct test6
 #include <mapnik/expression.hpp>
 #include <mapnik/expression_string.hpp>
 
-struct test7
+struct test7 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     std::string expr_;
-    explicit test7(unsigned iterations,
-                   unsigned threads,
-                   std::string const& expr) :
-      iter_(iterations),
-      threads_(threads),
+    test7(std::string const& name,
+          unsigned iterations,
+          unsigned threads,
+          std::string const& expr) :
+      test_case(name, iterations, threads),
       expr_(expr)
       {}
 
-    bool validate()
+    bool validate() const
     {
         mapnik::expression_ptr expr = mapnik::parse_expression(expr_,"utf-8");
         return mapnik::to_expression_string(*expr) == expr_;
     }
-    void operator()()
+    void operator()() const
     {
-         for (unsigned i=0;i<iter_;++i) {
+         for (unsigned i=0;i<iterations();++i) {
              mapnik::expression_ptr expr = mapnik::parse_expression(expr_,"utf-8");
          }
     }
@@ -365,29 +255,27 @@ struct test7
 
 #include <mapnik/expression_grammar.hpp>
 
-struct test8
+struct test8 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     std::string expr_;
-    explicit test8(unsigned iterations,
-                   unsigned threads,
-                   std::string const& expr) :
-      iter_(iterations),
-      threads_(threads),
+    test8(std::string const& name,
+          unsigned iterations,
+          unsigned threads,
+          std::string const& expr) :
+      test_case(name, iterations, threads),
       expr_(expr)
       {}
 
-    bool validate()
+    bool validate() const
     {
         mapnik::expression_grammar<std::string::const_iterator> expr_grammar(transcoder("utf-8"));
         mapnik::expression_ptr expr = mapnik::parse_expression(expr_,expr_grammar);
         return mapnik::to_expression_string(*expr) == expr_;
     }
-    void operator()()
+    void operator()() const
     {
          mapnik::expression_grammar<std::string::const_iterator> expr_grammar(transcoder("utf-8"));
-         for (unsigned i=0;i<iter_;++i) {
+         for (unsigned i=0;i<iterations();++i) {
              mapnik::expression_ptr expr = mapnik::parse_expression(expr_,expr_grammar);
          }
     }
@@ -461,19 +349,17 @@ private:
     rule_ptrs also_rules_;
 };
 
-struct test9
+struct test9 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     unsigned num_rules_;
     unsigned num_styles_;
     std::vector<rule> rules_;
-    explicit test9(unsigned iterations,
-                   unsigned threads,
-                   unsigned num_rules,
-                   unsigned num_styles) :
-      iter_(iterations),
-      threads_(threads),
+    test9(std::string const& name,
+          unsigned iterations,
+          unsigned threads,
+          unsigned num_rules,
+          unsigned num_styles) :
+      test_case(name, iterations, threads),
       num_rules_(num_rules),
       num_styles_(num_styles),
       rules_() {
@@ -483,13 +369,13 @@ struct test9
           }
       }
 
-    bool validate()
+    bool validate() const
     {
         return true;
     }
-    void operator()()
+    void operator()() const
     {
-         for (unsigned i=0;i<iter_;++i) {
+         for (unsigned i=0;i<iterations();++i) {
              boost::container::vector<rule_cache_move> rule_caches;
              for (unsigned i=0;i<num_styles_;++i) {
                  rule_cache_move rc;
@@ -550,19 +436,17 @@ private:
     rule_ptrs also_rules_;
 };
 
-struct test10
+struct test10 : benchmark::test_case
 {
-    unsigned iter_;
-    unsigned threads_;
     unsigned num_rules_;
     unsigned num_styles_;
     std::vector<rule> rules_;
-    explicit test10(unsigned iterations,
-                   unsigned threads,
-                   unsigned num_rules,
-                   unsigned num_styles) :
-      iter_(iterations),
-      threads_(threads),
+    test10(std::string const& name,
+           unsigned iterations,
+           unsigned threads,
+           unsigned num_rules,
+           unsigned num_styles) :
+      test_case(name, iterations, threads),
       num_rules_(num_rules),
       num_styles_(num_styles),
       rules_() {
@@ -572,13 +456,13 @@ struct test10
           }
       }
 
-    bool validate()
+    bool validate() const
     {
         return true;
     }
-    void operator()()
+    void operator()() const
     {
-         for (unsigned i=0;i<iter_;++i) {
+         for (unsigned i=0;i<iterations();++i) {
              boost::ptr_vector<rule_cache_heap> rule_caches;
              for (unsigned i=0;i<num_styles_;++i) {
                  std::auto_ptr<rule_cache_heap> rc(new rule_cache_heap);
@@ -591,137 +475,201 @@ struct test10
     }
 };
 
-int main( int argc, char** argv)
-{
-    if (argc > 0) {
-        for (int i=0;i<argc;++i) {
-            std::string opt(argv[i]);
-            if (opt == "-d" || opt == "--dry-run") {
-                dry_run = true;
-            } else if (opt[0] != '-') {
-                int arg;
-                if (mapnik::util::string2int(opt,arg)) {
-                    test_set.insert(arg);
-                }
-            }
-        }
-    }
-    try
-    {
-        std::cout << "starting benchmark…\n";
-
-        {
-            test1 runner(100);
-            benchmark(runner,"encoding blank image as png");
-        }
-
-        {
-            test2 runner(100);
-            benchmark(runner,"encoding multicolor image as png8:m=h");
-        }
+#include <mapnik/quad_tree.hpp>
+#include <mapnik/label_collision_detector.hpp>
 
-        {
-            test1 runner(10,10);
-            benchmark(runner,"encoding blank image as png");
-        }
+// the quad_tree based detector that label_collision_detector4 replaced
+class quad_tree_detector : mapnik::noncopyable
+{
+    struct label
+    {
+        label(box2d<double> const& b, UnicodeString const& t) : box(b), text(t) {}
+        box2d<double> box;
+        UnicodeString text;
+    };
+    typedef quad_tree<label> tree_t;
+    tree_t tree_;
+public:
+    explicit quad_tree_detector(box2d<double> const& extent)
+        : tree_(extent) {}
 
+    bool has_placement(box2d<double> const& box, UnicodeString const& text, double distance)
+    {
+        box2d<double> bigger_box(box.minx() - distance, box.miny() - distance, box.maxx() + distance, box.maxy() + distance);
+        tree_t::query_iterator itr = tree_.query_in_box(bigger_box);
+        tree_t::query_iterator end = tree_.query_end();
+        for ( ;itr != end; ++itr)
         {
-            test2 runner(10,10);
-            benchmark(runner,"encoding multicolor image as png8:m=h");
+            if (itr->box.intersects(box) || (text == itr->text && itr->box.intersects(bigger_box)))
+            {
+                return false;
+            }
         }
+        return true;
+    }
 
-        {
-            test3 runner(1000000);
-            benchmark(runner,"double to string conversion with std::ostringstream");
-        }
+    void insert(box2d<double> const& box, UnicodeString const& text)
+    {
+        tree_.insert(label(box, text), box);
+    }
+};
 
+template <typename Detector>
+struct test11 : benchmark::test_case
+{
+    unsigned num_labels_;
+    box2d<double> extent_;
+    std::vector<box2d<double> > boxes_;
+    std::vector<UnicodeString> texts_;
+    test11(std::string const& name,
+          unsigned iterations,
+                    unsigned threads,
+                    unsigned num_labels) :
+      test_case(name, iterations, threads),
+      num_labels_(num_labels),
+      extent_(-128,-128,2048+128,2048+128),
+      boxes_(),
+      texts_()
+    {
+        // label-dense metatile: deterministic pseudo random placements
+        mapnik::transcoder tr("utf-8");
+        unsigned seed = 12345;
+        for (unsigned i=0;i<num_labels_;++i)
         {
-            test4 runner(1000000);
-            benchmark(runner,"double to string conversion with mapnik::util_to_string");
+            seed = seed * 1103515245 + 12345;
+            double x = (seed >> 8) % 2048;
+            seed = seed * 1103515245 + 12345;
+            double y = (seed >> 8) % 2048;
+            double w = 20 + (seed >> 4) % 80;
+            boxes_.push_back(box2d<double>(x, y, x + w, y + 12));
+            std::ostringstream s;
+            s << "street " << (seed >> 12) % 50;
+            texts_.push_back(tr.transcode(s.str().c_str()));
         }
+    }
 
+    unsigned place() const
+    {
+        Detector detector(extent_);
+        unsigned placed = 0;
+        for (unsigned i=0;i<num_labels_;++i)
         {
-            test5 runner(1000000);
-            benchmark(runner,"double to string conversion with snprintf");
+            if (detector.has_placement(boxes_[i], texts_[i], 100.0))
+            {
+                detector.insert(boxes_[i], texts_[i]);
+                ++placed;
+            }
         }
+        return placed;
+    }
 
-        {
-            test3 runner(1000000,10);
-            benchmark(runner,"double to string conversion with std::ostringstream");
+    bool validate() const
+    {
+        test11<quad_tree_detector> reference(name(),1,0,num_labels_);
+        return place() == reference.place();
+    }
+    void operator()() const
+    {
+        for (unsigned i=0;i<iterations();++i) {
+            place();
         }
+    }
+};
 
-        {
-            test4 runner(1000000,10);
-            benchmark(runner,"double to string conversion with mapnik::util_to_string");
-        }
+BENCHMARK(png_encoding)
+{
+    tests.push_back(new test1("encoding blank image as png",100));
+    tests.push_back(new test2("encoding multicolor image as png8:m=h",100));
+    tests.push_back(new test1("encoding blank image as png",10,10));
+    tests.push_back(new test2("encoding multicolor image as png8:m=h",10,10));
+}
 
-        {
-            test5 runner(1000000,10);
-            benchmark(runner,"double to string conversion with snprintf");
-        }
+BENCHMARK(double_to_string)
+{
+    tests.push_back(new test3("double to string conversion with std::ostringstream",1000000));
+    tests.push_back(new test4("double to string conversion with mapnik::util_to_string",1000000));
+    tests.push_back(new test5("double to string conversion with snprintf",1000000));
+    tests.push_back(new test3("double to string conversion with std::ostringstream",1000000,10));
+    tests.push_back(new test4("double to string conversion with mapnik::util_to_string",1000000,10));
+    tests.push_back(new test5("double to string conversion with snprintf",1000000,10));
+}
 
-        mapnik::box2d<double> from(-180,-80,180,80);
-        mapnik::box2d<double> to(-20037508.3427892476,-15538711.0963092316,20037508.3427892476,15538711.0963092316);
+BENCHMARK(coord_transformation)
+{
+    mapnik::box2d<double> from(-180,-80,180,80);
+    mapnik::box2d<double> to(-20037508.3427892476,-15538711.0963092316,20037508.3427892476,15538711.0963092316);
+    // echo -180 -60 | cs2cs -f "%.10f" +init=epsg:4326 +to +init=epsg:3857
+    tests.push_back(new test6("lonlat -> merc coord transformation (epsg)",1,100,
+                              "+init=epsg:4326",
+                              "+init=epsg:3857",
+                              from,to,true));
+    tests.push_back(new test6("merc -> lonlat coord transformation (epsg)",1,100,
+                              "+init=epsg:3857",
+                              "+init=epsg:4326",
+                              to,from,true));
+    tests.push_back(new test6("lonlat -> merc coord transformation (literal)",1,100,
+                              "+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs",
+                              "+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0.0 +k=1.0 +units=m +nadgrids=@null +wktext +no_defs +over",
+                              from,to,true));
+    tests.push_back(new test6("merc -> lonlat coord transformation (literal)",1,100,
+                              "+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0.0 +k=1.0 +units=m +nadgrids=@null +wktext +no_defs +over",
+                              "+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs",
+                              to,from,true));
+}
 
-        {
-            // echo -180 -60 | cs2cs -f "%.10f" +init=epsg:4326 +to +init=epsg:3857
-            test6 runner(100000000,100,
-                         "+init=epsg:4326",
-                         "+init=epsg:3857",
-                         from,to,true);
-            benchmark(runner,"lonlat -> merc coord transformation (epsg)");
-        }
+BENCHMARK(expression_parsing)
+{
+    tests.push_back(new test7("expression parsing with grammer per parse",10000,100,"([foo]=1)"));
+    tests.push_back(new test8("expression parsing by re-using grammar",10000,100,"([foo]=1)"));
+}
 
-        {
-            test6 runner(100000000,100,
-                         "+init=epsg:3857",
-                         "+init=epsg:4326",
-                         to,from,true);
-            benchmark(runner,"merc -> lonlat coord transformation (epsg)");
-        }
+BENCHMARK(rule_caching)
+{
+#if BOOST_VERSION >= 105300
+    tests.push_back(new test9("rule caching using boost::move",1000,10,200,50));
+#else
+    std::clog << "not running: 'rule caching using boost::move'\n";
+#endif
+    tests.push_back(new test10("rule caching using heap allocation",1000,10,200,50));
+}
 
-        {
-            test6 runner(100000000,100,
-                         "+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs",
-                         "+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0.0 +k=1.0 +units=m +nadgrids=@null +wktext +no_defs +over",
-                         from,to,true);
-            benchmark(runner,"lonlat -> merc coord transformation (literal)");
-        }
+BENCHMARK(label_collision_detection)
+{
+    tests.push_back(new test11<quad_tree_detector>("label collision detection using quad_tree",20,0,20000));
+    tests.push_back(new test11<label_collision_detector4>("label collision detection using packed grid",20,0,20000));
+}
 
-        {
-            test6 runner(100000000,100,
-                         "+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0.0 +k=1.0 +units=m +nadgrids=@null +wktext +no_defs +over",
-                         "+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs",
-                         to,from,true);
-            benchmark(runner,"merc -> lonlat coord transformation (literal)");
-        }
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/font_engine_freetype.hpp>
 
-        {
-            test7 runner(10000,100,"([foo]=1)");
-            benchmark(runner,"expression parsing with grammer per parse");
-        }
+namespace {
 
-        {
-            test8 runner(10000,100,"([foo]=1)");
-            benchmark(runner,"expression parsing by re-using grammar");
-        }
+std::string env_or(char const* name, std::string const& fallback)
+{
+    char const* value = std::getenv(name);
+    return value ? std::string(value) : fallback;
+}
 
-        {
-#if BOOST_VERSION >= 105300
-            test9 runner(1000,10,200,50);
-            benchmark(runner,"rule caching using boost::move");
-#else
-            std::clog << "not running: 'rule caching using boost::move'\n";
-#endif
-        }
+}
 
-        {
-            test10 runner(1000,10,200,50);
-            benchmark(runner,"rule caching using heap allocation");
-        }
+int main( int argc, char** argv)
+{
+    benchmark::config conf;
+    if (!benchmark::parse_args(argc, argv, conf))
+    {
+        std::clog << "usage: " << argv[0] << " [-d|--dry-run] [--samples N] [--warmup N] [--json FILE] [test number or name ...]\n";
+        return -1;
+    }
+    try
+    {
+        // rendering and datasource tests need the plugins and fonts of the source tree
+        mapnik::datasource_cache::instance().register_datasources(env_or("MAPNIK_INPUT_PLUGINS_DIRECTORY","./plugins/input/"));
+        mapnik::freetype_engine::register_fonts(env_or("MAPNIK_FONT_DIRECTORY","./fonts/"), true);
 
+        std::cout << "starting benchmark…\n";
+        int failures = benchmark::run(conf);
         std::cout << "...benchmark done\n";
-        return 0;
+        return failures ? -1 : 0;
     }
     catch (std::exception const& ex)
     {
@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# compares two result files written by `./benchmark/run --json FILE`
+#
+#   ./benchmark/run --json before.json  # on the base commit
+#   ./benchmark/run --json after.json   # on the change
+#   python benchmark/utils/compare.py before.json after.json
+#
+# exits with 1 if the median wall time of any benchmark got slower
+# by more than the threshold (10% by default)
+
+import sys
+
+try:
+    import json
+except ImportError:
+    import simplejson as json
+
+def load(filename):
+    results = {}
+    for b in json.load(open(filename))['benchmarks']:
+        results[(b['name'], b['threads'])] = b
+    return results
+
+def label(key):
+    name, threads = key
+    if threads:
+        return 'threaded(%d) -> %s' % (threads, name)
+    return name
+
+if __name__ == "__main__":
+    threshold = 0.10
+    args = sys.argv[1:]
+    if '--threshold' in args:
+        i = args.index('--threshold')
+        threshold = float(args[i + 1]) / 100
+        del args[i:i + 2]
+    if len(args) != 2:
+        print 'usage: %s [--threshold PERCENT] before.json after.json' % sys.argv[0]
+        sys.exit(2)
+
+    before = load(args[0])
+    after = load(args[1])
+    regressions = 0
+    for key in sorted(after.keys()):
+        if key not in before:
+            print '%s: new' % label(key)
+            continue
+        old = before[key]['wall_ms']['p50']
+        new = after[key]['wall_ms']['p50']
+        if old <= 0:
+            continue
+        change = (new - old) / old
+        if change > threshold:
+            regressions += 1
+            mark = '\x1b[31m✘\x1b[0m'
+        elif change < -threshold:
+            mark = '\x1b[32m✓\x1b[0m'
+        else:
+            mark = ' '
+        print '%s %s: p50 %.2fms -> %.2fms (%+.1f%%)' % (mark, label(key), old, new, change * 100)
+
+    if regressions:
+        print '%d benchmarks slower by more than %d%%' % (regressions, threshold * 100)
+        sys.exit(1)
@@ -358,6 +358,7 @@ def PostGIS(**keywords):
       port -- postgres port (default: see postgres docs)
       initial_size -- integer size of connection pool (default: 1)
       max_size -- integer max of connection pool (default: 10)
+      pool_max_wait -- milliseconds to wait for a free connection once max_size are in use (default: 1000)
       persist_connection -- keep connection open (default: True)
 
     Optional table-level keyword arguments:
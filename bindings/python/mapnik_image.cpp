@@ -164,6 +164,18 @@ boost::shared_ptr<image_32> open_from_file(std::string const& filename)
     throw mapnik::image_reader_exception("Unsupported image format:" + filename);
 }
 
+boost::shared_ptr<image_32> open_from_string(std::string const& str)
+{
+    std::auto_ptr<image_reader> reader(get_image_reader(str.c_str(),str.size()));
+    if (reader.get())
+    {
+        boost::shared_ptr<image_32> image_ptr = boost::make_shared<image_32>(reader->width(),reader->height());
+        reader->read(0,0,image_ptr->data());
+        return image_ptr;
+    }
+    throw mapnik::image_reader_exception("Failed to load image from buffer");
+}
+
 void blend (image_32 & im, unsigned x, unsigned y, image_32 const& im2, float opacity)
 {
     im.set_rectangle_alpha2(im2.data(),x,y,opacity);
@@ -257,6 +269,8 @@ void export_image()
         .def("save", &save_to_file3)
         .def("open",open_from_file)
         .staticmethod("open")
+        .def("fromstring",open_from_string)
+        .staticmethod("fromstring")
 #if defined(HAVE_CAIRO) && defined(HAVE_PYCAIRO)
         .def("from_cairo",&from_cairo)
         .staticmethod("from_cairo")
@@ -95,12 +95,88 @@ void export_logger();
 #include "python_optional.hpp"
 #include <mapnik/marker_cache.hpp>
 #include <mapnik/mapped_memory_cache.hpp>
+#include <mapnik/glyph_cache.hpp>
+#include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/raster_tile_cache.hpp>
+#include <mapnik/warp_mesh_cache.hpp>
+#include <mapnik/rendering_stats.hpp>
+#include <mapnik/lru_cache.hpp>
 
 
 void clear_cache()
 {
     mapnik::marker_cache::instance().clear();
     mapnik::mapped_memory_cache::instance().clear();
+    mapnik::glyph_cache::instance().clear();
+    mapnik::freetype_engine::clear_cache();
+    mapnik::raster_tile_cache::instance().clear();
+    mapnik::warp_mesh_cache::instance().clear();
+}
+
+boost::python::dict lru_cache_stats_to_dict(mapnik::lru_cache_stats const& stats)
+{
+    boost::python::dict d;
+    d["hits"] = stats.hits;
+    d["misses"] = stats.misses;
+    d["evictions"] = stats.evictions;
+    d["entries"] = stats.entries;
+    d["bytes"] = stats.bytes;
+    return d;
+}
+
+boost::python::dict mapped_memory_cache_stats()
+{
+    return lru_cache_stats_to_dict(mapnik::mapped_memory_cache::instance().stats());
+}
+
+void set_mapped_memory_cache_limits(std::size_t max_bytes, std::size_t max_entries)
+{
+    mapnik::mapped_memory_cache & cache = mapnik::mapped_memory_cache::instance();
+    cache.set_max_bytes(max_bytes);
+    cache.set_max_entries(max_entries);
+}
+
+boost::python::dict glyph_cache_stats()
+{
+    return lru_cache_stats_to_dict(mapnik::glyph_cache::instance().stats());
+}
+
+void set_glyph_cache_limits(std::size_t max_bytes, unsigned subpixel_steps)
+{
+    mapnik::glyph_cache & cache = mapnik::glyph_cache::instance();
+    cache.set_max_bytes(max_bytes);
+    cache.set_subpixel_steps(subpixel_steps);
+}
+
+boost::python::dict font_cache_stats()
+{
+    mapnik::font_cache_stats stats = mapnik::freetype_engine::cache_stats();
+    boost::python::dict d;
+    d["files"] = stats.files;
+    d["bytes"] = stats.bytes;
+    d["libraries"] = stats.libraries;
+    d["idle_libraries"] = stats.idle_libraries;
+    d["faces_opened"] = stats.faces_opened;
+    d["face_hits"] = stats.face_hits;
+    d["metrics_hits"] = stats.metrics_hits;
+    d["metrics_misses"] = stats.metrics_misses;
+    d["metrics_entries"] = stats.metrics_entries;
+    return d;
+}
+
+boost::python::dict raster_tile_cache_stats()
+{
+    return lru_cache_stats_to_dict(mapnik::raster_tile_cache::instance().stats());
+}
+
+boost::python::dict warp_mesh_cache_stats()
+{
+    return lru_cache_stats_to_dict(mapnik::warp_mesh_cache::instance().stats());
+}
+
+void set_raster_tile_cache_limits(std::size_t max_bytes)
+{
+    mapnik::raster_tile_cache::instance().set_max_bytes(max_bytes);
 }
 
 #if defined(HAVE_CAIRO) && defined(HAVE_PYCAIRO)
@@ -127,6 +203,54 @@ void render(const mapnik::Map& map,
 
 }
 
+boost::python::dict render_with_stats(const mapnik::Map& map,
+                                     mapnik::image_32& image,
+                                     double scale_factor = 1.0,
+                                     unsigned offset_x = 0u,
+                                     unsigned offset_y = 0u)
+{
+    mapnik::rendering_stats stats;
+    {
+        python_unblock_auto_block b;
+        mapnik::agg_renderer<mapnik::image_32> ren(map,image,scale_factor,offset_x, offset_y);
+        ren.set_rendering_stats(&stats);
+        ren.apply();
+    }
+
+    boost::python::list layers;
+    for (std::size_t i = 0; i < stats.layers.size(); ++i)
+    {
+        mapnik::layer_stats const& lyr = stats.layers[i];
+        boost::python::list styles;
+        for (std::size_t j = 0; j < lyr.styles.size(); ++j)
+        {
+            mapnik::style_stats const& st = lyr.styles[j];
+            boost::python::dict style;
+            style["name"] = st.name;
+            style["features_queried"] = st.features_queried;
+            style["features_rendered"] = st.features_rendered;
+            style["query_time"] = st.query_time;
+            style["symbolizer_time"] = st.symbolizer_time;
+            style["render_time"] = st.render_time;
+            style["label_attempts"] = st.label_attempts;
+            style["labels_placed"] = st.labels_placed;
+            styles.append(style);
+        }
+        boost::python::dict layer;
+        layer["name"] = lyr.name;
+        layer["query_time"] = lyr.query_time;
+        layer["render_time"] = lyr.render_time;
+        layer["features_queried"] = lyr.features_queried();
+        layer["features_rendered"] = lyr.features_rendered();
+        layer["styles"] = styles;
+        layers.append(layer);
+    }
+    boost::python::dict d;
+    d["total_time"] = stats.total_time;
+    d["layers"] = layers;
+    return d;
+}
+
 void render_with_detector(
     const mapnik::Map &map,
     mapnik::image_32 &image,
@@ -408,6 +532,7 @@ BOOST_PYTHON_FUNCTION_OVERLOADS(load_map_string_overloads, load_map_string, 2, 4
 BOOST_PYTHON_FUNCTION_OVERLOADS(save_map_overloads, save_map, 2, 3)
 BOOST_PYTHON_FUNCTION_OVERLOADS(save_map_to_string_overloads, save_map_to_string, 1, 2)
 BOOST_PYTHON_FUNCTION_OVERLOADS(render_overloads, render, 2, 5)
+BOOST_PYTHON_FUNCTION_OVERLOADS(render_with_stats_overloads, render_with_stats, 2, 5)
 BOOST_PYTHON_FUNCTION_OVERLOADS(render_with_detector_overloads, render_with_detector, 3, 6)
 
 BOOST_PYTHON_MODULE(_mapnik)
@@ -470,13 +595,101 @@ BOOST_PYTHON_MODULE(_mapnik)
 
     def("clear_cache", &clear_cache,
         "\n"
-        "Clear all global caches of markers and mapped memory regions.\n"
+        "Clear all global caches of markers, mapped memory regions, glyphs,\n"
+        "font files, decoded raster tiles and raster reprojection meshes.\n"
         "\n"
         "Usage:\n"
         ">>> from mapnik import clear_cache\n"
         ">>> clear_cache()\n"
         );
 
+    def("mapped_memory_cache_stats", &mapped_memory_cache_stats,
+        "\n"
+        "Get hits, misses, evictions, entries and bytes of the cache of memory\n"
+        "mapped files (shapefiles, dbf and index files).\n"
+        "\n"
+        "Usage:\n"
+        ">>> from mapnik import mapped_memory_cache_stats\n"
+        ">>> mapped_memory_cache_stats()['hits']\n"
+        );
+
+    def("set_mapped_memory_cache_limits", &set_mapped_memory_cache_limits,
+        (arg("max_bytes")=0, arg("max_entries")=0),
+        "\n"
+        "Limit the bytes and number of memory mapped files kept in the cache.\n"
+        "Least recently used files are evicted first. Zero means unlimited.\n"
+        "\n"
+        "Usage:\n"
+        ">>> from mapnik import set_mapped_memory_cache_limits\n"
+        ">>> set_mapped_memory_cache_limits(max_bytes=1024*1024*1024)\n"
+        );
+
+    def("glyph_cache_stats", &glyph_cache_stats,
+        "\n"
+        "Get hits, misses, evictions, entries and bytes of the cache of\n"
+        "rasterized glyphs and halos shared by all renderers.\n"
+        "\n"
+        "Usage:\n"
+        ">>> from mapnik import glyph_cache_stats\n"
+        ">>> glyph_cache_stats()['hits']\n"
+        );
+
+    def("set_glyph_cache_limits", &set_glyph_cache_limits,
+        (arg("max_bytes")=16*1024*1024, arg("subpixel_steps")=64),
+        "\n"
+        "Limit the bytes of rasterized glyphs kept in the cache (zero disables\n"
+        "it) and the number of subpixel positions per pixel glyphs are cached at.\n"
+        "64 renders glyphs at full precision, fewer steps (e.g. 4) give more\n"
+        "cache hits at the cost of up to half a step of positioning accuracy.\n"
+        "\n"
+        "Usage:\n"
+        ">>> from mapnik import set_glyph_cache_limits\n"
+        ">>> set_glyph_cache_limits(max_bytes=64*1024*1024, subpixel_steps=4)\n"
+        );
+
+    def("font_cache_stats", &font_cache_stats,
+        "\n"
+        "Get the font files held in memory (files, bytes), the pooled FreeType\n"
+        "libraries (libraries, idle_libraries), faces opened and reused\n"
+        "(faces_opened, face_hits) and the hits, misses and entries of the\n"
+        "glyph metrics shared by all renderers.\n"
+        "\n"
+        "Usage:\n"
+        ">>> from mapnik import font_cache_stats\n"
+        ">>> font_cache_stats()['faces_opened']\n"
+        );
+
+    def("raster_tile_cache_stats", &raster_tile_cache_stats,
+        "\n"
+        "Get hits, misses, evictions, entries and bytes of the cache of\n"
+        "decoded raster tiles shared by all renders.\n"
+        "\n"
+        "Usage:\n"
+        ">>> from mapnik import raster_tile_cache_stats\n"
+        ">>> raster_tile_cache_stats()['hits']\n"
+        );
+
+    def("warp_mesh_cache_stats", &warp_mesh_cache_stats,
+        "\n"
+        "Get hits, misses, evictions, entries and bytes of the cache of\n"
+        "projected meshes used to reproject rasters.\n"
+        "\n"
+        "Usage:\n"
+        ">>> from mapnik import warp_mesh_cache_stats\n"
+        ">>> warp_mesh_cache_stats()['hits']\n"
+        );
+
+    def("set_raster_tile_cache_limits", &set_raster_tile_cache_limits,
+        (arg("max_bytes")=64*1024*1024),
+        "\n"
+        "Limit the bytes of decoded raster tiles kept in the cache (zero\n"
+        "disables it). Least recently used tiles are evicted first.\n"
+        "\n"
+        "Usage:\n"
+        ">>> from mapnik import set_raster_tile_cache_limits\n"
+        ">>> set_raster_tile_cache_limits(max_bytes=256*1024*1024)\n"
+        );
+
     def("render_grid",&render_grid,
         ( arg("map"),
           arg("layer"),
@@ -552,6 +765,26 @@ BOOST_PYTHON_MODULE(_mapnik)
             "\n"
             ));
 
+    def("render_with_stats", &render_with_stats, render_with_stats_overloads(
+            "\n"
+            "Render Map to an AGG image_32 like render() and return where the\n"
+            "time went: a dict with the 'total_time' and a list of 'layers', each\n"
+            "with its 'name', 'query_time', 'render_time', 'features_queried',\n"
+            "'features_rendered' and a list of 'styles'. Styles have a 'name',\n"
+            "'features_queried', 'features_rendered', 'query_time',\n"
+            "'symbolizer_time', 'render_time', 'label_attempts' and 'labels_placed'.\n"
+            "Times are in milliseconds.\n"
+            "\n"
+            "Usage:\n"
+            ">>> from mapnik import Map, Image, render_with_stats, load_map\n"
+            ">>> m = Map(256,256)\n"
+            ">>> load_map(m,'mapfile.xml')\n"
+            ">>> im = Image(m.width,m.height)\n"
+            ">>> stats = render_with_stats(m,im)\n"
+            ">>> max(stats['layers'], key=lambda l: l['render_time'])['name']\n"
+            "\n"
+            ));
+
     def("render_with_detector", &render_with_detector, render_with_detector_overloads(
             "\n"
             "Render Map to an AGG image_32 using a pre-constructed detector.\n"
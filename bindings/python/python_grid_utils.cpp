@@ -22,7 +22,6 @@
 
 // boost
 #include <boost/python.hpp>
-#include <boost/scoped_array.hpp>
 #include <boost/foreach.hpp>
 
 // mapnik
@@ -33,200 +32,17 @@
 #include <mapnik/grid/grid.hpp>
 #include <mapnik/grid/grid_util.hpp>
 #include <mapnik/grid/grid_view.hpp>
+#include <mapnik/grid/grid_encoder.hpp>
 #include <mapnik/value_error.hpp>
 #include <mapnik/feature.hpp>
 #include <mapnik/feature_kv_iterator.hpp>
 #include "mapnik_value_converter.hpp"
+#include "mapnik_threads.hpp"
 #include "python_grid_utils.hpp"
 
 namespace mapnik {
 
 
-template <typename T>
-void grid2utf(T const& grid_type,
-                     boost::python::list& l,
-                     std::vector<typename T::lookup_type>& key_order)
-{
-    typedef std::map< typename T::lookup_type, typename T::value_type> keys_type;
-    typedef typename keys_type::const_iterator keys_iterator;
-
-    typename T::data_type const& data = grid_type.data();
-    typename T::feature_key_type const& feature_keys = grid_type.get_feature_keys();
-    typename T::feature_key_type::const_iterator feature_pos;
-
-    keys_type keys;
-    // start counting at utf8 codepoint 32, aka space character
-    boost::uint16_t codepoint = 32;
-
-    unsigned array_size = data.width();
-    for (unsigned y = 0; y < data.height(); ++y)
-    {
-        boost::uint16_t idx = 0;
-        boost::scoped_array<Py_UNICODE> line(new Py_UNICODE[array_size]);
-        typename T::value_type const* row = data.getRow(y);
-        for (unsigned x = 0; x < data.width(); ++x)
-        {
-            typename T::value_type feature_id = row[x];
-            feature_pos = feature_keys.find(feature_id);
-            if (feature_pos != feature_keys.end())
-            {
-                mapnik::grid::lookup_type val = feature_pos->second;
-                keys_iterator key_pos = keys.find(val);
-                if (key_pos == keys.end())
-                {
-                    // Create a new entry for this key. Skip the codepoints that
-                    // can't be encoded directly in JSON.
-                    if (codepoint == 34) ++codepoint;      // Skip "
-                    else if (codepoint == 92) ++codepoint; // Skip backslash
-                    if (feature_id == mapnik::grid::base_mask)
-                    {
-                        keys[""] = codepoint;
-                        key_order.push_back("");
-                    }
-                    else
-                    {
-                        keys[val] = codepoint;
-                        key_order.push_back(val);
-                    }
-                    line[idx++] = static_cast<Py_UNICODE>(codepoint);
-                    ++codepoint;
-                }
-                else
-                {
-                    line[idx++] = static_cast<Py_UNICODE>(key_pos->second);
-                }
-            }
-            // else, shouldn't get here...
-        }
-        l.append(boost::python::object(
-                     boost::python::handle<>(
-                         PyUnicode_FromUnicode(line.get(), array_size))));
-    }
-}
-
-
-template <typename T>
-void grid2utf(T const& grid_type,
-                     boost::python::list& l,
-                     std::vector<typename T::lookup_type>& key_order,
-                     unsigned int resolution)
-{
-    typedef std::map< typename T::lookup_type, typename T::value_type> keys_type;
-    typedef typename keys_type::const_iterator keys_iterator;
-
-    typename T::feature_key_type const& feature_keys = grid_type.get_feature_keys();
-    typename T::feature_key_type::const_iterator feature_pos;
-
-    keys_type keys;
-    // start counting at utf8 codepoint 32, aka space character
-    boost::uint16_t codepoint = 32;
-
-    unsigned array_size = std::ceil(grid_type.width()/static_cast<float>(resolution));
-    for (unsigned y = 0; y < grid_type.height(); y=y+resolution)
-    {
-        boost::uint16_t idx = 0;
-        boost::scoped_array<Py_UNICODE> line(new Py_UNICODE[array_size]);
-        mapnik::grid::value_type const* row = grid_type.getRow(y);
-        for (unsigned x = 0; x < grid_type.width(); x=x+resolution)
-        {
-            typename T::value_type feature_id = row[x];
-            feature_pos = feature_keys.find(feature_id);
-            if (feature_pos != feature_keys.end())
-            {
-                mapnik::grid::lookup_type val = feature_pos->second;
-                keys_iterator key_pos = keys.find(val);
-                if (key_pos == keys.end())
-                {
-                    // Create a new entry for this key. Skip the codepoints that
-                    // can't be encoded directly in JSON.
-                    if (codepoint == 34) ++codepoint;      // Skip "
-                    else if (codepoint == 92) ++codepoint; // Skip backslash
-                    if (feature_id == mapnik::grid::base_mask)
-                    {
-                        keys[""] = codepoint;
-                        key_order.push_back("");
-                    }
-                    else
-                    {
-                        keys[val] = codepoint;
-                        key_order.push_back(val);
-                    }
-                    line[idx++] = static_cast<Py_UNICODE>(codepoint);
-                    ++codepoint;
-                }
-                else
-                {
-                    line[idx++] = static_cast<Py_UNICODE>(key_pos->second);
-                }
-            }
-            // else, shouldn't get here...
-        }
-        l.append(boost::python::object(
-                     boost::python::handle<>(
-                         PyUnicode_FromUnicode(line.get(), array_size))));
-    }
-}
-
-
-template <typename T>
-void grid2utf2(T const& grid_type,
-                      boost::python::list& l,
-                      std::vector<typename T::lookup_type>& key_order,
-                      unsigned int resolution)
-{
-    typedef std::map< typename T::lookup_type, typename T::value_type> keys_type;
-    typedef typename keys_type::const_iterator keys_iterator;
-
-    typename T::data_type const& data = grid_type.data();
-    typename T::feature_key_type const& feature_keys = grid_type.get_feature_keys();
-    typename T::feature_key_type::const_iterator feature_pos;
-
-    keys_type keys;
-    // start counting at utf8 codepoint 32, aka space character
-    uint16_t codepoint = 32;
-
-    mapnik::grid::data_type target(data.width()/resolution,data.height()/resolution);
-    mapnik::scale_grid(target,grid_type.data(),0.0,0.0);
-
-    unsigned array_size = target.width();
-    for (unsigned y = 0; y < target.height(); ++y)
-    {
-        uint16_t idx = 0;
-        boost::scoped_array<Py_UNICODE> line(new Py_UNICODE[array_size]);
-        mapnik::grid::value_type * row = target.getRow(y);
-        unsigned x;
-        for (x = 0; x < target.width(); ++x)
-        {
-            feature_pos = feature_keys.find(row[x]);
-            if (feature_pos != feature_keys.end())
-            {
-                mapnik::grid::lookup_type val = feature_pos->second;
-                keys_iterator key_pos = keys.find(val);
-                if (key_pos == keys.end())
-                {
-                    // Create a new entry for this key. Skip the codepoints that
-                    // can't be encoded directly in JSON.
-                    if (codepoint == 34) ++codepoint;      // Skip "
-                    else if (codepoint == 92) ++codepoint; // Skip backslash
-                    keys[val] = codepoint;
-                    key_order.push_back(val);
-                    line[idx++] = static_cast<Py_UNICODE>(codepoint);
-                    ++codepoint;
-                }
-                else
-                {
-                    line[idx++] = static_cast<Py_UNICODE>(key_pos->second);
-                }
-            }
-            // else, shouldn't get here...
-        }
-        l.append(boost::python::object(
-                     boost::python::handle<>(
-                         PyUnicode_FromUnicode(line.get(), array_size))));
-    }
-}
-
-
 template <typename T>
 void write_features(T const& grid_type,
                            boost::python::dict& feature_data,
@@ -283,24 +99,23 @@ void grid_encode_utf(T const& grid_type,
                             unsigned int resolution)
 {
     // convert buffer to utf and gather key order
-    boost::python::list l;
-    std::vector<typename T::lookup_type> key_order;
-
-    if (resolution != 1) {
-        // resample on the fly - faster, less accurate
-        mapnik::grid2utf<T>(grid_type,l,key_order,resolution);
-
-        // resample first - slower, more accurate
-        //mapnik::grid2utf2<T>(grid_type,l,key_order,resolution);
+    mapnik::utf_grid utf;
+    {
+        python_unblock_auto_block b;
+        mapnik::encode_utf_grid<T>(grid_type,utf,resolution);
     }
-    else
+
+    boost::python::list l;
+    BOOST_FOREACH ( std::string const& row, utf.rows )
     {
-        mapnik::grid2utf<T>(grid_type,l,key_order);
+        l.append(boost::python::object(
+                     boost::python::handle<>(
+                         PyUnicode_DecodeUTF8(row.data(), row.size(), 0))));
     }
 
     // convert key order to proper python list
     boost::python::list keys_a;
-    BOOST_FOREACH ( typename T::lookup_type const& key_id, key_order )
+    BOOST_FOREACH ( typename T::lookup_type const& key_id, utf.keys )
     {
         keys_a.append(key_id);
     }
@@ -308,7 +123,7 @@ void grid_encode_utf(T const& grid_type,
     // gather feature data
     boost::python::dict feature_data;
     if (add_features) {
-        mapnik::write_features<T>(grid_type,feature_data,key_order);
+        mapnik::write_features<T>(grid_type,feature_data,utf.keys);
     }
 
     json["grid"] = l;
@@ -336,6 +151,26 @@ boost::python::dict grid_encode( T const& grid, std::string const& format, bool
 template boost::python::dict grid_encode( mapnik::grid const& grid, std::string const& format, bool add_features, unsigned int resolution);
 template boost::python::dict grid_encode( mapnik::grid_view const& grid, std::string const& format, bool add_features, unsigned int resolution);
 
+template <typename T>
+PyObject* grid_encode_json( T const& grid, bool add_features, unsigned int resolution)
+{
+    std::string json;
+    {
+        python_unblock_auto_block b;
+        mapnik::encode_utf_grid_json<T>(grid,json,add_features,resolution);
+    }
+    return
+#if PY_VERSION_HEX >= 0x03000000
+        ::PyBytes_FromStringAndSize
+#else
+        ::PyString_FromStringAndSize
+#endif
+        (json.data(),json.size());
+}
+
+template PyObject* grid_encode_json( mapnik::grid const& grid, bool add_features, unsigned int resolution);
+template PyObject* grid_encode_json( mapnik::grid_view const& grid, bool add_features, unsigned int resolution);
+
 /* new approach: key comes from grid object
  * grid size should be same as the map
  * encoding, resizing handled as method on grid object
@@ -32,26 +32,6 @@
 namespace mapnik {
 
 
-template <typename T>
-void grid2utf(T const& grid_type,
-                     boost::python::list& l,
-                     std::vector<typename T::lookup_type>& key_order);
-
-
-template <typename T>
-void grid2utf(T const& grid_type,
-                     boost::python::list& l,
-                     std::vector<typename T::lookup_type>& key_order,
-                     unsigned int resolution);
-
-
-template <typename T>
-void grid2utf2(T const& grid_type,
-                      boost::python::list& l,
-                      std::vector<typename T::lookup_type>& key_order,
-                      unsigned int resolution);
-
-
 template <typename T>
 void write_features(T const& grid_type,
                            boost::python::dict& feature_data,
@@ -66,6 +46,10 @@ void grid_encode_utf(T const& grid_type,
 template <typename T>
 boost::python::dict grid_encode( T const& grid, std::string const& format, bool add_features, unsigned int resolution);
 
+// the UTFGrid as a json string, encoded without holding the GIL
+template <typename T>
+PyObject* grid_encode_json( T const& grid, bool add_features, unsigned int resolution);
+
 /* new approach: key comes from grid object
  * grid size should be same as the map
  * encoding, resizing handled as method on grid object
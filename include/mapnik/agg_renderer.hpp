@@ -45,6 +45,7 @@ namespace agg { struct trans_affine; }
 // fwd declarations to speed up compile
 namespace mapnik {
   class Map;
+  class building_extrusion;
   class feature_impl;
   class feature_type_style;
   class label_collision_detector4;
@@ -64,6 +65,8 @@ class MAPNIK_DECL agg_renderer : public feature_style_processor<agg_renderer<T>
 public:
     typedef T buffer_type;
     typedef agg_renderer<T> processor_impl_type;
+    // renders composited styles on other threads, see feature_style_processor::set_concurrency()
+    typedef agg_renderer<T> offscreen_renderer_type;
     // create with default, empty placement detector
     agg_renderer(Map const& m, T & pixmap, double scale_factor=1.0, unsigned offset_x=0, unsigned offset_y=0);
     // create with external placement detector, possibly non-empty
@@ -78,6 +81,25 @@ public:
     void start_style_processing(feature_type_style const& st);
     void end_style_processing(feature_type_style const& st);
 
+    /*!
+     * \brief true if the style is drawn into a buffer of its own and composited
+     * by end_style_processing().
+     */
+    bool composites_style(feature_type_style const& st) const;
+    /*!
+     * \brief a renderer drawing into a new transparent buffer the size of this
+     * renderer's, with the same transform and scale factor.
+     *
+     * Its features are then processed without start_style_processing(), and
+     * the buffer composited with composite_offscreen_style().
+     */
+    boost::shared_ptr<offscreen_renderer_type> offscreen_renderer(Map const& m) const;
+    /*!
+     * \brief composites a style drawn by an offscreen renderer, exactly as
+     * end_style_processing() composites a style drawn by this renderer.
+     */
+    void composite_offscreen_style(feature_type_style const& st, offscreen_renderer_type & offscreen);
+
     void render_marker(pixel_position const& pos, marker const& marker, agg::trans_affine const& tr,
                        double opacity, composite_mode_e comp_op);
 
@@ -128,6 +150,10 @@ public:
     {
         return DEFAULT;
     }
+    inline label_collision_detector4 const* label_detector() const
+    {
+        return detector_.get();
+    }
 
 protected:
     template <typename R>
@@ -138,7 +164,12 @@ protected:
     void draw_geo_extent(box2d<double> const& extent,mapnik::color const& color);
 
 private:
+    // offscreen renderer drawing into buffer, without the map background
+    agg_renderer(Map const& m, boost::shared_ptr<T> const& buffer, CoordTransform const& t, double scale_factor);
+
     buffer_type & pixmap_;
+    // the buffer of styles composited by end_style_processing(),
+    // or owns pixmap_ for offscreen renderers
     boost::shared_ptr<buffer_type> internal_buffer_;
     mutable buffer_type * current_buffer_;
     mutable bool style_level_compositing_;
@@ -150,6 +181,7 @@ private:
     face_manager<freetype_engine> font_manager_;
     boost::shared_ptr<label_collision_detector4> detector_;
     boost::scoped_ptr<rasterizer> ras_ptr;
+    boost::scoped_ptr<building_extrusion> extrusion_;
     box2d<double> query_extent_;
     void setup(Map const& m);
 };
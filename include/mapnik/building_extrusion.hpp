@@ -0,0 +1,133 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_BUILDING_EXTRUSION_HPP
+#define MAPNIK_BUILDING_EXTRUSION_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/ctrans.hpp>
+#include <mapnik/noncopyable.hpp>
+#include <mapnik/vertex.hpp>
+
+// stl
+#include <vector>
+#include <utility>
+
+namespace mapnik
+{
+
+class proj_transform;
+
+/*!
+ * \brief Screen geometry of a building extruded from its footprint.
+ *
+ * Every footprint vertex is projected once, at the ground and at the roof,
+ * and the walls, the frame and the roof are emitted as vertex sources over
+ * these points. Walls are kept back to front, in the order renderers draw
+ * them one by one.
+ * Renderers keep one instance and rebuild it for every geometry, reusing
+ * its storage.
+ */
+class MAPNIK_DECL building_extrusion : private mapnik::noncopyable
+{
+public:
+    struct path_vertex
+    {
+        path_vertex(double x_, double y_, unsigned cmd_)
+            : x(x_), y(y_), cmd(cmd_) {}
+        double x;
+        double y;
+        unsigned cmd;
+    };
+
+    typedef std::vector<path_vertex> path_type;
+
+    // vertex source over one of the paths
+    class path_source
+    {
+    public:
+        path_source(path_type const& path, std::size_t first, std::size_t last)
+            : path_(path),
+              first_(first),
+              last_(last),
+              pos_(first) {}
+
+        void rewind(unsigned)
+        {
+            pos_ = first_;
+        }
+
+        unsigned vertex(double * x, double * y)
+        {
+            if (pos_ == last_) return SEG_END;
+            path_vertex const& v = path_[pos_++];
+            *x = v.x;
+            *y = v.y;
+            return v.cmd;
+        }
+
+    private:
+        path_type const& path_;
+        std::size_t first_;
+        std::size_t last_;
+        std::size_t pos_;
+    };
+
+    building_extrusion() {}
+
+    // height is in map units, added to y like the roof of a building symbolizer
+    void build(geometry_type const& geom, double height,
+               CoordTransform const& t, proj_transform const& prj_trans);
+
+    // walls, the first one furthest away
+    std::size_t wall_count() const { return walls_.size() / 4; }
+    path_source wall(std::size_t i) const { return path_source(walls_, 4 * i, 4 * i + 4); }
+
+    path_source frame() const { return path_source(frame_, 0, frame_.size()); }
+    path_source roof() const { return path_source(roof_, 0, roof_.size()); }
+
+    bool empty() const { return walls_.empty() && roof_.empty(); }
+
+private:
+    void project(CoordTransform const& t, proj_transform const& prj_trans);
+    void add_wall(std::size_t i0, std::size_t i1);
+    void add_outline(path_type & path, std::size_t offset);
+
+    // footprint vertices followed by the same vertices raised to the roof
+    std::vector<double> xs_;
+    std::vector<double> ys_;
+    std::vector<double> zs_;
+    std::vector<unsigned> commands_;
+    std::vector<bool> valid_;
+    // segments by decreasing lowest y in map coordinates
+    std::vector<std::pair<double, std::size_t> > order_;
+    path_type walls_;
+    path_type frame_;
+    path_type roof_;
+};
+
+}
+
+#endif // MAPNIK_BUILDING_EXTRUSION_HPP
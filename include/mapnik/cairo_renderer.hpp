@@ -111,6 +111,10 @@ public:
     {
         return DEFAULT;
     }
+    inline label_collision_detector4 const* label_detector() const
+    {
+        return detector_.get();
+    }
 
     void render_marker(pixel_position const& pos, marker const& marker, const agg::trans_affine & mtx, double opacity=1.0, bool recenter=true);
     void render_box(box2d<double> const& b);
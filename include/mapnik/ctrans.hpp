@@ -30,6 +30,7 @@
 
 // stl
 #include <algorithm>
+#include <cmath>
 
 namespace mapnik
 {
@@ -59,17 +60,26 @@ struct MAPNIK_DECL coord_transform
     typedef std::size_t size_type;
     typedef typename select_value_type<Geometry, void>::type value_type;
 
+    // vertices are reprojected this many at a time
+    enum { batch_size = 64 };
+
     coord_transform(Transform const& t,
                      Geometry & geom,
                      proj_transform const& prj_trans)
         : t_(&t),
         geom_(geom),
-        prj_trans_(&prj_trans)  {}
+        prj_trans_(&prj_trans),
+        pos_(0),
+        size_(0),
+        done_(false)  {}
 
     explicit coord_transform(Geometry & geom)
         : t_(0),
         geom_(geom),
-        prj_trans_(0)  {}
+        prj_trans_(0),
+        pos_(0),
+        size_(0),
+        done_(false)  {}
 
     void set_proj_trans(proj_transform const& prj_trans)
     {
@@ -83,20 +93,29 @@ struct MAPNIK_DECL coord_transform
 
     unsigned vertex(double *x, double *y) const
     {
-        unsigned command = geom_.vertex(x, y);
-        if ( command != SEG_END)
+        if (prj_trans_->equal())
         {
-            double z = 0;
-            if (!prj_trans_->backward(*x, *y, z))
-                return SEG_END;
+            unsigned command = geom_.vertex(x, y);
+            t_->forward(x, y);
+            return command;
+        }
+        if (pos_ == size_)
+        {
+            fill();
+            if (size_ == 0) return SEG_END;
         }
+        *x = xs_[pos_];
+        *y = ys_[pos_];
         t_->forward(x, y);
-        return command;
+        return commands_[pos_++];
     }
 
     void rewind(unsigned pos) const
     {
         geom_.rewind(pos);
+        pos_ = 0;
+        size_ = 0;
+        done_ = false;
     }
 
     unsigned type() const
@@ -110,9 +129,60 @@ struct MAPNIK_DECL coord_transform
     }
 
 private:
+    // reads ahead up to batch_size vertices and reprojects them in one call
+    void fill() const
+    {
+        pos_ = 0;
+        size_ = 0;
+        while (!done_ && size_ < batch_size)
+        {
+            unsigned command = geom_.vertex(&xs_[size_], &ys_[size_]);
+            if (command == SEG_END)
+            {
+                done_ = true;
+                break;
+            }
+            commands_[size_] = command;
+            source_x_[size_] = xs_[size_];
+            source_y_[size_] = ys_[size_];
+            zs_[size_] = 0;
+            ++size_;
+        }
+        if (size_ == 0) return;
+
+        // proj4 fails a whole batch, or flags single points with HUGE_VAL,
+        // where one point at a time fails just that point. Redo the rest of
+        // the batch point by point from the first suspect vertex so the
+        // output is the same either way.
+        unsigned first = 0;
+        if (prj_trans_->backward(xs_, ys_, zs_, size_))
+        {
+            while (first < size_ && xs_[first] != HUGE_VAL && ys_[first] != HUGE_VAL) ++first;
+        }
+        for (unsigned i = first; i < size_; ++i)
+        {
+            double z = 0;
+            xs_[i] = source_x_[i];
+            ys_[i] = source_y_[i];
+            if (!prj_trans_->backward(xs_[i], ys_[i], z))
+            {
+                commands_[i] = SEG_END;
+            }
+        }
+    }
+
     Transform const* t_;
     Geometry & geom_;
     proj_transform const* prj_trans_;
+    mutable unsigned pos_;
+    mutable unsigned size_;
+    mutable bool done_;
+    mutable unsigned commands_[batch_size];
+    mutable double xs_[batch_size];
+    mutable double ys_[batch_size];
+    mutable double zs_[batch_size];
+    mutable double source_x_[batch_size];
+    mutable double source_y_[batch_size];
 };
 
 class CoordTransform
@@ -85,6 +85,17 @@ public:
         }
         return factory_error_policy<key_type,product_type>::on_unknown_type(key);
     }
+
+    template <typename Arg0, typename Arg1>
+    product_type* create_object(const key_type& key,Arg0 const& arg0,Arg1 const& arg1)
+    {
+        typename product_map::const_iterator pos=map_.find(key);
+        if (pos!=map_.end())
+        {
+            return (pos->second)(arg0,arg1);
+        }
+        return factory_error_policy<key_type,product_type>::on_unknown_type(key);
+    }
 };
 }
 
@@ -82,6 +82,7 @@ public:
     size_type size() const { return mapping_.size(); }
     const_iterator begin() const { return mapping_.begin();}
     const_iterator end() const { return mapping_.end();}
+    const_iterator find(key_type const& name) const { return mapping_.find(name);}
 
 private:
     map_type mapping_;
@@ -191,7 +192,7 @@ public:
         data_ = data;
     }
 
-    context_ptr context()
+    context_ptr context() const
     {
         return ctx_;
     }
@@ -40,6 +40,9 @@ class projection;
 class proj_transform;
 class feature_type_style;
 class rule_cache;
+class rendering_stats;
+struct style_stats;
+template <bool> struct offscreen_styles;
 
 enum eAttributeCollectionPolicy
 {
@@ -51,6 +54,8 @@ template <typename Processor>
 class feature_style_processor
 {
     struct symbol_dispatch;
+    struct layer_rendering_material;
+    template <bool> friend struct offscreen_styles;
 public:
     explicit feature_style_processor(Map const& m, double scale_factor = 1.0);
 
@@ -59,6 +64,51 @@ public:
      */
     void apply();
 
+    /*!
+     * \brief set the number of threads used to query and rasterize layers in apply().
+     *
+     * With a value greater than 1 the datasources of all visible layers are queried
+     * concurrently and their features streamed through bounded queues. Styles which
+     * the renderer draws into a buffer of their own (for the agg renderer, styles
+     * with a comp-op, image filters or an opacity) and which place no labels are
+     * rasterized on these threads too, each into its own buffer, and composited in
+     * map order. All other styles, and every label, are still rendered one at a time
+     * in map order, so the output is identical to the serial path. A value of at
+     * least the number of layers puts every query in flight before the first layer
+     * is rendered. Defaults to 1 (serial).
+     * Ignored unless mapnik is built with MAPNIK_THREADSAFE.
+     */
+    void set_concurrency(unsigned concurrency);
+
+    /*!
+     * \brief number of threads used to query layer datasources in apply().
+     */
+    unsigned concurrency() const;
+
+    /*!
+     * \brief set how many features per layer may be queued ahead of rendering
+     * when concurrency() is greater than 1. 0 means unbounded. Defaults to 1024.
+     */
+    void set_prefetch_size(std::size_t size);
+
+    /*!
+     * \brief how many features per layer may be queued ahead of rendering.
+     */
+    std::size_t prefetch_size() const;
+
+    /*!
+     * \brief collect per layer and per style metrics into stats while rendering.
+     *
+     * stats is cleared and filled by every following apply(), and must outlive them.
+     * Timing adds two clock reads per feature; pass 0 (the default) to collect nothing.
+     */
+    void set_rendering_stats(rendering_stats * stats);
+
+    /*!
+     * \brief the metrics passed to set_rendering_stats(), or 0.
+     */
+    rendering_stats * get_rendering_stats() const;
+
     /*!
      * \brief apply renderer to a single layer, providing pre-populated set of query attribute names.
      */
@@ -73,19 +123,52 @@ public:
                         std::set<std::string>& names);
 
 private:
+    /*!
+     * \brief computes extents, query and active styles of a layer without rendering anything.
+     */
+    void prepare_layer(layer_rendering_material & mat,
+                       Processor & p,
+                       double scale_denom);
+
+    /*!
+     * \brief renders a prepared layer, querying its datasource unless features were prefetched.
+     */
+    void render_material(layer_rendering_material & mat, Processor & p);
+
     /*!
      * \brief renders a featureset with the given styles.
+     * \return milliseconds spent reading features, 0 without rendering stats.
+     */
+    double render_style(layer const& lay,
+                        Processor & p,
+                        feature_type_style const* style,
+                        rule_cache const& rules,
+                        std::string const& style_name,
+                        featureset_ptr features,
+                        proj_transform const& prj_trans);
+
+    /*!
+     * \brief applies the rules of a style to features, counting and timing them into st unless 0.
+     */
+    void render_features(Processor & p,
+                         feature_type_style const* style,
+                         rule_cache const& rules,
+                         featureset_ptr features,
+                         proj_transform const& prj_trans,
+                         style_stats * st,
+                         double & query_secs,
+                         double & symbolizer_secs);
+
+    /*!
+     * \brief the metrics of a style of the current layer, added on first use.
      */
-    void render_style(layer const& lay,
-                      Processor & p,
-                      feature_type_style const* style,
-                      rule_cache const& rules,
-                      std::string const& style_name,
-                      featureset_ptr features,
-                      proj_transform const& prj_trans);
+    style_stats & stats_for_style(std::string const& style_name);
 
     Map const& m_;
     double scale_factor_;
+    unsigned concurrency_;
+    std::size_t prefetch_size_;
+    rendering_stats * stats_;
 };
 }
 
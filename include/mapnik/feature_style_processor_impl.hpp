@@ -45,23 +45,37 @@
 #include <mapnik/scale_denominator.hpp>
 #include <mapnik/projection.hpp>
 #include <mapnik/proj_transform.hpp>
+#include <mapnik/noncopyable.hpp>
+#include <mapnik/rendering_stats.hpp>
+#include <mapnik/label_collision_detector.hpp>
+#include <mapnik/timer.hpp>
+#if defined(MAPNIK_THREADSAFE)
+#include <mapnik/queued_featureset.hpp>
+#endif
 
 // boost
 #include <boost/variant/apply_visitor.hpp>
 #include <boost/variant/static_visitor.hpp>
 #include <boost/foreach.hpp>
 #include <boost/concept_check.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#if defined(MAPNIK_THREADSAFE)
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#endif
 
 // stl
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 
-#if defined(RENDERING_STATS)
-#include <mapnik/timer.hpp>
-#include <iomanip>
-#include <sstream>
-#endif
-
 namespace mapnik
 {
 
@@ -137,10 +151,485 @@ struct has_process
         );
 };
 
+template <typename T> no_tag  has_offscreen_renderer_helper(...);
+template <typename T> yes_tag has_offscreen_renderer_helper(typename T::offscreen_renderer_type* p);
+
+/** True if the renderer can draw styles into buffers of their own on other threads. */
+template <typename T>
+struct has_offscreen_renderer
+{
+    BOOST_STATIC_CONSTANT(bool
+                          , value = sizeof(has_offscreen_renderer_helper<T>(0)) == sizeof(yes_tag)
+        );
+};
+
+/** True for the symbolizers which place labels or read the placed ones. */
+struct uses_label_detector : public boost::static_visitor<bool>
+{
+    bool operator() (point_symbolizer const&) const { return true; }
+    bool operator() (shield_symbolizer const&) const { return true; }
+    bool operator() (text_symbolizer const&) const { return true; }
+    bool operator() (markers_symbolizer const&) const { return true; }
+    bool operator() (debug_symbolizer const&) const { return true; }
+
+    template <typename T>
+    bool operator() (T const&) const
+    {
+        return false;
+    }
+};
+
+#if defined(MAPNIK_THREADSAFE)
+/** A style rasterized on a worker thread into a buffer of its own, which the
+ * rendering thread composites once it reaches the style.
+ */
+template <typename Processor>
+class offscreen_style_job : private mapnik::noncopyable
+{
+public:
+    offscreen_style_job()
+        : stats_(""),
+          layer_query_time_(0),
+          done_(false),
+          failed_(false) {}
+
+    virtual ~offscreen_style_job() {}
+
+    /*!
+     * \brief rasterizes the style; runs on a worker thread.
+     */
+    void run()
+    {
+        bool failed = false;
+        try
+        {
+            rasterize();
+        }
+        catch (...)
+        {
+            failed = true;
+        }
+        boost::mutex::scoped_lock lock(mutex_);
+        done_ = true;
+        failed_ = failed;
+        done_cond_.notify_all();
+    }
+
+    /*!
+     * \brief waits for the style to be rasterized.
+     * \return false if it failed, in which case it is rendered in-line so
+     * the error surfaces exactly as in the serial path.
+     */
+    bool wait()
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (!done_)
+        {
+            done_cond_.wait(lock);
+        }
+        return !failed_;
+    }
+
+    /*!
+     * \brief composites the rasterized style and releases its buffer.
+     */
+    virtual void composite(Processor & p, feature_type_style const& style) = 0;
+
+    /*!
+     * \brief feature counts and times of the rasterization, if timed.
+     */
+    style_stats const& stats() const
+    {
+        return stats_;
+    }
+
+    /*!
+     * \brief milliseconds spent querying the layer and reading its features, if timed.
+     */
+    double layer_query_time() const
+    {
+        return layer_query_time_;
+    }
+
+protected:
+    virtual void rasterize() = 0;
+
+    style_stats stats_;
+    double layer_query_time_;
+
+private:
+    bool done_;
+    bool failed_;
+    boost::mutex mutex_;
+    boost::condition_variable done_cond_;
+};
+#endif
+
+/** Everything needed to render a single layer. Computed up front by prepare_layer()
+ * so that the datasource query can be issued apart from (and ahead of) rendering.
+ */
+template <typename Processor>
+struct feature_style_processor<Processor>::layer_rendering_material : private mapnik::noncopyable
+{
+    layer_rendering_material(layer const& lay, projection const& proj0)
+        : lay_(lay),
+          proj1_(lay.srs(),true),
+          prj_trans_(proj0,proj1_),
+          query_(lay.envelope()),
+          names_(),
+          active_styles_(),
+          rule_caches_(),
+          scale_denom_(1.0),
+          composite_only_(false),
+          layer_ext2_(),
+#if defined(MAPNIK_THREADSAFE)
+          queue_(),
+          streamed_(false),
+          offscreen_(),
+#endif
+          replay_() {}
+
+    bool needs_query() const
+    {
+        return !composite_only_ && !active_styles_.empty();
+    }
+
+#if defined(MAPNIK_THREADSAFE)
+    /*!
+     * \brief the job rasterizing an active style on another thread, or 0.
+     */
+    offscreen_style_job<Processor> * offscreen(std::size_t index) const
+    {
+        return index < offscreen_.size() ? offscreen_[index].get() : 0;
+    }
+
+    /*!
+     * \brief true if some style reads the layer's features on the rendering thread.
+     */
+    bool streams() const
+    {
+        if (!needs_query()) return false;
+        for (std::size_t i = 0; i < active_styles_.size(); ++i)
+        {
+            if (!offscreen(i)) return true;
+        }
+        return false;
+    }
+
+    /*!
+     * \brief creates the queue that the prefetching thread will fill.
+     */
+    void enable_prefetch(std::size_t queue_size)
+    {
+        queue_ = boost::make_shared<feature_queue>(queue_size);
+    }
+
+    /*!
+     * \brief queries the layer's datasource and streams all features into the queue.
+     *
+     * Runs on a prefetching thread; blocks whenever the queue is full.
+     */
+    void prefetch()
+    {
+        try
+        {
+            featureset_ptr features = lay_.datasource()->features(query_);
+            if (features)
+            {
+                feature_ptr feature;
+                while ((feature = features->next()))
+                {
+                    if (!queue_->push(feature)) break;
+                }
+            }
+            queue_->close();
+        }
+        catch (std::exception const& ex)
+        {
+            queue_->close(true, ex.what());
+        }
+        catch (...)
+        {
+            queue_->close(true, "unknown error while prefetching layer '" + lay_.name() + "'");
+        }
+    }
+#endif
+
+    /*!
+     * \brief returns the layer's features, streamed from the prefetching thread if enabled.
+     *
+     * May be called once per active style. Streamed features are recorded on first
+     * use and replayed on subsequent calls only if the layer caches features,
+     * otherwise later calls query the datasource again, as the serial path does.
+     */
+    featureset_ptr features()
+    {
+        if (replay_)
+        {
+            return replay_->features(query_);
+        }
+#if defined(MAPNIK_THREADSAFE)
+        if (queue_ && !streamed_)
+        {
+            streamed_ = true;
+            // if the query failed outright, query again in-line
+            // so the error surfaces exactly as in the serial path
+            if (!queue_->failed_empty())
+            {
+                if (lay_.cache_features() && active_styles_.size() > 1 && lay_.group_by() == "")
+                {
+                    replay_ = boost::make_shared<memory_datasource>(lay_.datasource()->type(),false);
+                }
+                return boost::make_shared<queued_featureset>(queue_, replay_);
+            }
+        }
+#endif
+        return lay_.datasource()->features(query_);
+    }
+
+    /*!
+     * \brief true if features() does not go back to the datasource.
+     */
+    bool prefetched() const
+    {
+#if defined(MAPNIK_THREADSAFE)
+        return (queue_ && !streamed_) || replay_;
+#else
+        return false;
+#endif
+    }
+
+    layer const& lay_;
+    projection proj1_;
+    proj_transform prj_trans_;
+    query query_;
+    std::set<std::string> names_;
+    std::vector<feature_type_style const*> active_styles_;
+    boost::ptr_vector<rule_cache> rule_caches_;
+    double scale_denom_;
+    bool composite_only_;
+    box2d<double> layer_ext2_;
+#if defined(MAPNIK_THREADSAFE)
+    feature_queue_ptr queue_;
+    bool streamed_;
+    std::vector<boost::shared_ptr<offscreen_style_job<Processor> > > offscreen_;
+#endif
+    boost::shared_ptr<memory_datasource> replay_;
+};
+
+#if defined(MAPNIK_THREADSAFE)
+/** Hands the styles of a layer which can be drawn apart from the others to
+ * offscreen_style_jobs: styles which are composited into the map anyway and
+ * place no labels, so drawing them into a buffer of their own on another
+ * thread changes neither the image nor the label placement.
+ */
+template <bool>
+struct offscreen_styles
+{
+    template <typename Processor, typename Material>
+    class job : public offscreen_style_job<Processor>
+    {
+    public:
+        typedef typename Processor::offscreen_renderer_type renderer_type;
+
+        job(Processor const& parent, Map const& m, Material const& mat, std::size_t index, bool timed)
+            : parent_(parent),
+              m_(m),
+              mat_(mat),
+              index_(index),
+              timed_(timed),
+              renderer_() {}
+
+        void composite(Processor & p, feature_type_style const& style)
+        {
+            p.composite_offscreen_style(style, *renderer_);
+            renderer_.reset();
+        }
+
+    protected:
+        void rasterize()
+        {
+            double start = timed_ ? monotonic_time() : 0;
+            renderer_ = parent_.offscreen_renderer(m_);
+            renderer_->start_layer_processing(mat_.lay_, mat_.layer_ext2_);
+            featureset_ptr features = mat_.lay_.datasource()->features(mat_.query_);
+            double open_secs = timed_ ? monotonic_time() - start : 0;
+            double query_secs = 0;
+            double symbolizer_secs = 0;
+            offscreen_styles::render_features(*renderer_, mat_.active_styles_[index_], mat_.rule_caches_[index_],
+                                              features, mat_.prj_trans_, timed_ ? &this->stats_ : 0,
+                                              query_secs, symbolizer_secs);
+            renderer_->end_layer_processing(mat_.lay_);
+            if (timed_)
+            {
+                this->stats_.query_time = query_secs * 1000.0;
+                this->stats_.symbolizer_time = symbolizer_secs * 1000.0;
+                this->stats_.render_time = (monotonic_time() - start) * 1000.0;
+                this->layer_query_time_ = (open_secs + query_secs) * 1000.0;
+            }
+        }
+
+    private:
+        Processor const& parent_;
+        Map const& m_;
+        Material const& mat_;
+        std::size_t index_;
+        bool timed_;
+        boost::shared_ptr<renderer_type> renderer_;
+    };
+
+    template <typename Processor, typename Material>
+    static void plan(feature_style_processor<Processor> & fsp, Processor & p, Material & mat)
+    {
+        layer const& lay = mat.lay_;
+        // grouped and cached layers read their features once for all styles
+        if (!mat.needs_query() || !lay.datasource() || lay.group_by() != "" ||
+            (lay.cache_features() && mat.active_styles_.size() > 1))
+        {
+            return;
+        }
+        mat.offscreen_.resize(mat.active_styles_.size());
+        for (std::size_t i = 0; i < mat.active_styles_.size(); ++i)
+        {
+            feature_type_style const& style = *mat.active_styles_[i];
+            if (p.composites_style(style) && !places_labels(style, mat.scale_denom_))
+            {
+                mat.offscreen_[i] = boost::make_shared<job<Processor, Material> >(
+                    p, fsp.m_, mat, i, fsp.stats_ != 0);
+            }
+        }
+    }
+
+    static bool places_labels(feature_type_style const& style, double scale_denom)
+    {
+        BOOST_FOREACH(rule const& r, style.get_rules())
+        {
+            if (!r.active(scale_denom)) continue;
+            BOOST_FOREACH(symbolizer const& sym, r.get_symbolizers())
+            {
+                if (boost::apply_visitor(uses_label_detector(), sym)) return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename Renderer>
+    static void render_features(Renderer & r,
+                                feature_type_style const* style,
+                                rule_cache const& rc,
+                                featureset_ptr features,
+                                proj_transform const& prj_trans,
+                                style_stats * st,
+                                double & query_secs,
+                                double & symbolizer_secs)
+    {
+        feature_style_processor<Renderer> & fsp = r;
+        fsp.render_features(r, style, rc, features, prj_trans, st, query_secs, symbolizer_secs);
+    }
+};
+
+template <> // No-op specialization
+struct offscreen_styles<false>
+{
+    template <typename Processor, typename Material>
+    static void plan(feature_style_processor<Processor> &, Processor &, Material &) {}
+};
+
+/** Runs the work queued ahead of rendering for a list of layers on a small pool
+ * of threads: the prefetching of their features and the styles rasterized by
+ * offscreen jobs. Work is handed out in the order in which the renderer
+ * consumes it, so a thread blocked on a full queue never starves the layer or
+ * style being rendered.
+ */
+template <typename Material, typename Job>
+class layer_task_runner : private mapnik::noncopyable
+{
+public:
+    layer_task_runner(std::vector<Material*> const& materials, unsigned concurrency)
+        : materials_(materials),
+          tasks_(),
+          next_(0),
+          cancelled_(false)
+    {
+        BOOST_FOREACH(Material * mat, materials_)
+        {
+            // the queue is first drained by the first style rendered in-line
+            bool prefetch = mat->queue_.get() != 0;
+            for (std::size_t i = 0; i < mat->active_styles_.size(); ++i)
+            {
+                Job * job = mat->offscreen(i);
+                if (job)
+                {
+                    tasks_.push_back(task(mat, job));
+                }
+                else if (prefetch)
+                {
+                    tasks_.push_back(task(mat, static_cast<Job*>(0)));
+                    prefetch = false;
+                }
+            }
+        }
+        unsigned num_threads = std::min<unsigned>(concurrency, tasks_.size());
+        for (unsigned i = 0; i < num_threads; ++i)
+        {
+            threads_.create_thread(boost::bind(&layer_task_runner::run, this));
+        }
+    }
+
+    ~layer_task_runner()
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            cancelled_ = true;
+        }
+        // unblock threads waiting on queues the renderer will no longer drain
+        BOOST_FOREACH(Material * mat, materials_)
+        {
+            if (mat->queue_) mat->queue_->cancel();
+        }
+        threads_.join_all();
+    }
+
+private:
+    typedef std::pair<Material*, Job*> task;
+
+    void run()
+    {
+        for (;;)
+        {
+            task t;
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                if (cancelled_ || next_ >= tasks_.size()) return;
+                t = tasks_[next_++];
+            }
+            if (t.second)
+            {
+                t.second->run();
+            }
+            else
+            {
+                t.first->prefetch();
+            }
+        }
+    }
+
+    std::vector<Material*> const& materials_;
+    std::vector<task> tasks_;
+    std::size_t next_;
+    bool cancelled_;
+    boost::mutex mutex_;
+    boost::thread_group threads_;
+};
+#endif
+
 template <typename Processor>
 feature_style_processor<Processor>::feature_style_processor(Map const& m, double scale_factor)
     : m_(m),
-      scale_factor_(scale_factor)
+      scale_factor_(scale_factor),
+      concurrency_(1),
+      prefetch_size_(1024),
+      stats_(0)
 {
     // https://github.com/mapnik/mapnik/issues/1100
     if (scale_factor_ <= 0)
@@ -149,13 +638,51 @@ feature_style_processor<Processor>::feature_style_processor(Map const& m, double
     }
 }
 
+template <typename Processor>
+void feature_style_processor<Processor>::set_concurrency(unsigned concurrency)
+{
+    concurrency_ = concurrency > 0 ? concurrency : 1;
+}
+
+template <typename Processor>
+unsigned feature_style_processor<Processor>::concurrency() const
+{
+    return concurrency_;
+}
+
+template <typename Processor>
+void feature_style_processor<Processor>::set_prefetch_size(std::size_t size)
+{
+    prefetch_size_ = size;
+}
+
+template <typename Processor>
+std::size_t feature_style_processor<Processor>::prefetch_size() const
+{
+    return prefetch_size_;
+}
+
+template <typename Processor>
+void feature_style_processor<Processor>::set_rendering_stats(rendering_stats * stats)
+{
+    stats_ = stats;
+}
+
+template <typename Processor>
+rendering_stats * feature_style_processor<Processor>::get_rendering_stats() const
+{
+    return stats_;
+}
+
 template <typename Processor>
 void feature_style_processor<Processor>::apply()
 {
-#if defined(RENDERING_STATS)
-    std::clog << "\n//-- starting rendering timer...\n";
-    mapnik::progress_timer t(std::clog, "total map rendering");
-#endif
+    double start_time = 0;
+    if (stats_)
+    {
+        stats_->clear();
+        start_time = monotonic_time();
+    }
 
     Processor & p = static_cast<Processor&>(*this);
     p.start_map_processing(m_);
@@ -166,12 +693,62 @@ void feature_style_processor<Processor>::apply()
         double scale_denom = mapnik::scale_denominator(m_.scale(),proj.is_geographic());
         scale_denom *= scale_factor_;
 
-        BOOST_FOREACH ( layer const& lyr, m_.layers() )
+#if defined(MAPNIK_THREADSAFE)
+        if (concurrency_ > 1)
         {
-            if (lyr.visible(scale_denom))
+            // prepare every visible layer first so all queries can be in flight
+            // while the layers are rendered one after another, each consuming
+            // its features from a bounded queue as they arrive
+            boost::ptr_vector<layer_rendering_material> materials;
+            std::vector<layer_rendering_material*> material_ptrs;
+            boost::scoped_ptr<proj_init_error> deferred_error;
+            try
             {
-                std::set<std::string> names;
-                apply_to_layer(lyr, p, proj, scale_denom, names);
+                BOOST_FOREACH ( layer const& lyr, m_.layers() )
+                {
+                    if (lyr.visible(scale_denom))
+                    {
+                        std::auto_ptr<layer_rendering_material> mat(new layer_rendering_material(lyr,proj));
+                        prepare_layer(*mat, p, scale_denom);
+                        material_ptrs.push_back(mat.get());
+                        materials.push_back(mat);
+                    }
+                }
+            }
+            catch (proj_init_error const& ex)
+            {
+                // render the layers preceding the failing one, like the serial path does
+                deferred_error.reset(new proj_init_error(ex));
+            }
+
+            BOOST_FOREACH(layer_rendering_material * mat, material_ptrs)
+            {
+                offscreen_styles<has_offscreen_renderer<Processor>::value>::plan(*this, p, *mat);
+                if (mat->streams())
+                {
+                    mat->enable_prefetch(prefetch_size_);
+                }
+            }
+            layer_task_runner<layer_rendering_material, offscreen_style_job<Processor> > runner(material_ptrs, concurrency_);
+            BOOST_FOREACH(layer_rendering_material * mat, material_ptrs)
+            {
+                render_material(*mat, p);
+            }
+            if (deferred_error)
+            {
+                throw proj_init_error(*deferred_error);
+            }
+        }
+        else
+#endif
+        {
+            BOOST_FOREACH ( layer const& lyr, m_.layers() )
+            {
+                if (lyr.visible(scale_denom))
+                {
+                    std::set<std::string> names;
+                    apply_to_layer(lyr, p, proj, scale_denom, names);
+                }
             }
         }
     }
@@ -182,16 +759,22 @@ void feature_style_processor<Processor>::apply()
 
     p.end_map_processing(m_);
 
-#if defined(RENDERING_STATS)
-    t.stop();
-    std::clog << "//-- rendering timer stopped...\n\n";
-#endif
-
+    if (stats_)
+    {
+        stats_->total_time = (monotonic_time() - start_time) * 1000.0;
+    }
 }
 
 template <typename Processor>
 void feature_style_processor<Processor>::apply(mapnik::layer const& lyr, std::set<std::string>& names)
 {
+    double start_time = 0;
+    if (stats_)
+    {
+        stats_->clear();
+        start_time = monotonic_time();
+    }
+
     Processor & p = static_cast<Processor&>(*this);
     p.start_map_processing(m_);
     try
@@ -210,6 +793,11 @@ void feature_style_processor<Processor>::apply(mapnik::layer const& lyr, std::se
         MAPNIK_LOG_ERROR(feature_style_processor) << "feature_style_processor: proj_init_error=" << ex.what();
     }
     p.end_map_processing(m_);
+
+    if (stats_)
+    {
+        stats_->total_time = (monotonic_time() - start_time) * 1000.0;
+    }
 }
 
 template <typename Processor>
@@ -218,6 +806,33 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
                                                         double scale_denom,
                                                         std::set<std::string>& names)
 {
+    if (lay.styles().empty())
+    {
+        MAPNIK_LOG_DEBUG(feature_style_processor) << "feature_style_processor: No style for layer=" << lay.name();
+
+        return;
+    }
+
+    if (! lay.datasource())
+    {
+        MAPNIK_LOG_DEBUG(feature_style_processor) << "feature_style_processor: No datasource for layer=" << lay.name();
+
+        return;
+    }
+
+    layer_rendering_material mat(lay,proj0);
+    mat.names_ = names;
+    prepare_layer(mat, p, scale_denom);
+    names = mat.names_;
+    render_material(mat, p);
+}
+
+template <typename Processor>
+void feature_style_processor<Processor>::prepare_layer(layer_rendering_material & mat,
+                                                       Processor & p,
+                                                       double scale_denom)
+{
+    layer const& lay = mat.lay_;
     std::vector<std::string> const& style_names = lay.styles();
 
     unsigned int num_styles = style_names.size();
@@ -236,21 +851,8 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
         return;
     }
 
-#if defined(RENDERING_STATS)
-    progress_timer layer_timer(std::clog, "rendering total for layer: '" + lay.name() + "'");
-#endif
-
-    projection proj1(lay.srs(),true);
-    proj_transform prj_trans(proj0,proj1);
-
-#if defined(RENDERING_STATS)
-    if (! prj_trans.equal())
-    {
-        std::clog << "notice: reprojecting layer: '" << lay.name() << "' from/to:\n\t'"
-                  << lay.srs() << "'\n\t'"
-                  << m_.srs() << "'\n";
-    }
-#endif
+    proj_transform const& prj_trans = mat.prj_trans_;
+    mat.scale_denom_ = scale_denom;
 
 
     box2d<double> query_ext = m_.get_current_extent(); // unbuffered
@@ -310,28 +912,9 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
 
     if (early_return)
     {
-        // check for styles needing compositing operations applied
+        // styles needing compositing operations are still triggered by render_material()
         // https://github.com/mapnik/mapnik/issues/1477
-        BOOST_FOREACH(std::string const& style_name, style_names)
-        {
-            boost::optional<feature_type_style const&> style=m_.find_style(style_name);
-            if (!style)
-            {
-                continue;
-            }
-            if (style->comp_op() || style->image_filters().size() > 0)
-            {
-                if (style->active(scale_denom))
-                {
-                    // trigger any needed compositing ops
-                    p.start_style_processing(*style);
-                    p.end_style_processing(*style);
-                }
-            }
-        }
-#if defined(RENDERING_STATS)
-        layer_timer.discard();
-#endif
+        mat.composite_only_ = true;
         return;
     }
 
@@ -358,8 +941,7 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
             prj_trans.forward(layer_ext2, PROJ_ENVELOPE_POINTS);
         }
     }
-
-    p.start_layer_processing(lay, layer_ext2);
+    mat.layer_ext2_ = layer_ext2;
 
     double qw = query_ext.width()>0 ? query_ext.width() : 1;
     double qh = query_ext.height()>0 ? query_ext.height() : 1;
@@ -367,11 +949,11 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
                                m_.height()/qh);
 
     query q(layer_ext,res,scale_denom,m_.get_current_extent());
-    std::vector<feature_type_style const*> active_styles;
-    attribute_collector collector(names);
+    std::vector<feature_type_style const*> & active_styles = mat.active_styles_;
+    attribute_collector collector(mat.names_);
     double filt_factor = 1.0;
     directive_collector d_collector(filt_factor);
-    boost::ptr_vector<rule_cache> rule_caches;
+    boost::ptr_vector<rule_cache> & rule_caches = mat.rule_caches_;
 
     // iterate through all named styles collecting active styles and attribute names
     BOOST_FOREACH(std::string const& style_name, style_names)
@@ -422,7 +1004,7 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
         }
         else
         {
-            BOOST_FOREACH(std::string const& name, names)
+            BOOST_FOREACH(std::string const& name, mat.names_)
             {
                 q.add_property_name(name);
             }
@@ -449,26 +1031,92 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
         }
 
         // Also query the group by attribute
-        std::string group_by = lay.group_by();
+        std::string const& group_by = lay.group_by();
         if (group_by != "")
         {
             q.add_property_name(group_by);
         }
+    }
+    mat.query_ = q;
+}
 
+template <typename Processor>
+void feature_style_processor<Processor>::render_material(layer_rendering_material & mat, Processor & p)
+{
+    layer const& lay = mat.lay_;
+    std::vector<std::string> const& style_names = lay.styles();
+    if (style_names.empty() || !lay.datasource())
+    {
+        return;
+    }
+
+    if (mat.composite_only_)
+    {
+        // check for styles needing compositing operations applied
+        // https://github.com/mapnik/mapnik/issues/1477
+        double scale_denom = mat.scale_denom_;
+        BOOST_FOREACH(std::string const& style_name, style_names)
+        {
+            boost::optional<feature_type_style const&> style=m_.find_style(style_name);
+            if (!style)
+            {
+                continue;
+            }
+            if (style->comp_op() || style->image_filters().size() > 0)
+            {
+                if (style->active(scale_denom))
+                {
+                    // trigger any needed compositing ops
+                    p.start_style_processing(*style);
+                    p.end_style_processing(*style);
+                }
+            }
+        }
+        return;
+    }
+
+    layer_stats * lyr_stats = 0;
+    double layer_start = 0;
+    if (stats_)
+    {
+        stats_->layers.push_back(layer_stats(lay.name()));
+        lyr_stats = &stats_->layers.back();
+        layer_start = monotonic_time();
+    }
+
+    p.start_layer_processing(lay, mat.layer_ext2_);
+
+    proj_transform const& prj_trans = mat.prj_trans_;
+    query const& q = mat.query_;
+    std::vector<feature_type_style const*> const& active_styles = mat.active_styles_;
+    boost::ptr_vector<rule_cache> const& rule_caches = mat.rule_caches_;
+    datasource_ptr ds = lay.datasource();
+
+    // Don't even try to do more work if there are no active styles.
+    if (active_styles.size() > 0)
+    {
+        std::string const& group_by = lay.group_by();
         bool cache_features = lay.cache_features() && active_styles.size() > 1;
 
         // Render incrementally when the column that we group by
         // changes value.
         if (group_by != "")
         {
-            featureset_ptr features = ds->features(q);
+            double query_start = lyr_stats ? monotonic_time() : 0;
+            featureset_ptr features = mat.features();
+            if (lyr_stats) lyr_stats->query_time += (monotonic_time() - query_start) * 1000.0;
             if (features) {
                 // Cache all features into the memory_datasource before rendering.
                 memory_datasource cache(ds->type(),false);
                 feature_ptr feature, prev;
 
-                while ((feature = features->next()))
+                for (;;)
                 {
+                    if (lyr_stats) query_start = monotonic_time();
+                    feature = features->next();
+                    if (lyr_stats) lyr_stats->query_time += (monotonic_time() - query_start) * 1000.0;
+                    if (!feature) break;
+
                     if (prev && prev->get(group_by) != feature->get(group_by))
                     {
                         // We're at a value boundary, so render what we have
@@ -495,8 +1143,9 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
                 }
             }
         }
-        else if (cache_features)
+        else if (cache_features && !mat.prefetched())
         {
+            double query_start = lyr_stats ? monotonic_time() : 0;
             memory_datasource cache(ds->type(),false);
             featureset_ptr features = ds->features(q);
             if (features) {
@@ -507,6 +1156,7 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
                     cache.push(feature);
                 }
             }
+            if (lyr_stats) lyr_stats->query_time += (monotonic_time() - query_start) * 1000.0;
             int i = 0;
             BOOST_FOREACH (feature_type_style const* style, active_styles)
             {
@@ -515,29 +1165,59 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay, Proces
                 i++;
             }
         }
-        // We only have a single style and no grouping.
+        // We only have a single style and no grouping,
+        // or all features have already been prefetched.
         else
         {
             int i = 0;
             BOOST_FOREACH (feature_type_style const* style, active_styles)
             {
-                render_style(lay, p, style, rule_caches[i], style_names[i],
-                             ds->features(q), prj_trans);
+#if defined(MAPNIK_THREADSAFE)
+                // styles rasterized on another thread are only composited here
+                offscreen_style_job<Processor> * job = mat.offscreen(i);
+                if (job && job->wait())
+                {
+                    double composite_start = lyr_stats ? monotonic_time() : 0;
+                    job->composite(p, *style);
+                    if (lyr_stats)
+                    {
+                        style_stats const& job_stats = job->stats();
+                        style_stats & st = stats_for_style(style_names[i]);
+                        st.features_queried += job_stats.features_queried;
+                        st.features_rendered += job_stats.features_rendered;
+                        st.query_time += job_stats.query_time;
+                        st.symbolizer_time += job_stats.symbolizer_time;
+                        st.render_time += job_stats.render_time + (monotonic_time() - composite_start) * 1000.0;
+                        lyr_stats->query_time += job->layer_query_time();
+                    }
+                    i++;
+                    continue;
+                }
+#endif
+                // replayed features are read from memory, not from the datasource
+                bool replayed = mat.replay_.get() != 0;
+                // creating the featureset is where most datasources run their query
+                double query_start = lyr_stats ? monotonic_time() : 0;
+                featureset_ptr features = mat.features();
+                if (lyr_stats) lyr_stats->query_time += (monotonic_time() - query_start) * 1000.0;
+                double read_time = render_style(lay, p, style, rule_caches[i], style_names[i],
+                                                features, prj_trans);
+                if (lyr_stats && !replayed) lyr_stats->query_time += read_time;
                 i++;
             }
         }
     }
 
-#if defined(RENDERING_STATS)
-    layer_timer.stop();
-#endif
-
     p.end_layer_processing(lay);
-}
 
+    if (lyr_stats)
+    {
+        lyr_stats->render_time = (monotonic_time() - layer_start) * 1000.0;
+    }
+}
 
 template <typename Processor>
-void feature_style_processor<Processor>::render_style(
+double feature_style_processor<Processor>::render_style(
     layer const& lay,
     Processor & p,
     feature_type_style const* style,
@@ -546,43 +1226,79 @@ void feature_style_processor<Processor>::render_style(
     featureset_ptr features,
     proj_transform const& prj_trans)
 {
-    p.start_style_processing(*style);
-    if (!features)
+    style_stats * st = 0;
+    label_collision_detector4 const* detector = 0;
+    std::size_t label_attempts = 0;
+    std::size_t labels_placed = 0;
+    double style_start = 0;
+    double query_secs = 0;
+    double symbolizer_secs = 0;
+    if (stats_)
     {
-        p.end_style_processing(*style);
-        return;
+        st = &stats_for_style(style_name);
+        detector = p.label_detector();
+        if (detector)
+        {
+            label_attempts = detector->placement_tests();
+            labels_placed = detector->insertions();
+        }
+        style_start = monotonic_time();
     }
 
-#if defined(RENDERING_STATS)
-    std::ostringstream s1;
-    s1 << "rendering style for layer: '" << lay.name()
-       << "' and style '" << style_name << "'";
-    mapnik::progress_timer style_timer(std::clog, s1.str());
+    p.start_style_processing(*style);
+    render_features(p, style, rc, features, prj_trans, st, query_secs, symbolizer_secs);
+    p.end_style_processing(*style);
 
-    int feature_processed_count = 0;
-    int feature_count = 0;
-#endif
+    if (st)
+    {
+        st->query_time += query_secs * 1000.0;
+        st->symbolizer_time += symbolizer_secs * 1000.0;
+        st->render_time += (monotonic_time() - style_start) * 1000.0;
+        if (detector)
+        {
+            st->label_attempts += detector->placement_tests() - label_attempts;
+            st->labels_placed += detector->insertions() - labels_placed;
+        }
+    }
+    return query_secs * 1000.0;
+}
 
-    feature_ptr feature;
-    while ((feature = features->next()))
+template <typename Processor>
+void feature_style_processor<Processor>::render_features(
+    Processor & p,
+    feature_type_style const* style,
+    rule_cache const& rc,
+    featureset_ptr features,
+    proj_transform const& prj_trans,
+    style_stats * st,
+    double & query_secs,
+    double & symbolizer_secs)
+{
+    if (features)
     {
-#if defined(RENDERING_STATS)
-        feature_count++;
-        bool feat_processed = false;
-#endif
+        // two clock reads per feature split the time between reading
+        // features and processing them
+        double t = st ? monotonic_time() : 0;
+        feature_ptr feature;
+        while ((feature = features->next()))
+        {
+            if (st)
+            {
+                double now = monotonic_time();
+                query_secs += now - t;
+                t = now;
+            }
 
-        bool do_else = true;
-        bool do_also = false;
+            bool rendered = false;
+            bool do_else = true;
+            bool do_also = false;
 
-        BOOST_FOREACH(rule const* r, rc.get_if_rules() )
-        {
-            expression_ptr const& expr=r->get_filter();
-            value_type result = boost::apply_visitor(evaluate<Feature,value_type>(*feature),*expr);
-            if (result.to_bool())
+            rc.bind(*feature);
+            rule_cache::rule_ptrs const& if_rules = rc.get_if_rules();
+            for (std::size_t i = rc.next_match(0); i != rule_cache::no_match; i = rc.next_match(i + 1))
             {
-#if defined(RENDERING_STATS)
-                feat_processed = true;
-#endif
+                rule const* r = if_rules[i];
+                rendered = true;
 
                 p.painted(true);
 
@@ -607,78 +1323,75 @@ void feature_style_processor<Processor>::render_style(
                     break;
                 }
             }
-        }
-        if (do_else)
-        {
-            BOOST_FOREACH( rule const* r, rc.get_else_rules() )
+            if (do_else)
             {
-#if defined(RENDERING_STATS)
-                feat_processed = true;
-#endif
+                BOOST_FOREACH( rule const* r, rc.get_else_rules() )
+                {
+                    rendered = true;
 
-                p.painted(true);
+                    p.painted(true);
 
-                rule::symbolizers const& symbols = r->get_symbolizers();
-                // if the underlying renderer is not able to process the complete set of symbolizers,
-                // process one by one.
-                if(!p.process(symbols,*feature,prj_trans))
-                {
-                    BOOST_FOREACH (symbolizer const& sym, symbols)
+                    rule::symbolizers const& symbols = r->get_symbolizers();
+                    // if the underlying renderer is not able to process the complete set of symbolizers,
+                    // process one by one.
+                    if(!p.process(symbols,*feature,prj_trans))
                     {
-                        boost::apply_visitor(symbol_dispatch(p,*feature,prj_trans),sym);
+                        BOOST_FOREACH (symbolizer const& sym, symbols)
+                        {
+                            boost::apply_visitor(symbol_dispatch(p,*feature,prj_trans),sym);
+                        }
                     }
                 }
             }
-        }
-        if (do_also)
-        {
-            BOOST_FOREACH( rule const* r, rc.get_also_rules() )
+            if (do_also)
             {
-#if defined(RENDERING_STATS)
-                feat_processed = true;
-#endif
+                BOOST_FOREACH( rule const* r, rc.get_also_rules() )
+                {
+                    rendered = true;
 
-                p.painted(true);
+                    p.painted(true);
 
-                rule::symbolizers const& symbols = r->get_symbolizers();
-                // if the underlying renderer is not able to process the complete set of symbolizers,
-                // process one by one.
-                if(!p.process(symbols,*feature,prj_trans))
-                {
-                    BOOST_FOREACH (symbolizer const& sym, symbols)
+                    rule::symbolizers const& symbols = r->get_symbolizers();
+                    // if the underlying renderer is not able to process the complete set of symbolizers,
+                    // process one by one.
+                    if(!p.process(symbols,*feature,prj_trans))
                     {
-                        boost::apply_visitor(symbol_dispatch(p,*feature,prj_trans),sym);
+                        BOOST_FOREACH (symbolizer const& sym, symbols)
+                        {
+                            boost::apply_visitor(symbol_dispatch(p,*feature,prj_trans),sym);
+                        }
                     }
                 }
             }
+
+            if (st)
+            {
+                ++st->features_queried;
+                if (rendered) ++st->features_rendered;
+                double now = monotonic_time();
+                symbolizer_secs += now - t;
+                t = now;
+            }
+        }
+        if (st)
+        {
+            // the final read which returned no feature
+            query_secs += monotonic_time() - t;
         }
-#if defined(RENDERING_STATS)
-        if (feat_processed)
-            feature_processed_count++;
-#endif
     }
+}
 
-#if defined(RENDERING_STATS)
-    style_timer.stop();
-
-    // done with style
-    std::ostringstream s;
-    if (feature_count > 0)
-    {
-        double perc_processed = ((double)feature_processed_count/(double)feature_count)*100.0;
-
-        s << "percent rendered: " << perc_processed << "% - " << feature_processed_count
-          << " rendered for " << feature_count << " queried for ";
-        s << std::setw(15 - (int)s.tellp()) << " layer '" << lay.name() << "' and style '" << style_name << "'\n";
-    }
-    else
+template <typename Processor>
+style_stats & feature_style_processor<Processor>::stats_for_style(std::string const& style_name)
+{
+    // styles rendered once per group_by value accumulate into one entry
+    std::vector<style_stats> & styles = stats_->layers.back().styles;
+    for (std::size_t i = 0; i < styles.size(); ++i)
     {
-        s << "" << std::setw(15) << "- no features returned from query for layer '" << lay.name() << "' and style '" << style_name << "'\n";
+        if (styles[i].name == style_name) return styles[i];
     }
-    std::clog << s.str();
-    style_timer.discard();
-#endif
-    p.end_style_processing(*style);
+    styles.push_back(style_stats(style_name));
+    return styles.back();
 }
 
 }
@@ -0,0 +1,150 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_FILTER_PROGRAM_HPP
+#define MAPNIK_FILTER_PROGRAM_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/noncopyable.hpp>
+
+// stl
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+/*!
+ * \brief A set of filter expressions compiled into a single flat instruction list.
+ *
+ * Identical subexpressions, across all compiled filters, share one instruction
+ * (e.g. `[highway]` or `[highway]='primary'` used by many rules of a style), and
+ * their result is computed at most once per feature. Subexpressions without
+ * attribute references are folded into constants at compile time. Attribute
+ * names are resolved to indices of the feature's context once per context
+ * instead of once per evaluation.
+ *
+ * Evaluation keeps per-feature state, so an instance must not be shared
+ * between threads.
+ */
+class MAPNIK_DECL filter_program : private mapnik::noncopyable
+{
+public:
+    typedef std::size_t program_id;
+
+    filter_program();
+
+    /*!
+     * \brief compiles a filter expression.
+     * \return identifier to pass to evaluate().
+     */
+    program_id compile(expr_node const& expr);
+
+    /*!
+     * \brief starts evaluating filters for a new feature.
+     *
+     * Results of shared subexpressions are kept until the next call.
+     */
+    void bind(feature_impl const& feature) const;
+
+    /*!
+     * \brief evaluates a compiled filter on the feature passed to bind().
+     */
+    bool evaluate(program_id id) const;
+
+    /*!
+     * \brief value of a compiled expression for the feature passed to bind().
+     */
+    value_type const& value(program_id id) const;
+
+    /*!
+     * \brief true if a compiled filter was folded into a constant.
+     */
+    bool is_constant(program_id id) const;
+
+    /*!
+     * \brief number of distinct instructions after sharing and folding.
+     */
+    std::size_t size() const;
+
+private:
+    friend struct filter_compiler;
+
+    enum opcode
+    {
+        op_constant,
+        op_attribute,
+        op_geometry_type,
+        op_negate,
+        op_plus,
+        op_minus,
+        op_mult,
+        op_div,
+        op_mod,
+        op_less,
+        op_less_equal,
+        op_greater,
+        op_greater_equal,
+        op_equal_to,
+        op_not_equal_to,
+        op_logical_not,
+        op_logical_and,
+        op_logical_or,
+        op_regex_match,
+        op_regex_replace
+    };
+
+    struct instruction
+    {
+        instruction(opcode o, std::size_t l = 0, std::size_t r = 0)
+            : op(o), left(l), right(r), constant(), name(), index(0), match(0), replace(0) {}
+        opcode op;
+        std::size_t left;
+        std::size_t right;
+        value_type constant;          // op_constant
+        std::string name;             // op_attribute
+        mutable std::size_t index;    // op_attribute, resolved per context
+        regex_match_node const* match;     // op_regex_match
+        regex_replace_node const* replace; // op_regex_replace
+    };
+
+    std::size_t add(instruction const& instr, std::string const& key);
+    value_type const& eval(std::size_t i) const;
+
+    std::vector<instruction> code_;
+    std::map<std::string, std::size_t> keys_;
+    // per-feature evaluation state
+    mutable std::vector<value_type> values_;
+    mutable std::vector<unsigned> stamps_;
+    mutable unsigned generation_;
+    mutable feature_impl const* feature_;
+    mutable context_ptr context_;
+    mutable std::size_t context_size_;
+};
+
+}
+
+#endif // MAPNIK_FILTER_PROGRAM_HPP
@@ -33,6 +33,7 @@
 #include <mapnik/char_info.hpp>
 #include <mapnik/pixel_position.hpp>
 #include <mapnik/image_compositing.hpp>
+#include <mapnik/glyph_cache.hpp>
 #include <mapnik/noncopyable.hpp>
 
 // freetype2
@@ -67,9 +68,17 @@ namespace mapnik
 class font_face;
 class text_path;
 class string_info;
+struct font_library;
 
 typedef boost::shared_ptr<font_face> face_ptr;
 
+// contents of a font file, shared by all faces opened from it
+typedef boost::shared_ptr<std::string const> font_buffer_ptr;
+
+// a FreeType library, released with FT_Done_FreeType once the last engine,
+// face or stroker using it is gone
+typedef boost::shared_ptr<FT_LibraryRec_> ft_library_ptr;
+
 class MAPNIK_DECL font_glyph : private mapnik::noncopyable
 {
 public:
@@ -95,8 +104,16 @@ typedef boost::shared_ptr<font_glyph> glyph_ptr;
 class font_face : mapnik::noncopyable
 {
 public:
-    font_face(FT_Face face)
-        : face_(face) {}
+    font_face(FT_Face face, std::string const& name = std::string(),
+              font_buffer_ptr const& buffer = font_buffer_ptr(),
+              ft_library_ptr const& library = ft_library_ptr())
+        : face_(face), name_(name), buffer_(buffer), library_(library) {}
+
+    // name the face was registered with, empty for unregistered faces
+    std::string const& name() const
+    {
+        return name_;
+    }
 
     std::string  family_name() const
     {
@@ -144,6 +161,11 @@ public:
 
 private:
     FT_Face face_;
+    std::string name_;
+    // a memory face reads from the buffer until FT_Done_Face
+    font_buffer_ptr buffer_;
+    // and belongs to the library it was opened in
+    ft_library_ptr library_;
 };
 
 class MAPNIK_DECL font_face_set : private mapnik::noncopyable
@@ -154,12 +176,19 @@ public:
 
     font_face_set(void)
         : faces_(),
-        dimension_cache_() {}
+        dimension_cache_(),
+        faces_key_(),
+        shared_metrics_(true),
+        size_(0) {}
 
     void add(face_ptr face)
     {
         faces_.push_back(face);
         dimension_cache_.clear(); //Make sure we don't use old cached data
+        // only registered faces are shared between face sets
+        if (face->name().empty()) shared_metrics_ = false;
+        faces_key_ += face->name();
+        faces_key_ += '\n';
     }
 
     size_type size() const
@@ -189,6 +218,8 @@ public:
         {
             face->set_pixel_sizes(size);
         }
+        // negative to tell pixel sizes from character sizes
+        set_size(-static_cast<long>(size));
     }
 
     void set_character_sizes(double size)
@@ -197,18 +228,31 @@ public:
         {
             face->set_character_sizes(size);
         }
+        set_size(static_cast<long>(size * (1<<6)));
     }
 private:
+    void set_size(long size)
+    {
+        if (size != size_)
+        {
+            dimension_cache_.clear();
+            size_ = size;
+        }
+    }
+
     container_type faces_;
     std::map<unsigned, char_info> dimension_cache_;
+    std::string faces_key_; // registered names of the faces, in order
+    bool shared_metrics_;
+    long size_;             // as set on the faces, 0 until set
 };
 
 // FT_Stroker wrapper
 class stroker : mapnik::noncopyable
 {
 public:
-    explicit stroker(FT_Stroker s)
-        : s_(s) {}
+    stroker(FT_Stroker s, ft_library_ptr const& library)
+        : s_(s), library_(library) {}
 
     void init(double radius)
     {
@@ -229,6 +273,7 @@ public:
     }
 private:
     FT_Stroker s_;
+    ft_library_ptr library_;
 };
 
 
@@ -236,7 +281,35 @@ private:
 typedef boost::shared_ptr<font_face_set> face_set_ptr;
 typedef boost::shared_ptr<stroker> stroker_ptr;
 
-class MAPNIK_DECL freetype_engine
+struct font_cache_stats
+{
+    font_cache_stats()
+        : files(0), bytes(0), libraries(0), idle_libraries(0),
+          faces_opened(0), face_hits(0),
+          metrics_hits(0), metrics_misses(0), metrics_entries(0) {}
+    std::size_t files;           // font files held in memory
+    std::size_t bytes;           // their size
+    std::size_t libraries;       // FreeType libraries in the pool
+    std::size_t idle_libraries;  // not checked out by an engine
+    std::size_t faces_opened;
+    std::size_t face_hits;       // faces reused from a pooled library
+    std::size_t metrics_hits;
+    std::size_t metrics_misses;
+    std::size_t metrics_entries;
+};
+
+/*!
+ * \brief Opens registered font faces.
+ *
+ * Font files are read into memory once per process and faces are opened
+ * from these buffers. Every engine checks out a FreeType library from a
+ * process wide pool for its lifetime and returns it, together with the faces
+ * opened in it, when destroyed. Faces are therefore reused by later engines
+ * but never used by two engines, and so by two threads, at the same time.
+ * Faces and strokers keep their library alive, but must not be used after
+ * their engine is destroyed, when another engine may check the library out.
+ */
+class MAPNIK_DECL freetype_engine : private mapnik::noncopyable
 {
 public:
     static bool is_font_file(std::string const& file_name);
@@ -257,10 +330,20 @@ public:
     static std::map<std::string,std::pair<int,std::string> > const& get_mapping();
     face_ptr create_face(std::string const& family_name);
     stroker_ptr create_stroker();
+
+    /*! \brief statistics of the font buffers, library pool and glyph metrics shared by all engines.
+     */
+    static font_cache_stats cache_stats();
+
+    /*! \brief release font buffers, idle libraries with their faces and cached glyph metrics.
+     *  Faces still in use keep their buffer and library until they are released.
+     */
+    static void clear_cache();
+
     virtual ~freetype_engine();
     freetype_engine();
 private:
-    FT_Library library_;
+    font_library * library_;
 #ifdef MAPNIK_THREADSAFE
     static boost::mutex mutex_;
 #endif
@@ -361,8 +444,10 @@ struct text_renderer : private mapnik::noncopyable
     {
         FT_Glyph image;
         char_properties *properties;
-        glyph_t(FT_Glyph image_, char_properties *properties_)
-            : image(image_), properties(properties_) {}
+        glyph_cache_key key; // without subpixel offset and stroke
+        FT_Vector pen;
+        glyph_t(FT_Glyph image_, char_properties *properties_, glyph_cache_key const& key_, FT_Vector pen_)
+            : image(image_), properties(properties_), key(key_), pen(pen_) {}
         ~glyph_t () { FT_Done_Glyph(image);}
     };
 
@@ -380,40 +465,35 @@ struct text_renderer : private mapnik::noncopyable
 
 private:
     
-    void render_bitmap(FT_Bitmap *bitmap, unsigned rgba, int x, int y, double opacity)
-    {
-        int x_max=x+bitmap->width;
-        int y_max=y+bitmap->rows;
-        int i,p,j,q;
+    glyph_bitmap_ptr rasterize(glyph_t const& glyph, FT_Vector const& start, double stroke_radius,
+                               unsigned steps, int & x, int & y);
 
-        for (i=x,p=0;i<x_max;++i,++p)
+    // blends the bitmap one clipped row at a time with the renderer's comp_op
+    void render_bitmap(glyph_bitmap const& bitmap, unsigned rgba, int x, int y, double opacity)
+    {
+        if (bitmap.width == 0) return;
+        for (unsigned row = 0; row < bitmap.rows; ++row)
         {
-            for (j=y,q=0;j<y_max;++j,++q)
-            {
-                int gray=bitmap->buffer[q*bitmap->width+p];
-                if (gray)
-                {
-                    pixmap_.blendPixel2(i, j, rgba, gray, opacity);
-                }
-            }
+            pixmap_.composite_span(comp_op_, x, y + row, rgba,
+                                   &bitmap.buffer[row * bitmap.width], bitmap.width, opacity);
         }
     }
 
-    void render_bitmap_id(FT_Bitmap *bitmap,int feature_id,int x,int y)
+    void render_bitmap_id(glyph_bitmap const& bitmap,int feature_id,int x,int y)
     {
-        int x_max=x+bitmap->width;
-        int y_max=y+bitmap->rows;
-        int i,p,j,q;
-
-        for (i=x,p=0;i<x_max;++i,++p)
+        int x0 = std::max(x, 0);
+        int x1 = std::min(x + static_cast<int>(bitmap.width), static_cast<int>(pixmap_.width()));
+        int y0 = std::max(y, 0);
+        int y1 = std::min(y + static_cast<int>(bitmap.rows), static_cast<int>(pixmap_.height()));
+        for (int j = y0; j < y1; ++j)
         {
-            for (j=y,q=0;j<y_max;++j,++q)
+            unsigned char const* covers = &bitmap.buffer[(j - y) * bitmap.width];
+            typename pixmap_type::value_type * row = pixmap_.data().getRow(j);
+            for (int i = x0; i < x1; ++i)
             {
-                int gray=bitmap->buffer[q*bitmap->width+p];
-                if (gray)
+                if (covers[i - x])
                 {
-                    pixmap_.setPixel(i,j,feature_id);
-                    //pixmap_.blendPixel2(i,j,rgba,gray,opacity_);
+                    row[i] = feature_id;
                 }
             }
         }
@@ -25,6 +25,7 @@
 
 // mapnik
 #include <mapnik/vertex_vector.hpp>
+#include <mapnik/vertex_array.hpp>
 #include <mapnik/box2d.hpp>
 #include <mapnik/noncopyable.hpp>
 
@@ -41,7 +42,7 @@ enum eGeomType {
     Polygon = 3
 };
 
-template <typename T, template <typename> class Container=vertex_vector>
+template <typename T, template <typename> class Container=vertex_array>
 class geometry : private mapnik::noncopyable
 {
 public:
@@ -53,16 +54,19 @@ private:
     container_type cont_;
     eGeomType type_;
     mutable unsigned itr_;
+    box2d<double> envelope_;
 public:
 
     geometry()
         : type_(Unknown),
-          itr_(0)
+          itr_(0),
+          envelope_()
     {}
 
     explicit geometry(eGeomType type)
         : type_(type),
-          itr_(0)
+          itr_(0),
+          envelope_()
     {}
 
     eGeomType type() const
@@ -85,31 +89,57 @@ public:
         return cont_.size();
     }
 
-    box2d<double> envelope() const
+    // bounding box of all vertices except SEG_CLOSE ones, kept up to date
+    // as vertices are added; invalid while the geometry is empty
+    box2d<double> const& envelope() const
     {
-        box2d<double> result;
-        double x = 0;
-        double y = 0;
-        rewind(0);
-        for (unsigned i=0; i < size(); ++i)
+        return envelope_;
+    }
+
+    void push_vertex(coord_type x, coord_type y, CommandType c)
+    {
+        cont_.push_back(x,y,c);
+        if (c != SEG_CLOSE) expand_envelope(x,y);
+    }
+
+    // appends count vertices stored as interleaved x,y coord_type values
+    void append_vertices(void const* xy, size_type count, CommandType c)
+    {
+        size_type first = cont_.size();
+        cont_.append(xy,count,c);
+        if (c != SEG_CLOSE)
         {
-            unsigned cmd = vertex(&x,&y);
-            if (cmd == SEG_CLOSE) continue;
-            if (i == 0)
-            {
-                result.init(x,y,x,y);
-            }
-            else
+            double x = 0;
+            double y = 0;
+            for (size_type i = first; i < cont_.size(); ++i)
             {
-                result.expand_to_include(x,y);
+                cont_.get_vertex(i,&x,&y);
+                expand_envelope(x,y);
             }
         }
-        return result;
     }
 
-    void push_vertex(coord_type x, coord_type y, CommandType c)
+    // interleaved x,y coordinates of all vertices, for transforming them in
+    // place; call update_envelope() once done
+    coord_type * coords()
     {
-        cont_.push_back(x,y,c);
+        return cont_.coords();
+    }
+
+    void update_envelope()
+    {
+        envelope_ = box2d<double>();
+        double x = 0;
+        double y = 0;
+        for (size_type i = 0; i < cont_.size(); ++i)
+        {
+            if (cont_.get_vertex(i,&x,&y) != SEG_CLOSE) expand_envelope(x,y);
+        }
+    }
+
+    void reserve(size_type size)
+    {
+        cont_.reserve(size);
     }
 
     void line_to(coord_type x,coord_type y)
@@ -169,9 +199,22 @@ public:
     {
         itr_=0;
     }
+
+private:
+    void expand_envelope(double x, double y)
+    {
+        if (envelope_.valid())
+        {
+            envelope_.expand_to_include(x,y);
+        }
+        else
+        {
+            envelope_.init(x,y,x,y);
+        }
+    }
 };
 
-typedef geometry<double,vertex_vector> geometry_type;
+typedef geometry<double,vertex_array> geometry_type;
 typedef boost::shared_ptr<geometry_type> geometry_ptr;
 typedef boost::ptr_vector<geometry_type> geometry_container;
 
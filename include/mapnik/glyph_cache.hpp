@@ -0,0 +1,140 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GLYPH_CACHE_HPP
+#define MAPNIK_GLYPH_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/utils.hpp>
+#include <mapnik/noncopyable.hpp>
+#include <mapnik/lru_cache.hpp>
+
+// boost
+#include <boost/shared_ptr.hpp>
+
+// stl
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+/*!
+ * \brief Identifies one rasterized glyph.
+ *
+ * Sizes, radii and offsets are in 26.6 fixed point and the rotation in
+ * 16.16, as passed to FreeType.
+ */
+struct glyph_cache_key
+{
+    glyph_cache_key()
+        : face(), index(0), size(0), xx(0), xy(0), x(0), y(0), stroke(0) {}
+    std::string face;  // registered face name
+    unsigned index;    // glyph index in the face
+    long size;         // character size
+    long xx;           // rotation matrix, yx and yy follow from these
+    long xy;
+    long x;            // subpixel offset of the glyph origin, in [0,64)
+    long y;
+    long stroke;       // halo radius, 0 for the glyph itself
+
+    bool operator==(glyph_cache_key const& other) const
+    {
+        return index == other.index && size == other.size &&
+            xx == other.xx && xy == other.xy &&
+            x == other.x && y == other.y &&
+            stroke == other.stroke && face == other.face;
+    }
+};
+
+MAPNIK_DECL std::size_t hash_value(glyph_cache_key const& key);
+
+/*!
+ * \brief 8 bit coverage of a rasterized glyph, rows stored top down
+ * without padding. left and top are relative to the glyph origin, y up.
+ */
+struct glyph_bitmap
+{
+    glyph_bitmap()
+        : left(0), top(0), width(0), rows(0), buffer() {}
+    int left;
+    int top;
+    unsigned width;
+    unsigned rows;
+    std::vector<unsigned char> buffer;
+};
+
+typedef boost::shared_ptr<glyph_bitmap const> glyph_bitmap_ptr;
+
+typedef lru_cache_stats glyph_cache_stats;
+
+/*!
+ * \brief Process wide cache of rasterized glyphs and glyph halos, shared by
+ * all text renderers.
+ *
+ * Subpixel offsets are quantized to subpixel_steps() positions per pixel
+ * before lookup. The default of 64 keeps FreeType's full precision, so
+ * output is identical to uncached rendering; fewer steps (e.g. 4) trade up
+ * to half a step of positioning accuracy for far more cache hits.
+ */
+class MAPNIK_DECL glyph_cache :
+        public singleton<glyph_cache, CreateStatic>,
+        private mapnik::noncopyable
+{
+    friend class CreateStatic<glyph_cache>;
+public:
+    glyph_bitmap_ptr find(glyph_cache_key const& key);
+    void insert(glyph_cache_key const& key, glyph_bitmap_ptr const& bitmap);
+    void clear();
+
+    // zero disables the cache, default is 16MB
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const;
+
+    // one of 1, 2, 4, 8, 16, 32 or 64. Renderers read it once per label.
+    void set_subpixel_steps(unsigned steps);
+    unsigned subpixel_steps() const;
+
+    /*!
+     * \brief splits a 26.6 coordinate into whole pixels and a subpixel
+     * offset quantized to steps positions per pixel, rounding to the
+     * nearest step.
+     */
+    static void quantize(long pos, unsigned steps, long & pixel, long & subpixel);
+
+    glyph_cache_stats stats() const;
+    void reset_stats();
+
+private:
+    glyph_cache();
+
+    sharded_lru_cache<glyph_cache_key, glyph_bitmap_ptr> cache_;
+#ifdef MAPNIK_THREADSAFE
+    mutable mutex steps_mutex_;
+#endif
+    unsigned subpixel_steps_;
+};
+
+}
+
+#endif // MAPNIK_GLYPH_CACHE_HPP
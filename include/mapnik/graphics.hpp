@@ -187,6 +187,10 @@ public:
 
     void composite_pixel(unsigned op, int x,int y,unsigned c, unsigned cover, double opacity);
 
+    // composites len coverage values as a horizontal run starting at (x,y), clipped to the image.
+    // Same result as composite_pixel() for each covered pixel.
+    void composite_span(unsigned op, int x, int y, unsigned c, unsigned char const* covers, int len, double opacity);
+
     inline unsigned width() const
     {
         return width_;
@@ -0,0 +1,67 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GRID_ENCODER_HPP
+#define MAPNIK_GRID_ENCODER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+/*!
+ * \brief A hit grid encoded as UTFGrid.
+ *
+ * Every sampled pixel is one character. The n-th distinct character,
+ * counting from U+0020 and skipping '"', '\' and surrogates, stands for
+ * keys[n]; an empty key marks pixels without a feature.
+ */
+struct utf_grid
+{
+    std::vector<std::string> rows; // UTF-8
+    std::vector<std::string> keys;
+};
+
+/*!
+ * \brief encode every resolution-th pixel of every resolution-th row of a grid or grid_view.
+ */
+template <typename T>
+MAPNIK_DECL void encode_utf_grid(T const& grid, utf_grid & result, unsigned resolution = 4);
+
+/*!
+ * \brief append the UTFGrid JSON of a grid or grid_view to a buffer.
+ *
+ * Writes {"grid":[...],"keys":[...],"data":{...}}, where data holds the
+ * property_names() of the features of all keys when add_features is true.
+ */
+template <typename T>
+MAPNIK_DECL void encode_utf_grid_json(T const& grid, std::string & json,
+                                      bool add_features = true, unsigned resolution = 4);
+
+}
+
+#endif // MAPNIK_GRID_ENCODER_HPP
@@ -46,6 +46,7 @@ namespace agg { struct trans_affine; }
 // fwd declarations to speed up compile
 namespace mapnik {
   class Map;
+  class building_extrusion;
   class feature_impl;
   class feature_type_style;
   class label_collision_detector4;
@@ -120,6 +121,10 @@ public:
     {
         return DEFAULT;
     }
+    inline label_collision_detector4 const* label_detector() const
+    {
+        return detector_.get();
+    }
 
 private:
     buffer_type & pixmap_;
@@ -131,6 +136,7 @@ private:
     face_manager<freetype_engine> font_manager_;
     boost::shared_ptr<label_collision_detector4> detector_;
     boost::scoped_ptr<grid_rasterizer> ras_ptr;
+    boost::scoped_ptr<building_extrusion> extrusion_;
     box2d<double> query_extent_;
     void setup(Map const& m);
 };
@@ -28,6 +28,7 @@
 #include <mapnik/config.hpp>
 
 // stl
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 
@@ -59,9 +60,17 @@ struct MAPNIK_DECL image_reader
 };
 
 bool register_image_reader(std::string const& type,image_reader* (*)(std::string const&));
+bool register_image_reader(std::string const& type,image_reader* (*)(char const*, std::size_t));
 MAPNIK_DECL image_reader* get_image_reader(std::string const& file,std::string const& type);
 MAPNIK_DECL image_reader* get_image_reader(std::string const& file);
 
+/*!
+ * \brief creates a reader decoding an encoded image held in memory, e.g. a
+ * memory mapped file or a blob fetched from a database. The type is detected
+ * from the leading bytes. The buffer is not copied and must outlive the reader.
+ */
+MAPNIK_DECL image_reader* get_image_reader(char const* data, std::size_t size);
+
 }
 
 #endif // MAPNIK_IMAGE_READER_HPP
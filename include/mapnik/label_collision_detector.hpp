@@ -26,9 +26,15 @@
 // mapnik
 #include <mapnik/quad_tree.hpp>
 #include <mapnik/noncopyable.hpp>
+#include <mapnik/unicode.hpp>
+
+// boost
+#include <boost/unordered_map.hpp>
 
 // stl
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include <unicode/unistr.h>
 
 namespace mapnik
@@ -135,101 +141,259 @@ public:
 };
 
 
-//quad tree based label collision detector so labels dont appear within a given distance
+// grid based label collision detector so labels dont appear within a given distance
+//
+// Labels are kept in one flat vector and referenced from a uniform grid of cells
+// covering the extent. Labels outside the extent are kept in the border cells; like
+// the quad_tree, queries entirely outside the extent find nothing, so labels placed
+// there never collide with each other. Cells are singly linked lists threaded through
+// a single entry vector, so neither inserts nor queries allocate per node, and
+// repeated texts are compared by interned id.
 class label_collision_detector4 : mapnik::noncopyable
 {
 public:
+    typedef unsigned text_id;
+
     struct label
     {
-        label(box2d<double> const& b) : box(b), text() {}
-        label(box2d<double> const& b, UnicodeString const& t) : box(b), text(t) {}
+        label(box2d<double> const& b, text_id t) : box(b), text(t) {}
 
         box2d<double> box;
-        UnicodeString text;
+        text_id text;
     };
 
 private:
-    typedef quad_tree< label > tree_t;
-    tree_t tree_;
+    typedef std::vector<label> label_list;
 
-public:
-    typedef tree_t::query_iterator query_iterator;
+    struct cell_entry
+    {
+        cell_entry(unsigned l, int n) : label_index(l), next(n) {}
+        unsigned label_index;
+        int next;
+    };
 
-    explicit label_collision_detector4(box2d<double> const& extent)
-        : tree_(extent) {}
+    // target cell size in map units (pixels for the renderers' detectors)
+    static unsigned cell_size() { return 64; }
+    static unsigned max_cells() { return 256; }
+    static text_id no_text() { return 0; }
+    static text_id unknown_text() { return static_cast<text_id>(-1); }
+
+    box2d<double> extent_;
+    unsigned cols_;
+    unsigned rows_;
+    double scale_x_;
+    double scale_y_;
+    std::vector<int> heads_;
+    std::vector<cell_entry> entries_;
+    label_list labels_;
+    std::vector<unsigned> stamps_;
+    unsigned generation_;
+    boost::unordered_map<UnicodeString, text_id, unicode_hash> texts_;
+    std::size_t placement_tests_;
+    std::size_t insertions_;
+
+    static unsigned cells_along(double length)
+    {
+        double cells = std::ceil(length / cell_size());
+        if (!(cells >= 1.0)) return 1;
+        return cells > max_cells() ? max_cells() : static_cast<unsigned>(cells);
+    }
 
-    bool has_placement(box2d<double> const& box)
+    unsigned cell_x(double x) const
     {
-        tree_t::query_iterator itr = tree_.query_in_box(box);
-        tree_t::query_iterator end = tree_.query_end();
+        double cx = (x - extent_.minx()) * scale_x_;
+        if (!(cx >= 0.0)) return 0;
+        return cx >= cols_ ? cols_ - 1 : static_cast<unsigned>(cx);
+    }
 
-        for ( ;itr != end; ++itr)
+    unsigned cell_y(double y) const
+    {
+        double cy = (y - extent_.miny()) * scale_y_;
+        if (!(cy >= 0.0)) return 0;
+        return cy >= rows_ ? rows_ - 1 : static_cast<unsigned>(cy);
+    }
+
+    // true if a label intersecting `query` satisfies `collides`
+    template <typename Predicate>
+    bool any_in_box(box2d<double> const& query, Predicate const& collides)
+    {
+        // as in quad_tree::query_in_box, nothing is found outside the extent
+        if (labels_.empty() || !query.intersects(extent_)) return false;
+        if (++generation_ == 0)
         {
-            if (itr->box.intersects(box))
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            generation_ = 1;
+        }
+        unsigned x0 = cell_x(query.minx()), x1 = cell_x(query.maxx());
+        unsigned y0 = cell_y(query.miny()), y1 = cell_y(query.maxy());
+        for (unsigned y = y0; y <= y1; ++y)
+        {
+            for (unsigned x = x0; x <= x1; ++x)
             {
-                return false;
+                for (int e = heads_[y * cols_ + x]; e >= 0; e = entries_[e].next)
+                {
+                    unsigned index = entries_[e].label_index;
+                    // labels spanning several cells are tested once
+                    if (stamps_[index] == generation_) continue;
+                    stamps_[index] = generation_;
+                    if (collides(labels_[index])) return true;
+                }
             }
         }
-
-        return true;
+        return false;
     }
 
-    bool has_placement(box2d<double> const& box, UnicodeString const& text, double distance)
+    struct intersects_box
     {
-        box2d<double> bigger_box(box.minx() - distance, box.miny() - distance, box.maxx() + distance, box.maxy() + distance);
-        tree_t::query_iterator itr = tree_.query_in_box(bigger_box);
-        tree_t::query_iterator end = tree_.query_end();
+        explicit intersects_box(box2d<double> const& b) : box(b) {}
+        bool operator() (label const& lbl) const { return lbl.box.intersects(box); }
+        box2d<double> const& box;
+    };
 
-        for ( ;itr != end; ++itr)
+    struct intersects_or_repeats
+    {
+        intersects_or_repeats(box2d<double> const& b, box2d<double> const& bb, text_id t)
+            : box(b), bigger_box(bb), text(t) {}
+        bool operator() (label const& lbl) const
         {
-            if (itr->box.intersects(box) || (text == itr->text && itr->box.intersects(bigger_box)))
-            {
-                return false;
-            }
+            return lbl.box.intersects(box) || (text == lbl.text && lbl.box.intersects(bigger_box));
         }
+        box2d<double> const& box;
+        box2d<double> const& bigger_box;
+        text_id text;
+    };
 
-        return true;
+public:
+    typedef label_list::const_iterator query_iterator;
+
+    explicit label_collision_detector4(box2d<double> const& extent)
+        : extent_(extent),
+          cols_(cells_along(extent.width())),
+          rows_(cells_along(extent.height())),
+          scale_x_(extent.width() > 0 ? cols_ / extent.width() : 0.0),
+          scale_y_(extent.height() > 0 ? rows_ / extent.height() : 0.0),
+          heads_(cols_ * rows_, -1),
+          entries_(),
+          labels_(),
+          stamps_(),
+          generation_(0),
+          texts_(),
+          placement_tests_(0),
+          insertions_(0)
+    {
+        // labels inserted without text share the empty text
+        texts_.insert(std::make_pair(UnicodeString(), no_text()));
+    }
+
+    /*!
+     * \brief returns the id of a label text, to pass to the text_id overloads.
+     */
+    text_id intern(UnicodeString const& text)
+    {
+        return texts_.insert(std::make_pair(text, static_cast<text_id>(texts_.size()))).first->second;
+    }
+
+    /*!
+     * \brief returns the id of a text without interning it.
+     *
+     * Texts which were never interned get an id no label carries, so they
+     * cannot repeat; placement tests use this and only inserts intern.
+     */
+    text_id find_text(UnicodeString const& text) const
+    {
+        boost::unordered_map<UnicodeString, text_id, unicode_hash>::const_iterator itr = texts_.find(text);
+        return itr != texts_.end() ? itr->second : unknown_text();
+    }
+
+    bool has_placement(box2d<double> const& box)
+    {
+        ++placement_tests_;
+        return !any_in_box(box, intersects_box(box));
+    }
+
+    bool has_placement(box2d<double> const& box, text_id text, double distance)
+    {
+        ++placement_tests_;
+        box2d<double> bigger_box(box.minx() - distance, box.miny() - distance, box.maxx() + distance, box.maxy() + distance);
+        return !any_in_box(bigger_box, intersects_or_repeats(box, bigger_box, text));
+    }
+
+    bool has_placement(box2d<double> const& box, UnicodeString const& text, double distance)
+    {
+        // a text that was never inserted cannot repeat
+        return has_placement(box, find_text(text), distance);
     }
 
     bool has_point_placement(box2d<double> const& box, double distance)
     {
+        ++placement_tests_;
         box2d<double> bigger_box(box.minx() - distance, box.miny() - distance, box.maxx() + distance, box.maxy() + distance);
-        tree_t::query_iterator itr = tree_.query_in_box(bigger_box);
-        tree_t::query_iterator end = tree_.query_end();
+        return !any_in_box(bigger_box, intersects_box(bigger_box));
+    }
 
-        for ( ;itr != end; ++itr)
+    void insert(box2d<double> const& box)
+    {
+        insert(box, no_text());
+    }
+
+    void insert(box2d<double> const& box, text_id text)
+    {
+        ++insertions_;
+        unsigned index = labels_.size();
+        labels_.push_back(label(box, text));
+        stamps_.push_back(0);
+        unsigned x0 = cell_x(box.minx()), x1 = cell_x(box.maxx());
+        unsigned y0 = cell_y(box.miny()), y1 = cell_y(box.maxy());
+        for (unsigned y = y0; y <= y1; ++y)
         {
-            if (itr->box.intersects(bigger_box))
+            for (unsigned x = x0; x <= x1; ++x)
             {
-                return false;
+                int & head = heads_[y * cols_ + x];
+                entries_.push_back(cell_entry(index, head));
+                head = static_cast<int>(entries_.size() - 1);
             }
         }
+    }
 
-        return true;
+    void insert(box2d<double> const& box, UnicodeString const& text)
+    {
+        insert(box, intern(text));
     }
 
-    void insert(box2d<double> const& box)
+    void clear()
     {
-        tree_.insert(label(box), box);
+        // keeps the allocated capacity for the next tile
+        std::fill(heads_.begin(), heads_.end(), -1);
+        entries_.clear();
+        labels_.clear();
+        stamps_.clear();
+        texts_.clear();
+        texts_.insert(std::make_pair(UnicodeString(), no_text()));
     }
 
-    void insert(box2d<double> const& box, UnicodeString const& text)
+    box2d<double> const& extent() const
     {
-        tree_.insert(label(box, text), box);
+        return extent_;
     }
 
-    void clear()
+    /*!
+     * \brief number of has_placement() and has_point_placement() tests since construction.
+     */
+    std::size_t placement_tests() const
     {
-        tree_.clear();
+        return placement_tests_;
     }
 
-    box2d<double> const& extent() const
+    /*!
+     * \brief number of labels inserted since construction, including cleared ones.
+     */
+    std::size_t insertions() const
     {
-        return tree_.extent();
+        return insertions_;
     }
 
-    query_iterator begin() { return tree_.query_in_box(extent()); }
-    query_iterator end() { return tree_.query_end(); }
+    query_iterator begin() { return labels_.begin(); }
+    query_iterator end() { return labels_.end(); }
 };
 }
 
@@ -0,0 +1,308 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_LRU_CACHE_HPP
+#define MAPNIK_LRU_CACHE_HPP
+
+// mapnik
+#include <mapnik/noncopyable.hpp>
+#include <mapnik/utils.hpp>
+
+// boost
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+// stl
+#include <list>
+#include <utility>
+
+namespace mapnik
+{
+
+struct lru_cache_stats
+{
+    lru_cache_stats()
+        : hits(0), misses(0), evictions(0), entries(0), bytes(0) {}
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t evictions;
+    std::size_t entries;
+    std::size_t bytes;
+};
+
+/*!
+ * \brief Thread safe, size bounded cache shared by the process wide caches.
+ *
+ * Keys are spread over independently locked shards, so concurrent lookups
+ * only contend when they hash to the same shard. Each shard keeps its
+ * entries in least recently used order.
+ *
+ * The byte and entry budgets apply to the cache as a whole. Inserts are
+ * serialized and, once over budget, evict across shards with a clock hand:
+ * the least recently used entry of the next shard goes, unless it was looked
+ * up since the hand last passed, in which case it gets a second chance.
+ * A value larger than the whole byte budget is not cached.
+ *
+ * Zero budgets mean unlimited. Evicted values stay alive as long as callers
+ * hold a copy, so Value is usually a shared_ptr.
+ */
+template <typename Key, typename Value>
+class sharded_lru_cache : private mapnik::noncopyable
+{
+public:
+    explicit sharded_lru_cache(std::size_t max_bytes = 0, std::size_t max_entries = 0)
+        : max_bytes_(max_bytes),
+          max_entries_(max_entries),
+          bytes_(0),
+          entries_(0),
+          evictions_(0),
+          hand_(0) {}
+
+    // copies the value out on a hit
+    bool find(Key const& key, Value & value)
+    {
+        shard & s = shard_for(key);
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(s.shard_mutex);
+#endif
+        typename index_type::const_iterator itr = s.index.find(key);
+        if (itr == s.index.end())
+        {
+            ++s.misses;
+            return false;
+        }
+        // move to the most recently used position
+        s.lru.splice(s.lru.begin(), s.lru, itr->second);
+        itr->second->referenced = true;
+        ++s.hits;
+        value = itr->second->value;
+        return true;
+    }
+
+    // like std::map::insert, returns the cached value, which is an earlier
+    // one if another thread inserted the same key in the meantime, and
+    // whether the value was stored; values over the byte budget are not
+    std::pair<Value, bool> insert(Key const& key, Value const& value, std::size_t bytes)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(budget_mutex_);
+#endif
+        if (max_bytes_ > 0 && bytes > max_bytes_)
+        {
+            return std::make_pair(value, false);
+        }
+        {
+            shard & s = shard_for(key);
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock shard_lock(s.shard_mutex);
+#endif
+            typename index_type::const_iterator itr = s.index.find(key);
+            if (itr != s.index.end())
+            {
+                return std::make_pair(itr->second->value, false);
+            }
+            // new entries start with a second chance, so they are not
+            // evicted by their own insert
+            s.lru.push_front(entry(key, value, bytes));
+            s.index.insert(std::make_pair(key, s.lru.begin()));
+        }
+        ++entries_;
+        bytes_ += bytes;
+        evict();
+        return std::make_pair(value, true);
+    }
+
+    void clear()
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(budget_mutex_);
+#endif
+        for (unsigned i = 0; i < shard_count; ++i)
+        {
+            shard & s = shards_[i];
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock shard_lock(s.shard_mutex);
+#endif
+            s.index.clear();
+            s.lru.clear();
+        }
+        entries_ = 0;
+        bytes_ = 0;
+    }
+
+    void set_max_bytes(std::size_t max_bytes)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(budget_mutex_);
+#endif
+        max_bytes_ = max_bytes;
+        evict();
+    }
+
+    std::size_t max_bytes() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(budget_mutex_);
+#endif
+        return max_bytes_;
+    }
+
+    void set_max_entries(std::size_t max_entries)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(budget_mutex_);
+#endif
+        max_entries_ = max_entries;
+        evict();
+    }
+
+    std::size_t max_entries() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(budget_mutex_);
+#endif
+        return max_entries_;
+    }
+
+    lru_cache_stats stats() const
+    {
+        lru_cache_stats total;
+        {
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock lock(budget_mutex_);
+#endif
+            total.evictions = evictions_;
+            total.entries = entries_;
+            total.bytes = bytes_;
+        }
+        for (unsigned i = 0; i < shard_count; ++i)
+        {
+            shard const& s = shards_[i];
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock lock(s.shard_mutex);
+#endif
+            total.hits += s.hits;
+            total.misses += s.misses;
+        }
+        return total;
+    }
+
+    void reset_stats()
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(budget_mutex_);
+#endif
+        evictions_ = 0;
+        for (unsigned i = 0; i < shard_count; ++i)
+        {
+            shard & s = shards_[i];
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock shard_lock(s.shard_mutex);
+#endif
+            s.hits = 0;
+            s.misses = 0;
+        }
+    }
+
+private:
+    struct entry
+    {
+        entry(Key const& k, Value const& v, std::size_t b)
+            : key(k), value(v), bytes(b), referenced(true) {}
+        Key key;
+        Value value;
+        std::size_t bytes;
+        bool referenced; // looked up since the clock hand last passed
+    };
+    typedef std::list<entry> lru_list;
+    typedef boost::unordered_map<Key, typename lru_list::iterator> index_type;
+
+    struct shard : private mapnik::noncopyable
+    {
+        shard()
+            : lru(), index(), hits(0), misses(0) {}
+#ifdef MAPNIK_THREADSAFE
+        mutable mapnik::mutex shard_mutex;
+#endif
+        lru_list lru; // most recently used first
+        index_type index;
+        std::size_t hits;
+        std::size_t misses;
+    };
+
+    enum { shard_count = 16 };
+
+    shard & shard_for(Key const& key)
+    {
+        return shards_[boost::hash<Key>()(key) % shard_count];
+    }
+
+    bool over_budget() const
+    {
+        return (max_entries_ > 0 && entries_ > max_entries_) ||
+            (max_bytes_ > 0 && bytes_ > max_bytes_);
+    }
+
+    // called with budget_mutex_ held, which is always taken before a shard lock
+    void evict()
+    {
+        unsigned spared = 0;
+        while (entries_ > 0 && over_budget())
+        {
+            shard & s = shards_[hand_];
+            hand_ = (hand_ + 1) % shard_count;
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock lock(s.shard_mutex);
+#endif
+            if (s.lru.empty()) continue;
+            entry & victim = s.lru.back();
+            // bounded, as lookups may keep setting the flag meanwhile
+            if (victim.referenced && spared < 2 * shard_count)
+            {
+                victim.referenced = false;
+                ++spared;
+                continue;
+            }
+            bytes_ -= victim.bytes;
+            --entries_;
+            ++evictions_;
+            s.index.erase(victim.key);
+            s.lru.pop_back();
+        }
+    }
+
+#ifdef MAPNIK_THREADSAFE
+    mutable mutex budget_mutex_;
+#endif
+    shard shards_[shard_count];
+    std::size_t max_bytes_;
+    std::size_t max_entries_;
+    std::size_t bytes_;
+    std::size_t entries_;
+    std::size_t evictions_;
+    unsigned hand_;
+};
+
+}
+
+#endif // MAPNIK_LRU_CACHE_HPP
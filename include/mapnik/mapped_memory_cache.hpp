@@ -27,13 +27,16 @@
 #include <mapnik/config.hpp>
 #include <mapnik/utils.hpp>
 #include <mapnik/noncopyable.hpp>
+#include <mapnik/lru_cache.hpp>
 
 // boost
-#include <boost/unordered_map.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
 
+// stl
+#include <string>
+
 namespace mapnik
 {
 
@@ -41,15 +44,39 @@ using namespace boost::interprocess;
 
 typedef boost::shared_ptr<mapped_region> mapped_region_ptr;
 
+typedef lru_cache_stats mapped_memory_cache_stats;
+
+/*!
+ * \brief Process wide cache of memory mapped files (shapefiles, dbf and index files).
+ *
+ * Files are kept in a sharded_lru_cache, so lookups from many threads only
+ * contend when they hash to the same shard, while the byte and entry budgets
+ * bound the cache as a whole. Evicted regions stay mapped until their last
+ * user releases them.
+ */
 struct MAPNIK_DECL mapped_memory_cache :
         public singleton<mapped_memory_cache, CreateStatic>,
         private mapnik::noncopyable
 {
     friend class CreateStatic<mapped_memory_cache>;
-    boost::unordered_map<std::string,mapped_region_ptr> cache_;
+
     bool insert(std::string const& key, mapped_region_ptr);
     boost::optional<mapped_region_ptr> find(std::string const& key, bool update_cache = false);
     void clear();
+
+    // zero means unlimited, which is the default
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const;
+    void set_max_entries(std::size_t max_entries);
+    std::size_t max_entries() const;
+
+    mapped_memory_cache_stats stats() const;
+    void reset_stats();
+
+private:
+    mapped_memory_cache();
+
+    sharded_lru_cache<std::string, mapped_region_ptr> cache_;
 };
 
 }
@@ -26,12 +26,26 @@
 // mapnik
 #include <mapnik/datasource.hpp>
 #include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/packed_rtree.hpp>
+
+// boost
+#ifdef MAPNIK_THREADSAFE
+#include <boost/thread/mutex.hpp>
+#endif
 
 // stl
 #include <deque>
 
 namespace mapnik {
 
+/*!
+ * \brief Datasource serving features held in memory.
+ *
+ * With bbox_check enabled, queries are answered from a packed R-tree over
+ * the feature bounds, built on the first query. Features pushed later are
+ * added to the index as they arrive and the tree is repacked once enough of
+ * them accumulate. Geometries must not be changed after a feature is pushed.
+ */
 class MAPNIK_DECL memory_datasource : public datasource
 {
     friend class memory_featureset;
@@ -49,11 +63,18 @@ public:
     size_t size() const;
     void clear();
 private:
+    featureset_ptr query_index(box2d<double> const& box) const;
+
     std::deque<feature_ptr> features_;
     mapnik::layer_descriptor desc_;
     datasource::datasource_t type_;
     bool bbox_check_;
     mutable box2d<double> extent_;
+    mutable packed_rtree index_;
+    mutable bool indexed_;
+#ifdef MAPNIK_THREADSAFE
+    mutable boost::mutex mutex_;
+#endif
 };
 
 }
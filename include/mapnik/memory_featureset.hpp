@@ -32,6 +32,11 @@
 // boost
 #include <boost/utility.hpp>
 
+// stl
+#include <algorithm>
+#include <deque>
+#include <vector>
+
 namespace mapnik {
 
 class memory_featureset : public Featureset
@@ -39,63 +44,84 @@ class memory_featureset : public Featureset
 public:
     memory_featureset(box2d<double> const& bbox, memory_datasource const& ds, bool bbox_check = true)
         : bbox_(bbox),
-          pos_(ds.features_.begin()),
-          end_(ds.features_.end()),
+          features_(ds.features_),
+          ids_(),
+          pos_(0),
+          end_(ds.features_.size()),
           type_(ds.type()),
-          bbox_check_(bbox_check)
+          bbox_check_(bbox_check),
+          indexed_(false)
     {}
 
     memory_featureset(box2d<double> const& bbox, std::deque<feature_ptr> const& features, bool bbox_check = true)
         : bbox_(bbox),
-          pos_(features.begin()),
-          end_(features.end()),
+          features_(features),
+          ids_(),
+          pos_(0),
+          end_(features.size()),
           type_(datasource::Vector),
-          bbox_check_(bbox_check)
+          bbox_check_(bbox_check),
+          indexed_(false)
     {}
 
+    // visits only the candidates returned by a spatial index query, in their original order
+    memory_featureset(box2d<double> const& bbox, std::deque<feature_ptr> const& features,
+                      std::vector<std::size_t> & candidates, datasource::datasource_t type = datasource::Vector)
+        : bbox_(bbox),
+          features_(features),
+          ids_(),
+          pos_(0),
+          end_(candidates.size()),
+          type_(type),
+          bbox_check_(true),
+          indexed_(true)
+    {
+        ids_.swap(candidates);
+        std::sort(ids_.begin(), ids_.end());
+    }
+
     virtual ~memory_featureset() {}
 
     feature_ptr next()
     {
         while (pos_ != end_)
         {
-            if (!bbox_check_)
-            {
-                return *pos_++;
-            }
-            else
+            feature_ptr const& feature = features_[indexed_ ? ids_[pos_] : pos_];
+            ++pos_;
+            if (!bbox_check_ || intersects(*feature))
             {
-                if (type_ == datasource::Raster)
-                {
-                    raster_ptr const& source = (*pos_)->get_raster();
-                    if (source && bbox_.intersects(source->ext_))
-                    {
-                        return *pos_++;
-                    }
-                }
-                else
-                {
-                    for (unsigned i=0; i<(*pos_)->num_geometries();++i)
-                    {
-                        geometry_type & geom = (*pos_)->get_geometry(i);
-                        if (bbox_.intersects(geom.envelope()))
-                        {
-                            return *pos_++;
-                        }
-                    }
-                }
-                ++pos_;
+                return feature;
             }
         }
         return feature_ptr();
     }
 
 private:
+    bool intersects(feature_impl const& feature) const
+    {
+        if (type_ == datasource::Raster)
+        {
+            raster_ptr const& source = feature.get_raster();
+            return source && bbox_.intersects(source->ext_);
+        }
+        for (unsigned i=0; i<feature.num_geometries();++i)
+        {
+            if (bbox_.intersects(feature.get_geometry(i).envelope()))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     box2d<double> bbox_;
-    std::deque<feature_ptr>::const_iterator pos_;
-    std::deque<feature_ptr>::const_iterator end_;
+    std::deque<feature_ptr> const& features_;
+    std::vector<std::size_t> ids_;
+    std::size_t pos_;
+    std::size_t end_;
     datasource::datasource_t type_;
     bool bbox_check_;
+    bool indexed_;
 };
 }
 
@@ -0,0 +1,83 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_PACKED_RTREE_HPP
+#define MAPNIK_PACKED_RTREE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/box2d.hpp>
+#include <mapnik/noncopyable.hpp>
+
+// stl
+#include <vector>
+
+namespace mapnik
+{
+
+/*!
+ * \brief Static R-tree over item ids and their bounding boxes, packed
+ * bottom up with the Sort-Tile-Recursive algorithm.
+ *
+ * Nodes are stored level by level in one array, with node_size children
+ * per node, so the tree costs one box per node and no pointers. Items
+ * inserted after build() are kept in an unpacked list which queries scan
+ * linearly until the next build().
+ */
+class MAPNIK_DECL packed_rtree : private mapnik::noncopyable
+{
+public:
+    explicit packed_rtree(unsigned node_size = 16);
+
+    // items with an invalid box are never returned and are not stored
+    void insert(std::size_t id, box2d<double> const& box);
+
+    // packs all items inserted so far
+    void build();
+
+    // appends the ids of all items whose box intersects box, in no particular order
+    void query(box2d<double> const& box, std::vector<std::size_t> & ids) const;
+
+    void clear();
+
+    std::size_t size() const;
+    std::size_t unpacked() const;
+
+private:
+    struct item
+    {
+        item(std::size_t i, box2d<double> const& b)
+            : id(i), box(b) {}
+        std::size_t id;
+        box2d<double> box;
+    };
+
+    unsigned node_size_;
+    std::vector<item> items_;       // leaves, in packed order
+    std::vector<item> unpacked_;
+    std::vector<box2d<double> > nodes_;  // all levels above the leaves, lowest first
+    std::vector<std::size_t> level_offsets_; // start of each level in nodes_, plus the end
+};
+
+}
+
+#endif // MAPNIK_PACKED_RTREE_HPP
@@ -132,6 +132,10 @@ private:
     DetectorT & detector_;
     box2d<double> const& dimensions_;
     string_info const& info_;
+    /** Id of info_'s text in the detector, so it compares ids instead of strings.
+     * Looked up without interning; interned once the first placement is inserted.
+     */
+    typename DetectorT::text_id text_;
     text_symbolizer_properties const& p;
     text_placement_info const& pi;
     /** Length of the longest line after linebreaks.
@@ -30,8 +30,12 @@
 
 // boost
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_set.hpp>
 #ifdef MAPNIK_THREADSAFE
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #endif
 
 // stl
@@ -39,6 +43,7 @@
 #include <deque>
 #include <ctime>
 #include <cassert>
+#include <algorithm>
 
 namespace mapnik
 {
@@ -64,40 +69,135 @@ private:
     PoolGuard& operator=(const PoolGuard&);
 };
 
+struct pool_stats
+{
+    pool_stats()
+        : borrowed(0),
+          created(0),
+          waited(0),
+          timeouts(0),
+          wait_time(0.0) {}
+    std::size_t borrowed;  // successful borrowObject() calls
+    std::size_t created;   // objects created over the pool's lifetime
+    std::size_t waited;    // borrowObject() calls that had to wait
+    std::size_t timeouts;  // waits that ended without an object
+    double wait_time;      // total seconds spent waiting
+};
+
+/*!
+ * \brief Pool of reusable objects, e.g. database connections.
+ *
+ * Once max_size objects are borrowed, borrowObject() waits up to max_wait
+ * milliseconds for one to be returned. Waiters are served in arrival order:
+ * returned objects, and slots freed by dropping broken objects, are handed
+ * directly to the longest waiting borrower. Objects are created outside the
+ * lock, so a slow connect does not block other borrowers.
+ *
+ * Idle objects are validated with isOK() when they are returned and again
+ * before they are lent out; broken ones are dropped and their slot reused.
+ */
 template <typename T,template <typename> class Creator>
 class Pool : private mapnik::noncopyable
 {
     typedef boost::shared_ptr<T> HolderType;
     typedef std::deque<HolderType> ContType;
+    typedef boost::unordered_set<T const*> UsedType;
+
+#ifdef MAPNIK_THREADSAFE
+    struct waiter
+    {
+        waiter()
+            : obj(),
+              ready(false) {}
+        HolderType obj; // handed over object, empty if a slot to create one was granted
+        bool ready;
+        boost::condition_variable cond;
+    };
+    typedef boost::mutex::scoped_lock lock_type;
+#endif
 
     Creator<T> creator_;
     unsigned initialSize_;
     unsigned maxSize_;
-    ContType usedPool_;
+    unsigned maxWait_;
+    unsigned pending_; // slots reserved for objects being created
+    UsedType usedPool_;
     ContType unusedPool_;
+    pool_stats stats_;
 #ifdef MAPNIK_THREADSAFE
+    std::deque<waiter*> waiters_;
     mutable boost::mutex mutex_;
 #endif
-public:
 
-    Pool(const Creator<T>& creator,unsigned initialSize, unsigned maxSize)
-        :creator_(creator),
-         initialSize_(initialSize),
-         maxSize_(maxSize)
+    HolderType lend(HolderType const& obj)
     {
-        for (unsigned i=0; i < initialSize_; ++i)
+        usedPool_.insert(obj.get());
+        ++stats_.borrowed;
+        return obj;
+    }
+
+    bool can_grow() const
+    {
+        return usedPool_.size() + pending_ < maxSize_;
+    }
+
+    // hands free slots to waiting borrowers, which create the object themselves
+    void grant_slots()
+    {
+#ifdef MAPNIK_THREADSAFE
+        while (!waiters_.empty() && can_grow())
         {
-            HolderType conn(creator_());
-            if (conn->isOK())
-                unusedPool_.push_back(conn);
+            waiter * w = waiters_.front();
+            waiters_.pop_front();
+            ++pending_;
+            w->ready = true;
+            w->cond.notify_one();
         }
+#endif
     }
 
-    HolderType borrowObject()
+    // creates an object for a reserved slot, the lock is released meanwhile
+#ifdef MAPNIK_THREADSAFE
+    HolderType create(lock_type & lock)
+#else
+    HolderType create()
+#endif
     {
+        HolderType conn;
+        try
+        {
 #ifdef MAPNIK_THREADSAFE
-        mutex::scoped_lock lock(mutex_);
+            lock.unlock();
 #endif
+            conn.reset(creator_());
+#ifdef MAPNIK_THREADSAFE
+            lock.lock();
+#endif
+        }
+        catch (...)
+        {
+#ifdef MAPNIK_THREADSAFE
+            lock.lock();
+#endif
+            --pending_;
+            grant_slots();
+            throw;
+        }
+        --pending_;
+        ++stats_.created;
+        if (conn->isOK())
+        {
+            MAPNIK_LOG_DEBUG(pool) << "pool: Create connection=" << conn.get();
+
+            return lend(conn);
+        }
+        grant_slots();
+        return HolderType();
+    }
+
+    // lends the first valid idle object, dropping broken ones on the way
+    HolderType lend_idle()
+    {
         typename ContType::iterator itr=unusedPool_.begin();
         while ( itr!=unusedPool_.end())
         {
@@ -105,9 +205,9 @@ public:
 
             if ((*itr)->isOK())
             {
-                usedPool_.push_back(*itr);
+                HolderType conn = *itr;
                 unusedPool_.erase(itr);
-                return usedPool_.back();
+                return lend(conn);
             }
             else
             {
@@ -116,40 +216,140 @@ public:
                 itr=unusedPool_.erase(itr);
             }
         }
-        // all connection have been taken, check if we allowed to grow pool
-        if (usedPool_.size() < maxSize_)
+        return HolderType();
+    }
+
+    // hands idle objects to waiting borrowers before granting free slots
+    void serve_waiters()
+    {
+#ifdef MAPNIK_THREADSAFE
+        while (!waiters_.empty() && !unusedPool_.empty())
+        {
+            HolderType conn = unusedPool_.front();
+            unusedPool_.pop_front();
+            if (!conn->isOK()) continue;
+            waiter * w = waiters_.front();
+            waiters_.pop_front();
+            w->obj = lend(conn);
+            w->ready = true;
+            w->cond.notify_one();
+        }
+#endif
+        grant_slots();
+    }
+
+public:
+
+    Pool(const Creator<T>& creator,unsigned initialSize, unsigned maxSize, unsigned maxWait = 0)
+        :creator_(creator),
+         initialSize_(initialSize),
+         maxSize_(maxSize),
+         maxWait_(maxWait),
+         pending_(0)
+    {
+        for (unsigned i=0; i < initialSize_; ++i)
         {
             HolderType conn(creator_());
+            ++stats_.created;
             if (conn->isOK())
+                unusedPool_.push_back(conn);
+        }
+    }
+
+    HolderType borrowObject()
+    {
+#ifdef MAPNIK_THREADSAFE
+        lock_type lock(mutex_);
+#endif
+        HolderType idle = lend_idle();
+        if (idle)
+        {
+            return idle;
+        }
+        // all connection have been taken, check if we allowed to grow pool
+        if (can_grow())
+        {
+            ++pending_;
+#ifdef MAPNIK_THREADSAFE
+            return create(lock);
+#else
+            return create();
+#endif
+        }
+#ifdef MAPNIK_THREADSAFE
+        if (maxWait_ > 0)
+        {
+            waiter w;
+            waiters_.push_back(&w);
+            ++stats_.waited;
+            boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+            boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(maxWait_);
+            while (!w.ready)
             {
-                usedPool_.push_back(conn);
+                if (!w.cond.timed_wait(lock, deadline)) break;
+            }
+            stats_.wait_time += (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+            if (!w.ready)
+            {
+                waiters_.erase(std::find(waiters_.begin(), waiters_.end(), &w));
+                ++stats_.timeouts;
 
-                MAPNIK_LOG_DEBUG(pool) << "pool: Create connection=" << conn.get();
+                MAPNIK_LOG_DEBUG(pool) << "pool: Timed out after " << maxWait_ << "ms waiting for a connection";
 
-                return conn;
+                return HolderType();
+            }
+            if (w.obj)
+            {
+                return w.obj;
             }
+            return create(lock);
         }
+#endif
         return HolderType();
     }
 
+    // like borrowObject(), but only lends an idle object: never creates one or waits
+    HolderType borrowIdleObject()
+    {
+#ifdef MAPNIK_THREADSAFE
+        lock_type lock(mutex_);
+#endif
+        return lend_idle();
+    }
+
     void returnObject(HolderType obj)
     {
 #ifdef MAPNIK_THREADSAFE
-        mutex::scoped_lock lock(mutex_);
+        lock_type lock(mutex_);
 #endif
-        typename ContType::iterator itr=usedPool_.begin();
-        while (itr != usedPool_.end())
+        typename UsedType::iterator itr = usedPool_.find(obj.get());
+        if (itr == usedPool_.end())
         {
-            if (obj.get()==(*itr).get())
-            {
-                MAPNIK_LOG_DEBUG(pool) << "pool: Return instance=" << (*itr).get();
+            return;
+        }
+        usedPool_.erase(itr);
 
-                unusedPool_.push_back(*itr);
-                usedPool_.erase(itr);
-                return;
-            }
-            ++itr;
+        MAPNIK_LOG_DEBUG(pool) << "pool: Return instance=" << obj.get();
+
+        if (!obj->isOK())
+        {
+            MAPNIK_LOG_DEBUG(pool) << "pool: Bad connection (drop) instance=" << obj.get();
+
+            grant_slots();
+            return;
         }
+#ifdef MAPNIK_THREADSAFE
+        if (!waiters_.empty())
+        {
+            waiter * w = waiters_.front();
+            waiters_.pop_front();
+            w->obj = lend(obj);
+            w->ready = true;
+            w->cond.notify_one();
+            return;
+        }
+#endif
+        unusedPool_.push_back(obj);
     }
 
     std::pair<unsigned,unsigned> size() const
@@ -161,6 +361,14 @@ public:
         return size;
     }
 
+    pool_stats stats() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(mutex_);
+#endif
+        return stats_;
+    }
+
     unsigned max_size() const
     {
 #ifdef MAPNIK_THREADSAFE
@@ -175,6 +383,23 @@ public:
         mutex::scoped_lock lock(mutex_);
 #endif
         maxSize_ = std::max(maxSize_,size);
+        grant_slots();
+    }
+
+    unsigned max_wait() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(mutex_);
+#endif
+        return maxWait_;
+    }
+
+    void set_max_wait(unsigned milliseconds)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(mutex_);
+#endif
+        maxWait_ = milliseconds;
     }
 
     unsigned initial_size() const
@@ -202,9 +427,11 @@ public:
                 for (unsigned i=0; i < grow_size; ++i)
                 {
                     HolderType conn(creator_());
+                    ++stats_.created;
                     if (conn->isOK())
                         unusedPool_.push_back(conn);
                 }
+                serve_waiters();
             }
         }
     }
@@ -26,6 +26,7 @@
 // mapnik
 #include <mapnik/projection.hpp>
 #include <mapnik/box2d.hpp>
+#include <mapnik/geometry.hpp>
 #include <mapnik/noncopyable.hpp>
 
 namespace mapnik {
@@ -45,6 +46,11 @@ public:
     bool backward (box2d<double> & box) const;
     bool forward (box2d<double> & box, int points) const;
     bool backward (box2d<double> & box, int points) const;
+    // transform all vertices of geom in place and update its envelope.
+    // Not used by the renderers, whose geometries are shared between styles:
+    // coord_transform reprojects copies with the exact per point formulas.
+    bool forward (geometry_type & geom) const;
+    bool backward (geometry_type & geom) const;
     mapnik::projection const& source() const;
     mapnik::projection const& dest() const;
 
@@ -67,6 +67,8 @@ public:
 
 private:
     void swap (projection& rhs);
+    // the proj4 object to use from the calling thread
+    void * proj() const;
 
 private:
     std::string params_;
@@ -0,0 +1,195 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2011 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_QUEUED_FEATURESET_HPP
+#define MAPNIK_QUEUED_FEATURESET_HPP
+
+// mapnik
+#include <mapnik/datasource.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/noncopyable.hpp>
+
+// boost
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+// stl
+#include <deque>
+#include <string>
+
+namespace mapnik {
+
+/** A bounded queue of features with a single producer (a thread reading a
+ * datasource featureset) and a single consumer (the renderer).
+ * push() blocks while the queue is full, pop() while it is empty.
+ * A capacity of 0 means unbounded.
+ */
+class feature_queue : private mapnik::noncopyable
+{
+public:
+    explicit feature_queue(std::size_t capacity)
+        : capacity_(capacity),
+          pushed_(0),
+          closed_(false),
+          failed_(false),
+          cancelled_(false) {}
+
+    /*!
+     * \brief adds a feature, blocking while the queue is full.
+     * \return false if the consumer has cancelled and production should stop.
+     */
+    bool push(feature_ptr const& feature)
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (capacity_ > 0 && queue_.size() >= capacity_ && !cancelled_)
+        {
+            not_full_.wait(lock);
+        }
+        if (cancelled_) return false;
+        queue_.push_back(feature);
+        ++pushed_;
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /*!
+     * \brief marks the end of the stream, optionally recording the producer's error.
+     */
+    void close(bool failed = false, std::string const& error = std::string())
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        closed_ = true;
+        failed_ = failed;
+        error_ = error;
+        not_empty_.notify_all();
+    }
+
+    /*!
+     * \brief unblocks and stops the producer; remaining features are discarded.
+     */
+    void cancel()
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        cancelled_ = true;
+        queue_.clear();
+        not_full_.notify_all();
+    }
+
+    /*!
+     * \brief takes the next feature, blocking while the queue is empty.
+     * \return an empty feature_ptr at the end of the stream.
+     * \throws datasource_exception if the producer failed.
+     */
+    feature_ptr pop()
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (queue_.empty() && !closed_)
+        {
+            not_empty_.wait(lock);
+        }
+        if (queue_.empty())
+        {
+            if (failed_) throw datasource_exception(error_);
+            return feature_ptr();
+        }
+        feature_ptr feature = queue_.front();
+        queue_.pop_front();
+        not_full_.notify_one();
+        return feature;
+    }
+
+    /*!
+     * \brief blocks until a feature is available or the stream ended.
+     * \return true if the producer failed before delivering any feature.
+     */
+    bool failed_empty()
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (queue_.empty() && !closed_)
+        {
+            not_empty_.wait(lock);
+        }
+        return failed_ && pushed_ == 0;
+    }
+
+private:
+    std::size_t capacity_;
+    std::size_t pushed_;
+    bool closed_;
+    bool failed_;
+    bool cancelled_;
+    std::string error_;
+    std::deque<feature_ptr> queue_;
+    boost::mutex mutex_;
+    boost::condition_variable not_empty_;
+    boost::condition_variable not_full_;
+};
+
+typedef boost::shared_ptr<feature_queue> feature_queue_ptr;
+
+/** Featureset reading from a feature_queue filled on another thread.
+ * Features can optionally be recorded into a memory_datasource
+ * so that they can be replayed once the queue is drained.
+ * Destroying it before the end of the stream, e.g. when a symbolizer
+ * throws, cancels the queue so the producer does not block forever.
+ */
+class queued_featureset : public Featureset
+{
+public:
+    queued_featureset(feature_queue_ptr const& queue,
+                      boost::shared_ptr<memory_datasource> const& recorder)
+        : queue_(queue),
+          recorder_(recorder),
+          drained_(false) {}
+
+    virtual ~queued_featureset()
+    {
+        if (!drained_)
+        {
+            queue_->cancel();
+        }
+    }
+
+    feature_ptr next()
+    {
+        feature_ptr feature = queue_->pop();
+        if (!feature)
+        {
+            drained_ = true;
+        }
+        else if (recorder_)
+        {
+            recorder_->push(feature);
+        }
+        return feature;
+    }
+
+private:
+    feature_queue_ptr queue_;
+    boost::shared_ptr<memory_datasource> recorder_;
+    bool drained_;
+};
+
+}
+
+#endif // MAPNIK_QUEUED_FEATURESET_HPP
@@ -216,6 +216,9 @@ public:
     inline float get_epsilon() const { return epsilon_; }
 
 private:
+    //! \brief Translate a value within the stop at stopIdx, -1 for values before the first stop
+    color get_color(float value, int stopIdx) const;
+
     colorizer_stops stops_;         //!< The vector of stops
 
     colorizer_mode default_mode_;   //!< The default mode inherited by stops
@@ -0,0 +1,107 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_RASTER_TILE_CACHE_HPP
+#define MAPNIK_RASTER_TILE_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/utils.hpp>
+#include <mapnik/noncopyable.hpp>
+#include <mapnik/image_data.hpp>
+#include <mapnik/lru_cache.hpp>
+
+// boost
+#include <boost/shared_ptr.hpp>
+
+// stl
+#include <string>
+
+namespace mapnik
+{
+
+/*!
+ * \brief Identifies one decoded tile of a raster file by the file name, the
+ * pixel position of the tile's top left corner in the file and its size.
+ */
+struct raster_tile_key
+{
+    raster_tile_key()
+        : file(), x(0), y(0), width(0), height(0) {}
+    raster_tile_key(std::string const& f, unsigned x0, unsigned y0, unsigned w, unsigned h)
+        : file(f), x(x0), y(y0), width(w), height(h) {}
+    std::string file;
+    unsigned x;
+    unsigned y;
+    unsigned width;
+    unsigned height;
+
+    bool operator==(raster_tile_key const& other) const
+    {
+        return x == other.x && y == other.y &&
+            width == other.width && height == other.height &&
+            file == other.file;
+    }
+};
+
+MAPNIK_DECL std::size_t hash_value(raster_tile_key const& key);
+
+typedef boost::shared_ptr<image_data_32 const> raster_tile_ptr;
+
+typedef lru_cache_stats raster_tile_cache_stats;
+
+/*!
+ * \brief Process wide cache of decoded raster tiles, shared by all renders.
+ *
+ * The tiff reader keeps the tiles of tiled files here, and the raster plugin
+ * the tile files of multi-file rasters, so raster layers drawn over the same
+ * area again (adjacent map tiles, metatiles, repeated renders of a
+ * hillshade) skip the decompression. Files are not watched for changes,
+ * call clear() after replacing a raster on disk.
+ */
+class MAPNIK_DECL raster_tile_cache :
+        public singleton<raster_tile_cache, CreateStatic>,
+        private mapnik::noncopyable
+{
+    friend class CreateStatic<raster_tile_cache>;
+public:
+    raster_tile_ptr find(raster_tile_key const& key);
+    void insert(raster_tile_key const& key, raster_tile_ptr const& tile);
+    void clear();
+
+    // zero disables the cache, default is 64MB
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const;
+
+    raster_tile_cache_stats stats() const;
+    void reset_stats();
+
+private:
+    raster_tile_cache();
+
+    sharded_lru_cache<raster_tile_key, raster_tile_ptr> cache_;
+};
+
+}
+
+#endif // MAPNIK_RASTER_TILE_CACHE_HPP
@@ -0,0 +1,115 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_RENDERING_STATS_HPP
+#define MAPNIK_RENDERING_STATS_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+// all times are wall clock milliseconds
+
+struct style_stats
+{
+    explicit style_stats(std::string const& style_name)
+        : name(style_name),
+          features_queried(0),
+          features_rendered(0),
+          query_time(0),
+          symbolizer_time(0),
+          render_time(0),
+          label_attempts(0),
+          labels_placed(0) {}
+
+    std::string name;
+    std::size_t features_queried;   // features the style was applied to
+    std::size_t features_rendered;  // features matching at least one rule
+    double query_time;              // reading features
+    double symbolizer_time;         // matching rules and processing their symbolizers
+    double render_time;             // the whole style, including compositing
+    std::size_t label_attempts;     // candidate label positions tested for collisions
+    std::size_t labels_placed;      // labels added to the collision detector
+};
+
+struct MAPNIK_DECL layer_stats
+{
+    explicit layer_stats(std::string const& layer_name)
+        : name(layer_name),
+          query_time(0),
+          render_time(0),
+          styles() {}
+
+    std::string name;
+    double query_time;   // querying the datasource and reading features from it, for all styles;
+                         // features cached in memory for further styles are not counted again
+    double render_time;  // the whole layer, including query_time
+    std::vector<style_stats> styles;
+
+    std::size_t features_queried() const;
+    std::size_t features_rendered() const;
+};
+
+/*!
+ * \brief Per layer and per style metrics of a rendering.
+ *
+ * Collected by a renderer's apply() when passed to
+ * feature_style_processor::set_rendering_stats(). Layers and styles appear in
+ * the order they were rendered; layers which are not visible at the current
+ * scale, or which do not intersect the map extent, are left out.
+ *
+ * With concurrent layer queries (feature_style_processor::set_concurrency())
+ * the query time of a layer is the time rendering waited for its features.
+ * Styles rasterized on other threads report the time spent there, plus the
+ * time taken to composite them, so times may add up to more than the total.
+ */
+class MAPNIK_DECL rendering_stats
+{
+public:
+    rendering_stats();
+
+    void clear();
+
+    /*!
+     * \brief the slowest layer, or 0 if no layer was rendered.
+     */
+    layer_stats const* slowest_layer() const;
+
+    /*!
+     * \brief a human readable report of all layers and styles.
+     */
+    std::string to_string() const;
+
+    double total_time;
+    std::vector<layer_stats> layers;
+};
+
+}
+
+#endif // MAPNIK_RENDERING_STATS_HPP
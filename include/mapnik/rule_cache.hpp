@@ -24,43 +24,69 @@
 #define MAPNIK_RULE_CACHE_HPP
 
 // mapnik
+#include <mapnik/config.hpp>
 #include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
 #include <mapnik/feature_type_style.hpp>
+#include <mapnik/filter_program.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/noncopyable.hpp>
 
 // boost
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 
 // stl
+#include <map>
+#include <string>
 #include <vector>
 
 namespace mapnik
 {
 
-class rule_cache
+/*!
+ * \brief Active rules of a style, split into if/else/also rules.
+ *
+ * If-rule filters are compiled into a shared filter_program. If-rules whose
+ * filter is a plain `[attr] = 'string'` comparison on the same attribute are
+ * additionally indexed by that string, so matching a feature only evaluates
+ * the rules indexed under its value plus the remaining (residual) rules.
+ * Matches are always reported in rule order.
+ */
+class MAPNIK_DECL rule_cache : private mapnik::noncopyable
 {
 public:
     typedef std::vector<rule const*> rule_ptrs;
-    rule_cache()
-     : if_rules_(),
-       else_rules_(),
-       also_rules_() {}
+    static const std::size_t no_match = static_cast<std::size_t>(-1);
+
+    rule_cache();
+
+    void add_rule(rule const& r);
+
+    /*!
+     * \brief starts matching if-rules against a new feature.
+     */
+    void bind(feature_impl const& feature) const;
 
-    void add_rule(rule const& r)
+    /*!
+     * \brief index of the first if-rule at or after start matching the bound feature.
+     * \return no_match if there is none. Must be called with increasing start.
+     */
+    std::size_t next_match(std::size_t start) const;
+
+    /*!
+     * \brief evaluates the filter of the if-rule at index against the bound feature.
+     */
+    bool match(std::size_t index) const
     {
-        if (r.has_else_filter())
-        {
-            else_rules_.push_back(&r);
-        }
-        else if (r.has_also_filter())
-        {
-            also_rules_.push_back(&r);
-        }
-        else
-        {
-            if_rules_.push_back(&r);
-        }
+        return filters_.evaluate(filter_ids_[index]);
     }
 
+    /*!
+     * \brief number of if-rules dispatched by attribute value rather than evaluated.
+     */
+    std::size_t indexed_rules() const;
+
     rule_ptrs const& get_if_rules() const
     {
         return if_rules_;
@@ -77,9 +103,28 @@ public:
     }
 
 private:
+    typedef std::vector<std::size_t> index_list;
+    typedef boost::unordered_map<value_unicode_string, index_list, unicode_hash> dispatch_table;
+
+    void build_index() const;
+
     rule_ptrs if_rules_;
     rule_ptrs else_rules_;
     rule_ptrs also_rules_;
+    filter_program filters_;
+    std::vector<filter_program::program_id> filter_ids_;
+    // `[attr] = 'string'` if-rules by attribute name
+    std::map<std::string, std::vector<std::pair<std::size_t, value_unicode_string> > > equality_rules_;
+    std::map<std::string, filter_program::program_id> attribute_ids_;
+    // dispatch index, built on first use
+    mutable bool indexed_;
+    mutable filter_program::program_id key_id_;
+    mutable dispatch_table table_;
+    mutable index_list residual_;
+    // matching state of the bound feature
+    mutable index_list const* candidates_;
+    mutable std::size_t candidate_pos_;
+    mutable std::size_t residual_pos_;
 };
 
 }
@@ -134,6 +134,11 @@ public:
     {
         return DEFAULT;
     }
+    inline label_collision_detector4 const* label_detector() const
+    {
+        // labels are not placed
+        return 0;
+    }
 
     inline OutputIterator& get_output_iterator()
     {
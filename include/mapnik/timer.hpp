@@ -38,6 +38,10 @@
 #include <sys/resource.h>
 #endif
 
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
 
 namespace mapnik {
 
@@ -58,6 +62,25 @@ inline double time_now()
 #endif
 }
 
+// Seconds since an arbitrary point, unaffected by changes to the system clock,
+// for measuring intervals
+inline double monotonic_time()
+{
+#if defined(_WINDOWS)
+    // the performance counter is monotonic
+    return time_now();
+#elif defined(__APPLE__)
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    return double(mach_absolute_time()) * timebase.numer / timebase.denom * 1e-9;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#else
+    return time_now();
+#endif
+}
 
 // Measure times in both wall clock time and CPU times. Results are returned in milliseconds.
 class timer
@@ -49,6 +49,15 @@ private:
     bool ok_;
     UConverter * conv_;
 };
+
+// hash functor for unordered containers keyed by UnicodeString
+struct unicode_hash
+{
+    std::size_t operator() (UnicodeString const& str) const
+    {
+        return static_cast<std::size_t>(str.hashCode());
+    }
+};
 }
 
 #endif // MAPNIK_UNICODE_HPP
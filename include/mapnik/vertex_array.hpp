@@ -0,0 +1,175 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_VERTEX_ARRAY_HPP
+#define MAPNIK_VERTEX_ARRAY_HPP
+
+// mapnik
+#include <mapnik/vertex.hpp>
+#include <mapnik/noncopyable.hpp>
+
+// boost
+#include <boost/tuple/tuple.hpp>
+
+#include <cstring>  // required for memcpy with linux/g++
+
+namespace mapnik
+{
+
+/*!
+ * \brief Vertex container keeping all vertices in one contiguous allocation.
+ *
+ * Coordinates are interleaved (x0,y0,x1,y1,...) and followed by one command
+ * byte per vertex, so a geometry costs a single allocation sized to its
+ * vertices, and sequential access is a plain array walk. Storage grows by
+ * doubling, or can be sized up front with reserve().
+ *
+ * Each vertex takes 2 * sizeof(T) + 1 bytes of the allocation, 17 bytes for
+ * double coordinates. That is the per vertex cost only: a geometry also holds
+ * this container, its type and iterator position and its cached 32 byte
+ * envelope: on 64 bit platforms a point geometry_type is 80 bytes plus its
+ * 17 byte allocation.
+ *
+ * Drop-in alternative to vertex_vector for geometry<T,Container>.
+ */
+template <typename T>
+class vertex_array : private mapnik::noncopyable
+{
+    typedef T coord_type;
+public:
+    // required for iterators support
+    typedef boost::tuple<unsigned,coord_type,coord_type> value_type;
+    typedef std::size_t size_type;
+
+private:
+    coord_type* vertices_;
+    unsigned char* commands_;
+    size_type size_;
+    size_type capacity_;
+
+public:
+
+    vertex_array()
+        : vertices_(0),
+          commands_(0),
+          size_(0),
+          capacity_(0) {}
+
+    ~vertex_array()
+    {
+        ::operator delete(vertices_);
+    }
+
+    size_type size() const
+    {
+        return size_;
+    }
+
+    size_type capacity() const
+    {
+        return capacity_;
+    }
+
+    void push_back (coord_type x, coord_type y, unsigned command)
+    {
+        if (size_ == capacity_)
+        {
+            reallocate(capacity_ ? capacity_ * 2 : 1);
+        }
+        coord_type* vertex = vertices_ + (size_ << 1);
+        *vertex++ = x;
+        *vertex   = y;
+        commands_[size_++] = static_cast<unsigned char>(command);
+    }
+
+    // appends count vertices stored as interleaved x,y coordinates, which need not be aligned
+    void append(void const* xy, size_type count, unsigned command)
+    {
+        // nothing to copy, and vertices_ may still be null
+        if (count == 0) return;
+        if (size_ + count > capacity_)
+        {
+            size_type capacity = capacity_ * 2;
+            reallocate(capacity < size_ + count ? size_ + count : capacity);
+        }
+        std::memcpy(vertices_ + (size_ << 1), xy, count * 2 * sizeof(coord_type));
+        std::memset(commands_ + size_, command, count);
+        size_ += count;
+    }
+
+    void reserve(size_type size)
+    {
+        if (size > capacity_)
+        {
+            reallocate(size);
+        }
+    }
+
+    unsigned get_vertex(unsigned pos,coord_type* x,coord_type* y) const
+    {
+        if (pos >= size_) return SEG_END;
+        const coord_type* vertex = vertices_ + (pos << 1);
+        *x = (*vertex++);
+        *y = (*vertex);
+        return commands_[pos];
+    }
+
+    // interleaved x,y coordinates of all vertices
+    coord_type * coords()
+    {
+        return vertices_;
+    }
+
+    coord_type const* coords() const
+    {
+        return vertices_;
+    }
+
+    void set_command(unsigned pos, unsigned command)
+    {
+        if (pos < size_)
+        {
+            commands_[pos] = static_cast<unsigned char>(command);
+        }
+    }
+
+private:
+    void reallocate(size_type capacity)
+    {
+        coord_type* new_vertices =
+            static_cast<coord_type*>(::operator new (capacity * (2 * sizeof(coord_type) + 1)));
+        unsigned char* new_commands = reinterpret_cast<unsigned char*>(new_vertices + (capacity << 1));
+        if (vertices_)
+        {
+            std::memcpy(new_vertices, vertices_, size_ * 2 * sizeof(coord_type));
+            std::memcpy(new_commands, commands_, size_);
+            ::operator delete(vertices_);
+        }
+        vertices_ = new_vertices;
+        commands_ = new_commands;
+        capacity_ = capacity;
+    }
+};
+
+}
+
+#endif // MAPNIK_VERTEX_ARRAY_HPP
@@ -105,6 +105,38 @@ public:
         *vertex   = y;
         ++pos_;
     }
+
+    // appends count vertices stored as interleaved x,y coordinates, which need not be aligned
+    void append(void const* xy, size_type count, unsigned command)
+    {
+        char const* src = static_cast<char const*>(xy);
+        while (count > 0)
+        {
+            unsigned block = pos_ >> block_shift;
+            if (block >= num_blocks_)
+            {
+                allocate_block(block);
+            }
+            size_type offset = pos_ & block_mask;
+            size_type n = block_size - offset;
+            if (n > count) n = count;
+            std::memcpy(vertices_[block] + (offset << 1), src, n * 2 * sizeof(coord_type));
+            std::memset(commands_[block] + offset, command, n);
+            src += n * 2 * sizeof(coord_type);
+            pos_ += n;
+            count -= n;
+        }
+    }
+
+    void reserve(size_type size)
+    {
+        unsigned blocks = (size + block_mask) >> block_shift;
+        while (num_blocks_ < blocks)
+        {
+            allocate_block(num_blocks_);
+        }
+    }
+
     unsigned get_vertex(unsigned pos,coord_type* x,coord_type* y) const
     {
         if (pos >= pos_) return SEG_END;
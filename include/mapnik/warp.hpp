@@ -24,6 +24,7 @@
 #define MAPNIK_WARP_HPP
 
 // mapnik
+#include <mapnik/config.hpp>
 #include <mapnik/image_scaling.hpp>
 
 namespace mapnik {
@@ -31,13 +32,23 @@ namespace mapnik {
 class raster;
 class proj_transform;
 
-void reproject_and_scale_raster(raster & target,
-                                raster const& source,
-                                proj_transform const& prj_trans,
-                                double offset_x, double offset_y,
-                                unsigned mesh_size,
-                                double filter_radius,
-                                scaling_method_e scaling_method);
+/*!
+ * \brief Reproject and scale the source raster into the target raster.
+ *
+ * The source is divided into cells of mesh_size pixels whose corners are
+ * projected to the target srs; the projected mesh is kept in the
+ * warp_mesh_cache for rasters of the same extent and size. With threads
+ * greater than 1 the target is rendered in up to that many horizontal
+ * bands of at least 32 rows in parallel, on threads started for the call.
+ */
+MAPNIK_DECL void reproject_and_scale_raster(raster & target,
+                                            raster const& source,
+                                            proj_transform const& prj_trans,
+                                            double offset_x, double offset_y,
+                                            unsigned mesh_size,
+                                            double filter_radius,
+                                            scaling_method_e scaling_method,
+                                            unsigned threads = 1);
 
 }
 
@@ -0,0 +1,122 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_WARP_MESH_CACHE_HPP
+#define MAPNIK_WARP_MESH_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/utils.hpp>
+#include <mapnik/noncopyable.hpp>
+#include <mapnik/box2d.hpp>
+#include <mapnik/lru_cache.hpp>
+
+// boost
+#include <boost/shared_ptr.hpp>
+
+// stl
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+/*!
+ * \brief Identifies the reprojection mesh of a source raster by the
+ * projections, the extent and size of the raster and the mesh size.
+ */
+struct warp_mesh_key
+{
+    warp_mesh_key()
+        : source_srs(), dest_srs(), ext(), width(0), height(0), mesh_size(0) {}
+    std::string source_srs;
+    std::string dest_srs;
+    box2d<double> ext;
+    unsigned width;
+    unsigned height;
+    unsigned mesh_size;
+
+    bool operator==(warp_mesh_key const& other) const
+    {
+        return width == other.width && height == other.height &&
+            mesh_size == other.mesh_size && ext == other.ext &&
+            source_srs == other.source_srs && dest_srs == other.dest_srs;
+    }
+};
+
+MAPNIK_DECL std::size_t hash_value(warp_mesh_key const& key);
+
+/*!
+ * \brief Source raster mesh points projected to the destination srs, row by row.
+ */
+struct warp_mesh
+{
+    warp_mesh(unsigned nx_, unsigned ny_)
+        : nx(nx_), ny(ny_), xs(nx_ * ny_), ys(nx_ * ny_) {}
+    unsigned nx;
+    unsigned ny;
+    std::vector<double> xs;
+    std::vector<double> ys;
+};
+
+typedef boost::shared_ptr<warp_mesh const> warp_mesh_ptr;
+
+typedef lru_cache_stats warp_mesh_cache_stats;
+
+/*!
+ * \brief Process wide cache of reprojection meshes used by reproject_and_scale_raster().
+ *
+ * Rendering the same source window again, as for adjacent metatiles or
+ * repeated renders of a layer, skips projecting the mesh. A mesh holds two
+ * doubles per mesh point, so a 4096x4096 raster with the default mesh size
+ * of 16 takes about 1MB: the cache is bounded by bytes as well as entries.
+ */
+class MAPNIK_DECL warp_mesh_cache :
+        public singleton<warp_mesh_cache, CreateStatic>,
+        private mapnik::noncopyable
+{
+    friend class CreateStatic<warp_mesh_cache>;
+public:
+    warp_mesh_ptr find(warp_mesh_key const& key);
+    void insert(warp_mesh_key const& key, warp_mesh_ptr const& mesh);
+    void clear();
+
+    // zero disables the cache, default is 16MB
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const;
+
+    // zero disables the cache, default is 256 meshes
+    void set_max_entries(std::size_t max_entries);
+    std::size_t max_entries() const;
+
+    warp_mesh_cache_stats stats() const;
+    void reset_stats();
+
+private:
+    warp_mesh_cache();
+
+    sharded_lru_cache<warp_mesh_key, warp_mesh_ptr> cache_;
+};
+
+}
+
+#endif // MAPNIK_WARP_MESH_CACHE_HPP
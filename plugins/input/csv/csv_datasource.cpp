@@ -22,9 +22,13 @@
 
 #include "csv_datasource.hpp"
 #include "csv_utils.hpp"
+#include "csv_featureset.hpp"
 
 // boost
 #include <boost/make_shared.hpp>
+#include <boost/ref.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/interprocess/streams/bufferstream.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/algorithm/string.hpp>
 
@@ -35,6 +39,7 @@
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/geometry.hpp>
 #include <mapnik/memory_featureset.hpp>
+#include <mapnik/mapped_memory_cache.hpp>
 #include <mapnik/wkt/wkt_factory.hpp>
 #include <mapnik/json/geometry_parser.hpp>
 #include <mapnik/util/geometry_to_ds_type.hpp>
@@ -65,6 +70,8 @@ csv_datasource::csv_datasource(parameters const& params)
       file_length_(0),
       row_limit_(*params.get<mapnik::value_integer>("row_limit", 0)),
       features_(),
+      rows_(),
+      index_(),
       escape_(*params.get<std::string>("escape", "")),
       separator_(*params.get<std::string>("separator", "")),
       quote_(*params.get<std::string>("quote", "")),
@@ -72,6 +79,9 @@ csv_datasource::csv_datasource(parameters const& params)
       manual_headers_(mapnik::util::trim_copy(*params.get<std::string>("headers", ""))),
       strict_(*params.get<mapnik::boolean>("strict", false)),
       filesize_max_(*params.get<double>("filesize_max", 20.0)),  // MB
+      streaming_(*params.get<mapnik::boolean>("streaming", false)),
+      file_(),
+      columns_(),
       ctx_(boost::make_shared<mapnik::context_type>())
 {
     /* TODO:
@@ -80,14 +90,10 @@ csv_datasource::csv_datasource(parameters const& params)
        - tests of grid_renderer output
        - ensure that the attribute desc_ matches the first feature added
        alternate large file pipeline:
-       - stat file, detect > 15 MB
-       - build up csv line-by-line iterator
-       - creates opportunity to filter attributes by map query
+       - stat file, detect > 15 MB and stream automatically
        speed:
        - add properties for wkt/json/lon/lat at parse time
        - add ability to pass 'filter' keyword to drop attributes at layer init
-       - create quad tree on the fly for small/med size files
-       - memory map large files for reading
        - smaller features (less memory overhead)
        usability:
        - enforce column names without leading digit
@@ -114,9 +120,21 @@ csv_datasource::csv_datasource(parameters const& params)
     }
     if (!inline_string_.empty())
     {
+        streaming_ = false;
         std::istringstream in(inline_string_);
         parse_csv(in,escape_, separator_, quote_);
     }
+    else if (streaming_)
+    {
+        // rows are only located and indexed here, and parsed again from the mapping on demand
+        boost::optional<mapnik::mapped_region_ptr> region =
+            mapnik::mapped_memory_cache::instance().find(filename_, true);
+        if (!region)
+            throw mapnik::datasource_exception("CSV Plugin: could not open: '" + filename_ + "'");
+        file_ = *region;
+        boost::interprocess::ibufferstream in(static_cast<char const*>(file_->get_address()), file_->get_size());
+        parse_csv(in,escape_, separator_, quote_);
+    }
     else
     {
         std::ifstream in(filename_.c_str(),std::ios_base::in | std::ios_base::binary);
@@ -139,7 +157,7 @@ void csv_datasource::parse_csv(T & stream,
     stream.seekg(0, std::ios::end);
     file_length_ = stream.tellg();
 
-    if (filesize_max_ > 0)
+    if (filesize_max_ > 0 && !streaming_)
     {
         double file_mb = static_cast<double>(file_length_)/1048576;
 
@@ -159,7 +177,7 @@ void csv_datasource::parse_csv(T & stream,
     // autodetect newlines
     char newline = '\n';
     bool has_newline = false;
-    for (unsigned lidx = 0; lidx < file_length_ && lidx < 4000; lidx++)
+    for (std::streamoff lidx = 0; lidx < file_length_ && lidx < 4000; lidx++)
     {
         char c = static_cast<char>(stream.get());
         if (c == '\r')
@@ -399,33 +417,50 @@ void csv_datasource::parse_csv(T & stream,
         throw mapnik::datasource_exception("CSV Plugin: could not detect column headers with the name of wkt, geojson, x/y, or latitude/longitude - this is required for reading geometry data");
     }
 
+    columns_.grammer = grammer;
+    columns_.quote = quo;
+    columns_.has_wkt_field = has_wkt_field;
+    columns_.has_json_field = has_json_field;
+    columns_.has_lat_field = has_lat_field;
+    columns_.has_lon_field = has_lon_field;
+    columns_.wkt_idx = wkt_idx;
+    columns_.json_idx = json_idx;
+    columns_.lat_idx = lat_idx;
+    columns_.lon_idx = lon_idx;
+
     mapnik::value_integer feature_count(0);
     bool extent_initialized = false;
-    std::size_t num_headers = headers_.size();
 
     for (std::size_t i = 0; i < headers_.size(); ++i)
     {
         ctx_->push(headers_[i]);
     }
 
-    mapnik::transcoder tr(desc_.get_encoding());
-    mapnik::wkt_parser parse_wkt;
-    mapnik::json::geometry_parser<std::string::const_iterator> parse_json;
+    row_parsers parsers(desc_.get_encoding());
+
+    // when streaming, attributes are parsed at query time, so only the first
+    // row is read in full to type the layer descriptor
+    std::set<std::string> const no_attributes;
 
     // handle rare case of a single line of data and user-provided headers
     // where a lack of a newline will mean that std::getline returns false
     bool is_first_row = false;
     if (!has_newline)
     {
+        // rows are located by offset, which can't be trusted here
+        streaming_ = false;
         stream >> csv_line;
         if (!csv_line.empty())
         {
             is_first_row = true;
         }
     }
+    std::streamoff row_start = streaming_ ? static_cast<std::streamoff>(stream.tellg()) : 0;
     while (std::getline(stream,csv_line,newline) || is_first_row)
     {
         is_first_row = false;
+        std::streamoff row_offset = row_start;
+        if (streaming_) row_start = stream.tellg();
         if ((row_limit_ > 0) && (line_number > row_limit_))
         {
             MAPNIK_LOG_DEBUG(csv) << "csv_datasource: row limit hit, exiting at feature: " << feature_count;
@@ -448,421 +483,446 @@ void csv_datasource::parse_csv(T & stream,
 
         try
         {
-            // special handling for varieties of quoting that we will enounter with json
-            // TODO - test with custom "quo" option
-            if (has_json_field && (quo == "\"") && (std::count(csv_line.begin(), csv_line.end(), '"') >= 6))
+            // NOTE: feature id's should start at 1
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_count + 1));
+            std::vector<mapnik::attribute_descriptor> descriptors;
+            bool first = (feature_count == 0);
+            if (!parse_row(csv_line, line_number, *feature, parsers,
+                           (streaming_ && !first) ? &no_attributes : 0,
+                           first ? &descriptors : 0, true))
             {
-                csv_utils::fix_json_quoting(csv_line);
+                continue;
+            }
+            ++feature_count;
+            for (std::size_t i = 0; i < descriptors.size(); ++i)
+            {
+                desc_.add_descriptor(descriptors[i]);
             }
 
-            Tokenizer tok(csv_line, grammer);
-            Tokenizer::iterator beg = tok.begin();
+            mapnik::box2d<double> box = feature->envelope();
+            if (!extent_initialized)
+            {
+                extent_initialized = true;
+                extent_ = box;
+            }
+            else
+            {
+                extent_.expand_to_include(box);
+            }
 
-            unsigned num_fields = std::distance(beg,tok.end());
-            if (num_fields > num_headers)
+            if (streaming_)
+            {
+                row_ref row;
+                row.offset = static_cast<std::size_t>(row_offset);
+                row.size = line_length;
+                row.line_number = line_number;
+                row.id = feature_count;
+                index_.insert(rows_.size(), box);
+                rows_.push_back(row);
+            }
+            else
+            {
+                index_.insert(features_.size(), box);
+                features_.push_back(feature);
+            }
+            ++line_number;
+        }
+        catch(mapnik::datasource_exception const& ex )
+        {
+            if (strict_)
+            {
+                throw mapnik::datasource_exception(ex.what());
+            }
+            else
+            {
+                MAPNIK_LOG_ERROR(csv) << ex.what();
+            }
+        }
+        catch(std::exception const& ex)
+        {
+            std::ostringstream s;
+            s << "CSV Plugin: unexpected error parsing line: " << line_number
+              << " - found " << headers_.size() << " with values like: " << csv_line << "\n"
+              << " and got error like: " << ex.what();
+            if (strict_)
             {
-                std::ostringstream s;
-                s << "CSV Plugin: # of columns("
-                << num_fields << ") > # of headers("
-                << num_headers << ") parsed for row " << line_number << "\n";
                 throw mapnik::datasource_exception(s.str());
             }
-            else if (num_fields < num_headers)
+            else
             {
-                std::ostringstream s;
-                s << "CSV Plugin: # of headers("
-                << num_headers << ") > # of columns("
-                << num_fields << ") parsed for row " << line_number << "\n";
-                if (strict_)
-                {
-                    throw mapnik::datasource_exception(s.str());
-                }
-                else
-                {
-                    MAPNIK_LOG_WARN(csv) << s.str();
-                }
+                MAPNIK_LOG_ERROR(csv) << s.str();
             }
+        }
+    }
+    if (!feature_count > 0)
+    {
+        MAPNIK_LOG_ERROR(csv) << "CSV Plugin: could not parse any lines of data";
+    }
 
-            // NOTE: we use ++feature_count here because feature id's should start at 1;
-            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,++feature_count));
-            double x(0);
-            double y(0);
-            bool parsed_x = false;
-            bool parsed_y = false;
-            bool parsed_wkt = false;
-            bool parsed_json = false;
-            std::vector<std::string> collected;
-            for (unsigned i = 0; i < num_headers; ++i)
-            {
-                std::string fld_name(headers_.at(i));
-                collected.push_back(fld_name);
-                std::string value;
-                if (beg == tok.end()) // there are more headers than column values for this row
-                {
-                    // add an empty string here to represent a missing value
-                    // not using null type here since nulls are not a csv thing
-                    feature->put(fld_name,tr.transcode(value.c_str()));
-                    if (feature_count == 1)
-                    {
-                        desc_.add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
-                    }
-                    // continue here instead of break so that all missing values are
-                    // encoded consistenly as empty strings
-                    continue;
-                }
-                else
-                {
-                    value = mapnik::util::trim_copy(*beg);
-                    ++beg;
-                }
+    index_.build();
+}
 
-                int value_length = value.length();
+bool csv_datasource::parse_row(std::string & csv_line,
+                               int line_number,
+                               mapnik::feature_impl & feature,
+                               row_parsers & parsers,
+                               std::set<std::string> const* names,
+                               std::vector<mapnik::attribute_descriptor> * descriptors,
+                               bool report) const
+{
+    typedef boost::tokenizer< boost::escaped_list_separator<char> > Tokenizer;
+    std::size_t num_headers = headers_.size();
 
-                // parse wkt
-                if (has_wkt_field)
-                {
-                    if (i == wkt_idx)
-                    {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
+    // special handling for varieties of quoting that we will enounter with json
+    // TODO - test with custom "quo" option
+    if (columns_.has_json_field && (columns_.quote == "\"") && (std::count(csv_line.begin(), csv_line.end(), '"') >= 6))
+    {
+        csv_utils::fix_json_quoting(csv_line);
+    }
 
-                        if (parse_wkt.parse(value, feature->paths()))
-                        {
-                            parsed_wkt = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected well known text geometry: could not parse row "
-                              << line_number
-                              << ",column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
-                    }
+    Tokenizer tok(csv_line, columns_.grammer);
+    Tokenizer::iterator beg = tok.begin();
+
+    unsigned num_fields = std::distance(beg,tok.end());
+    if (num_fields > num_headers)
+    {
+        std::ostringstream s;
+        s << "CSV Plugin: # of columns("
+        << num_fields << ") > # of headers("
+        << num_headers << ") parsed for row " << line_number << "\n";
+        throw mapnik::datasource_exception(s.str());
+    }
+    else if (num_fields < num_headers)
+    {
+        std::ostringstream s;
+        s << "CSV Plugin: # of headers("
+        << num_headers << ") > # of columns("
+        << num_fields << ") parsed for row " << line_number << "\n";
+        if (strict_)
+        {
+            throw mapnik::datasource_exception(s.str());
+        }
+        else if (report)
+        {
+            MAPNIK_LOG_WARN(csv) << s.str();
+        }
+    }
+
+    double x(0);
+    double y(0);
+    bool parsed_x = false;
+    bool parsed_y = false;
+    bool parsed_wkt = false;
+    bool parsed_json = false;
+    std::vector<std::string> collected;
+    unsigned last_geometry_column = columns_.has_wkt_field ? columns_.wkt_idx :
+        (columns_.has_json_field ? columns_.json_idx : std::max(columns_.lat_idx, columns_.lon_idx));
+    for (unsigned i = 0; i < num_headers; ++i)
+    {
+        // with no attributes wanted, nothing is left to read past the geometry
+        if (names && names->empty() && i > last_geometry_column) break;
+        std::string fld_name(headers_.at(i));
+        collected.push_back(fld_name);
+        std::string value;
+        if (beg == tok.end()) // there are more headers than column values for this row
+        {
+            if (names && names->find(fld_name) == names->end()) continue;
+            // add an empty string here to represent a missing value
+            // not using null type here since nulls are not a csv thing
+            feature.put(fld_name,parsers.tr.transcode(value.c_str()));
+            if (descriptors)
+            {
+                descriptors->push_back(mapnik::attribute_descriptor(fld_name,mapnik::String));
+            }
+            // continue here instead of break so that all missing values are
+            // encoded consistenly as empty strings
+            continue;
+        }
+        else
+        {
+            value = mapnik::util::trim_copy(*beg);
+            ++beg;
+        }
+
+        int value_length = value.length();
+
+        // parse wkt
+        if (columns_.has_wkt_field)
+        {
+            if (i == columns_.wkt_idx)
+            {
+                // skip empty geoms
+                if (value.empty())
+                {
+                    break;
                 }
-                // TODO - support both wkt/geojson columns
-                // at once to create multi-geoms?
-                // parse as geojson
-                else if (has_json_field)
+
+                if (parsers.wkt.parse(value, feature.paths()))
                 {
-                    if (i == json_idx)
-                    {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-                        if (parse_json.parse(value.begin(),value.end(), feature->paths()))
-                        {
-                            parsed_json = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected geojson geometry: could not parse row "
-                              << line_number
-                              << ",column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
-                    }
+                    parsed_wkt = true;
                 }
                 else
                 {
-                    // longitude
-                    if (i == lon_idx)
+                    std::ostringstream s;
+                    s << "CSV Plugin: expected well known text geometry: could not parse row "
+                      << line_number
+                      << ",column "
+                      << i << " - found: '"
+                      << value << "'";
+                    if (strict_)
                     {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-
-                        if (mapnik::util::string2double(value,x))
-                        {
-                            parsed_x = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected a float value for longitude: could not parse row "
-                              << line_number
-                              << ", column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
+                        throw mapnik::datasource_exception(s.str());
                     }
-                    // latitude
-                    else if (i == lat_idx)
+                    else if (report)
                     {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-
-                        if (mapnik::util::string2double(value,y))
-                        {
-                            parsed_y = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected a float value for latitude: could not parse row "
-                              << line_number
-                              << ", column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
+                        MAPNIK_LOG_ERROR(csv) << s.str();
                     }
                 }
-
-                // now, add attributes, skipping any WKT or JSON fields
-                if ((has_wkt_field) && (i == wkt_idx)) continue;
-                if ((has_json_field) && (i == json_idx)) continue;
-                /* First we detect likely strings, then try parsing likely numbers,
-                   finally falling back to string type
-                   * We intentionally do not try to detect boolean or null types
-                   since they are not common in csv
-                   * Likely strings are either empty values, very long values
-                   or value with leading zeros like 001 (which are not safe
-                   to assume are numbers)
-                */
-
-                bool matched = false;
-                bool has_dot = value.find(".") != std::string::npos;
-                if (value.empty() ||
-                    (value_length > 20) ||
-                    (value_length > 1 && !has_dot && value[0] == '0'))
+            }
+        }
+        // TODO - support both wkt/geojson columns
+        // at once to create multi-geoms?
+        // parse as geojson
+        else if (columns_.has_json_field)
+        {
+            if (i == columns_.json_idx)
+            {
+                // skip empty geoms
+                if (value.empty())
                 {
-                    matched = true;
-                    feature->put(fld_name,tr.transcode(value.c_str()));
-                    if (feature_count == 1)
-                    {
-                        desc_.add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
-                    }
+                    break;
                 }
-                else if ((value[0] >= '0' && value[0] <= '9') ||
-                          value[0] == '-' ||
-                          value[0] == '+' ||
-                          value[0] == '.')
+                if (parsers.json.parse(value.begin(),value.end(), feature.paths()))
                 {
-                    bool has_e = value.find("e") != std::string::npos;
-                    if (has_dot || has_e)
+                    parsed_json = true;
+                }
+                else
+                {
+                    std::ostringstream s;
+                    s << "CSV Plugin: expected geojson geometry: could not parse row "
+                      << line_number
+                      << ",column "
+                      << i << " - found: '"
+                      << value << "'";
+                    if (strict_)
                     {
-                        double float_val = 0.0;
-                        if (mapnik::util::string2double(value,float_val))
-                        {
-                            matched = true;
-                            feature->put(fld_name,float_val);
-                            if (feature_count == 1)
-                            {
-                                desc_.add_descriptor(
-                                    mapnik::attribute_descriptor(
-                                        fld_name,mapnik::Double));
-                            }
-                        }
+                        throw mapnik::datasource_exception(s.str());
                     }
-                    else
+                    else if (report)
                     {
-                        mapnik::value_integer int_val = 0;
-                        if (mapnik::util::string2int(value,int_val))
-                        {
-                            matched = true;
-                            feature->put(fld_name,int_val);
-                            if (feature_count == 1)
-                            {
-                                desc_.add_descriptor(
-                                    mapnik::attribute_descriptor(
-                                        fld_name,mapnik::Integer));
-                            }
-                        }
+                        MAPNIK_LOG_ERROR(csv) << s.str();
                     }
                 }
-                if (!matched)
+            }
+        }
+        else
+        {
+            // longitude
+            if (i == columns_.lon_idx)
+            {
+                // skip empty geoms
+                if (value.empty())
                 {
-                    // fallback to normal string
-                    feature->put(fld_name,tr.transcode(value.c_str()));
-                    if (feature_count == 1)
-                    {
-                        desc_.add_descriptor(
-                            mapnik::attribute_descriptor(
-                                fld_name,mapnik::String));
-                    }
+                    break;
                 }
-            }
 
-            bool null_geom = true;
-            if (has_wkt_field || has_json_field)
-            {
-                if (parsed_wkt || parsed_json)
+                if (mapnik::util::string2double(value,x))
                 {
-                    if (!extent_initialized)
-                    {
-                        extent_initialized = true;
-                        extent_ = feature->envelope();
-                    }
-                    else
-                    {
-                        extent_.expand_to_include(feature->envelope());
-                    }
-                    features_.push_back(feature);
-                    null_geom = false;
+                    parsed_x = true;
                 }
                 else
                 {
                     std::ostringstream s;
-                    s << "CSV Plugin: could not read WKT or GeoJSON geometry "
-                      << "for line " << line_number << " - found " <<  headers_.size()
-                      << " with values like: " << csv_line << "\n";
+                    s << "CSV Plugin: expected a float value for longitude: could not parse row "
+                      << line_number
+                      << ", column "
+                      << i << " - found: '"
+                      << value << "'";
                     if (strict_)
                     {
                         throw mapnik::datasource_exception(s.str());
                     }
-                    else
+                    else if (report)
                     {
                         MAPNIK_LOG_ERROR(csv) << s.str();
-                        continue;
                     }
                 }
             }
-            else if (has_lat_field || has_lon_field)
+            // latitude
+            else if (i == columns_.lat_idx)
             {
-                if (parsed_x && parsed_y)
+                // skip empty geoms
+                if (value.empty())
                 {
-                    mapnik::geometry_type * pt = new mapnik::geometry_type(mapnik::Point);
-                    pt->move_to(x,y);
-                    feature->add_geometry(pt);
-                    features_.push_back(feature);
-                    null_geom = false;
-                    if (!extent_initialized)
-                    {
-                        extent_initialized = true;
-                        extent_ = feature->envelope();
-                    }
-                    else
-                    {
-                        extent_.expand_to_include(feature->envelope());
-                    }
+                    break;
+                }
+
+                if (mapnik::util::string2double(value,y))
+                {
+                    parsed_y = true;
                 }
-                else if (parsed_x || parsed_y)
+                else
                 {
                     std::ostringstream s;
-                    s << "CSV Plugin: does your csv have valid headers?\n";
-                    if (!parsed_x)
-                    {
-                          s << "Could not detect or parse any rows named 'x' or 'longitude' "
-                          << "for line " << line_number << " but found " <<  headers_.size()
-                          << " with values like: " << csv_line << "\n"
-                          << "for: " << boost::algorithm::join(collected, ",") << "\n";
-                    }
-                    if (!parsed_y)
-                    {
-                          s << "Could not detect or parse any rows named 'y' or 'latitude' "
-                          << "for line " << line_number << " but found " <<  headers_.size()
-                          << " with values like: " << csv_line << "\n"
-                          << "for: " << boost::algorithm::join(collected, ",") << "\n";
-                    }
+                    s << "CSV Plugin: expected a float value for latitude: could not parse row "
+                      << line_number
+                      << ", column "
+                      << i << " - found: '"
+                      << value << "'";
                     if (strict_)
                     {
                         throw mapnik::datasource_exception(s.str());
                     }
-                    else
+                    else if (report)
                     {
                         MAPNIK_LOG_ERROR(csv) << s.str();
-                        continue;
                     }
                 }
             }
+        }
 
-            if (null_geom)
+        // now, add attributes, skipping any WKT or JSON fields
+        if ((columns_.has_wkt_field) && (i == columns_.wkt_idx)) continue;
+        if ((columns_.has_json_field) && (i == columns_.json_idx)) continue;
+        // and any that weren't asked for
+        if (names && names->find(fld_name) == names->end()) continue;
+        /* First we detect likely strings, then try parsing likely numbers,
+           finally falling back to string type
+           * We intentionally do not try to detect boolean or null types
+           since they are not common in csv
+           * Likely strings are either empty values, very long values
+           or value with leading zeros like 001 (which are not safe
+           to assume are numbers)
+        */
+
+        bool matched = false;
+        bool has_dot = value.find(".") != std::string::npos;
+        if (value.empty() ||
+            (value_length > 20) ||
+            (value_length > 1 && !has_dot && value[0] == '0'))
+        {
+            matched = true;
+            feature.put(fld_name,parsers.tr.transcode(value.c_str()));
+            if (descriptors)
             {
-                std::ostringstream s;
-                s << "CSV Plugin: could not detect and parse valid lat/lon fields or wkt/json geometry for line "
-                  << line_number;
-                if (strict_)
+                descriptors->push_back(mapnik::attribute_descriptor(fld_name,mapnik::String));
+            }
+        }
+        else if ((value[0] >= '0' && value[0] <= '9') ||
+                  value[0] == '-' ||
+                  value[0] == '+' ||
+                  value[0] == '.')
+        {
+            bool has_e = value.find("e") != std::string::npos;
+            if (has_dot || has_e)
+            {
+                double float_val = 0.0;
+                if (mapnik::util::string2double(value,float_val))
                 {
-                    throw mapnik::datasource_exception(s.str());
+                    matched = true;
+                    feature.put(fld_name,float_val);
+                    if (descriptors)
+                    {
+                        descriptors->push_back(mapnik::attribute_descriptor(fld_name,mapnik::Double));
+                    }
                 }
-                else
+            }
+            else
+            {
+                mapnik::value_integer int_val = 0;
+                if (mapnik::util::string2int(value,int_val))
                 {
-                    MAPNIK_LOG_ERROR(csv) << s.str();
-                    // with no geometry we will never
-                    // add this feature so drop the count
-                    feature_count--;
-                    continue;
+                    matched = true;
+                    feature.put(fld_name,int_val);
+                    if (descriptors)
+                    {
+                        descriptors->push_back(mapnik::attribute_descriptor(fld_name,mapnik::Integer));
+                    }
                 }
             }
-
-            ++line_number;
         }
-        catch(mapnik::datasource_exception const& ex )
+        if (!matched)
         {
-            if (strict_)
-            {
-                throw mapnik::datasource_exception(ex.what());
-            }
-            else
+            // fallback to normal string
+            feature.put(fld_name,parsers.tr.transcode(value.c_str()));
+            if (descriptors)
             {
-                MAPNIK_LOG_ERROR(csv) << ex.what();
+                descriptors->push_back(mapnik::attribute_descriptor(fld_name,mapnik::String));
             }
         }
-        catch(std::exception const& ex)
+    }
+
+    if (columns_.has_wkt_field || columns_.has_json_field)
+    {
+        if (parsed_wkt || parsed_json)
+        {
+            return true;
+        }
+        std::ostringstream s;
+        s << "CSV Plugin: could not read WKT or GeoJSON geometry "
+          << "for line " << line_number << " - found " <<  headers_.size()
+          << " with values like: " << csv_line << "\n";
+        if (strict_)
+        {
+            throw mapnik::datasource_exception(s.str());
+        }
+        if (report)
+        {
+            MAPNIK_LOG_ERROR(csv) << s.str();
+        }
+        return false;
+    }
+    else if (columns_.has_lat_field || columns_.has_lon_field)
+    {
+        if (parsed_x && parsed_y)
+        {
+            mapnik::geometry_type * pt = new mapnik::geometry_type(mapnik::Point);
+            pt->move_to(x,y);
+            feature.add_geometry(pt);
+            return true;
+        }
+        else if (parsed_x || parsed_y)
         {
             std::ostringstream s;
-            s << "CSV Plugin: unexpected error parsing line: " << line_number
-              << " - found " << headers_.size() << " with values like: " << csv_line << "\n"
-              << " and got error like: " << ex.what();
+            s << "CSV Plugin: does your csv have valid headers?\n";
+            if (!parsed_x)
+            {
+                  s << "Could not detect or parse any rows named 'x' or 'longitude' "
+                  << "for line " << line_number << " but found " <<  headers_.size()
+                  << " with values like: " << csv_line << "\n"
+                  << "for: " << boost::algorithm::join(collected, ",") << "\n";
+            }
+            if (!parsed_y)
+            {
+                  s << "Could not detect or parse any rows named 'y' or 'latitude' "
+                  << "for line " << line_number << " but found " <<  headers_.size()
+                  << " with values like: " << csv_line << "\n"
+                  << "for: " << boost::algorithm::join(collected, ",") << "\n";
+            }
             if (strict_)
             {
                 throw mapnik::datasource_exception(s.str());
             }
-            else
+            if (report)
             {
                 MAPNIK_LOG_ERROR(csv) << s.str();
             }
+            return false;
         }
     }
-    if (!feature_count > 0)
+
+    std::ostringstream s;
+    s << "CSV Plugin: could not detect and parse valid lat/lon fields or wkt/json geometry for line "
+      << line_number;
+    if (strict_)
     {
-        MAPNIK_LOG_ERROR(csv) << "CSV Plugin: could not parse any lines of data";
+        throw mapnik::datasource_exception(s.str());
+    }
+    if (report)
+    {
+        MAPNIK_LOG_ERROR(csv) << s.str();
     }
+    return false;
 }
 
 const char * csv_datasource::name()
@@ -884,10 +944,27 @@ boost::optional<mapnik::datasource::geometry_t> csv_datasource::get_geometry_typ
 {
     boost::optional<mapnik::datasource::geometry_t> result;
     int multi_type = 0;
-    unsigned num_features = features_.size();
+    unsigned num_features = streaming_ ? rows_.size() : features_.size();
+    boost::scoped_ptr<row_parsers> parsers;
+    if (streaming_ && num_features > 0) parsers.reset(new row_parsers(desc_.get_encoding()));
+    std::set<std::string> const no_attributes;
     for (unsigned i = 0; i < num_features && i < 5; ++i)
     {
-        mapnik::util::to_ds_type(features_[i]->paths(),result);
+        mapnik::feature_ptr feature;
+        if (streaming_)
+        {
+            row_ref const& row = rows_[i];
+            char const* data = static_cast<char const*>(file_->get_address()) + row.offset;
+            std::string csv_line(data, row.size);
+            feature = mapnik::feature_factory::create(ctx_, row.id);
+            // problems with the row were reported when the index was built
+            parse_row(csv_line, row.line_number, *feature, *parsers, &no_attributes, 0, false);
+        }
+        else
+        {
+            feature = features_[i];
+        }
+        mapnik::util::to_ds_type(feature->paths(),result);
         if (result)
         {
             int type = static_cast<int>(*result);
@@ -931,7 +1008,13 @@ mapnik::featureset_ptr csv_datasource::features(mapnik::query const& q) const
         }
         ++pos;
     }
-    return boost::make_shared<mapnik::memory_featureset>(q.get_bbox(),features_);
+    std::vector<std::size_t> candidates;
+    index_.query(q.get_bbox(), candidates);
+    if (streaming_)
+    {
+        return boost::make_shared<csv_featureset>(boost::cref(*this),q.get_bbox(),boost::ref(candidates),boost::cref(attribute_names));
+    }
+    return boost::make_shared<mapnik::memory_featureset>(q.get_bbox(),boost::cref(features_),boost::ref(candidates));
 }
 
 mapnik::featureset_ptr csv_datasource::features_at_point(mapnik::coord2d const& pt, double tol) const
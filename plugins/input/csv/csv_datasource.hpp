@@ -32,17 +32,27 @@
 #include <mapnik/coord.hpp>
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/value_types.hpp>
+#include <mapnik/packed_rtree.hpp>
+#include <mapnik/mapped_memory_cache.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/wkt/wkt_factory.hpp>
+#include <mapnik/json/geometry_parser.hpp>
+#include <mapnik/noncopyable.hpp>
 
 // boost
 #include <boost/optional.hpp>
+#include <boost/tokenizer.hpp>
 
 // stl
 #include <vector>
 #include <deque>
+#include <ios>
+#include <set>
 #include <string>
 
 class csv_datasource : public mapnik::datasource
 {
+    friend class csv_featureset;
 public:
     csv_datasource(mapnik::parameters const& params);
     virtual ~csv_datasource ();
@@ -61,13 +71,70 @@ public:
                    std::string const& quote);
 
 private:
+    // parsers reused for every row read in one pass or featureset
+    struct row_parsers : private mapnik::noncopyable
+    {
+        explicit row_parsers(std::string const& encoding)
+            : tr(encoding) {}
+        mapnik::transcoder tr;
+        mapnik::wkt_parser wkt;
+        mapnik::json::geometry_parser<std::string::const_iterator> json;
+    };
+
+    // problems with the row are logged only with report set: rows of a
+    // streamed file are parsed again at query time and reported once
+    bool parse_row(std::string & csv_line,
+                   int line_number,
+                   mapnik::feature_impl & feature,
+                   row_parsers & parsers,
+                   std::set<std::string> const* names,
+                   std::vector<mapnik::attribute_descriptor> * descriptors,
+                   bool report) const;
+
+    // location of a data row in a streamed file
+    struct row_ref
+    {
+        std::size_t offset;
+        unsigned size;
+        int line_number;
+        mapnik::value_integer id;
+    };
+
+    // tokenizer settings and geometry columns detected from the headers
+    struct columns
+    {
+        columns()
+            : grammer(),
+              quote(),
+              has_wkt_field(false),
+              has_json_field(false),
+              has_lat_field(false),
+              has_lon_field(false),
+              wkt_idx(0),
+              json_idx(0),
+              lat_idx(0),
+              lon_idx(0) {}
+        boost::escaped_list_separator<char> grammer;
+        std::string quote;
+        bool has_wkt_field;
+        bool has_json_field;
+        bool has_lat_field;
+        bool has_lon_field;
+        unsigned wkt_idx;
+        unsigned json_idx;
+        unsigned lat_idx;
+        unsigned lon_idx;
+    };
+
     mapnik::layer_descriptor desc_;
     mapnik::box2d<double> extent_;
     std::string filename_;
     std::string inline_string_;
-    unsigned file_length_;
+    std::streamoff file_length_;
     mapnik::value_integer row_limit_;
     std::deque<mapnik::feature_ptr> features_;
+    std::vector<row_ref> rows_;
+    mapnik::packed_rtree index_;
     std::string escape_;
     std::string separator_;
     std::string quote_;
@@ -75,6 +142,9 @@ private:
     std::string manual_headers_;
     bool strict_;
     double filesize_max_;
+    bool streaming_;
+    mapnik::mapped_region_ptr file_;
+    columns columns_;
     mapnik::context_ptr ctx_;
 };
 
@@ -0,0 +1,83 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/debug.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/geometry.hpp>
+
+// stl
+#include <algorithm>
+
+#include "csv_featureset.hpp"
+
+csv_featureset::csv_featureset(csv_datasource const& ds,
+                               mapnik::box2d<double> const& bbox,
+                               std::vector<std::size_t> & rows,
+                               std::set<std::string> const& names)
+    : ds_(ds),
+      file_(ds.file_),
+      bbox_(bbox),
+      rows_(),
+      pos_(0),
+      names_(names),
+      parsers_(ds.desc_.get_encoding())
+{
+    // visit rows in file order
+    rows_.swap(rows);
+    std::sort(rows_.begin(), rows_.end());
+}
+
+csv_featureset::~csv_featureset() {}
+
+mapnik::feature_ptr csv_featureset::next()
+{
+    char const* data = static_cast<char const*>(file_->get_address());
+    while (pos_ < rows_.size())
+    {
+        csv_datasource::row_ref const& row = ds_.rows_[rows_[pos_++]];
+        std::string csv_line(data + row.offset, row.size);
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ds_.ctx_, row.id));
+        // problems with the row were reported once, when the index was built,
+        // so rows failing again are skipped silently
+        try
+        {
+            if (!ds_.parse_row(csv_line, row.line_number, *feature, parsers_, &names_, 0, false))
+            {
+                continue;
+            }
+        }
+        catch (mapnik::datasource_exception const&)
+        {
+            continue;
+        }
+        for (unsigned i = 0; i < feature->num_geometries(); ++i)
+        {
+            if (bbox_.intersects(feature->get_geometry(i).envelope()))
+            {
+                return feature;
+            }
+        }
+    }
+    return mapnik::feature_ptr();
+}
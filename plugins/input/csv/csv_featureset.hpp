@@ -0,0 +1,58 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef CSV_FEATURESET_HPP
+#define CSV_FEATURESET_HPP
+
+// mapnik
+#include <mapnik/feature.hpp>
+#include <mapnik/box2d.hpp>
+
+// stl
+#include <set>
+#include <string>
+#include <vector>
+
+#include "csv_datasource.hpp"
+
+// parses the candidate rows of a streamed csv file as they are requested
+class csv_featureset : public mapnik::Featureset
+{
+public:
+    csv_featureset(csv_datasource const& ds,
+                   mapnik::box2d<double> const& bbox,
+                   std::vector<std::size_t> & rows,
+                   std::set<std::string> const& names);
+    virtual ~csv_featureset();
+    mapnik::feature_ptr next();
+
+private:
+    csv_datasource const& ds_;
+    mapnik::mapped_region_ptr file_;
+    mapnik::box2d<double> bbox_;
+    std::vector<std::size_t> rows_;
+    std::size_t pos_;
+    std::set<std::string> names_;
+    csv_datasource::row_parsers parsers_;
+};
+
+#endif // CSV_FEATURESET_HPP
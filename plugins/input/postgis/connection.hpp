@@ -30,8 +30,12 @@
 
 // boost
 #include <boost/make_shared.hpp>
+#ifdef MAPNIK_THREADSAFE
+#include <boost/thread/mutex.hpp>
+#endif
 
 // std
+#include <map>
 #include <sstream>
 #include <iostream>
 
@@ -46,7 +50,8 @@ class Connection
 public:
     Connection(std::string const& connection_str,boost::optional<std::string> const& password)
         : cursorId(0),
-          closed_(false)
+          closed_(false),
+          pending_owner_(0)
     {
         std::string connect_with_pass = connection_str;
         if (password && !password->empty())
@@ -83,6 +88,10 @@ public:
         mapnik::progress_timer __stats__(std::clog, std::string("postgis_connection::execute ") + sql);
 #endif
 
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        parkPending();
         PGresult *result = PQexec(conn_, sql.c_str());
         bool ok = (result && (PQresultStatus(result) == PGRES_COMMAND_OK));
         PQclear(result);
@@ -95,6 +104,10 @@ public:
         mapnik::progress_timer __stats__(std::clog, std::string("postgis_connection::execute_query ") + sql);
 #endif
 
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        parkPending();
         PGresult* result = 0;
         if (type == 1)
         {
@@ -105,21 +118,70 @@ public:
             result = PQexec(conn_, sql.c_str());
         }
 
-        if (! result || (PQresultStatus(result) != PGRES_TUPLES_OK))
+        return checkedResult(result, sql);
+    }
+
+    /*
+     * Asynchronous queries: at most one query is in flight per connection and
+     * its owner collects the result with getResult(). When the connection is
+     * used for anything else before that, the in-flight result is read first
+     * and parked until its owner asks for it. The in-flight and parked state
+     * is guarded by a mutex, as result sets of one connection may be read
+     * from different threads (e.g. layers prefetched concurrently).
+     */
+    void sendQuery(std::string const& sql, void const* owner)
+    {
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        parkPending();
+        if (! PQsendQuery(conn_, sql.c_str()))
         {
             std::string err_msg = status();
             err_msg += "\nFull sql was: '";
             err_msg += sql;
             err_msg += "'\n";
+            throw mapnik::datasource_exception(err_msg);
+        }
+        pending_owner_ = owner;
+        pending_sql_ = sql;
+    }
+
+    // reads whatever arrived for the query in flight, without blocking
+    void consumeInput() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        if (pending_owner_)
+        {
+            PQconsumeInput(conn_);
+        }
+    }
+
+    boost::shared_ptr<ResultSet> getResult(void const* owner) const
+    {
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        return takeResult(owner);
+    }
+
+    void discardResult(void const* owner) const
+    {
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        if (pending_owner_ == owner)
+        {
+            pending_owner_ = 0;
+            PGresult* result = collectResult();
             if (result)
             {
                 PQclear(result);
             }
-
-            throw mapnik::datasource_exception(err_msg);
         }
-
-        return boost::make_shared<ResultSet>(result);
+        parked_.erase(owner);
     }
 
     std::string status() const
@@ -143,13 +205,23 @@ public:
 
     bool isOK() const
     {
-        return (PQstatus(conn_) != CONNECTION_BAD);
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        return (!closed_ && PQstatus(conn_) != CONNECTION_BAD);
     }
 
     void close()
     {
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
         if (! closed_)
         {
+            // results still in flight die with the connection; their owners
+            // get an error instead of reading from a finished connection
+            pending_owner_ = 0;
+            parked_.clear();
             PQfinish(conn_);
 
             MAPNIK_LOG_DEBUG(postgis) << "postgis_connection: datasource closed, also closing connection - " << conn_;
@@ -158,17 +230,105 @@ public:
         }
     }
 
+    // cursors of one connection may be declared from several threads
     std::string new_cursor_name()
     {
+#ifdef MAPNIK_THREADSAFE
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
         std::ostringstream s;
         s << "mapnik_" << (cursorId++);
         return s.str();
     }
 
 private:
+    struct parked_result
+    {
+        boost::shared_ptr<ResultSet> rs;
+        std::string error;
+    };
+    typedef std::map<void const*, parked_result> parked_results;
+
+    boost::shared_ptr<ResultSet> checkedResult(PGresult* result, std::string const& sql) const
+    {
+        if (! result || (PQresultStatus(result) != PGRES_TUPLES_OK))
+        {
+            std::string err_msg = status();
+            err_msg += "\nFull sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            if (result)
+            {
+                PQclear(result);
+            }
+
+            throw mapnik::datasource_exception(err_msg);
+        }
+
+        return boost::make_shared<ResultSet>(result);
+    }
+
+    // the caller holds the mutex
+    boost::shared_ptr<ResultSet> takeResult(void const* owner) const
+    {
+        if (pending_owner_ == owner)
+        {
+            pending_owner_ = 0;
+            return checkedResult(collectResult(), pending_sql_);
+        }
+        parked_results::iterator itr = parked_.find(owner);
+        if (itr == parked_.end())
+        {
+            throw mapnik::datasource_exception("Postgis Plugin: no query in flight");
+        }
+        parked_result parked = itr->second;
+        parked_.erase(itr);
+        if (! parked.error.empty())
+        {
+            throw mapnik::datasource_exception(parked.error);
+        }
+        return parked.rs;
+    }
+
+    // PQgetResult must be called until it returns null before the next query
+    PGresult* collectResult() const
+    {
+        PGresult* result = PQgetResult(conn_);
+        PGresult* extra;
+        while ((extra = PQgetResult(conn_)) != 0)
+        {
+            PQclear(extra);
+        }
+        return result;
+    }
+
+    void parkPending() const
+    {
+        if (pending_owner_)
+        {
+            void const* owner = pending_owner_;
+            parked_result parked;
+            try
+            {
+                parked.rs = takeResult(owner);
+            }
+            catch (mapnik::datasource_exception const& ex)
+            {
+                parked.error = ex.what();
+            }
+            parked_[owner] = parked;
+        }
+    }
+
     PGconn *conn_;
     int cursorId;
     bool closed_;
+    mutable void const* pending_owner_;
+    mutable std::string pending_sql_;
+    mutable parked_results parked_;
+#ifdef MAPNIK_THREADSAFE
+    mutable boost::mutex mutex_;
+#endif
 };
 
 #endif //CONNECTION_HPP
@@ -109,7 +109,12 @@ class ConnectionManager : public singleton <ConnectionManager,CreateStatic>
 
 public:
 
-    bool registerPool(const ConnectionCreator<Connection>& creator,unsigned initialSize,unsigned maxSize)
+    // pools are shared by all datasources with the same connection parameters:
+    // a wait given explicitly applies to the whole pool, otherwise a new pool
+    // waits defaultWait milliseconds and an existing one keeps its wait
+    bool registerPool(const ConnectionCreator<Connection>& creator,unsigned initialSize,unsigned maxSize,
+                      boost::optional<unsigned> const& maxWait = boost::optional<unsigned>(),
+                      unsigned defaultWait = 0)
     {
         ContType::const_iterator itr = pools_.find(creator.id());
 
@@ -117,12 +122,17 @@ public:
         {
             itr->second->set_initial_size(initialSize);
             itr->second->set_max_size(maxSize);
+            if (maxWait)
+            {
+                itr->second->set_max_wait(*maxWait);
+            }
         }
         else
         {
             return pools_.insert(
                 std::make_pair(creator.id(),
-                               boost::make_shared<PoolType>(creator,initialSize,maxSize))).second;
+                               boost::make_shared<PoolType>(creator,initialSize,maxSize,
+                                                            maxWait ? *maxWait : defaultWait))).second;
         }
         return false;
 
@@ -36,6 +36,7 @@ public:
           cursorName_(cursorName),
           fetch_size_(fetch_count),
           is_closed_(false),
+          in_flight_(false),
           refCount_(new int(1))
     {
         getNextResultSet();
@@ -47,6 +48,7 @@ public:
           rs_(rhs.rs_),
           fetch_size_(rhs.fetch_size_),
           is_closed_(rhs.is_closed_),
+          in_flight_(rhs.in_flight_),
           refCount_(rhs.refCount_)
     {
         (*refCount_)++;
@@ -75,6 +77,7 @@ public:
         refCount_=rhs.refCount_;
         fetch_size_=rhs.fetch_size_;
         is_closed_ = false;
+        in_flight_ = rhs.in_flight_;
         (*refCount_)++;
         return *this;
     }
@@ -84,6 +87,11 @@ public:
         if (!is_closed_)
         {
             rs_.reset();
+            if (in_flight_)
+            {
+                conn_->discardResult(refCount_);
+                in_flight_ = false;
+            }
 
             std::ostringstream s;
             s << "CLOSE " << cursorName_;
@@ -103,8 +111,11 @@ public:
     virtual bool next()
     {
         if (rs_->next()) {
+            // let libpq read the batch in flight while this one is decoded
+            if ((rs_->pos() & 63) == 63) conn_->consumeInput();
             return true;
-        } else if (rs_->size() == 0) {
+        } else if (!in_flight_) {
+            // a short batch means the cursor is exhausted
             return false;
         } else {
             getNextResultSet();
@@ -153,17 +164,34 @@ public:
     }
 
 private:
-    void getNextResultSet()
+    void sendFetch()
     {
         std::ostringstream s;
         s << "FETCH FORWARD " << fetch_size_ << " FROM " << cursorName_;
 
         MAPNIK_LOG_DEBUG(postgis) << "postgis_cursor_resultset: " << s.str();
 
-        rs_ = conn_->executeQuery(s.str());
+        conn_->sendQuery(s.str(), refCount_);
+        in_flight_ = true;
+    }
+
+    void getNextResultSet()
+    {
+        if (!in_flight_)
+        {
+            sendFetch();
+        }
+        in_flight_ = false;
+        rs_ = conn_->getResult(refCount_);
         is_closed_ = false;
 
         MAPNIK_LOG_DEBUG(postgis) << "postgis_cursor_resultset: FETCH result (" << cursorName_ << "): " << rs_->size() << " rows";
+
+        // keep the next batch in flight while this one is decoded
+        if (rs_->size() >= fetch_size_)
+        {
+            sendFetch();
+        }
     }
 
     boost::shared_ptr<Connection> conn_;
@@ -171,6 +199,7 @@ private:
     boost::shared_ptr<ResultSet> rs_;
     int fetch_size_;
     bool is_closed_;
+    bool in_flight_;
     int *refCount_;
 };
 
@@ -102,13 +102,24 @@ postgis_datasource::postgis_datasource(parameters const& params)
 
     boost::optional<int> initial_size = params.get<int>("initial_size", 1);
     boost::optional<int> max_size = params.get<int>("max_size", 10);
+    // milliseconds to wait for a connection once max_size are in use
+    boost::optional<int> pool_max_wait = params.get<int>("pool_max_wait");
+    boost::optional<unsigned> max_wait;
+    if (pool_max_wait)
+    {
+        if (*pool_max_wait < 0)
+        {
+            throw mapnik::datasource_exception("Postgis Plugin: <pool_max_wait> must not be negative");
+        }
+        max_wait = static_cast<unsigned>(*pool_max_wait);
+    }
     boost::optional<mapnik::boolean> autodetect_key_field = params.get<mapnik::boolean>("autodetect_key_field", false);
     boost::optional<mapnik::boolean> estimate_extent = params.get<mapnik::boolean>("estimate_extent", false);
     estimate_extent_ = estimate_extent && *estimate_extent;
     boost::optional<mapnik::boolean> simplify_opt = params.get<mapnik::boolean>("simplify_geometries", false);
     simplify_geometries_ = simplify_opt && *simplify_opt;
 
-    ConnectionManager::instance().registerPool(creator_, *initial_size, *max_size);
+    ConnectionManager::instance().registerPool(creator_, *initial_size, *max_size, max_wait, 1000);
     shared_ptr< Pool<Connection,ConnectionCreator> > pool = ConnectionManager::instance().getPool(creator_.id());
     if (pool)
     {
@@ -423,10 +434,13 @@ postgis_datasource::~postgis_datasource()
         shared_ptr< Pool<Connection,ConnectionCreator> > pool = ConnectionManager::instance().getPool(creator_.id());
         if (pool)
         {
-            shared_ptr<Connection> conn = pool->borrowObject();
+            // never wait for a busy pool (up to max_wait) just to close a connection
+            shared_ptr<Connection> conn = pool->borrowIdleObject();
             if (conn)
             {
+                // the closed connection is dropped when returned, freeing its slot
                 conn->close();
+                pool->returnObject(conn);
             }
         }
     }
@@ -28,6 +28,7 @@
 #include <mapnik/image_reader.hpp>
 #include <mapnik/image_util.hpp>
 #include <mapnik/feature_factory.hpp>
+#include <mapnik/raster_tile_cache.hpp>
 
 // boost
 #include <boost/algorithm/string/replace.hpp>
@@ -41,6 +42,9 @@ using mapnik::feature_ptr;
 using mapnik::image_data_32;
 using mapnik::raster;
 using mapnik::feature_factory;
+using mapnik::raster_tile_cache;
+using mapnik::raster_tile_key;
+using mapnik::raster_tile_ptr;
 
 template <typename LookupPolicy>
 raster_featureset<LookupPolicy>::raster_featureset(LookupPolicy const& policy,
@@ -52,7 +56,9 @@ raster_featureset<LookupPolicy>::raster_featureset(LookupPolicy const& policy,
       extent_(extent),
       bbox_(q.get_bbox()),
       curIter_(policy_.begin()),
-      endIter_(policy_.end())
+      endIter_(policy_.end()),
+      reader_(),
+      reader_file_()
 {
 }
 
@@ -70,15 +76,20 @@ feature_ptr raster_featureset<LookupPolicy>::next()
 
         try
         {
-            std::auto_ptr<image_reader> reader(mapnik::get_image_reader(curIter_->file(),curIter_->format()));
+            if (!reader_ || reader_file_ != curIter_->file())
+            {
+                reader_.reset();
+                reader_file_ = curIter_->file();
+                reader_.reset(mapnik::get_image_reader(curIter_->file(),curIter_->format()));
+            }
 
             MAPNIK_LOG_DEBUG(raster) << "raster_featureset: Reader=" << curIter_->format() << "," << curIter_->file()
                                      << ",size(" << curIter_->width() << "," << curIter_->height() << ")";
 
-            if (reader.get())
+            if (reader_)
             {
-                int image_width = policy_.img_width(reader->width());
-                int image_height = policy_.img_height(reader->height());
+                int image_width = policy_.img_width(reader_->width());
+                int image_height = policy_.img_height(reader_->height());
 
                 if (image_width > 0 && image_height > 0)
                 {
@@ -114,8 +125,8 @@ feature_ptr raster_featureset<LookupPolicy>::next()
                         intersect = t.backward(feature_raster_extent);
 
                         mapnik::raster_ptr raster = boost::make_shared<mapnik::raster>(intersect, width, height);
-                        reader->read(x_off, y_off, raster->data_);
-                        raster->premultiplied_alpha_ = reader->premultiplied_alpha();
+                        read(x_off, y_off, raster->data_);
+                        raster->premultiplied_alpha_ = reader_->premultiplied_alpha();
                         feature->set_raster(raster);
                     }
                 }
@@ -140,6 +151,39 @@ feature_ptr raster_featureset<LookupPolicy>::next()
     return feature_ptr();
 }
 
+template <typename LookupPolicy>
+void raster_featureset<LookupPolicy>::read(unsigned x, unsigned y, image_data_32 & data)
+{
+    raster_tile_cache & cache = raster_tile_cache::instance();
+    unsigned width = reader_->width();
+    unsigned height = reader_->height();
+    // files too large to ever be cached are read through the window only
+    if (!policy_.whole_file_tiles() ||
+        std::size_t(width) * height * 4 > cache.max_bytes())
+    {
+        reader_->read(x, y, data);
+        return;
+    }
+
+    raster_tile_key key(reader_file_, 0, 0, width, height);
+    raster_tile_ptr tile = cache.find(key);
+    if (!tile)
+    {
+        boost::shared_ptr<image_data_32> decoded = boost::make_shared<image_data_32>(width, height);
+        reader_->read(0, 0, *decoded);
+        cache.insert(key, decoded);
+        tile = decoded;
+    }
+
+    if (x >= width || y >= height) return;
+    unsigned w = std::min(data.width(), width - x);
+    unsigned h = std::min(data.height(), height - y);
+    for (unsigned row = 0; row < h; ++row)
+    {
+        data.setRow(row, tile->getRow(y + row) + x, w);
+    }
+}
+
 std::string tiled_multi_file_policy::interpolate(std::string const& pattern, int x, int y) const
 {
     // TODO: make from some sort of configurable interpolation
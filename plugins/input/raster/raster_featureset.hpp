@@ -29,6 +29,7 @@
 // mapnik
 #include <mapnik/feature.hpp>
 #include <mapnik/debug.hpp>
+#include <mapnik/image_reader.hpp>
 
 // stl
 #include <vector>
@@ -36,6 +37,7 @@
 // boost
 #include <boost/utility.hpp>
 #include <boost/format.hpp>
+#include <boost/scoped_ptr.hpp>
 
 class single_file_policy
 {
@@ -116,6 +118,11 @@ public:
     {
         return box2d<double>(0, 0, 0, 0);
     }
+
+    inline bool whole_file_tiles() const
+    {
+        return false;
+    }
 };
 
 class tiled_file_policy
@@ -191,6 +198,11 @@ public:
         return box2d<double>(0, 0, 0, 0);
     }
 
+    inline bool whole_file_tiles() const
+    {
+        return false;
+    }
+
 private:
 
     std::vector<raster_info> infos_;
@@ -294,6 +306,12 @@ public:
         return rem;
     }
 
+    // every file is one small tile, decoded whole and shared through raster_tile_cache
+    inline bool whole_file_tiles() const
+    {
+        return true;
+    }
+
 private:
 
     std::string interpolate(std::string const& pattern, int x, int y) const;
@@ -315,6 +333,8 @@ public:
     mapnik::feature_ptr next();
 
 private:
+    void read(unsigned x, unsigned y, mapnik::image_data_32 & data);
+
     LookupPolicy policy_;
     mapnik::value_integer feature_id_;
     mapnik::context_ptr ctx_;
@@ -322,6 +342,9 @@ private:
     mapnik::box2d<double> bbox_;
     iterator_type curIter_;
     iterator_type endIter_;
+    // tiles of the same file are read through one reader
+    boost::scoped_ptr<mapnik::image_reader> reader_;
+    std::string reader_file_;
 };
 
 #endif // RASTER_FEATURESET_HPP
@@ -24,6 +24,7 @@
 #include <mapnik/agg_renderer.hpp>
 #include <mapnik/agg_rasterizer.hpp>
 #include <mapnik/agg_helpers.hpp>
+#include <mapnik/building_extrusion.hpp>
 #include <mapnik/graphics.hpp>
 
 #include <mapnik/rule.hpp>
@@ -79,7 +80,8 @@ agg_renderer<T>::agg_renderer(Map const& m, T & pixmap, double scale_factor, uns
       font_engine_(),
       font_manager_(font_engine_),
       detector_(boost::make_shared<label_collision_detector4>(box2d<double>(-m.buffer_size(), -m.buffer_size(), m.width() + m.buffer_size() ,m.height() + m.buffer_size()))),
-      ras_ptr(new rasterizer)
+      ras_ptr(new rasterizer),
+      extrusion_(new building_extrusion)
 {
     setup(m);
 }
@@ -99,11 +101,32 @@ agg_renderer<T>::agg_renderer(Map const& m, T & pixmap, boost::shared_ptr<label_
       font_engine_(),
       font_manager_(font_engine_),
       detector_(detector),
-      ras_ptr(new rasterizer)
+      ras_ptr(new rasterizer),
+      extrusion_(new building_extrusion)
 {
     setup(m);
 }
 
+template <typename T>
+agg_renderer<T>::agg_renderer(Map const& m, boost::shared_ptr<T> const& buffer, CoordTransform const& t, double scale_factor)
+    : feature_style_processor<agg_renderer>(m, scale_factor),
+      pixmap_(*buffer),
+      internal_buffer_(buffer),
+      current_buffer_(buffer.get()),
+      style_level_compositing_(false),
+      width_(pixmap_.width()),
+      height_(pixmap_.height()),
+      scale_factor_(scale_factor),
+      t_(t),
+      font_engine_(),
+      font_manager_(font_engine_),
+      detector_(boost::make_shared<label_collision_detector4>(box2d<double>(-m.buffer_size(), -m.buffer_size(), m.width() + m.buffer_size() ,m.height() + m.buffer_size()))),
+      ras_ptr(new rasterizer),
+      extrusion_(new building_extrusion)
+{
+    ras_ptr->clip_box(0,0,width_,height_);
+}
+
 template <typename T>
 void agg_renderer<T>::setup(Map const &m)
 {
@@ -200,14 +223,7 @@ template <typename T>
 void agg_renderer<T>::start_style_processing(feature_type_style const& st)
 {
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: Start processing style";
-    if (st.comp_op() || st.image_filters().size() > 0 || st.get_opacity() < 1)
-    {
-        style_level_compositing_ = true;
-    }
-    else
-    {
-        style_level_compositing_ = false;
-    }
+    style_level_compositing_ = composites_style(st);
 
     if (style_level_compositing_)
     {
@@ -262,6 +278,33 @@ void agg_renderer<T>::end_style_processing(feature_type_style const& st)
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: End processing style";
 }
 
+template <typename T>
+bool agg_renderer<T>::composites_style(feature_type_style const& st) const
+{
+    return st.comp_op() || st.image_filters().size() > 0 || st.get_opacity() < 1;
+}
+
+template <typename T>
+boost::shared_ptr<agg_renderer<T> > agg_renderer<T>::offscreen_renderer(Map const& m) const
+{
+    // a new buffer is transparent, like internal_buffer_ after start_style_processing()
+    boost::shared_ptr<buffer_type> buffer = boost::make_shared<buffer_type>(width_, height_);
+    return boost::shared_ptr<agg_renderer<T> >(new agg_renderer<T>(m, buffer, t_, scale_factor_));
+}
+
+template <typename T>
+void agg_renderer<T>::composite_offscreen_style(feature_type_style const& st, agg_renderer<T> & offscreen)
+{
+    style_level_compositing_ = true;
+    current_buffer_ = &offscreen.pixmap_;
+    end_style_processing(st);
+    current_buffer_ = &pixmap_;
+    if (offscreen.pixmap_.painted())
+    {
+        pixmap_.painted(true);
+    }
+}
+
 template <typename T>
 void agg_renderer<T>::render_marker(pixel_position const& pos,
                                     marker const& marker,
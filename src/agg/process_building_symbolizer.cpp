@@ -25,17 +25,11 @@
 #include <mapnik/feature.hpp>
 #include <mapnik/agg_renderer.hpp>
 #include <mapnik/agg_rasterizer.hpp>
-#include <mapnik/segment.hpp>
+#include <mapnik/building_extrusion.hpp>
 #include <mapnik/expression_evaluator.hpp>
 #include <mapnik/building_symbolizer.hpp>
 #include <mapnik/expression.hpp>
 
-// boost
-#include <boost/scoped_ptr.hpp>
-
-// stl
-#include <deque>
-
 // agg
 #include "agg_basics.h"
 #include "agg_rendering_buffer.h"
@@ -53,7 +47,6 @@ void agg_renderer<T>::process(building_symbolizer const& sym,
                               mapnik::feature_impl & feature,
                               proj_transform const& prj_trans)
 {
-    typedef coord_transform<CoordTransform,geometry_type> path_type;
     typedef agg::renderer_base<agg::pixfmt_rgba32> ren_base;
     typedef agg::renderer_scanline_aa_solid<ren_base> renderer;
 
@@ -80,86 +73,41 @@ void agg_renderer<T>::process(building_symbolizer const& sym,
         height = result.to_double() * scale_factor_;
     }
 
+    agg::rgba8 wall_color(int(r*0.8), int(g*0.8), int(b*0.8), int(a * sym.get_opacity()));
+    agg::rgba8 roof_color(r, g, b, int(a * sym.get_opacity()));
+
+    building_extrusion & extrusion = *extrusion_;
     for (unsigned i=0;i<feature.num_geometries();++i)
     {
         geometry_type const& geom = feature.get_geometry(i);
         if (geom.size() > 2)
         {
-            boost::scoped_ptr<geometry_type> frame(new geometry_type(LineString));
-            boost::scoped_ptr<geometry_type> roof(new geometry_type(Polygon));
-            std::deque<segment_t> face_segments;
-            double x0 = 0;
-            double y0 = 0;
-            double x,y;
-            geom.rewind(0);
-            for (unsigned cm = geom.vertex(&x, &y); cm != SEG_END;
-                 cm = geom.vertex(&x, &y))
-            {
-                if (cm == SEG_MOVETO)
-                {
-                    frame->move_to(x,y);
-                }
-                else if (cm == SEG_LINETO || cm == SEG_CLOSE)
-                {
-                    frame->line_to(x,y);
-                    face_segments.push_back(segment_t(x0,y0,x,y));
-                }
-                x0 = x;
-                y0 = y;
-            }
+            extrusion.build(geom, height, t_, prj_trans);
+            if (extrusion.empty()) continue;
 
-            std::sort(face_segments.begin(),face_segments.end(), y_order);
-            std::deque<segment_t>::const_iterator itr=face_segments.begin();
-            std::deque<segment_t>::const_iterator end=face_segments.end();
-
-            for (; itr!=end; ++itr)
+            // walls are blended one by one, back to front: translucent walls show
+            // the ones behind them and adjacent walls keep their anti-aliased seams
+            ren.color(wall_color);
+            for (std::size_t j = 0; j < extrusion.wall_count(); ++j)
             {
-                boost::scoped_ptr<geometry_type> faces(new geometry_type(Polygon));
-                faces->move_to(itr->get<0>(),itr->get<1>());
-                faces->line_to(itr->get<2>(),itr->get<3>());
-                faces->line_to(itr->get<2>(),itr->get<3>() + height);
-                faces->line_to(itr->get<0>(),itr->get<1>() + height);
-
-                path_type faces_path (t_,*faces,prj_trans);
-                ras_ptr->add_path(faces_path);
-                ren.color(agg::rgba8(int(r*0.8), int(g*0.8), int(b*0.8), int(a * sym.get_opacity())));
-                agg::render_scanlines(*ras_ptr, sl, ren);
+                building_extrusion::path_source wall = extrusion.wall(j);
                 ras_ptr->reset();
-                //
-                frame->move_to(itr->get<0>(),itr->get<1>());
-                frame->line_to(itr->get<0>(),itr->get<1>()+height);
-
-            }
-
-            geom.rewind(0);
-            for (unsigned cm = geom.vertex(&x, &y); cm != SEG_END;
-                 cm = geom.vertex(&x, &y))
-            {
-                if (cm == SEG_MOVETO)
-                {
-                    frame->move_to(x,y+height);
-                    roof->move_to(x,y+height);
-                }
-                else if (cm == SEG_LINETO || cm == SEG_CLOSE)
-                {
-                    frame->line_to(x,y+height);
-                    roof->line_to(x,y+height);
-                }
+                ras_ptr->add_path(wall);
+                agg::render_scanlines(*ras_ptr, sl, ren);
             }
 
-            path_type path(t_,*frame,prj_trans);
-            agg::conv_stroke<path_type> stroke(path);
+            building_extrusion::path_source frame = extrusion.frame();
+            agg::conv_stroke<building_extrusion::path_source> stroke(frame);
             stroke.width(scale_factor_);
+            ras_ptr->reset();
             ras_ptr->add_path(stroke);
-            ren.color(agg::rgba8(int(r*0.8), int(g*0.8), int(b*0.8), int(a * sym.get_opacity())));
             agg::render_scanlines(*ras_ptr, sl, ren);
-            ras_ptr->reset();
 
-            path_type roof_path (t_,*roof,prj_trans);
-            ras_ptr->add_path(roof_path);
-            ren.color(agg::rgba8(r, g, b, int(a * sym.get_opacity())));
+            building_extrusion::path_source roof = extrusion.roof();
+            ras_ptr->reset();
+            ras_ptr->add_path(roof);
+            ren.color(roof_color);
             agg::render_scanlines(*ras_ptr, sl, ren);
-
         }
     }
 }
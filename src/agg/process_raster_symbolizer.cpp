@@ -94,11 +94,13 @@ void agg_renderer<T>::process(raster_symbolizer const& sym,
             {
                 double offset_x = ext.minx() - start_x;
                 double offset_y = ext.miny() - start_y;
+                // warp in parallel when layers may be queried concurrently too
                 reproject_and_scale_raster(target, *source, prj_trans,
                                  offset_x, offset_y,
                                  sym.get_mesh_size(),
                                  filter_radius,
-                                 scaling_method);
+                                 scaling_method,
+                                 this->concurrency());
             }
             else
             {
@@ -120,6 +120,7 @@ source = Split(
     image_filter_grammar.cpp
     image_scaling.cpp
     box2d.cpp
+    building_extrusion.cpp
     building_symbolizer.cpp
     datasource_cache.cpp
     debug.cpp
@@ -128,12 +129,14 @@ source = Split(
     expression_grammar.cpp
     expression_string.cpp
     expression.cpp
+    filter_program.cpp
     transform_expression_grammar.cpp
     transform_expression.cpp
     feature_kv_iterator.cpp
     feature_type_style.cpp
     font_engine_freetype.cpp
     font_set.cpp
+    glyph_cache.cpp
     gamma_method.cpp
     gradient.cpp
     graphics.cpp
@@ -151,10 +154,12 @@ source = Split(
     path_expression_grammar.cpp
     placement_finder.cpp
     plugin.cpp
+    raster_tile_cache.cpp
     point_symbolizer.cpp
     polygon_pattern_symbolizer.cpp
     polygon_symbolizer.cpp
     rule.cpp
+    rule_cache.cpp
     save_map.cpp
     shield_symbolizer.cpp
     text_symbolizer.cpp
@@ -165,6 +170,7 @@ source = Split(
     scale_denominator.cpp
     simplify.cpp
     memory_datasource.cpp
+    packed_rtree.cpp
     stroke.cpp
     symbolizer.cpp
     symbolizer_helpers.cpp
@@ -172,6 +178,7 @@ source = Split(
     markers_symbolizer.cpp
     raster_colorizer.cpp
     raster_symbolizer.cpp
+    rendering_stats.cpp
     wkt/wkt_factory.cpp
     wkt/wkt_generator.cpp
     mapped_memory_cache.cpp
@@ -181,6 +188,7 @@ source = Split(
     svg/svg_points_parser.cpp
     svg/svg_transform_parser.cpp
     warp.cpp
+    warp_mesh_cache.cpp
     json/geometry_grammar.cpp
     json/geometry_parser.cpp
     json/feature_grammar.cpp
@@ -263,6 +271,7 @@ if env['RUNTIME_LINK'] == "static":
 source += Split(
     """
     grid/grid.cpp
+    grid/grid_encoder.cpp
     grid/grid_renderer.cpp
     grid/process_building_symbolizer.cpp
     grid/process_line_pattern_symbolizer.cpp
@@ -336,17 +345,7 @@ else:
         """
     )
 
-processor_cpp = 'feature_style_processor.cpp'
-
-if env['RENDERING_STATS']:
-    env3 = lib_env.Clone()
-    env3.Append(CXXFLAGS='-DRENDERING_STATS')
-    if env['LINKING'] == 'static':
-        source.insert(0,env3.StaticObject(processor_cpp))
-    else:
-        source.insert(0,env3.SharedObject(processor_cpp))
-else:
-    source.insert(0,processor_cpp);
+source.insert(0,'feature_style_processor.cpp')
 
 if env['CUSTOM_LDFLAGS']:
     linkflags = '%s %s' % (env['CUSTOM_LDFLAGS'], mapnik_lib_link_flag)
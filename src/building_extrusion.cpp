@@ -0,0 +1,168 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/building_extrusion.hpp>
+#include <mapnik/proj_transform.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+
+namespace mapnik
+{
+
+namespace {
+
+bool further(std::pair<double, std::size_t> const& a, std::pair<double, std::size_t> const& b)
+{
+    return a.first > b.first;
+}
+
+}
+
+void building_extrusion::build(geometry_type const& geom, double height,
+                               CoordTransform const& t, proj_transform const& prj_trans)
+{
+    xs_.clear();
+    ys_.clear();
+    commands_.clear();
+    walls_.clear();
+    frame_.clear();
+    roof_.clear();
+
+    double x = 0;
+    double y = 0;
+    geom.rewind(0);
+    for (unsigned cm = geom.vertex(&x, &y); cm != SEG_END; cm = geom.vertex(&x, &y))
+    {
+        xs_.push_back(x);
+        ys_.push_back(y);
+        commands_.push_back(cm);
+    }
+    std::size_t n = commands_.size();
+    if (n == 0) return;
+    xs_.resize(2 * n);
+    ys_.resize(2 * n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        xs_[n + i] = xs_[i];
+        ys_[n + i] = ys_[i] + height;
+    }
+
+    // walls further up the map are further away: same comparison and algorithm as
+    // y_order in the cairo renderer, so walls keep their previous drawing order
+    order_.clear();
+    for (std::size_t i = 1; i < n; ++i)
+    {
+        if (commands_[i] == SEG_LINETO || commands_[i] == SEG_CLOSE)
+        {
+            order_.push_back(std::make_pair(std::min(ys_[i - 1], ys_[i]), i));
+        }
+    }
+    std::sort(order_.begin(), order_.end(), further);
+
+    project(t, prj_trans);
+
+    for (std::size_t k = 0; k < order_.size(); ++k)
+    {
+        add_wall(order_[k].second - 1, order_[k].second);
+    }
+
+    add_outline(frame_, 0);
+    for (std::size_t i = 1; i < n; ++i)
+    {
+        if ((commands_[i] == SEG_LINETO || commands_[i] == SEG_CLOSE) &&
+            valid_[i - 1] && valid_[n + i - 1])
+        {
+            frame_.push_back(path_vertex(xs_[i - 1], ys_[i - 1], SEG_MOVETO));
+            frame_.push_back(path_vertex(xs_[n + i - 1], ys_[n + i - 1], SEG_LINETO));
+        }
+    }
+    add_outline(frame_, n);
+    add_outline(roof_, n);
+}
+
+// same as coord_transform: vertices proj4 fails on are left out
+void building_extrusion::project(CoordTransform const& t, proj_transform const& prj_trans)
+{
+    std::size_t size = xs_.size();
+    valid_.assign(size, true);
+    if (!prj_trans.equal())
+    {
+        std::vector<double> source_x(xs_);
+        std::vector<double> source_y(ys_);
+        zs_.assign(size, 0);
+        std::size_t first = 0;
+        if (prj_trans.backward(&xs_[0], &ys_[0], &zs_[0], static_cast<int>(size)))
+        {
+            while (first < size && xs_[first] != HUGE_VAL && ys_[first] != HUGE_VAL) ++first;
+        }
+        for (std::size_t i = first; i < size; ++i)
+        {
+            double z = 0;
+            xs_[i] = source_x[i];
+            ys_[i] = source_y[i];
+            valid_[i] = prj_trans.backward(xs_[i], ys_[i], z);
+        }
+    }
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        t.forward(&xs_[i], &ys_[i]);
+    }
+}
+
+void building_extrusion::add_wall(std::size_t i0, std::size_t i1)
+{
+    std::size_t n = commands_.size();
+    std::size_t corners[4] = { i0, i1, n + i1, n + i0 };
+    for (unsigned k = 0; k < 4; ++k)
+    {
+        if (!valid_[corners[k]]) return;
+    }
+    walls_.push_back(path_vertex(xs_[i0], ys_[i0], SEG_MOVETO));
+    for (unsigned k = 1; k < 4; ++k)
+    {
+        walls_.push_back(path_vertex(xs_[corners[k]], ys_[corners[k]], SEG_LINETO));
+    }
+}
+
+// footprint or roof outline, restarting after vertices which could not be projected
+void building_extrusion::add_outline(path_type & path, std::size_t offset)
+{
+    bool connected = false;
+    for (std::size_t i = 0; i < commands_.size(); ++i)
+    {
+        std::size_t j = offset + i;
+        if (!valid_[j])
+        {
+            connected = false;
+            continue;
+        }
+        unsigned cmd = (commands_[i] == SEG_MOVETO || !connected) ? SEG_MOVETO : SEG_LINETO;
+        path.push_back(path_vertex(xs_[j], ys_[j], cmd));
+        connected = true;
+    }
+}
+
+}
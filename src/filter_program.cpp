@@ -0,0 +1,431 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/filter_program.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/unicode.hpp>
+
+// boost
+#include <boost/variant/static_visitor.hpp>
+#include <boost/variant/apply_visitor.hpp>
+#include <boost/regex.hpp>
+#if defined(BOOST_REGEX_HAS_ICU)
+#include <boost/regex/icu.hpp>
+#endif
+
+// stl
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+namespace mapnik
+{
+
+namespace {
+
+static const std::size_t unbound_index = std::numeric_limits<std::size_t>::max();
+
+// unique key of a constant, precise enough to never merge different values
+struct constant_key : public boost::static_visitor<std::string>
+{
+    std::string operator() (value_double val) const
+    {
+        std::ostringstream s;
+        s.precision(17);
+        s << val;
+        return s.str();
+    }
+
+    template <typename T>
+    std::string operator() (T const& val) const
+    {
+        return value(val).to_string();
+    }
+};
+
+}
+
+struct filter_compiler : public boost::static_visitor<std::size_t>
+{
+    typedef filter_program::instruction instruction;
+
+    explicit filter_compiler(filter_program & program)
+        : program_(program) {}
+
+    std::size_t operator() (value_type const& val) const
+    {
+        return constant(val);
+    }
+
+    std::size_t operator() (attribute const& attr) const
+    {
+        instruction instr(filter_program::op_attribute);
+        instr.name = attr.name();
+        instr.index = unbound_index;
+        return program_.add(instr, "a:" + attr.name());
+    }
+
+    std::size_t operator() (geometry_type_attribute const&) const
+    {
+        return program_.add(instruction(filter_program::op_geometry_type), "g");
+    }
+
+    std::size_t operator() (unary_node<tags::negate> const& x) const
+    {
+        return unary(filter_program::op_negate, x.expr);
+    }
+
+    std::size_t operator() (unary_node<tags::logical_not> const& x) const
+    {
+        return unary(filter_program::op_logical_not, x.expr);
+    }
+
+    std::size_t operator() (binary_node<tags::plus> const& x) const
+    {
+        return binary(filter_program::op_plus, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::minus> const& x) const
+    {
+        return binary(filter_program::op_minus, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::mult> const& x) const
+    {
+        return binary(filter_program::op_mult, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::div> const& x) const
+    {
+        return binary(filter_program::op_div, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::mod> const& x) const
+    {
+        return binary(filter_program::op_mod, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::less> const& x) const
+    {
+        return binary(filter_program::op_less, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::less_equal> const& x) const
+    {
+        return binary(filter_program::op_less_equal, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::greater> const& x) const
+    {
+        return binary(filter_program::op_greater, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::greater_equal> const& x) const
+    {
+        return binary(filter_program::op_greater_equal, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::equal_to> const& x) const
+    {
+        return binary(filter_program::op_equal_to, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::not_equal_to> const& x) const
+    {
+        return binary(filter_program::op_not_equal_to, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::logical_and> const& x) const
+    {
+        return binary(filter_program::op_logical_and, x.left, x.right);
+    }
+
+    std::size_t operator() (binary_node<tags::logical_or> const& x) const
+    {
+        return binary(filter_program::op_logical_or, x.left, x.right);
+    }
+
+    std::size_t operator() (regex_match_node const& x) const
+    {
+        instruction instr(filter_program::op_regex_match, boost::apply_visitor(*this, x.expr));
+        instr.match = &x;
+        return fold(instr, node_key("m", &x, instr.left));
+    }
+
+    std::size_t operator() (regex_replace_node const& x) const
+    {
+        instruction instr(filter_program::op_regex_replace, boost::apply_visitor(*this, x.expr));
+        instr.replace = &x;
+        return fold(instr, node_key("r", &x, instr.left));
+    }
+
+private:
+    std::size_t constant(value_type const& val) const
+    {
+        instruction instr(filter_program::op_constant);
+        instr.constant = val;
+        std::ostringstream key;
+        key << "c" << val.base().which() << ":" << boost::apply_visitor(constant_key(), val.base());
+        return program_.add(instr, key.str());
+    }
+
+    bool is_constant(std::size_t i) const
+    {
+        return program_.code_[i].op == filter_program::op_constant;
+    }
+
+    std::size_t unary(filter_program::opcode op, expr_node const& expr) const
+    {
+        instruction instr(op, boost::apply_visitor(*this, expr));
+        std::ostringstream key;
+        key << "u" << op << ":" << instr.left;
+        return fold(instr, key.str());
+    }
+
+    std::size_t binary(filter_program::opcode op, expr_node const& left, expr_node const& right) const
+    {
+        instruction instr(op, boost::apply_visitor(*this, left), boost::apply_visitor(*this, right));
+        // a constant operand may decide a logical expression on its own
+        if (op == filter_program::op_logical_and || op == filter_program::op_logical_or)
+        {
+            bool decisive = (op == filter_program::op_logical_or);
+            if ((is_constant(instr.left) && program_.code_[instr.left].constant.to_bool() == decisive) ||
+                (is_constant(instr.right) && program_.code_[instr.right].constant.to_bool() == decisive))
+            {
+                return constant(value_type(decisive));
+            }
+        }
+        std::ostringstream key;
+        key << "b" << op << ":" << instr.left << "," << instr.right;
+        return fold(instr, key.str());
+    }
+
+    std::string node_key(char const* prefix, void const* node, std::size_t operand) const
+    {
+        std::ostringstream key;
+        key << prefix << node << ":" << operand;
+        return key.str();
+    }
+
+    // replaces an instruction whose operands are all constants by its result
+    std::size_t fold(instruction const& instr, std::string const& key) const
+    {
+        bool unary_op = instr.op == filter_program::op_negate ||
+                        instr.op == filter_program::op_logical_not ||
+                        instr.op == filter_program::op_regex_match ||
+                        instr.op == filter_program::op_regex_replace;
+        if (is_constant(instr.left) && (unary_op || is_constant(instr.right)))
+        {
+            program_.code_.push_back(instr);
+            program_.values_.push_back(value_type());
+            program_.stamps_.push_back(0);
+            value_type result = program_.eval(program_.code_.size() - 1);
+            program_.code_.pop_back();
+            program_.values_.pop_back();
+            program_.stamps_.pop_back();
+            return constant(result);
+        }
+        return program_.add(instr, key);
+    }
+
+    filter_program & program_;
+};
+
+filter_program::filter_program()
+    : code_(),
+      keys_(),
+      values_(),
+      stamps_(),
+      generation_(1),
+      feature_(0),
+      context_(),
+      context_size_(0) {}
+
+filter_program::program_id filter_program::compile(expr_node const& expr)
+{
+    return boost::apply_visitor(filter_compiler(*this), expr);
+}
+
+std::size_t filter_program::add(instruction const& instr, std::string const& key)
+{
+    std::map<std::string, std::size_t>::const_iterator itr = keys_.find(key);
+    if (itr != keys_.end())
+    {
+        return itr->second;
+    }
+    std::size_t i = code_.size();
+    code_.push_back(instr);
+    values_.push_back(value_type());
+    stamps_.push_back(0);
+    keys_.insert(std::make_pair(key, i));
+    // a new instruction may need its attribute bound to the current context
+    context_.reset();
+    return i;
+}
+
+void filter_program::bind(feature_impl const& feature) const
+{
+    feature_ = &feature;
+    if (++generation_ == 0)
+    {
+        std::fill(stamps_.begin(), stamps_.end(), 0);
+        generation_ = 1;
+    }
+    context_ptr ctx = feature.context();
+    if (ctx != context_ || ctx->size() != context_size_)
+    {
+        // resolve attribute names once per context
+        for (std::vector<instruction>::size_type i = 0; i < code_.size(); ++i)
+        {
+            instruction const& instr = code_[i];
+            if (instr.op == op_attribute)
+            {
+                context_type::const_iterator itr = ctx->find(instr.name);
+                instr.index = (itr != ctx->end()) ? itr->second : unbound_index;
+            }
+        }
+        context_ = ctx;
+        context_size_ = ctx->size();
+    }
+}
+
+bool filter_program::evaluate(program_id id) const
+{
+    return eval(id).to_bool();
+}
+
+value_type const& filter_program::value(program_id id) const
+{
+    return eval(id);
+}
+
+bool filter_program::is_constant(program_id id) const
+{
+    return code_[id].op == op_constant;
+}
+
+std::size_t filter_program::size() const
+{
+    return code_.size();
+}
+
+value_type const& filter_program::eval(std::size_t i) const
+{
+    instruction const& instr = code_[i];
+    switch (instr.op)
+    {
+    case op_constant:
+        return instr.constant;
+    case op_attribute:
+        return instr.index != unbound_index ? feature_->get(instr.index) : default_value;
+    default:
+        break;
+    }
+
+    if (stamps_[i] == generation_)
+    {
+        return values_[i];
+    }
+
+    value_type result;
+    switch (instr.op)
+    {
+    case op_geometry_type:
+        result = geometry_type_attribute().value<value_type,feature_impl>(*feature_);
+        break;
+    case op_negate:
+        result = -eval(instr.left);
+        break;
+    case op_plus:
+        result = eval(instr.left) + eval(instr.right);
+        break;
+    case op_minus:
+        result = eval(instr.left) - eval(instr.right);
+        break;
+    case op_mult:
+        result = eval(instr.left) * eval(instr.right);
+        break;
+    case op_div:
+        result = eval(instr.left) / eval(instr.right);
+        break;
+    case op_mod:
+        result = eval(instr.left) % eval(instr.right);
+        break;
+    case op_less:
+        result = eval(instr.left) < eval(instr.right);
+        break;
+    case op_less_equal:
+        result = eval(instr.left) <= eval(instr.right);
+        break;
+    case op_greater:
+        result = eval(instr.left) > eval(instr.right);
+        break;
+    case op_greater_equal:
+        result = eval(instr.left) >= eval(instr.right);
+        break;
+    case op_equal_to:
+        result = eval(instr.left) == eval(instr.right);
+        break;
+    case op_not_equal_to:
+        result = eval(instr.left) != eval(instr.right);
+        break;
+    case op_logical_not:
+        result = !eval(instr.left).to_bool();
+        break;
+    case op_logical_and:
+        result = eval(instr.left).to_bool() && eval(instr.right).to_bool();
+        break;
+    case op_logical_or:
+        result = eval(instr.left).to_bool() || eval(instr.right).to_bool();
+        break;
+    case op_regex_match:
+    {
+        value_type const& v = eval(instr.left);
+#if defined(BOOST_REGEX_HAS_ICU)
+        result = boost::u32regex_match(v.to_unicode(),instr.match->pattern);
+#else
+        result = boost::regex_match(v.to_string(),instr.match->pattern);
+#endif
+        break;
+    }
+    case op_regex_replace:
+    {
+        value_type const& v = eval(instr.left);
+#if defined(BOOST_REGEX_HAS_ICU)
+        result = boost::u32regex_replace(v.to_unicode(),instr.replace->pattern,instr.replace->format);
+#else
+        std::string repl = boost::regex_replace(v.to_string(),instr.replace->pattern,instr.replace->format);
+        mapnik::transcoder tr_("utf8");
+        result = tr_.transcode(repl.c_str());
+#endif
+        break;
+    }
+    default:
+        break;
+    }
+    values_[i] = result;
+    stamps_[i] = generation_;
+    return values_[i];
+}
+
+}
@@ -27,15 +27,20 @@
 #include <mapnik/graphics.hpp>
 #include <mapnik/grid/grid.hpp>
 #include <mapnik/text_path.hpp>
+#include <mapnik/lru_cache.hpp>
+#include <mapnik/utils.hpp>
 
 // boost
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/functional/hash.hpp>
 
 // stl
 #include <sstream>
+#include <fstream>
 #include <algorithm>
+#include <cstring>
 
 // icu
 #include <unicode/ubidi.h>
@@ -45,18 +50,236 @@
 
 namespace mapnik
 {
-freetype_engine::freetype_engine()
+
+// a FreeType library and the faces opened in it, checked out by one engine at a time
+struct font_library : private mapnik::noncopyable
 {
-    FT_Error error = FT_Init_FreeType( &library_ );
-    if (error)
+    font_library()
+        : library(),
+          faces()
     {
-        throw std::runtime_error("can not load FreeType2 library");
+        FT_Library lib;
+        FT_Error error = FT_Init_FreeType(&lib);
+        if (error)
+        {
+            throw std::runtime_error("can not load FreeType2 library");
+        }
+        library.reset(lib, FT_Done_FreeType);
     }
+
+    ft_library_ptr library;
+    std::map<std::string, face_ptr> faces;
+};
+
+namespace {
+
+struct metrics_key
+{
+    metrics_key(std::string const& faces_, long size_, unsigned c_)
+        : faces(faces_), size(size_), c(c_) {}
+    std::string faces;
+    long size;
+    unsigned c;
+
+    bool operator==(metrics_key const& other) const
+    {
+        return c == other.c && size == other.size && faces == other.faces;
+    }
+};
+
+std::size_t hash_value(metrics_key const& key)
+{
+    std::size_t seed = boost::hash<std::string>()(key.faces);
+    boost::hash_combine(seed, key.size);
+    boost::hash_combine(seed, key.c);
+    return seed;
 }
 
+// state shared by all engines: the library pool, font file buffers and the
+// character dimensions shared by all face sets of the same faces and size
+class font_cache :
+        public singleton<font_cache, CreateStatic>,
+        private mapnik::noncopyable
+{
+    friend class CreateStatic<font_cache>;
+public:
+    font_library * checkout()
+    {
+        {
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock lock(pool_mutex_);
+#endif
+            if (!idle_.empty())
+            {
+                font_library * library = idle_.back();
+                idle_.pop_back();
+                return library;
+            }
+        }
+        font_library * library = new font_library;
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(pool_mutex_);
+#endif
+        ++libraries_;
+        return library;
+    }
+
+    void checkin(font_library * library)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(pool_mutex_);
+#endif
+        idle_.push_back(library);
+    }
+
+    void count_face(bool hit)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(pool_mutex_);
+#endif
+        if (hit) ++face_hits_;
+        else ++faces_opened_;
+    }
+
+    font_buffer_ptr buffer(std::string const& file_name)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(files_mutex_);
+#endif
+        std::map<std::string, font_buffer_ptr>::const_iterator itr = files_.find(file_name);
+        if (itr != files_.end())
+        {
+            return itr->second;
+        }
+        std::ifstream file(file_name.c_str(), std::ios::in | std::ios::binary);
+        if (!file)
+        {
+            return font_buffer_ptr();
+        }
+        boost::shared_ptr<std::string> buffer = boost::make_shared<std::string>();
+        file.seekg(0, std::ios::end);
+        buffer->resize(static_cast<std::size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        if (buffer->empty() || !file.read(&(*buffer)[0], buffer->size()))
+        {
+            return font_buffer_ptr();
+        }
+        files_.insert(std::make_pair(file_name, buffer));
+        return buffer;
+    }
+
+    bool find_metrics(metrics_key const& key, char_info & dim)
+    {
+        return metrics_.find(key, dim);
+    }
+
+    void insert_metrics(metrics_key const& key, char_info const& dim)
+    {
+        metrics_.insert(key, dim, sizeof(char_info));
+    }
+
+    font_cache_stats stats() const
+    {
+        font_cache_stats stats;
+        {
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock lock(pool_mutex_);
+#endif
+            stats.libraries = libraries_;
+            stats.idle_libraries = idle_.size();
+            stats.faces_opened = faces_opened_;
+            stats.face_hits = face_hits_;
+        }
+        {
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock lock(files_mutex_);
+#endif
+            stats.files = files_.size();
+            std::map<std::string, font_buffer_ptr>::const_iterator itr;
+            for (itr = files_.begin(); itr != files_.end(); ++itr)
+            {
+                stats.bytes += itr->second->size();
+            }
+        }
+        lru_cache_stats metrics = metrics_.stats();
+        stats.metrics_hits = metrics.hits;
+        stats.metrics_misses = metrics.misses;
+        stats.metrics_entries = metrics.entries;
+        return stats;
+    }
+
+    // faces still in use keep their library and buffer alive
+    void clear()
+    {
+        {
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock lock(pool_mutex_);
+#endif
+            release_idle();
+        }
+        {
+#ifdef MAPNIK_THREADSAFE
+            mutex::scoped_lock lock(files_mutex_);
+#endif
+            files_.clear();
+        }
+        metrics_.clear();
+    }
+
+private:
+    font_cache()
+        : idle_(),
+          libraries_(0),
+          faces_opened_(0),
+          face_hits_(0),
+          files_(),
+          metrics_(0, 16 * 4096) {}
+
+    ~font_cache()
+    {
+        release_idle();
+    }
+
+    void release_idle()
+    {
+        for (std::size_t i = 0; i < idle_.size(); ++i)
+        {
+            delete idle_[i];
+        }
+        libraries_ -= idle_.size();
+        idle_.clear();
+    }
+
+#ifdef MAPNIK_THREADSAFE
+    mutable mutex pool_mutex_;
+    mutable mutex files_mutex_;
+#endif
+    std::vector<font_library*> idle_;
+    std::size_t libraries_;
+    std::size_t faces_opened_;
+    std::size_t face_hits_;
+    std::map<std::string, font_buffer_ptr> files_;
+    sharded_lru_cache<metrics_key, char_info> metrics_;
+};
+
+}
+
+freetype_engine::freetype_engine()
+    : library_(font_cache::instance().checkout()) {}
+
 freetype_engine::~freetype_engine()
 {
-    FT_Done_FreeType(library_);
+    font_cache::instance().checkin(library_);
+}
+
+font_cache_stats freetype_engine::cache_stats()
+{
+    return font_cache::instance().stats();
+}
+
+void freetype_engine::clear_cache()
+{
+    font_cache::instance().clear();
 }
 
 bool freetype_engine::is_font_file(std::string const& file_name)
@@ -203,18 +426,35 @@ std::map<std::string,std::pair<int,std::string> > const& freetype_engine::get_ma
 
 face_ptr freetype_engine::create_face(std::string const& family_name)
 {
+    // the library is ours alone, so its faces need no locking
+    std::map<std::string, face_ptr>::const_iterator cached = library_->faces.find(family_name);
+    if (cached != library_->faces.end())
+    {
+        font_cache::instance().count_face(true);
+        return cached->second;
+    }
+
     std::map<std::string, std::pair<int,std::string> >::iterator itr;
     itr = name2file_.find(family_name);
     if (itr != name2file_.end())
     {
+        font_buffer_ptr buffer = font_cache::instance().buffer(itr->second.second);
+        if (!buffer)
+        {
+            return face_ptr();
+        }
         FT_Face face;
-        FT_Error error = FT_New_Face (library_,
-                                      itr->second.second.c_str(),
-                                      itr->second.first,
-                                      &face);
+        FT_Error error = FT_New_Memory_Face (library_->library.get(),
+                                             reinterpret_cast<FT_Byte const*>(buffer->data()),
+                                             static_cast<FT_Long>(buffer->size()),
+                                             itr->second.first,
+                                             &face);
         if (!error)
         {
-            return boost::make_shared<font_face>(face);
+            face_ptr result = boost::make_shared<font_face>(face, family_name, buffer, library_->library);
+            library_->faces.insert(std::make_pair(family_name, result));
+            font_cache::instance().count_face(false);
+            return result;
         }
     }
     return face_ptr();
@@ -223,10 +463,10 @@ face_ptr freetype_engine::create_face(std::string const& family_name)
 stroker_ptr freetype_engine::create_stroker()
 {
     FT_Stroker s;
-    FT_Error error = FT_Stroker_New(library_, &s);
+    FT_Error error = FT_Stroker_New(library_->library.get(), &s);
     if (!error)
     {
-        return boost::make_shared<stroker>(s);
+        return boost::make_shared<stroker>(s, library_->library);
     }
     return stroker_ptr();
 }
@@ -240,6 +480,18 @@ char_info font_face_set::character_dimensions(const unsigned c)
         return itr->second;
     }
 
+    // then if another face set of the same faces and size measured it
+    bool shared = shared_metrics_ && size_ != 0;
+    if (shared)
+    {
+        char_info dim;
+        if (font_cache::instance().find_metrics(metrics_key(faces_key_, size_, c), dim))
+        {
+            dimension_cache_.insert(std::pair<unsigned, char_info>(c, dim));
+            return dim;
+        }
+    }
+
     FT_Matrix matrix;
     FT_Vector pen;
     FT_Error  error;
@@ -275,6 +527,10 @@ char_info font_face_set::character_dimensions(const unsigned c)
 
     char_info dim(c, tempx, glyph_bbox.yMax, glyph_bbox.yMin, face->size->metrics.height/64.0 /* >> 6 */);
     dimension_cache_.insert(std::pair<unsigned, char_info>(c, dim));
+    if (shared)
+    {
+        font_cache::instance().insert_metrics(metrics_key(faces_key_, size_, c), dim);
+    }
     return dim;
 }
 
@@ -408,42 +664,127 @@ box2d<double> text_renderer<T>::prepare_glyphs(text_path const& path)
             bbox.yMax = 0;
         }
 
+        glyph_cache_key key;
+        key.face = glyph->get_face()->name();
+        key.index = glyph->get_index();
+        key.size = static_cast<long>(c->format->text_size * scale_factor_ * (1 << 6));
+        key.xx = matrix.xx;
+        key.xy = matrix.xy;
+
         // take ownership of the glyph
-        glyphs_.push_back(new glyph_t(image, c->format));
+        glyphs_.push_back(new glyph_t(image, c->format, key, pen));
     }
 
     return box2d<double>(bbox.xMin, bbox.yMin, bbox.xMax, bbox.yMax);
 }
 
+namespace {
+
+// whole pixels halos are shifted by while they are rendered, see rasterize()
+long const halo_origin = 4096;
+
+}
+
 template <typename T>
-void composite_bitmap(T & pixmap, FT_Bitmap *bitmap, unsigned rgba, int x, int y, double opacity, composite_mode_e comp_op)
+glyph_bitmap_ptr text_renderer<T>::rasterize(glyph_t const& glyph, FT_Vector const& start, double stroke_radius,
+                                             unsigned steps, int & x, int & y)
 {
-    int x_max=x+bitmap->width;
-    int y_max=y+bitmap->rows;
-    int i,p,j,q;
+    glyph_cache & cache = glyph_cache::instance();
+    glyph_cache_key key = glyph.key;
+    long pixel_x, pixel_y;
+    glyph_cache::quantize(glyph.pen.x + start.x, steps, pixel_x, key.x);
+    glyph_cache::quantize(glyph.pen.y + start.y, steps, pixel_y, key.y);
+    key.stroke = stroke_radius > 0.0 ? static_cast<long>(stroke_radius * (1 << 6)) : 0;
+    x = static_cast<int>(pixel_x);
+    y = static_cast<int>(pixel_y);
+
+    // render at the subpixel offset only, whole pixels are added when blending
+    FT_Vector delta;
+    delta.x = key.x - glyph.pen.x;
+    delta.y = key.y - glyph.pen.y;
+    long shift = 0;
+
+    // unregistered faces have no stable identity to cache them by
+    bool cached = !key.face.empty();
+    if (key.stroke > 0)
+    {
+        // FreeType's stroker halves coordinates rounding towards zero, so a
+        // halo only comes out the same at another whole pixel offset while
+        // all its coordinates stay positive. Halos are rendered shifted by
+        // halo_origin pixels, or uncached at their absolute position where
+        // they reach below zero on the map.
+        FT_BBox box;
+        FT_Glyph_Get_CBox(glyph.image, FT_GLYPH_BBOX_UNSCALED, &box);
+        long margin = key.stroke + 2 * 64;
+        if (box.xMin + start.x < margin || box.yMin + start.y < margin ||
+            box.xMin + delta.x + halo_origin * 64 < margin ||
+            box.yMin + delta.y + halo_origin * 64 < margin)
+        {
+            cached = false;
+            delta = start;
+            x = 0;
+            y = 0;
+        }
+        else
+        {
+            shift = halo_origin;
+            delta.x += shift * 64;
+            delta.y += shift * 64;
+        }
+    }
 
-    for (i=x,p=0;i<x_max;++i,++p)
+    if (cached)
     {
-        for (j=y,q=0;j<y_max;++j,++q)
+        glyph_bitmap_ptr bitmap = cache.find(key);
+        if (bitmap) return bitmap;
+    }
+
+    FT_Glyph g;
+    FT_Error error = FT_Glyph_Copy(glyph.image, &g);
+    if (error) return glyph_bitmap_ptr();
+
+    FT_Glyph_Transform(g, 0, &delta);
+    if (key.stroke > 0)
+    {
+        stroker_.init(stroke_radius);
+        FT_Glyph_Stroke(&g, stroker_.get(), 1);
+    }
+
+    boost::shared_ptr<glyph_bitmap> bitmap;
+    error = FT_Glyph_To_Bitmap(&g, FT_RENDER_MODE_NORMAL, 0, 1);
+    if (!error)
+    {
+        FT_BitmapGlyph bit = (FT_BitmapGlyph)g;
+        bitmap = boost::make_shared<glyph_bitmap>();
+        bitmap->left = bit->left - shift;
+        bitmap->top = bit->top - shift;
+        bitmap->width = bit->bitmap.width;
+        bitmap->rows = bit->bitmap.rows;
+        bitmap->buffer.resize(bitmap->width * bitmap->rows);
+        for (unsigned row = 0; row < bitmap->rows; ++row)
         {
-            unsigned gray=bitmap->buffer[q*bitmap->width+p];
-            if (gray)
-            {
-                pixmap.composite_pixel(comp_op, i, j, rgba, gray, opacity);
-            }
+            std::memcpy(&bitmap->buffer[row * bitmap->width],
+                        bit->bitmap.buffer + row * bit->bitmap.pitch,
+                        bitmap->width);
+        }
+        if (cached)
+        {
+            cache.insert(key, bitmap);
         }
     }
+    FT_Done_Glyph(g);
+    return bitmap;
 }
 
 template <typename T>
 void text_renderer<T>::render(pixel_position pos)
 {
-    FT_Error  error;
     FT_Vector start;
     unsigned height = pixmap_.height();
 
     start.x =  static_cast<FT_Pos>(pos.x * (1 << 6));
     start.y =  static_cast<FT_Pos>((height - pos.y) * (1 << 6));
+    unsigned steps = glyph_cache::instance().subpixel_steps();
 
     // now render transformed glyphs
     typename glyphs_t::iterator itr;
@@ -452,49 +793,27 @@ void text_renderer<T>::render(pixel_position pos)
         double halo_radius = itr->properties->halo_radius * scale_factor_;
         //make sure we've got reasonable values.
         if (halo_radius <= 0.0 || halo_radius > 1024.0) continue;
-        stroker_.init(halo_radius);
-        FT_Glyph g;
-        error = FT_Glyph_Copy(itr->image, &g);
-        if (!error)
+        int x, y;
+        glyph_bitmap_ptr bitmap = rasterize(*itr, start, halo_radius, steps, x, y);
+        if (bitmap)
         {
-            FT_Glyph_Transform(g,0,&start);
-            FT_Glyph_Stroke(&g,stroker_.get(),1);
-            error = FT_Glyph_To_Bitmap( &g,FT_RENDER_MODE_NORMAL,0,1);
-            if ( ! error )
-            {
-
-                FT_BitmapGlyph bit = (FT_BitmapGlyph)g;
-                composite_bitmap(pixmap_, &bit->bitmap, itr->properties->halo_fill.rgba(),
-                                 bit->left,
-                                 height - bit->top, 
-                                 itr->properties->text_opacity,
-                                 comp_op_
-                    );
-            }
+            render_bitmap(*bitmap, itr->properties->halo_fill.rgba(),
+                          x + bitmap->left,
+                          height - y - bitmap->top,
+                          itr->properties->text_opacity);
         }
-        FT_Done_Glyph(g);
     }
     //render actual text
     for (itr = glyphs_.begin(); itr != glyphs_.end(); ++itr)
     {
-
-        FT_Glyph_Transform(itr->image,0,&start);
-
-        error = FT_Glyph_To_Bitmap( &(itr->image),FT_RENDER_MODE_NORMAL,0,1);
-        if ( ! error )
+        int x, y;
+        glyph_bitmap_ptr bitmap = rasterize(*itr, start, 0.0, steps, x, y);
+        if (bitmap)
         {
-
-            FT_BitmapGlyph bit = (FT_BitmapGlyph)itr->image;
-            //render_bitmap(&bit->bitmap, itr->properties->fill.rgba(),
-            //              bit->left,
-            //              height - bit->top, itr->properties->text_opacity);
-            
-            composite_bitmap(pixmap_, &bit->bitmap, itr->properties->fill.rgba(),
-                             bit->left,
-                             height - bit->top, 
-                             itr->properties->text_opacity,
-                             comp_op_
-                );
+            render_bitmap(*bitmap, itr->properties->fill.rgba(),
+                          x + bitmap->left,
+                          height - y - bitmap->top,
+                          itr->properties->text_opacity);
         }
     }
 }
@@ -503,36 +822,25 @@ void text_renderer<T>::render(pixel_position pos)
 template <typename T>
 void text_renderer<T>::render_id(int feature_id, pixel_position pos, double min_radius)
 {
-    FT_Error  error;
     FT_Vector start;
     unsigned height = pixmap_.height();
 
     start.x =  static_cast<FT_Pos>(pos.x * (1 << 6));
     start.y =  static_cast<FT_Pos>((height - pos.y) * (1 << 6));
+    unsigned steps = glyph_cache::instance().subpixel_steps();
 
     // now render transformed glyphs
     typename glyphs_t::iterator itr;
     for (itr = glyphs_.begin(); itr != glyphs_.end(); ++itr)
     {
-        stroker_.init(std::max(itr->properties->halo_radius, min_radius));
-        FT_Glyph g;
-        error = FT_Glyph_Copy(itr->image, &g);
-        if (!error)
+        int x, y;
+        glyph_bitmap_ptr bitmap = rasterize(*itr, start, std::max(itr->properties->halo_radius, min_radius), steps, x, y);
+        if (bitmap)
         {
-            FT_Glyph_Transform(g,0,&start);
-            FT_Glyph_Stroke(&g,stroker_.get(),1);
-            error = FT_Glyph_To_Bitmap( &g,FT_RENDER_MODE_NORMAL,0,1);
-            //error = FT_Glyph_To_Bitmap( &g,FT_RENDER_MODE_MONO,0,1);
-            if ( ! error )
-            {
-
-                FT_BitmapGlyph bit = (FT_BitmapGlyph)g;
-                render_bitmap_id(&bit->bitmap, feature_id,
-                                 bit->left,
-                                 height - bit->top);
-            }
+            render_bitmap_id(*bitmap, feature_id,
+                             x + bitmap->left,
+                             height - y - bitmap->top);
         }
-        FT_Done_Glyph(g);
     }
 }
 
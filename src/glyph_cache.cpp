@@ -0,0 +1,137 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/debug.hpp>
+#include <mapnik/glyph_cache.hpp>
+
+// boost
+#include <boost/functional/hash.hpp>
+
+namespace mapnik
+{
+
+std::size_t hash_value(glyph_cache_key const& key)
+{
+    std::size_t seed = boost::hash<std::string>()(key.face);
+    boost::hash_combine(seed, key.index);
+    boost::hash_combine(seed, key.size);
+    boost::hash_combine(seed, key.xx);
+    boost::hash_combine(seed, key.xy);
+    boost::hash_combine(seed, key.x);
+    boost::hash_combine(seed, key.y);
+    boost::hash_combine(seed, key.stroke);
+    return seed;
+}
+
+namespace {
+
+std::size_t entry_bytes(glyph_bitmap const& bitmap)
+{
+    return sizeof(glyph_bitmap) + bitmap.buffer.size();
+}
+
+}
+
+glyph_cache::glyph_cache()
+    : cache_(16 * 1024 * 1024),
+      subpixel_steps_(64) {}
+
+glyph_bitmap_ptr glyph_cache::find(glyph_cache_key const& key)
+{
+    glyph_bitmap_ptr bitmap;
+    cache_.find(key, bitmap);
+    return bitmap;
+}
+
+void glyph_cache::insert(glyph_cache_key const& key, glyph_bitmap_ptr const& bitmap)
+{
+    // zero budgets are unlimited for the underlying cache
+    if (cache_.max_bytes() == 0) return;
+    cache_.insert(key, bitmap, entry_bytes(*bitmap));
+}
+
+void glyph_cache::clear()
+{
+    cache_.clear();
+}
+
+void glyph_cache::set_max_bytes(std::size_t max_bytes)
+{
+    cache_.set_max_bytes(max_bytes);
+    if (max_bytes == 0) cache_.clear();
+}
+
+std::size_t glyph_cache::max_bytes() const
+{
+    return cache_.max_bytes();
+}
+
+void glyph_cache::set_subpixel_steps(unsigned steps)
+{
+    if (steps == 0 || steps > 64 || (64 % steps) != 0)
+    {
+        MAPNIK_LOG_ERROR(glyph_cache) << "glyph_cache: Ignoring invalid subpixel steps " << steps;
+        return;
+    }
+#ifdef MAPNIK_THREADSAFE
+    mutex::scoped_lock lock(steps_mutex_);
+#endif
+    if (steps != subpixel_steps_)
+    {
+        subpixel_steps_ = steps;
+        // bitmaps rendered at the old positions are never looked up again
+        cache_.clear();
+    }
+}
+
+unsigned glyph_cache::subpixel_steps() const
+{
+#ifdef MAPNIK_THREADSAFE
+    mutex::scoped_lock lock(steps_mutex_);
+#endif
+    return subpixel_steps_;
+}
+
+void glyph_cache::quantize(long pos, unsigned steps, long & pixel, long & subpixel)
+{
+    pixel = pos >= 0 ? pos / 64 : -((63 - pos) / 64);
+    long step = 64 / steps;
+    subpixel = ((pos - pixel * 64 + step / 2) / step) * step;
+    if (subpixel == 64)
+    {
+        subpixel = 0;
+        ++pixel;
+    }
+}
+
+glyph_cache_stats glyph_cache::stats() const
+{
+    return cache_.stats();
+}
+
+void glyph_cache::reset_stats()
+{
+    cache_.reset_stats();
+}
+
+}
@@ -34,6 +34,9 @@
 // boost
 #include <boost/scoped_array.hpp>
 
+// stl
+#include <cstring>
+
 // cairo
 #ifdef HAVE_CAIRO
 #include <mapnik/cairo_context.hpp>
@@ -221,4 +224,76 @@ void image_32::composite_pixel(unsigned op, int x,int y, unsigned c, unsigned co
     }
 }
 
+void image_32::composite_span(unsigned op, int x, int y, unsigned c, unsigned char const* covers, int len, double opacity)
+{
+    typedef agg::rgba8 color_type;
+    typedef color_type::value_type value_type;
+    typedef agg::order_rgba order_type;
+
+    if (y < 0 || y >= static_cast<int>(height_)) return;
+    if (x < 0)
+    {
+        covers -= x;
+        len += x;
+        x = 0;
+    }
+    if (x + len > static_cast<int>(width_))
+    {
+        len = width_ - x;
+    }
+    if (len <= 0) return;
+
+    // premultiplied source, as comp_op_adaptor_rgba computes it
+    unsigned ca = (unsigned)(((c >> 24) & 0xff) * opacity);
+    value_type src[4];
+    src[order_type::R] = (value_type)(((c & 0xff) * ca + 255) >> 8);
+    src[order_type::G] = (value_type)((((c >> 8) & 0xff) * ca + 255) >> 8);
+    src[order_type::B] = (value_type)((((c >> 16) & 0xff) * ca + 255) >> 8);
+    src[order_type::A] = (value_type)ca;
+
+    unsigned int* row = data_.getRow(y) + x;
+    if (op == agg::comp_op_src_over)
+    {
+        // comp_op_rgba_src_over on two channels at a time, each in a 16 bit lane
+        // of a 32 bit word, so lanes can't overflow into each other
+        unsigned int const mask = 0x00ff00ff;
+        unsigned int src_pixel;
+        std::memcpy(&src_pixel, src, 4);
+        unsigned int const src_lo = src_pixel & mask;
+        unsigned int const src_hi = (src_pixel >> 8) & mask;
+        for (int i = 0; i < len; ++i)
+        {
+            unsigned cover = covers[i];
+            if (cover == 0) continue;
+            unsigned int s_lo = src_lo;
+            unsigned int s_hi = src_hi;
+            unsigned sa = ca;
+            if (cover < 255)
+            {
+                s_lo = ((s_lo * cover + mask) >> 8) & mask;
+                s_hi = ((s_hi * cover + mask) >> 8) & mask;
+                sa = (sa * cover + 255) >> 8;
+            }
+            unsigned s1a = 255 - sa;
+            unsigned int d = row[i];
+            unsigned int d_lo = (((d & mask) * s1a + mask) >> 8) & mask;
+            unsigned int d_hi = ((((d >> 8) & mask) * s1a + mask) >> 8) & mask;
+            row[i] = ((s_lo + d_lo) & mask) | (((s_hi + d_hi) & mask) << 8);
+        }
+    }
+    else
+    {
+        agg::comp_op_table_rgba<color_type, order_type>::comp_op_func_type blend =
+            agg::comp_op_table_rgba<color_type, order_type>::g_comp_op_func[op];
+        for (int i = 0; i < len; ++i)
+        {
+            unsigned cover = covers[i];
+            if (cover == 0) continue;
+            blend((value_type*)(row + i),
+                  src[order_type::R], src[order_type::G], src[order_type::B], src[order_type::A],
+                  cover);
+        }
+    }
+}
+
 }
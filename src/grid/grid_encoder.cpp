@@ -0,0 +1,336 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/grid/grid_encoder.hpp>
+#include <mapnik/grid/grid.hpp>
+#include <mapnik/grid/grid_view.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/noncopyable.hpp>
+#include <mapnik/util/conversions.hpp>
+
+// boost
+#include <boost/unordered_map.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
+
+// stl
+#include <cstdio>
+
+namespace mapnik
+{
+
+namespace {
+
+// appends the UTF-8 encoding of a codepoint, returns the number of bytes
+unsigned encode_utf8(unsigned codepoint, char * out)
+{
+    if (codepoint < 0x80)
+    {
+        out[0] = static_cast<char>(codepoint);
+        return 1;
+    }
+    else if (codepoint < 0x800)
+    {
+        out[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+        out[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    else if (codepoint < 0x10000)
+    {
+        out[0] = static_cast<char>(0xE0 | (codepoint >> 12));
+        out[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (codepoint >> 18));
+    out[1] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+void append_json_string(std::string & json, std::string const& str)
+{
+    json += '"';
+    for (std::string::const_iterator itr = str.begin(); itr != str.end(); ++itr)
+    {
+        unsigned char c = static_cast<unsigned char>(*itr);
+        switch (c)
+        {
+        case '"': json += "\\\""; break;
+        case '\\': json += "\\\\"; break;
+        case '\n': json += "\\n"; break;
+        case '\r': json += "\\r"; break;
+        case '\t': json += "\\t"; break;
+        default:
+            if (c < 0x20)
+            {
+                char buf[8];
+                std::sprintf(buf, "\\u%04x", c);
+                json += buf;
+            }
+            else
+            {
+                json += *itr;
+            }
+        }
+    }
+    json += '"';
+}
+
+struct json_value_writer : public boost::static_visitor<>
+{
+    explicit json_value_writer(std::string & json)
+        : json_(json) {}
+
+    void operator() (value_null const&) const
+    {
+        json_ += "null";
+    }
+
+    void operator() (value_bool val) const
+    {
+        json_ += val ? "true" : "false";
+    }
+
+    void operator() (value_integer val) const
+    {
+        util::to_string(json_, val);
+    }
+
+    void operator() (value_double val) const
+    {
+        // json has no nan or infinity
+        if (!(boost::math::isfinite)(val))
+        {
+            json_ += "null";
+            return;
+        }
+        util::to_string(json_, val);
+    }
+
+    void operator() (value_unicode_string const& val) const
+    {
+        std::string utf8;
+        to_utf8(val, utf8);
+        append_json_string(json_, utf8);
+    }
+
+    std::string & json_;
+};
+
+// assigns characters to keys in the order they are first seen
+template <typename T>
+class utf_grid_encoder : private mapnik::noncopyable
+{
+public:
+    typedef typename T::value_type value_type;
+    typedef typename T::feature_key_type feature_key_type;
+
+    utf_grid_encoder(T const& grid, unsigned resolution, std::vector<std::string> & keys)
+        : grid_(grid),
+          feature_keys_(grid.get_feature_keys()),
+          resolution_(resolution > 0 ? resolution : 1),
+          keys_(keys),
+          codepoints_(),
+          key_codepoints_(),
+          next_codepoint_(32),
+          no_key_() {}
+
+    unsigned width() const
+    {
+        return (grid_.width() + resolution_ - 1) / resolution_;
+    }
+
+    unsigned height() const
+    {
+        return (grid_.height() + resolution_ - 1) / resolution_;
+    }
+
+    // appends the sampled row y as UTF-8
+    void encode_row(unsigned y, std::string & out)
+    {
+        value_type const* row = grid_.getRow(y * resolution_);
+        unsigned const w = grid_.width();
+        char buf[4];
+        unsigned len = 0;
+        value_type current = 0;
+        // pixels of a horizontal run share the character of its first pixel
+        for (unsigned x = 0; x < w; x += resolution_)
+        {
+            if (len == 0 || row[x] != current)
+            {
+                current = row[x];
+                len = encode_utf8(codepoint(current), buf);
+            }
+            out.append(buf, len);
+        }
+    }
+
+private:
+    unsigned codepoint(value_type id)
+    {
+        typename boost::unordered_map<value_type, unsigned>::const_iterator itr = codepoints_.find(id);
+        if (itr != codepoints_.end())
+        {
+            return itr->second;
+        }
+        // ids without a key, like the background, map to the empty key
+        typename feature_key_type::const_iterator key = feature_keys_.find(id);
+        std::string const& key_value = key != feature_keys_.end() ? key->second : no_key_;
+
+        // features sharing a key share a character
+        unsigned code;
+        boost::unordered_map<std::string, unsigned>::const_iterator key_itr = key_codepoints_.find(key_value);
+        if (key_itr != key_codepoints_.end())
+        {
+            code = key_itr->second;
+        }
+        else
+        {
+            code = next_codepoint();
+            key_codepoints_.insert(std::make_pair(key_value, code));
+            keys_.push_back(key_value);
+        }
+        codepoints_.insert(std::make_pair(id, code));
+        return code;
+    }
+
+    unsigned next_codepoint()
+    {
+        // skip the characters which would need escaping in json and the
+        // surrogates, which are not valid on their own
+        if (next_codepoint_ == 34 || next_codepoint_ == 92) ++next_codepoint_;
+        else if (next_codepoint_ == 0xD800) next_codepoint_ = 0xE000;
+        return next_codepoint_++;
+    }
+
+    T const& grid_;
+    feature_key_type const& feature_keys_;
+    unsigned resolution_;
+    std::vector<std::string> & keys_;
+    boost::unordered_map<value_type, unsigned> codepoints_;
+    boost::unordered_map<std::string, unsigned> key_codepoints_;
+    unsigned next_codepoint_;
+    std::string const no_key_;
+};
+
+template <typename T>
+void write_features(T const& grid, std::vector<std::string> const& keys, std::string & json)
+{
+    typename T::feature_type const& features = grid.get_grid_features();
+    std::set<std::string> const& attributes = grid.property_names();
+    bool first = true;
+    for (std::vector<std::string>::const_iterator key = keys.begin(); key != keys.end(); ++key)
+    {
+        if (key->empty()) continue;
+        typename T::feature_type::const_iterator feat_itr = features.find(*key);
+        if (feat_itr == features.end()) continue;
+
+        mapnik::feature_ptr const& feature = feat_itr->second;
+        std::string properties;
+        bool found = false;
+        for (std::set<std::string>::const_iterator attr = attributes.begin(); attr != attributes.end(); ++attr)
+        {
+            if (*attr == "__id__")
+            {
+                properties += properties.empty() ? "{" : ",";
+                append_json_string(properties, *attr);
+                properties += ':';
+                util::to_string(properties, feature->id());
+            }
+            else if (feature->has_key(*attr))
+            {
+                found = true;
+                properties += properties.empty() ? "{" : ",";
+                append_json_string(properties, *attr);
+                properties += ':';
+                boost::apply_visitor(json_value_writer(properties), feature->get(*attr).base());
+            }
+        }
+        // like the python encoder, features with none of the properties are left out
+        if (!found) continue;
+
+        if (!first) json += ',';
+        first = false;
+        append_json_string(json, *key);
+        json += ':';
+        json += properties;
+        json += '}';
+    }
+}
+
+}
+
+template <typename T>
+void encode_utf_grid(T const& grid, utf_grid & result, unsigned resolution)
+{
+    result.rows.clear();
+    result.keys.clear();
+    utf_grid_encoder<T> encoder(grid, resolution, result.keys);
+    unsigned const height = encoder.height();
+    result.rows.resize(height);
+    for (unsigned y = 0; y < height; ++y)
+    {
+        result.rows[y].reserve(encoder.width());
+        encoder.encode_row(y, result.rows[y]);
+    }
+}
+
+template <typename T>
+void encode_utf_grid_json(T const& grid, std::string & json, bool add_features, unsigned resolution)
+{
+    std::vector<std::string> keys;
+    utf_grid_encoder<T> encoder(grid, resolution, keys);
+    unsigned const height = encoder.height();
+    // most tiles have few features, so most characters take a single byte
+    json.reserve(json.size() + height * (encoder.width() + 3) + 64);
+    json += "{\"grid\":[";
+    for (unsigned y = 0; y < height; ++y)
+    {
+        if (y > 0) json += ',';
+        // characters never need escaping
+        json += '"';
+        encoder.encode_row(y, json);
+        json += '"';
+    }
+    json += "],\"keys\":[";
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        if (i > 0) json += ',';
+        append_json_string(json, keys[i]);
+    }
+    json += "],\"data\":{";
+    if (add_features)
+    {
+        write_features(grid, keys, json);
+    }
+    json += "}}";
+}
+
+template MAPNIK_DECL void encode_utf_grid(grid const&, utf_grid &, unsigned);
+template MAPNIK_DECL void encode_utf_grid(grid_view const&, utf_grid &, unsigned);
+template MAPNIK_DECL void encode_utf_grid_json(grid const&, std::string &, bool, unsigned);
+template MAPNIK_DECL void encode_utf_grid_json(grid_view const&, std::string &, bool, unsigned);
+
+}
@@ -25,6 +25,7 @@
 #include <mapnik/grid/grid_renderer.hpp>
 #include <mapnik/grid/grid_renderer_base.hpp>
 #include <mapnik/grid/grid.hpp>
+#include <mapnik/building_extrusion.hpp>
 
 
 #include <mapnik/image_scaling.hpp>
@@ -66,7 +67,8 @@ grid_renderer<T>::grid_renderer(Map const& m, T & pixmap, double scale_factor, u
       font_engine_(),
       font_manager_(font_engine_),
       detector_(boost::make_shared<label_collision_detector4>(box2d<double>(-m.buffer_size(), -m.buffer_size(), m.width() + m.buffer_size() ,m.height() + m.buffer_size()))),
-      ras_ptr(new grid_rasterizer)
+      ras_ptr(new grid_rasterizer),
+      extrusion_(new building_extrusion)
 {
     setup(m);
 }
@@ -26,17 +26,11 @@
 #include <mapnik/grid/grid_renderer.hpp>
 #include <mapnik/grid/grid_renderer_base.hpp>
 #include <mapnik/grid/grid.hpp>
-#include <mapnik/segment.hpp>
+#include <mapnik/building_extrusion.hpp>
 #include <mapnik/expression_evaluator.hpp>
 #include <mapnik/building_symbolizer.hpp>
 #include <mapnik/expression.hpp>
 
-// boost
-#include <boost/scoped_ptr.hpp>
-
-// stl
-#include <deque>
-
 // agg
 #include "agg_rasterizer_scanline_aa.h"
 #include "agg_renderer_scanline.h"
@@ -54,7 +48,6 @@ void grid_renderer<T>::process(building_symbolizer const& sym,
     typedef typename grid_renderer_base_type::pixfmt_type pixfmt_type;
     typedef typename grid_renderer_base_type::pixfmt_type::color_type color_type;
     typedef agg::renderer_scanline_bin_solid<grid_renderer_base_type> renderer_type;
-    typedef coord_transform<CoordTransform,geometry_type> path_type;
     agg::scanline_bin sl;
 
     grid_rendering_buffer buf(pixmap_.raw_data(), width_, height_, width_);
@@ -73,81 +66,34 @@ void grid_renderer<T>::process(building_symbolizer const& sym,
         height = result.to_double() * scale_factor_;
     }
 
+    ren.color(color_type(feature.id()));
+
+    building_extrusion & extrusion = *extrusion_;
     for (unsigned i=0;i<feature.num_geometries();++i)
     {
-        geometry_type & geom = feature.get_geometry(i);
+        geometry_type const& geom = feature.get_geometry(i);
         if (geom.size() > 2)
         {
-            boost::scoped_ptr<geometry_type> frame(new geometry_type(LineString));
-            boost::scoped_ptr<geometry_type> roof(new geometry_type(Polygon));
-            std::deque<segment_t> face_segments;
-            double x0(0);
-            double y0(0);
-            unsigned cm = geom.vertex(&x0,&y0);
-            for (unsigned j=1;j<geom.size();++j)
-            {
-                double x(0);
-                double y(0);
-                cm = geom.vertex(&x,&y);
-                if (cm == SEG_MOVETO)
-                {
-                    frame->move_to(x,y);
-                }
-                else if (cm == SEG_LINETO)
-                {
-                    frame->line_to(x,y);
-                    face_segments.push_back(segment_t(x0,y0,x,y));
-                }
+            extrusion.build(geom, height, t_, prj_trans);
+            if (extrusion.empty()) continue;
 
-                x0 = x;
-                y0 = y;
-            }
-            std::sort(face_segments.begin(),face_segments.end(), y_order);
-            std::deque<segment_t>::const_iterator itr=face_segments.begin();
-            for (;itr!=face_segments.end();++itr)
+            for (std::size_t j = 0; j < extrusion.wall_count(); ++j)
             {
-                boost::scoped_ptr<geometry_type> faces(new geometry_type(Polygon));
-                faces->move_to(itr->get<0>(),itr->get<1>());
-                faces->line_to(itr->get<2>(),itr->get<3>());
-                faces->line_to(itr->get<2>(),itr->get<3>() + height);
-                faces->line_to(itr->get<0>(),itr->get<1>() + height);
-
-                path_type faces_path (t_,*faces,prj_trans);
-                ras_ptr->add_path(faces_path);
-                ren.color(color_type(feature.id()));
-                agg::render_scanlines(*ras_ptr, sl, ren);
+                building_extrusion::path_source wall = extrusion.wall(j);
                 ras_ptr->reset();
-
-                frame->move_to(itr->get<0>(),itr->get<1>());
-                frame->line_to(itr->get<0>(),itr->get<1>()+height);
+                ras_ptr->add_path(wall);
+                agg::render_scanlines(*ras_ptr, sl, ren);
             }
 
-            geom.rewind(0);
-            for (unsigned j=0;j<geom.size();++j)
-            {
-                double x,y;
-                cm = geom.vertex(&x,&y);
-                if (cm == SEG_MOVETO)
-                {
-                    frame->move_to(x,y+height);
-                    roof->move_to(x,y+height);
-                }
-                else if (cm == SEG_LINETO)
-                {
-                    frame->line_to(x,y+height);
-                    roof->line_to(x,y+height);
-                }
-            }
-            path_type path(t_,*frame,prj_trans);
-            agg::conv_stroke<path_type> stroke(path);
+            building_extrusion::path_source frame = extrusion.frame();
+            agg::conv_stroke<building_extrusion::path_source> stroke(frame);
+            ras_ptr->reset();
             ras_ptr->add_path(stroke);
-            ren.color(color_type(feature.id()));
             agg::render_scanlines(*ras_ptr, sl, ren);
-            ras_ptr->reset();
 
-            path_type roof_path (t_,*roof,prj_trans);
-            ras_ptr->add_path(roof_path);
-            ren.color(color_type(feature.id()));
+            building_extrusion::path_source roof = extrusion.roof();
+            ras_ptr->reset();
+            ras_ptr->add_path(roof);
             agg::render_scanlines(*ras_ptr, sl, ren);
         }
     }
@@ -29,6 +29,35 @@ namespace mapnik
 {
 typedef factory<image_reader,std::string,
                 image_reader* (*)(std::string const&)>  ImageReaderFactory;
+typedef factory<image_reader,std::string,
+                image_reader* (*)(char const*, std::size_t)>  MemoryImageReaderFactory;
+
+namespace {
+
+boost::optional<std::string> type_from_bytes(char const* data, std::size_t size)
+{
+    typedef boost::optional<std::string> result_type;
+    if (size >= 4)
+    {
+        unsigned char const* header = reinterpret_cast<unsigned char const*>(data);
+        if (header[0] == 0x89 && header[1] == 'P' && header[2] == 'N' && header[3] == 'G')
+        {
+            return result_type("png");
+        }
+        if (header[0] == 0xff && header[1] == 0xd8)
+        {
+            return result_type("jpeg");
+        }
+        if ((header[0] == 'I' && header[1] == 'I' && header[2] == 42 && header[3] == 0) ||
+            (header[0] == 'M' && header[1] == 'M' && header[2] == 0 && header[3] == 42))
+        {
+            return result_type("tiff");
+        }
+    }
+    return result_type();
+}
+
+}
 
 
 bool register_image_reader(std::string const& type,image_reader* (* fun)(std::string const&))
@@ -36,6 +65,11 @@ bool register_image_reader(std::string const& type,image_reader* (* fun)(std::st
     return ImageReaderFactory::instance().register_product(type,fun);
 }
 
+bool register_image_reader(std::string const& type,image_reader* (* fun)(char const*, std::size_t))
+{
+    return MemoryImageReaderFactory::instance().register_product(type,fun);
+}
+
 image_reader* get_image_reader(std::string const& filename,std::string const& type)
 {
     return ImageReaderFactory::instance().create_object(type,filename);
@@ -51,4 +85,14 @@ image_reader* get_image_reader(std::string const& filename)
     return 0;
 }
 
+image_reader* get_image_reader(char const* data, std::size_t size)
+{
+    boost::optional<std::string> type = type_from_bytes(data,size);
+    if (type)
+    {
+        return MemoryImageReaderFactory::instance().create_object(*type,data,size);
+    }
+    return 0;
+}
+
 }
@@ -33,9 +33,13 @@ extern "C"
 
 // boost
 #include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/interprocess/streams/bufferstream.hpp>
 
 // std
+#include <algorithm>
 #include <cstdio>
+#include <fstream>
 
 namespace mapnik
 {
@@ -43,10 +47,12 @@ class JpegReader : public image_reader, mapnik::noncopyable
 {
 private:
     std::string fileName_;
+    boost::scoped_ptr<std::istream> stream_;
     unsigned width_;
     unsigned height_;
 public:
     explicit JpegReader(std::string const& fileName);
+    JpegReader(char const* data, std::size_t size);
     ~JpegReader();
     unsigned width() const;
     unsigned height() const;
@@ -62,11 +68,113 @@ image_reader* createJpegReader(std::string const& file)
 {
     return new JpegReader(file);
 }
+image_reader* createJpegReaderFromMemory(char const* data, std::size_t size)
+{
+    return new JpegReader(data, size);
+}
 const bool registered = register_image_reader("jpeg",createJpegReader);
+const bool registered_memory = register_image_reader("jpeg",createJpegReaderFromMemory);
+
+// libjpeg source manager pulling compressed data from a std::istream
+struct istream_source_mgr
+{
+    jpeg_source_mgr pub;
+    std::istream * stream;
+    JOCTET buffer[4096];
+};
+
+void init_source(j_decompress_ptr)
+{
+}
+
+boolean fill_input_buffer(j_decompress_ptr cinfo)
+{
+    istream_source_mgr * src = reinterpret_cast<istream_source_mgr *>(cinfo->src);
+    src->stream->read(reinterpret_cast<char *>(src->buffer), sizeof(src->buffer));
+    std::streamsize count = src->stream->gcount();
+    if (count <= 0)
+    {
+        // premature end of data, insert a fake EOI marker as libjpeg's stdio source does
+        src->buffer[0] = static_cast<JOCTET>(0xFF);
+        src->buffer[1] = static_cast<JOCTET>(JPEG_EOI);
+        count = 2;
+    }
+    src->pub.next_input_byte = src->buffer;
+    src->pub.bytes_in_buffer = count;
+    return TRUE;
+}
+
+void skip_input_data(j_decompress_ptr cinfo, long count)
+{
+    istream_source_mgr * src = reinterpret_cast<istream_source_mgr *>(cinfo->src);
+    if (count <= 0) return;
+    while (count > static_cast<long>(src->pub.bytes_in_buffer))
+    {
+        count -= static_cast<long>(src->pub.bytes_in_buffer);
+        fill_input_buffer(cinfo);
+    }
+    src->pub.next_input_byte += count;
+    src->pub.bytes_in_buffer -= count;
+}
+
+void term_source(j_decompress_ptr)
+{
+}
+
+void attach_istream(j_decompress_ptr cinfo, std::istream * stream)
+{
+    istream_source_mgr * src = static_cast<istream_source_mgr *>(
+        (*cinfo->mem->alloc_small)(reinterpret_cast<j_common_ptr>(cinfo), JPOOL_PERMANENT, sizeof(istream_source_mgr)));
+    src->stream = stream;
+    src->pub.init_source = init_source;
+    src->pub.fill_input_buffer = fill_input_buffer;
+    src->pub.skip_input_data = skip_input_data;
+    src->pub.resync_to_restart = jpeg_resync_to_restart;
+    src->pub.term_source = term_source;
+    src->pub.bytes_in_buffer = 0;
+    src->pub.next_input_byte = 0;
+    cinfo->src = reinterpret_cast<jpeg_source_mgr *>(src);
+}
+
+// libjpeg's default error handler exits the process, throw instead
+void on_error(j_common_ptr cinfo)
+{
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    throw image_reader_exception(std::string("JPEG Reader: ") + buffer);
+}
+
+void on_error_message(j_common_ptr)
+{
+}
+
+// destroys the decompressor however decoding ends
+struct decompress_guard
+{
+    explicit decompress_guard(jpeg_decompress_struct * cinfo)
+        : cinfo_(cinfo) {}
+
+    ~decompress_guard()
+    {
+        jpeg_destroy_decompress(cinfo_);
+    }
+    jpeg_decompress_struct * cinfo_;
+};
 }
 
 JpegReader::JpegReader(std::string const& fileName)
     : fileName_(fileName),
+      stream_(new std::ifstream(fileName.c_str(), std::ios::in | std::ios::binary)),
+      width_(0),
+      height_(0)
+{
+    if (!*stream_) throw image_reader_exception("JPEG Reader: cannot open image file " + fileName_);
+    init();
+}
+
+JpegReader::JpegReader(char const* data, std::size_t size)
+    : fileName_("<memory>"),
+      stream_(new boost::interprocess::ibufferstream(data, size)),
       width_(0),
       height_(0)
 {
@@ -77,16 +185,16 @@ JpegReader::~JpegReader() {}
 
 void JpegReader::init()
 {
-    FILE *fp = fopen(fileName_.c_str(),"rb");
-    if (!fp) throw image_reader_exception("JPEG Reader: cannot open image file " + fileName_);
-
     struct jpeg_decompress_struct cinfo;
     struct jpeg_error_mgr jerr;
 
     cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = on_error;
+    jerr.output_message = on_error_message;
 
     jpeg_create_decompress(&cinfo);
-    jpeg_stdio_src(&cinfo, fp);
+    decompress_guard guard(&cinfo);
+    attach_istream(&cinfo, stream_.get());
     jpeg_read_header(&cinfo, TRUE);
 
     jpeg_start_decompress(&cinfo);
@@ -94,8 +202,6 @@ void JpegReader::init()
     height_ = cinfo.output_height;
     // if enabled: "Application transferred too few scanlines"
     //jpeg_finish_decompress(&cinfo);
-    jpeg_destroy_decompress(&cinfo);
-    fclose(fp);
 }
 
 unsigned JpegReader::width() const
@@ -110,16 +216,21 @@ unsigned JpegReader::height() const
 
 void JpegReader::read(unsigned x0, unsigned y0, image_data_32& image)
 {
-    struct jpeg_decompress_struct cinfo;
+    if (x0 >= width_ || y0 >= height_) return;
 
-    FILE *fp = fopen(fileName_.c_str(),"rb");
-    if (!fp) throw image_reader_exception("JPEG Reader: cannot open image file " + fileName_);
+    // the stream stays open between reads, start again from the beginning
+    stream_->clear();
+    stream_->seekg(0, std::ios::beg);
 
+    struct jpeg_decompress_struct cinfo;
     struct jpeg_error_mgr jerr;
     cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = on_error;
+    jerr.output_message = on_error_message;
 
     jpeg_create_decompress(&cinfo);
-    jpeg_stdio_src(&cinfo, fp);
+    decompress_guard guard(&cinfo);
+    attach_istream(&cinfo, stream_.get());
 
     jpeg_read_header(&cinfo, TRUE);
     if (cinfo.out_color_space == JCS_UNKNOWN)
@@ -128,8 +239,6 @@ void JpegReader::read(unsigned x0, unsigned y0, image_data_32& image)
     jpeg_start_decompress(&cinfo);
 
     if (cinfo.output_width == 0) {
-        jpeg_destroy_decompress (&cinfo);
-        fclose(fp);
         throw image_reader_exception("JPEG Reader: failed to read image size of " + fileName_);
     }
 
@@ -139,24 +248,25 @@ void JpegReader::read(unsigned x0, unsigned y0, image_data_32& image)
     row_stride = cinfo.output_width * cinfo.output_components;
     buffer = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
 
-    unsigned w = std::min(unsigned(image.width()),width_);
-    unsigned h = std::min(unsigned(image.height()),height_);
+    unsigned w = std::min(unsigned(image.width()),width_ - x0);
+    unsigned h = std::min(unsigned(image.height()),height_ - y0);
 
     boost::scoped_array<unsigned int> out_row(new unsigned int[w]);
-    // TODO - handle x0
-    for (unsigned i=0;i<h;++i)
+    // scanlines below the window are never decoded
+    for (unsigned i=0;i<y0 + h;++i)
     {
         jpeg_read_scanlines(&cinfo, buffer, 1);
-        if (i>=y0 && i<h)
+        if (i>=y0)
         {
             for (unsigned int x=0; x<w; x++)
             {
+                unsigned offset = cinfo.output_components * (x0 + x);
                 a = 255; // alpha not supported in jpg
-                r = buffer[0][cinfo.output_components * x];
+                r = buffer[0][offset];
                 if (cinfo.output_components > 2)
                 {
-                    g = buffer[0][cinfo.output_components*x+1];
-                    b = buffer[0][cinfo.output_components*x+2];
+                    g = buffer[0][offset+1];
+                    b = buffer[0][offset+2];
                 } else {
                     g = r;
                     b = r;
@@ -166,8 +276,9 @@ void JpegReader::read(unsigned x0, unsigned y0, image_data_32& image)
             image.setRow(i-y0, out_row.get(), w);
         }
     }
-    jpeg_finish_decompress(&cinfo);
-    jpeg_destroy_decompress(&cinfo);
-    fclose(fp);
+    if (y0 + h == height_)
+    {
+        jpeg_finish_decompress(&cinfo);
+    }
 }
 }
@@ -25,7 +25,6 @@
 #include <mapnik/mapped_memory_cache.hpp>
 
 // boost
-#include <boost/assert.hpp>
 #include <boost/interprocess/file_mapping.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/make_shared.hpp>
@@ -33,36 +32,30 @@
 namespace mapnik
 {
 
+mapped_memory_cache::mapped_memory_cache()
+    : cache_() {}
+
 void mapped_memory_cache::clear()
 {
-#ifdef MAPNIK_THREADSAFE
-    mutex::scoped_lock lock(mutex_);
-#endif
-    return cache_.clear();
+    cache_.clear();
 }
 
 bool mapped_memory_cache::insert(std::string const& uri, mapped_region_ptr mem)
 {
-#ifdef MAPNIK_THREADSAFE
-    mutex::scoped_lock lock(mutex_);
-#endif
-    return cache_.insert(std::make_pair(uri,mem)).second;
+    return cache_.insert(uri, mem, mem->get_size()).second;
 }
 
 boost::optional<mapped_region_ptr> mapped_memory_cache::find(std::string const& uri, bool update_cache)
 {
-#ifdef MAPNIK_THREADSAFE
-    mutex::scoped_lock lock(mutex_);
-#endif
-    typedef boost::unordered_map<std::string, mapped_region_ptr>::const_iterator iterator_type;
     boost::optional<mapped_region_ptr> result;
-    iterator_type itr = cache_.find(uri);
-    if (itr != cache_.end())
+    mapped_region_ptr cached;
+    if (cache_.find(uri, cached))
     {
-        result.reset(itr->second);
+        result.reset(cached);
         return result;
     }
 
+    // map the file without holding any cache lock
     boost::filesystem::path path(uri);
     if (exists(path))
     {
@@ -71,12 +64,12 @@ boost::optional<mapped_region_ptr> mapped_memory_cache::find(std::string const&
             file_mapping mapping(uri.c_str(),read_only);
             mapped_region_ptr region(boost::make_shared<mapped_region>(mapping,read_only));
 
-            result.reset(region);
-
             if (update_cache)
             {
-                cache_.insert(std::make_pair(uri,*result));
+                // another thread may have mapped the same file in the meantime
+                region = cache_.insert(uri, region, region->get_size()).first;
             }
+            result.reset(region);
             return result;
         }
         catch (...)
@@ -93,4 +86,34 @@ boost::optional<mapped_region_ptr> mapped_memory_cache::find(std::string const&
     return result;
 }
 
+void mapped_memory_cache::set_max_bytes(std::size_t max_bytes)
+{
+    cache_.set_max_bytes(max_bytes);
+}
+
+std::size_t mapped_memory_cache::max_bytes() const
+{
+    return cache_.max_bytes();
+}
+
+void mapped_memory_cache::set_max_entries(std::size_t max_entries)
+{
+    cache_.set_max_entries(max_entries);
+}
+
+std::size_t mapped_memory_cache::max_entries() const
+{
+    return cache_.max_entries();
+}
+
+mapped_memory_cache_stats mapped_memory_cache::stats() const
+{
+    return cache_.stats();
+}
+
+void mapped_memory_cache::reset_stats()
+{
+    cache_.reset_stats();
+}
+
 }
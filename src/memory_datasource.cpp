@@ -29,6 +29,7 @@
 
 // boost
 #include <boost/make_shared.hpp>
+#include <boost/ref.hpp>
 
 // stl
 #include <algorithm>
@@ -61,11 +62,43 @@ struct accumulate_extent
     bool first_;
 };
 
+namespace {
+
+box2d<double> feature_bounds(feature_impl const& feature, datasource::datasource_t type)
+{
+    box2d<double> result;
+    if (type == datasource::Raster)
+    {
+        raster_ptr const& source = feature.get_raster();
+        if (source) result = source->ext_;
+        return result;
+    }
+    for (unsigned i = 0; i < feature.num_geometries(); ++i)
+    {
+        box2d<double> const& box = feature.get_geometry(i).envelope();
+        if (!box.valid()) continue;
+        if (result.valid()) result.expand_to_include(box);
+        else result = box;
+    }
+    return result;
+}
+
+// unpacked features are scanned linearly, so repack once there are many of them
+bool needs_packing(packed_rtree const& index)
+{
+    return index.unpacked() > 1024 && index.unpacked() * 4 > index.size();
+}
+
+}
+
 memory_datasource::memory_datasource(datasource::datasource_t type, bool bbox_check)
     : datasource(parameters()),
       desc_("in-memory datasource","utf-8"),
       type_(type),
-      bbox_check_(bbox_check) {}
+      bbox_check_(bbox_check),
+      extent_(),
+      index_(),
+      indexed_(false) {}
 
 memory_datasource::~memory_datasource() {}
 
@@ -73,7 +106,14 @@ void memory_datasource::push(feature_ptr feature)
 {
     // TODO - collect attribute descriptors?
     //desc_.add_descriptor(attribute_descriptor(fld_name,mapnik::Integer));
+#ifdef MAPNIK_THREADSAFE
+    mutex::scoped_lock lock(mutex_);
+#endif
     features_.push_back(feature);
+    if (indexed_)
+    {
+        index_.insert(features_.size() - 1, feature_bounds(*feature, type_));
+    }
 }
 
 datasource::datasource_t memory_datasource::type() const
@@ -83,9 +123,40 @@ datasource::datasource_t memory_datasource::type() const
 
 featureset_ptr memory_datasource::features(const query& q) const
 {
+    if (bbox_check_)
+    {
+        return query_index(q.get_bbox());
+    }
     return boost::make_shared<memory_featureset>(q.get_bbox(),*this,bbox_check_);
 }
 
+featureset_ptr memory_datasource::query_index(box2d<double> const& box) const
+{
+    std::vector<std::size_t> candidates;
+    {
+#ifdef MAPNIK_THREADSAFE
+        mutex::scoped_lock lock(mutex_);
+#endif
+        if (!indexed_)
+        {
+            for (std::size_t i = 0; i < features_.size(); ++i)
+            {
+                index_.insert(i, feature_bounds(*features_[i], type_));
+            }
+            index_.build();
+            indexed_ = true;
+
+            MAPNIK_LOG_DEBUG(memory_datasource) << "memory_datasource: Indexed " << index_.size() << " of " << features_.size() << " features";
+        }
+        else if (needs_packing(index_))
+        {
+            index_.build();
+        }
+        index_.query(box, candidates);
+    }
+    return boost::make_shared<memory_featureset>(box,boost::cref(features_),boost::ref(candidates),type_);
+}
+
 
 featureset_ptr memory_datasource::features_at_point(coord2d const& pt, double tol) const
 {
@@ -93,7 +164,7 @@ featureset_ptr memory_datasource::features_at_point(coord2d const& pt, double to
 
     MAPNIK_LOG_DEBUG(memory_datasource) << "memory_datasource: Box=" << box << ", Point x=" << pt.x << ",y=" << pt.y;
 
-    return boost::make_shared<memory_featureset>(box,*this);
+    return query_index(box);
 }
 
 void memory_datasource::set_envelope(box2d<double> const& box)
@@ -129,7 +200,12 @@ size_t memory_datasource::size() const
 
 void memory_datasource::clear()
 {
+#ifdef MAPNIK_THREADSAFE
+    mutex::scoped_lock lock(mutex_);
+#endif
     features_.clear();
+    index_.clear();
+    indexed_ = false;
 }
 
 }
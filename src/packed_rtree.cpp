@@ -0,0 +1,186 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/packed_rtree.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace mapnik
+{
+
+namespace {
+
+template <typename Item>
+struct center_x_less
+{
+    bool operator() (Item const& a, Item const& b) const
+    {
+        return a.box.minx() + a.box.maxx() < b.box.minx() + b.box.maxx();
+    }
+};
+
+template <typename Item>
+struct center_y_less
+{
+    bool operator() (Item const& a, Item const& b) const
+    {
+        return a.box.miny() + a.box.maxy() < b.box.miny() + b.box.maxy();
+    }
+};
+
+}
+
+packed_rtree::packed_rtree(unsigned node_size)
+    : node_size_(node_size < 2 ? 2 : node_size),
+      items_(),
+      unpacked_(),
+      nodes_(),
+      level_offsets_() {}
+
+void packed_rtree::insert(std::size_t id, box2d<double> const& box)
+{
+    if (box.valid())
+    {
+        unpacked_.push_back(item(id, box));
+    }
+}
+
+void packed_rtree::build()
+{
+    items_.insert(items_.end(), unpacked_.begin(), unpacked_.end());
+    unpacked_.clear();
+    nodes_.clear();
+    level_offsets_.clear();
+
+    std::size_t count = items_.size();
+    if (count == 0) return;
+
+    // sort-tile-recursive: vertical slices of whole leaves, each sorted by y
+    std::size_t leaves = (count + node_size_ - 1) / node_size_;
+    std::size_t slices = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(leaves))));
+    std::size_t slice_size = slices * node_size_;
+    std::sort(items_.begin(), items_.end(), center_x_less<item>());
+    for (std::size_t first = 0; first < count; first += slice_size)
+    {
+        std::size_t last = std::min(first + slice_size, count);
+        std::sort(items_.begin() + first, items_.begin() + last, center_y_less<item>());
+    }
+
+    // first level bounds the leaves
+    level_offsets_.push_back(0);
+    for (std::size_t first = 0; first < count; first += node_size_)
+    {
+        std::size_t last = std::min(first + node_size_, count);
+        box2d<double> box = items_[first].box;
+        for (std::size_t i = first + 1; i < last; ++i)
+        {
+            box.expand_to_include(items_[i].box);
+        }
+        nodes_.push_back(box);
+    }
+    level_offsets_.push_back(nodes_.size());
+
+    // then group nodes until a single root is left
+    while (level_offsets_.back() - level_offsets_[level_offsets_.size() - 2] > 1)
+    {
+        std::size_t begin = level_offsets_[level_offsets_.size() - 2];
+        std::size_t end = level_offsets_.back();
+        for (std::size_t first = begin; first < end; first += node_size_)
+        {
+            std::size_t last = std::min(first + node_size_, end);
+            box2d<double> box = nodes_[first];
+            for (std::size_t i = first + 1; i < last; ++i)
+            {
+                box.expand_to_include(nodes_[i]);
+            }
+            nodes_.push_back(box);
+        }
+        level_offsets_.push_back(nodes_.size());
+    }
+}
+
+void packed_rtree::query(box2d<double> const& box, std::vector<std::size_t> & ids) const
+{
+    if (!nodes_.empty())
+    {
+        // (level, index within level), starting from the root
+        std::vector<std::pair<std::size_t, std::size_t> > stack;
+        stack.push_back(std::make_pair(level_offsets_.size() - 2, std::size_t(0)));
+        while (!stack.empty())
+        {
+            std::size_t level = stack.back().first;
+            std::size_t index = stack.back().second;
+            stack.pop_back();
+            if (!box.intersects(nodes_[level_offsets_[level] + index])) continue;
+
+            std::size_t first = index * node_size_;
+            if (level == 0)
+            {
+                std::size_t last = std::min(first + node_size_, items_.size());
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    if (box.intersects(items_[i].box)) ids.push_back(items_[i].id);
+                }
+            }
+            else
+            {
+                std::size_t children = level_offsets_[level] - level_offsets_[level - 1];
+                std::size_t last = std::min(first + node_size_, children);
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    stack.push_back(std::make_pair(level - 1, i));
+                }
+            }
+        }
+    }
+
+    std::vector<item>::const_iterator itr = unpacked_.begin();
+    std::vector<item>::const_iterator end = unpacked_.end();
+    for (; itr != end; ++itr)
+    {
+        if (box.intersects(itr->box)) ids.push_back(itr->id);
+    }
+}
+
+void packed_rtree::clear()
+{
+    items_.clear();
+    unpacked_.clear();
+    nodes_.clear();
+    level_offsets_.clear();
+}
+
+std::size_t packed_rtree::size() const
+{
+    return items_.size() + unpacked_.size();
+}
+
+std::size_t packed_rtree::unpacked() const
+{
+    return unpacked_.size();
+}
+
+}
@@ -106,6 +106,7 @@ placement_finder<DetectorT>::placement_finder(feature_impl const& feature,
     : detector_(detector),
       dimensions_(extent),
       info_(info),
+      text_(detector.find_text(info.get_string())),
       p(placement_info.properties),
       pi(placement_info),
       string_width_(0),
@@ -945,7 +946,7 @@ bool placement_finder<DetectorT>::test_placement(std::auto_ptr<text_path> const&
 
         if (!detector_.extent().intersects(e) ||
             (!p.allow_overlap &&
-             !detector_.has_placement(e, info_.get_string(), pi.get_actual_minimum_distance())
+             !detector_.has_placement(e, text_, pi.get_actual_minimum_distance())
                 )
             )
         {
@@ -1031,11 +1032,12 @@ template <typename DetectorT>
 void placement_finder<DetectorT>::update_detector()
 {
     if (collect_extents_) extents_.init(0,0,0,0);
+    if (!envelopes_.empty()) text_ = detector_.intern(info_.get_string());
     // add the bboxes to the detector and remove from the placement
     while (!envelopes_.empty())
     {
         box2d<double> e = envelopes_.front();
-        detector_.insert(e, info_.get_string());
+        detector_.insert(e, text_);
         envelopes_.pop();
 
         if (collect_extents_)
@@ -29,7 +29,14 @@ extern "C"
 #include <png.h>
 }
 
+// boost
 #include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/interprocess/streams/bufferstream.hpp>
+
+// stl
+#include <algorithm>
+#include <fstream>
 
 namespace mapnik
 {
@@ -37,12 +44,14 @@ class png_reader : public image_reader, mapnik::noncopyable
 {
 private:
     std::string fileName_;
+    boost::scoped_ptr<std::istream> stream_;
     unsigned width_;
     unsigned height_;
     int bit_depth_;
     int color_type_;
 public:
     explicit png_reader(std::string const& fileName);
+    png_reader(char const* data, std::size_t size);
     ~png_reader();
     unsigned width() const;
     unsigned height() const;
@@ -58,11 +67,44 @@ image_reader* create_png_reader(std::string const& file)
 {
     return new png_reader(file);
 }
+image_reader* create_png_reader_from_memory(char const* data, std::size_t size)
+{
+    return new png_reader(data, size);
+}
 const bool registered = register_image_reader("png",create_png_reader);
+const bool registered_memory = register_image_reader("png",create_png_reader_from_memory);
+
+// destroys the read structs however decoding ends
+struct png_struct_guard
+{
+    png_struct_guard(png_structp * png_ptr, png_infop * info_ptr)
+        : png_ptr_(png_ptr),
+          info_ptr_(info_ptr) {}
+
+    ~png_struct_guard()
+    {
+        png_destroy_read_struct(png_ptr_, info_ptr_, 0);
+    }
+    png_structp * png_ptr_;
+    png_infop * info_ptr_;
+};
 }
 
 png_reader::png_reader(std::string const& fileName)
     : fileName_(fileName),
+      stream_(new std::ifstream(fileName.c_str(), std::ios::in | std::ios::binary)),
+      width_(0),
+      height_(0),
+      bit_depth_(0),
+      color_type_(0)
+{
+    if (!*stream_) throw image_reader_exception("cannot open image file "+fileName_);
+    init();
+}
+
+png_reader::png_reader(char const* data, std::size_t size)
+    : fileName_("<memory>"),
+      stream_(new boost::interprocess::ibufferstream(data, size)),
       width_(0),
       height_(0),
       bit_depth_(0),
@@ -86,11 +128,9 @@ void user_warning_fn(png_structp png_ptr, png_const_charp warning_msg)
 static void
 png_read_data(png_structp png_ptr, png_bytep data, png_size_t length)
 {
-    png_size_t check;
-    check = (png_size_t)fread(data, (png_size_t)1, length,
-                              (FILE *)png_get_io_ptr(png_ptr));
-
-    if (check != length)
+    std::istream * stream = static_cast<std::istream *>(png_get_io_ptr(png_ptr));
+    stream->read(reinterpret_cast<char *>(data), length);
+    if (static_cast<png_size_t>(stream->gcount()) != length)
     {
         png_error(png_ptr, "Read Error");
     }
@@ -98,19 +138,16 @@ png_read_data(png_structp png_ptr, png_bytep data, png_size_t length)
 
 void png_reader::init()
 {
-    FILE *fp=fopen(fileName_.c_str(),"rb");
-    if (!fp) throw image_reader_exception("cannot open image file "+fileName_);
     png_byte header[8];
     memset(header,0,8);
-    if ( fread(header,1,8,fp) != 8)
+    stream_->read(reinterpret_cast<char *>(header), 8);
+    if (stream_->gcount() != 8)
     {
-        fclose(fp);
         throw image_reader_exception("Could not read " + fileName_);
     }
     int is_png=!png_sig_cmp(header,0,8);
     if (!is_png)
     {
-        fclose(fp);
         throw image_reader_exception(fileName_ + " is not a png file");
     }
     png_structp png_ptr = png_create_read_struct
@@ -118,32 +155,21 @@ void png_reader::init()
 
     if (!png_ptr)
     {
-        fclose(fp);
         throw image_reader_exception("failed to allocate png_ptr");
     }
 
     // catch errors in a custom way to avoid the need for setjmp
     png_set_error_fn(png_ptr, png_get_error_ptr(png_ptr), user_error_fn, user_warning_fn);
 
-    png_infop info_ptr;
-    try
-    {
-        info_ptr = png_create_info_struct(png_ptr);
-        if (!info_ptr)
-        {
-            png_destroy_read_struct(&png_ptr,0,0);
-            fclose(fp);
-            throw image_reader_exception("failed to create info_ptr");
-        }
-    }
-    catch (std::exception const& ex)
+    png_infop info_ptr = 0;
+    png_struct_guard guard(&png_ptr, &info_ptr);
+    info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr)
     {
-        png_destroy_read_struct(&png_ptr,0,0);
-        fclose(fp);
-        throw;
+        throw image_reader_exception("failed to create info_ptr");
     }
 
-    png_set_read_fn(png_ptr, (png_voidp)fp, png_read_data);
+    png_set_read_fn(png_ptr, (png_voidp)stream_.get(), png_read_data);
 
     png_set_sig_bytes(png_ptr,8);
     png_read_info(png_ptr, info_ptr);
@@ -155,9 +181,6 @@ void png_reader::init()
     height_=height;
 
     MAPNIK_LOG_DEBUG(png_reader) << "png_reader: bit_depth=" << bit_depth_ << ",color_type=" << color_type_;
-
-    png_destroy_read_struct(&png_ptr,&info_ptr,0);
-    fclose(fp);
 }
 
 unsigned png_reader::width() const
@@ -172,40 +195,32 @@ unsigned png_reader::height() const
 
 void png_reader::read(unsigned x0, unsigned y0,image_data_32& image)
 {
-    FILE *fp=fopen(fileName_.c_str(),"rb");
-    if (!fp) throw image_reader_exception("cannot open image file "+fileName_);
+    if (x0 >= width_ || y0 >= height_) return;
+
+    // the stream stays open between reads, start again from the signature
+    stream_->clear();
+    stream_->seekg(0, std::ios::beg);
 
     png_structp png_ptr = png_create_read_struct
         (PNG_LIBPNG_VER_STRING,0,0,0);
 
     if (!png_ptr)
     {
-        fclose(fp);
         throw image_reader_exception("failed to allocate png_ptr");
     }
 
     // catch errors in a custom way to avoid the need for setjmp
     png_set_error_fn(png_ptr, png_get_error_ptr(png_ptr), user_error_fn, user_warning_fn);
 
-    png_infop info_ptr;
-    try
-    {
-        info_ptr = png_create_info_struct(png_ptr);
-        if (!info_ptr)
-        {
-            png_destroy_read_struct(&png_ptr,0,0);
-            fclose(fp);
-            throw image_reader_exception("failed to create info_ptr");
-        }
-    }
-    catch (std::exception const& ex)
+    png_infop info_ptr = 0;
+    png_struct_guard guard(&png_ptr, &info_ptr);
+    info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr)
     {
-        png_destroy_read_struct(&png_ptr,0,0);
-        fclose(fp);
-        throw;
+        throw image_reader_exception("failed to create info_ptr");
     }
 
-    png_set_read_fn(png_ptr, (png_voidp)fp, png_read_data);
+    png_set_read_fn(png_ptr, (png_voidp)stream_.get(), png_read_data);
     png_read_info(png_ptr, info_ptr);
 
     if (color_type_ == PNG_COLOR_TYPE_PALETTE)
@@ -227,45 +242,55 @@ void png_reader::read(unsigned x0, unsigned y0,image_data_32& image)
     if (png_get_gAMA(png_ptr, info_ptr, &gamma))
         png_set_gamma(png_ptr, 2.2, gamma);
 
-    if (x0 == 0 && y0 == 0 && image.width() >= width_ && image.height() >= height_)
+    bool interlaced = png_get_interlace_type(png_ptr,info_ptr) == PNG_INTERLACE_ADAM7;
+    if (interlaced)
     {
+        png_set_interlace_handling(png_ptr); // FIXME: libpng bug?
+        // according to docs png_read_image
+        // "..automatically handles interlacing,
+        // so you don't need to call png_set_interlace_handling()"
+    }
+    png_read_update_info(png_ptr, info_ptr);
 
-        if (png_get_interlace_type(png_ptr,info_ptr) == PNG_INTERLACE_ADAM7)
-        {
-            png_set_interlace_handling(png_ptr); // FIXME: libpng bug?
-            // according to docs png_read_image
-            // "..automatically handles interlacing,
-            // so you don't need to call png_set_interlace_handling()"
-        }
-        png_read_update_info(png_ptr, info_ptr);
+    if (x0 == 0 && y0 == 0 && image.width() >= width_ && image.height() >= height_)
+    {
         // we can read whole image at once
         // alloc row pointers
         boost::scoped_array<png_byte*> rows(new png_bytep[height_]);
         for (unsigned i=0; i<height_; ++i)
             rows[i] = (png_bytep)image.getRow(i);
         png_read_image(png_ptr, rows.get());
+        png_read_end(png_ptr,0);
+        return;
+    }
+
+    unsigned w=std::min(unsigned(image.width()),width_ - x0);
+    unsigned h=std::min(unsigned(image.height()),height_ - y0);
+    if (interlaced)
+    {
+        // every pass touches every row, so the whole image has to be decoded
+        image_data_32 buffer(width_,height_);
+        boost::scoped_array<png_byte*> rows(new png_bytep[height_]);
+        for (unsigned i=0; i<height_; ++i)
+            rows[i] = (png_bytep)buffer.getRow(i);
+        png_read_image(png_ptr, rows.get());
+        for (unsigned i=0; i<h; ++i)
+        {
+            image.setRow(i,buffer.getRow(y0 + i) + x0,w);
+        }
     }
     else
     {
-        png_read_update_info(png_ptr, info_ptr);
-        unsigned w=std::min(unsigned(image.width()),width_);
-        unsigned h=std::min(unsigned(image.height()),height_);
-        unsigned rowbytes=png_get_rowbytes(png_ptr, info_ptr);
-        boost::scoped_array<png_byte> row(new png_byte[rowbytes]);
-        //START read image rows
-        for (unsigned i=0;i<height_;++i)
+        boost::scoped_array<unsigned> row(new unsigned[width_]);
+        // rows below the window are never decoded
+        for (unsigned i=0; i<y0 + h; ++i)
         {
-            png_read_row(png_ptr,row.get(),0);
-            if (i>=y0 && i<h)
+            png_read_row(png_ptr,reinterpret_cast<png_bytep>(row.get()),0);
+            if (i>=y0)
             {
-                image.setRow(i-y0,reinterpret_cast<unsigned*>(&row[x0]),w);
+                image.setRow(i-y0,row.get() + x0,w);
             }
         }
-        //END
     }
-
-    png_read_end(png_ptr,0);
-    png_destroy_read_struct(&png_ptr, &info_ptr,0);
-    fclose(fp);
 }
 }
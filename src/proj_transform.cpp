@@ -33,9 +33,48 @@
 
 // stl
 #include <vector>
+#include <cmath>
 
 namespace mapnik {
 
+#ifdef MAPNIK_USE_PROJ4
+namespace {
+
+// pj_transform over interleaved x,y pairs
+bool transform_xy(void * from, void * to, bool from_longlat, bool to_longlat,
+                  double * xy, std::size_t point_count)
+{
+    if (from_longlat)
+    {
+        for (std::size_t i = 0; i < point_count * 2; ++i)
+        {
+            xy[i] *= DEG_TO_RAD;
+        }
+    }
+
+    if (pj_transform(from, to, point_count, 2, xy, xy + 1, 0) != 0)
+    {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < point_count * 2; ++i)
+    {
+        if (xy[i] == HUGE_VAL) return false;
+    }
+
+    if (to_longlat)
+    {
+        for (std::size_t i = 0; i < point_count * 2; ++i)
+        {
+            xy[i] *= RAD_TO_DEG;
+        }
+    }
+    return true;
+}
+
+}
+#endif
+
 proj_transform::proj_transform(projection const& source,
                                projection const& dest)
     : source_(source),
@@ -113,7 +152,7 @@ bool proj_transform::forward (double * x, double * y , double * z, int point_cou
         }
     }
 
-    if (pj_transform( source_.proj_, dest_.proj_, point_count,
+    if (pj_transform( source_.proj(), dest_.proj(), point_count,
                       0, x,y,z) != 0)
     {
         return false;
@@ -155,7 +194,7 @@ bool proj_transform::backward (double * x, double * y , double * z, int point_co
         }
     }
 
-    if (pj_transform( dest_.proj_, source_.proj_, point_count,
+    if (pj_transform( dest_.proj(), source_.proj(), point_count,
                       0, x,y,z) != 0)
     {
         return false;
@@ -311,6 +350,60 @@ bool proj_transform::forward(box2d<double>& env, int points) const
     return true;
 }
 
+// WGS84 <-> spherical mercator goes through the vectorized bulk
+// conversions, everything else through one pj_transform call
+bool proj_transform::forward (geometry_type & geom) const
+{
+    if (is_source_equal_dest_ || geom.size() == 0)
+        return true;
+
+    bool result = true;
+    if (wgs84_to_merc_)
+    {
+        lonlat2merc_bulk(geom.coords(), geom.size());
+    }
+    else if (merc_to_wgs84_)
+    {
+        merc2lonlat_bulk(geom.coords(), geom.size());
+    }
+#ifdef MAPNIK_USE_PROJ4
+    else
+    {
+        result = transform_xy(source_.proj(), dest_.proj(),
+                              is_source_longlat_, is_dest_longlat_,
+                              geom.coords(), geom.size());
+    }
+#endif
+    geom.update_envelope();
+    return result;
+}
+
+bool proj_transform::backward (geometry_type & geom) const
+{
+    if (is_source_equal_dest_ || geom.size() == 0)
+        return true;
+
+    bool result = true;
+    if (wgs84_to_merc_)
+    {
+        merc2lonlat_bulk(geom.coords(), geom.size());
+    }
+    else if (merc_to_wgs84_)
+    {
+        lonlat2merc_bulk(geom.coords(), geom.size());
+    }
+#ifdef MAPNIK_USE_PROJ4
+    else
+    {
+        result = transform_xy(dest_.proj(), source_.proj(),
+                              is_dest_longlat_, is_source_longlat_,
+                              geom.coords(), geom.size());
+    }
+#endif
+    geom.update_envelope();
+    return result;
+}
+
 mapnik::projection const& proj_transform::source() const
 {
     return source_;
@@ -35,6 +35,65 @@
 static boost::mutex mutex_;
 #endif
 
+#if defined(MAPNIK_THREADSAFE) && PJ_VERSION >= 480
+#define MAPNIK_THREAD_LOCAL_PROJ
+#include <mapnik/noncopyable.hpp>
+// boost
+#include <boost/thread/tss.hpp>
+// stl
+#include <map>
+
+namespace {
+
+// Every thread initializes its own proj4 objects in its own context and
+// keeps them for its lifetime. Projections can then be used from any thread
+// without locking, and each definition (including +init file lookups) is
+// parsed once per thread instead of once per projection object.
+struct thread_projections : private mapnik::noncopyable
+{
+    typedef std::map<std::string, projPJ> proj_map;
+
+    thread_projections()
+        : ctx(pj_ctx_alloc()),
+          projs() {}
+
+    ~thread_projections()
+    {
+        for (proj_map::iterator itr = projs.begin(); itr != projs.end(); ++itr)
+        {
+            if (itr->second) pj_free(itr->second);
+        }
+        pj_ctx_free(ctx);
+    }
+
+    projCtx ctx;
+    proj_map projs;
+};
+
+boost::thread_specific_ptr<thread_projections> thread_projections_;
+
+projPJ thread_proj(std::string const& params)
+{
+    thread_projections * cache = thread_projections_.get();
+    if (!cache)
+    {
+        cache = new thread_projections;
+        thread_projections_.reset(cache);
+    }
+    thread_projections::proj_map::const_iterator itr = cache->projs.find(params);
+    if (itr != cache->projs.end())
+    {
+        return itr->second;
+    }
+    // invalid definitions are remembered too
+    projPJ proj = pj_init_plus_ctx(cache->ctx, params.c_str());
+    cache->projs.insert(std::make_pair(params, proj));
+    return proj;
+}
+
+}
+#endif
+
 #endif
 
 namespace mapnik {
@@ -93,7 +152,12 @@ void projection::init_proj4() const
 #ifdef MAPNIK_USE_PROJ4
     if (!proj_)
     {
-#if PJ_VERSION >= 480
+#if defined(MAPNIK_THREAD_LOCAL_PROJ)
+        // owned by the calling thread, only used from here on to tell
+        // whether the definition is valid
+        proj_ = thread_proj(params_);
+        if (!proj_) throw proj_init_error(params_);
+#elif PJ_VERSION >= 480
         proj_ctx_ = pj_ctx_alloc();
         proj_ = pj_init_plus_ctx(proj_ctx_, params_.c_str());
         if (!proj_)
@@ -146,7 +210,7 @@ void projection::forward(double & x, double &y ) const
     projUV p;
     p.u = x * DEG_TO_RAD;
     p.v = y * DEG_TO_RAD;
-    p = pj_fwd(p,proj_);
+    p = pj_fwd(p,proj());
     x = p.u;
     y = p.v;
     if (is_geographic_)
@@ -178,7 +242,7 @@ void projection::inverse(double & x,double & y) const
     projUV p;
     p.u = x;
     p.v = y;
-    p = pj_inv(p,proj_);
+    p = pj_inv(p,proj());
     x = RAD_TO_DEG * p.u;
     y = RAD_TO_DEG * p.v;
 #else
@@ -188,7 +252,7 @@ void projection::inverse(double & x,double & y) const
 
 projection::~projection()
 {
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ4) && !defined(MAPNIK_THREAD_LOCAL_PROJ)
     #if defined(MAPNIK_THREADSAFE) && PJ_VERSION < 480
         mutex::scoped_lock lock(mutex_);
     #endif
@@ -199,10 +263,18 @@ projection::~projection()
 #endif
 }
 
+void * projection::proj() const
+{
+#if defined(MAPNIK_THREAD_LOCAL_PROJ)
+    if (proj_) return thread_proj(params_);
+#endif
+    return proj_;
+}
+
 std::string projection::expanded() const
 {
 #ifdef MAPNIK_USE_PROJ4
-    if (proj_) return mapnik::util::trim_copy(pj_get_def( proj_, 0 ));
+    if (proj_) return mapnik::util::trim_copy(pj_get_def( proj(), 0 ));
 #endif
     return params_;
 }
@@ -210,6 +282,10 @@ std::string projection::expanded() const
 void projection::swap(projection& rhs)
 {
     std::swap(params_,rhs.params_);
+    std::swap(defer_proj_init_,rhs.defer_proj_init_);
+    std::swap(is_geographic_,rhs.is_geographic_);
+    std::swap(proj_,rhs.proj_);
+    std::swap(proj_ctx_,rhs.proj_ctx_);
 }
 
 }
@@ -31,6 +31,7 @@
 // stl
 #include <limits>
 #include <cmath>
+#include <algorithm>
 
 namespace mapnik
 {
@@ -137,14 +138,51 @@ void raster_colorizer::colorize(raster_ptr const& raster, feature_impl const& f)
         noDataValue = static_cast<float>(f.get("NODATA").to_double());
     }
 
+    unsigned const nodata_rgba = color(0,0,0,0).rgba();
+    if (stops_.empty())
+    {
+        unsigned const rgba = default_color_.rgba();
+        for (int i=0; i<len; ++i)
+        {
+            float value = *reinterpret_cast<float *> (&imageData[i]);
+            imageData[i] = (hasNoData && noDataValue == value) ? nodata_rgba : rgba;
+        }
+        return;
+    }
+
+    // get_color() uses the first stop greater than the value, which is also
+    // the first position where the running maximum of the stop values is
+    // greater, so the stops can be binary searched even if they are unordered
+    std::vector<float> bounds(stops_.size());
+    bounds[0] = stops_[0].get_value();
+    for (std::size_t i = 1; i < stops_.size(); ++i)
+    {
+        bounds[i] = std::max(bounds[i-1], stops_[i].get_value());
+    }
+
+    // neighbouring pixels often share a value (flat areas, nodata, integer elevations)
+    float last_value = std::numeric_limits<float>::quiet_NaN();
+    unsigned last_rgba = 0;
     for (int i=0; i<len; ++i)
     {
         // the GDAL plugin reads single bands as floats
         float value = *reinterpret_cast<float *> (&imageData[i]);
         if (hasNoData && noDataValue == value)
-            imageData[i] = color(0,0,0,0).rgba();
+        {
+            imageData[i] = nodata_rgba;
+        }
+        else if (value == last_value)
+        {
+            imageData[i] = last_rgba;
+        }
         else
-            imageData[i] = get_color(value).rgba();
+        {
+            // nan is not less than any stop and ends up past the last one, like in get_color()
+            int stopIdx = static_cast<int>(std::upper_bound(bounds.begin(), bounds.end(), value) - bounds.begin()) - 1;
+            last_rgba = get_color(value, stopIdx).rgba();
+            last_value = value;
+            imageData[i] = last_rgba;
+        }
     }
 }
 
@@ -182,6 +220,13 @@ color raster_colorizer::get_color(float value) const
         stopIdx = stopCount-1;
     }
 
+    return get_color(value, stopIdx);
+}
+
+color raster_colorizer::get_color(float value, int stopIdx) const
+{
+    int stopCount = stops_.size();
+
     //2 - Find the next stop
     int nextStopIdx = stopIdx + 1;
     if(nextStopIdx >= stopCount)
@@ -0,0 +1,95 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/raster_tile_cache.hpp>
+
+// boost
+#include <boost/functional/hash.hpp>
+
+namespace mapnik
+{
+
+std::size_t hash_value(raster_tile_key const& key)
+{
+    std::size_t seed = boost::hash<std::string>()(key.file);
+    boost::hash_combine(seed, key.x);
+    boost::hash_combine(seed, key.y);
+    boost::hash_combine(seed, key.width);
+    boost::hash_combine(seed, key.height);
+    return seed;
+}
+
+namespace {
+
+std::size_t entry_bytes(image_data_32 const& tile)
+{
+    return sizeof(image_data_32) + tile.width() * tile.height() * sizeof(image_data_32::pixel_type);
+}
+
+}
+
+raster_tile_cache::raster_tile_cache()
+    : cache_(64 * 1024 * 1024) {}
+
+raster_tile_ptr raster_tile_cache::find(raster_tile_key const& key)
+{
+    raster_tile_ptr tile;
+    cache_.find(key, tile);
+    return tile;
+}
+
+void raster_tile_cache::insert(raster_tile_key const& key, raster_tile_ptr const& tile)
+{
+    // zero budgets are unlimited for the underlying cache
+    if (cache_.max_bytes() == 0) return;
+    cache_.insert(key, tile, entry_bytes(*tile));
+}
+
+void raster_tile_cache::clear()
+{
+    cache_.clear();
+}
+
+void raster_tile_cache::set_max_bytes(std::size_t max_bytes)
+{
+    cache_.set_max_bytes(max_bytes);
+    if (max_bytes == 0) cache_.clear();
+}
+
+std::size_t raster_tile_cache::max_bytes() const
+{
+    return cache_.max_bytes();
+}
+
+raster_tile_cache_stats raster_tile_cache::stats() const
+{
+    return cache_.stats();
+}
+
+void raster_tile_cache::reset_stats()
+{
+    cache_.reset_stats();
+}
+
+}
@@ -0,0 +1,102 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/rendering_stats.hpp>
+
+// stl
+#include <iomanip>
+#include <sstream>
+
+namespace mapnik
+{
+
+std::size_t layer_stats::features_queried() const
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < styles.size(); ++i)
+    {
+        count += styles[i].features_queried;
+    }
+    return count;
+}
+
+std::size_t layer_stats::features_rendered() const
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < styles.size(); ++i)
+    {
+        count += styles[i].features_rendered;
+    }
+    return count;
+}
+
+rendering_stats::rendering_stats()
+    : total_time(0),
+      layers() {}
+
+void rendering_stats::clear()
+{
+    total_time = 0;
+    layers.clear();
+}
+
+layer_stats const* rendering_stats::slowest_layer() const
+{
+    layer_stats const* slowest = 0;
+    for (std::size_t i = 0; i < layers.size(); ++i)
+    {
+        if (!slowest || layers[i].render_time > slowest->render_time)
+        {
+            slowest = &layers[i];
+        }
+    }
+    return slowest;
+}
+
+std::string rendering_stats::to_string() const
+{
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(2);
+    for (std::size_t i = 0; i < layers.size(); ++i)
+    {
+        layer_stats const& lyr = layers[i];
+        s << std::setw(10) << lyr.render_time << "ms | layer '" << lyr.name
+          << "' (query " << lyr.query_time << "ms)\n";
+        for (std::size_t j = 0; j < lyr.styles.size(); ++j)
+        {
+            style_stats const& st = lyr.styles[j];
+            s << std::setw(10) << st.render_time << "ms |   style '" << st.name
+              << "': " << st.features_rendered << " of " << st.features_queried << " features rendered"
+              << " (query " << st.query_time << "ms, symbolizers " << st.symbolizer_time << "ms";
+            if (st.label_attempts > 0)
+            {
+                s << ", " << st.labels_placed << " labels placed in " << st.label_attempts << " attempts";
+            }
+            s << ")\n";
+        }
+    }
+    s << std::setw(10) << total_time << "ms | total map rendering\n";
+    return s.str();
+}
+
+}
@@ -0,0 +1,213 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/rule_cache.hpp>
+#include <mapnik/expression_node.hpp>
+
+// boost
+#include <boost/variant/get.hpp>
+
+namespace mapnik
+{
+
+namespace {
+
+// dispatching only pays off once several rules test the same attribute
+static const std::size_t min_indexed_rules = 2;
+
+value_unicode_string const* string_constant(expr_node const& node)
+{
+    value_type const* val = boost::get<value_type>(&node);
+    return val ? boost::get<value_unicode_string>(&val->base()) : 0;
+}
+
+// matches `[attr] = 'string'` and `'string' = [attr]`
+bool is_string_equality(expr_node const& expr, std::string & name, value_unicode_string & str)
+{
+    binary_node<tags::equal_to> const* eq = boost::get<binary_node<tags::equal_to> >(&expr);
+    if (!eq) return false;
+    attribute const* attr = boost::get<attribute>(&eq->left);
+    value_unicode_string const* constant = string_constant(eq->right);
+    if (!attr || !constant)
+    {
+        attr = boost::get<attribute>(&eq->right);
+        constant = string_constant(eq->left);
+    }
+    if (!attr || !constant) return false;
+    name = attr->name();
+    str = *constant;
+    return true;
+}
+
+}
+
+const std::size_t rule_cache::no_match;
+
+rule_cache::rule_cache()
+    : if_rules_(),
+      else_rules_(),
+      also_rules_(),
+      filters_(),
+      filter_ids_(),
+      equality_rules_(),
+      attribute_ids_(),
+      indexed_(false),
+      key_id_(0),
+      table_(),
+      residual_(),
+      candidates_(0),
+      candidate_pos_(0),
+      residual_pos_(0) {}
+
+void rule_cache::add_rule(rule const& r)
+{
+    if (r.has_else_filter())
+    {
+        else_rules_.push_back(&r);
+    }
+    else if (r.has_also_filter())
+    {
+        also_rules_.push_back(&r);
+    }
+    else
+    {
+        std::size_t index = if_rules_.size();
+        if_rules_.push_back(&r);
+        expr_node const& filter = *r.get_filter();
+        // filters of all rules are compiled together so that
+        // shared subexpressions are evaluated once per feature
+        filter_ids_.push_back(filters_.compile(filter));
+
+        std::string name;
+        value_unicode_string str;
+        if (is_string_equality(filter, name, str))
+        {
+            equality_rules_[name].push_back(std::make_pair(index, str));
+            if (attribute_ids_.find(name) == attribute_ids_.end())
+            {
+                attribute_ids_.insert(std::make_pair(name, filters_.compile(attribute(name))));
+            }
+        }
+        indexed_ = false;
+    }
+}
+
+void rule_cache::build_index() const
+{
+    table_.clear();
+    residual_.clear();
+
+    // index the attribute tested by most rules
+    typedef std::map<std::string, std::vector<std::pair<std::size_t, value_unicode_string> > > equality_map;
+    equality_map::const_iterator best = equality_rules_.end();
+    for (equality_map::const_iterator itr = equality_rules_.begin(); itr != equality_rules_.end(); ++itr)
+    {
+        if (best == equality_rules_.end() || itr->second.size() > best->second.size())
+        {
+            best = itr;
+        }
+    }
+
+    std::vector<bool> indexed(if_rules_.size(), false);
+    if (best != equality_rules_.end() && best->second.size() >= min_indexed_rules)
+    {
+        key_id_ = attribute_ids_.find(best->first)->second;
+        for (std::size_t i = 0; i < best->second.size(); ++i)
+        {
+            // rules are added in order, so every list stays sorted
+            table_[best->second[i].second].push_back(best->second[i].first);
+            indexed[best->second[i].first] = true;
+        }
+    }
+    for (std::size_t i = 0; i < if_rules_.size(); ++i)
+    {
+        if (!indexed[i]) residual_.push_back(i);
+    }
+    indexed_ = true;
+}
+
+void rule_cache::bind(feature_impl const& feature) const
+{
+    if (!indexed_)
+    {
+        build_index();
+    }
+    filters_.bind(feature);
+    candidates_ = 0;
+    candidate_pos_ = 0;
+    residual_pos_ = 0;
+    if (!table_.empty())
+    {
+        // a string equality can only hold for a string attribute value
+        value_unicode_string const* key = boost::get<value_unicode_string>(&filters_.value(key_id_).base());
+        if (key)
+        {
+            dispatch_table::const_iterator itr = table_.find(*key);
+            if (itr != table_.end())
+            {
+                candidates_ = &itr->second;
+            }
+        }
+    }
+}
+
+std::size_t rule_cache::next_match(std::size_t start) const
+{
+    std::size_t next_candidate = no_match;
+    if (candidates_)
+    {
+        while (candidate_pos_ < candidates_->size() && (*candidates_)[candidate_pos_] < start)
+        {
+            ++candidate_pos_;
+        }
+        if (candidate_pos_ < candidates_->size())
+        {
+            next_candidate = (*candidates_)[candidate_pos_];
+        }
+    }
+    while (residual_pos_ < residual_.size() && residual_[residual_pos_] < start)
+    {
+        ++residual_pos_;
+    }
+    // residual rules preceding the next candidate need their filter evaluated
+    for (; residual_pos_ < residual_.size() && residual_[residual_pos_] < next_candidate; ++residual_pos_)
+    {
+        std::size_t index = residual_[residual_pos_];
+        if (match(index))
+        {
+            return index;
+        }
+    }
+    return next_candidate;
+}
+
+std::size_t rule_cache::indexed_rules() const
+{
+    if (!indexed_)
+    {
+        build_index();
+    }
+    return if_rules_.size() - residual_.size();
+}
+
+}
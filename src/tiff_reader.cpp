@@ -23,10 +23,16 @@
 // mapnik
 #include <mapnik/debug.hpp>
 #include <mapnik/image_reader.hpp>
+#include <mapnik/raster_tile_cache.hpp>
 // boost
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/scoped_array.hpp>
 #include <boost/filesystem/operations.hpp>
 
+// stl
+#include <cstring>
+
 extern "C"
 {
 #include <tiffio.h>
@@ -38,6 +44,19 @@ namespace mapnik
 using std::min;
 using std::max;
 
+namespace
+{
+// encoded image handed to libtiff through TIFFClientOpen
+struct memory_source
+{
+    memory_source(char const* d, std::size_t s)
+        : data(d), size(s), pos(0) {}
+    char const* data;
+    std::size_t size;
+    std::size_t pos;
+};
+}
+
 class tiff_reader : public image_reader
 {
     typedef boost::shared_ptr<TIFF> tiff_ptr;
@@ -54,10 +73,11 @@ class tiff_reader : public image_reader
 
 private:
     std::string file_name_;
+    boost::shared_ptr<memory_source> memory_;
     int read_method_;
     unsigned width_;
     unsigned height_;
-    int rows_per_strip_;
+    unsigned rows_per_strip_;
     int tile_width_;
     int tile_height_;
     tiff_ptr tif_;
@@ -69,6 +89,7 @@ public:
         tiled
     };
     explicit tiff_reader(std::string const& file_name);
+    tiff_reader(char const* data, std::size_t size);
     virtual ~tiff_reader();
     unsigned width() const;
     unsigned height() const;
@@ -91,11 +112,79 @@ image_reader* create_tiff_reader(std::string const& file)
     return new tiff_reader(file);
 }
 
+image_reader* create_tiff_reader_from_memory(char const* data, std::size_t size)
+{
+    return new tiff_reader(data, size);
+}
+
 const bool registered = register_image_reader("tiff",create_tiff_reader);
+const bool registered_memory = register_image_reader("tiff",create_tiff_reader_from_memory);
+
+tsize_t memory_read(thandle_t handle, tdata_t buf, tsize_t size)
+{
+    memory_source * src = static_cast<memory_source *>(handle);
+    std::size_t count = min(static_cast<std::size_t>(size), src->size - src->pos);
+    std::memcpy(buf, src->data + src->pos, count);
+    src->pos += count;
+    return static_cast<tsize_t>(count);
+}
+
+tsize_t memory_write(thandle_t, tdata_t, tsize_t)
+{
+    return 0;
+}
+
+toff_t memory_seek(thandle_t handle, toff_t offset, int whence)
+{
+    memory_source * src = static_cast<memory_source *>(handle);
+    std::size_t pos = static_cast<std::size_t>(offset);
+    if (whence == SEEK_CUR) pos += src->pos;
+    else if (whence == SEEK_END) pos += src->size;
+    src->pos = min(pos, src->size);
+    return static_cast<toff_t>(src->pos);
+}
+
+int memory_close(thandle_t)
+{
+    return 0;
+}
+
+toff_t memory_size(thandle_t handle)
+{
+    return static_cast<toff_t>(static_cast<memory_source *>(handle)->size);
+}
+
+// lets libtiff decode straight from the buffer, like a mapped file
+int memory_map(thandle_t handle, tdata_t * base, toff_t * size)
+{
+    memory_source * src = static_cast<memory_source *>(handle);
+    *base = const_cast<char *>(src->data);
+    *size = static_cast<toff_t>(src->size);
+    return 1;
+}
+
+void memory_unmap(thandle_t, tdata_t, toff_t)
+{
+}
 }
 
 tiff_reader::tiff_reader(std::string const& file_name)
     : file_name_(file_name),
+      memory_(),
+      read_method_(generic),
+      width_(0),
+      height_(0),
+      rows_per_strip_(0),
+      tile_width_(0),
+      tile_height_(0),
+      premultiplied_alpha_(false)
+{
+    init();
+}
+
+tiff_reader::tiff_reader(char const* data, std::size_t size)
+    : file_name_(),
+      memory_(boost::make_shared<memory_source>(data, size)),
       read_method_(generic),
       width_(0),
       height_(0),
@@ -113,7 +202,11 @@ void tiff_reader::init()
     // TODO: error handling
     TIFFSetWarningHandler(0);
     TIFF* tif = load_if_exists(file_name_);
-    if (!tif) throw image_reader_exception( std::string("Can't load tiff file: '") + file_name_ + "'");
+    if (!tif)
+    {
+        if (memory_) throw image_reader_exception("Can't load tiff from memory");
+        throw image_reader_exception( std::string("Can't load tiff file: '") + file_name_ + "'");
+    }
 
     char msg[1024];
 
@@ -200,43 +293,61 @@ void tiff_reader::read_generic(unsigned /*x*/,unsigned /*y*/,image_data_32& /*im
 void tiff_reader::read_tiled(unsigned x0,unsigned y0,image_data_32& image)
 {
     TIFF* tif = load_if_exists(file_name_);
-    if (tif)
+    if (tif && x0 < width_ && y0 < height_)
     {
-        uint32* buf = (uint32*)_TIFFmalloc(tile_width_*tile_height_*sizeof(uint32));
-        int width=image.width();
-        int height=image.height();
-
-        int start_y=(y0/tile_height_)*tile_height_;
-        int end_y=((y0+height)/tile_height_+1)*tile_height_;
+        unsigned end_x = min(x0 + image.width(), width_);
+        unsigned end_y = min(y0 + image.height(), height_);
 
-        int start_x=(x0/tile_width_)*tile_width_;
-        int end_x=((x0+width)/tile_width_+1)*tile_width_;
-        int row,tx0,tx1,ty0,ty1;
+        // decoded tiles of files are shared between readers and renders,
+        // tiles of in-memory images have no stable key
+        raster_tile_cache & cache = raster_tile_cache::instance();
+        bool use_cache = !memory_ && cache.max_bytes() > 0;
+        boost::scoped_array<uint32> buf;
 
-        for (int y=start_y;y<end_y;y+=tile_height_)
+        for (unsigned y = (y0 / tile_height_) * tile_height_; y < end_y; y += tile_height_)
         {
-            ty0 = max(y0,(unsigned)y) - y;
-            ty1 = min(height+y0,(unsigned)(y+tile_height_)) - y;
+            // rows of the window within this row of tiles
+            unsigned ty0 = max(y0, y) - y;
+            unsigned ty1 = min(end_y, y + tile_height_) - y;
 
-            int n0=tile_height_-ty1;
-            int n1=tile_height_-ty0-1;
-
-            for (int x=start_x;x<end_x;x+=tile_width_)
+            for (unsigned x = (x0 / tile_width_) * tile_width_; x < end_x; x += tile_width_)
             {
+                unsigned tx0 = max(x0, x);
+                unsigned tx1 = min(end_x, x + tile_width_);
+                raster_tile_key key(file_name_, x, y, tile_width_, tile_height_);
+                raster_tile_ptr tile;
+                if (use_cache) tile = cache.find(key);
 
-                if (!TIFFReadRGBATile(tif,x,y,buf)) break;
+                if (!tile)
+                {
+                    if (!buf) buf.reset(new uint32[tile_width_ * tile_height_]);
+                    if (!TIFFReadRGBATile(tif, x, y, buf.get())) continue;
+
+                    // TIFFReadRGBATile returns rows bottom up
+                    if (!use_cache)
+                    {
+                        for (unsigned ty = ty0; ty < ty1; ++ty)
+                        {
+                            image.setRow(y + ty - y0, tx0 - x0, tx1 - x0,
+                                         reinterpret_cast<unsigned const*>(&buf[(tile_height_ - ty - 1) * tile_width_ + tx0 - x]));
+                        }
+                        continue;
+                    }
+                    boost::shared_ptr<image_data_32> decoded = boost::make_shared<image_data_32>(tile_width_, tile_height_);
+                    for (int ty = 0; ty < tile_height_; ++ty)
+                    {
+                        decoded->setRow(ty, reinterpret_cast<unsigned const*>(&buf[(tile_height_ - ty - 1) * tile_width_]), tile_width_);
+                    }
+                    cache.insert(key, decoded);
+                    tile = decoded;
+                }
 
-                tx0=max(x0,(unsigned)x);
-                tx1=min(width+x0,(unsigned)(x+tile_width_));
-                row=y+ty0-y0;
-                for (int n=n1;n>=n0;--n)
+                for (unsigned ty = ty0; ty < ty1; ++ty)
                 {
-                    image.setRow(row,tx0-x0,tx1-x0,(const unsigned*)&buf[n*tile_width_+tx0-x]);
-                    ++row;
+                    image.setRow(y + ty - y0, tx0 - x0, tx1 - x0, tile->getRow(ty) + tx0 - x);
                 }
             }
         }
-        _TIFFfree(buf);
     }
 }
 
@@ -244,39 +355,31 @@ void tiff_reader::read_tiled(unsigned x0,unsigned y0,image_data_32& image)
 void tiff_reader::read_stripped(unsigned x0,unsigned y0,image_data_32& image)
 {
     TIFF* tif = load_if_exists(file_name_);
-    if (tif)
+    if (tif && x0 < width_ && y0 < height_)
     {
-        uint32* buf = (uint32*)_TIFFmalloc(width_*rows_per_strip_*sizeof(uint32));
-
-        int width=image.width();
-        int height=image.height();
-
-        unsigned start_y=(y0/rows_per_strip_)*rows_per_strip_;
-        unsigned end_y=((y0+height)/rows_per_strip_+1)*rows_per_strip_;
-        bool laststrip=((unsigned)end_y > height_)?true:false;
-        int row,tx0,tx1,ty0,ty1;
+        // a single strip may be tagged as 2^32-1 rows
+        unsigned rows_per_strip = min(rows_per_strip_, height_);
+        boost::scoped_array<uint32> buf(new uint32[width_ * rows_per_strip]);
 
-        tx0=x0;
-        tx1=min(width+x0,(unsigned)width_);
+        unsigned end_x = min(x0 + image.width(), width_);
+        unsigned end_y = min(y0 + image.height(), height_);
 
-        for (unsigned y=start_y; y < end_y; y+=rows_per_strip_)
+        for (unsigned y = (y0 / rows_per_strip) * rows_per_strip; y < end_y; y += rows_per_strip)
         {
-            ty0 = max(y0,y)-y;
-            ty1 = min(height+y0,y+rows_per_strip_)-y;
+            // rows of the window within this strip
+            unsigned ty0 = max(y0, y) - y;
+            unsigned ty1 = min(end_y, y + rows_per_strip) - y;
+            unsigned rows = min(height_ - y, rows_per_strip);
 
-            if (!TIFFReadRGBAStrip(tif,y,buf)) break;
+            if (!TIFFReadRGBAStrip(tif, y, buf.get())) break;
 
-            row=y+ty0-y0;
-
-            int n0=laststrip ? 0:(rows_per_strip_-ty1);
-            int n1=laststrip ? (ty1-ty0-1):(rows_per_strip_-ty0-1);
-            for (int n=n1;n>=n0;--n)
+            // TIFFReadRGBAStrip returns rows bottom up
+            for (unsigned ty = ty0; ty < ty1; ++ty)
             {
-                image.setRow(row,tx0-x0,tx1-x0,(const unsigned*)&buf[n*width_+tx0]);
-                ++row;
+                image.setRow(y + ty - y0, 0, end_x - x0,
+                             reinterpret_cast<unsigned const*>(&buf[(rows - ty - 1) * width_ + x0]));
             }
         }
-        _TIFFfree(buf);
     }
 }
 
@@ -284,6 +387,15 @@ TIFF* tiff_reader::load_if_exists(std::string const& filename)
 {
     if (!tif_)
     {
+        if (memory_)
+        {
+            memory_->pos = 0;
+            tif_ = tiff_ptr(TIFFClientOpen("<memory>", "rb", memory_.get(),
+                                           memory_read, memory_write, memory_seek,
+                                           memory_close, memory_size,
+                                           memory_map, memory_unmap), tiff_closer());
+            return tif_.get();
+        }
         boost::filesystem::path path(file_name_);
         if (boost::filesystem::is_regular(path)) // exists and regular file
         {
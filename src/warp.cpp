@@ -29,6 +29,19 @@
 #include <mapnik/ctrans.hpp>
 #include <mapnik/raster.hpp>
 #include <mapnik/proj_transform.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/warp_mesh_cache.hpp>
+
+// boost
+#include <boost/make_shared.hpp>
+#ifdef MAPNIK_THREADSAFE
+#include <boost/thread/thread.hpp>
+#endif
+
+// stl
+#include <vector>
+#include <algorithm>
+#include <cmath>
 
 // agg
 #include "agg_image_filters.h"
@@ -43,68 +56,166 @@
 #include "agg_renderer_scanline.h"
 #include "agg_span_allocator.h"
 #include "agg_image_accessors.h"
-#include "agg_renderer_scanline.h"
 
 namespace mapnik {
 
-void reproject_and_scale_raster(raster & target, raster const& source,
-                                proj_transform const& prj_trans,
-                                double offset_x, double offset_y,
-                                unsigned mesh_size,
-                                double filter_radius,
-                                scaling_method_e scaling_method)
+namespace {
+
+// projects the source pixel grid every mesh_size pixels to the target srs
+warp_mesh_ptr projected_mesh(raster const& source,
+                             proj_transform const& prj_trans,
+                             unsigned mesh_size)
 {
+    warp_mesh_key key;
+    key.source_srs = prj_trans.source().params();
+    key.dest_srs = prj_trans.dest().params();
+    key.ext = source.ext_;
+    key.width = source.data_.width();
+    key.height = source.data_.height();
+    key.mesh_size = mesh_size;
+
+    warp_mesh_cache & cache = warp_mesh_cache::instance();
+    warp_mesh_ptr cached = cache.find(key);
+    if (cached)
+    {
+        return cached;
+    }
+
     CoordTransform ts(source.data_.width(), source.data_.height(),
                       source.ext_);
-    CoordTransform tt(target.data_.width(), target.data_.height(),
-                      target.ext_, offset_x, offset_y);
-    unsigned i, j;
     unsigned mesh_nx = std::ceil(source.data_.width()/double(mesh_size) + 1);
     unsigned mesh_ny = std::ceil(source.data_.height()/double(mesh_size) + 1);
+    boost::shared_ptr<warp_mesh> mesh = boost::make_shared<warp_mesh>(mesh_nx, mesh_ny);
+    for (unsigned j=0; j<mesh_ny; ++j)
+    {
+        for (unsigned i=0; i<mesh_nx; ++i)
+        {
+            double & x = mesh->xs[j * mesh_nx + i];
+            double & y = mesh->ys[j * mesh_nx + i];
+            x = std::min(i*mesh_size,source.data_.width());
+            y = std::min(j*mesh_size,source.data_.height());
+            ts.backward(&x, &y);
+        }
+    }
+    prj_trans.backward(&mesh->xs[0], &mesh->ys[0], NULL, mesh_nx*mesh_ny);
+    cache.insert(key, mesh);
+    return mesh;
+}
 
-    ImageData<double> xs(mesh_nx, mesh_ny);
-    ImageData<double> ys(mesh_nx, mesh_ny);
+// a mesh cell in target pixels and the affine transform to its source pixels
+struct warp_cell
+{
+    double polygon[8];
+    double miny;
+    double maxy;
+    agg::trans_affine tr;
+};
 
-    // Precalculate reprojected mesh
-    for(j=0; j<mesh_ny; ++j)
+// renders the cells overlapping the target rows [y0, y1), bands of the
+// same target can be rendered concurrently
+class warp_band
+{
+public:
+    warp_band(raster & target, raster const& source,
+              std::vector<warp_cell> const& cells,
+              agg::image_filter_lut const& filter,
+              scaling_method_e scaling_method,
+              unsigned y0, unsigned y1)
+        : target_(target),
+          source_(source),
+          cells_(cells),
+          filter_(filter),
+          scaling_method_(scaling_method),
+          y0_(y0),
+          y1_(y1) {}
+
+    void operator()() const
     {
-        for (i=0; i<mesh_nx; ++i)
+        typedef agg::pixfmt_rgba32 pixfmt;
+        typedef pixfmt::color_type color_type;
+        typedef agg::pixfmt_rgba32_pre pixfmt_pre;
+        typedef agg::renderer_base<pixfmt_pre> renderer_base_pre;
+
+        agg::rasterizer_scanline_aa<> rasterizer;
+        agg::scanline_u8  scanline;
+        agg::rendering_buffer buf((unsigned char*)target_.data_.getData(),
+                                  target_.data_.width(),
+                                  target_.data_.height(),
+                                  target_.data_.width()*4);
+        pixfmt_pre pixf_pre(buf);
+        renderer_base_pre rb_pre(pixf_pre);
+        rasterizer.clip_box(0, y0_, target_.data_.width(), y1_);
+        agg::rendering_buffer buf_tile(
+            (unsigned char*)source_.data_.getData(),
+            source_.data_.width(),
+            source_.data_.height(),
+            source_.data_.width() * 4);
+
+        pixfmt pixf_tile(buf_tile);
+
+        typedef agg::image_accessor_clone<pixfmt> img_accessor_type;
+        img_accessor_type ia(pixf_tile);
+
+        agg::span_allocator<color_type> sa;
+
+        for (std::vector<warp_cell>::const_iterator cell = cells_.begin(); cell != cells_.end(); ++cell)
         {
-            xs(i,j) = std::min(i*mesh_size,source.data_.width());
-            ys(i,j) = std::min(j*mesh_size,source.data_.height());
-            ts.backward(&xs(i,j), &ys(i,j));
+            if (cell->maxy < y0_ || cell->miny >= y1_) continue;
+            double const* polygon = cell->polygon;
+            rasterizer.reset();
+            rasterizer.move_to_d(polygon[0], polygon[1]);
+            rasterizer.line_to_d(polygon[2], polygon[3]);
+            rasterizer.line_to_d(polygon[4], polygon[5]);
+            rasterizer.line_to_d(polygon[6], polygon[7]);
+
+            typedef agg::span_interpolator_linear<agg::trans_affine>
+                interpolator_type;
+            interpolator_type interpolator(cell->tr);
+
+            if (scaling_method_ == SCALING_NEAR) {
+                typedef agg::span_image_filter_rgba_nn
+                    <img_accessor_type, interpolator_type>
+                    span_gen_type;
+                span_gen_type sg(ia, interpolator);
+                agg::render_scanlines_aa(rasterizer, scanline, rb_pre,
+                                         sa, sg);
+            } else {
+                typedef agg::span_image_resample_rgba_affine
+                    <img_accessor_type> span_gen_type;
+                span_gen_type sg(ia, interpolator, filter_);
+                agg::render_scanlines_aa(rasterizer, scanline, rb_pre,
+                                         sa, sg);
+            }
         }
     }
-    prj_trans.backward(xs.getData(), ys.getData(), NULL, mesh_nx*mesh_ny);
-
-    // Initialize AGG objects
-    typedef agg::pixfmt_rgba32 pixfmt;
-    typedef pixfmt::color_type color_type;
-    typedef agg::renderer_base<pixfmt> renderer_base;
-    typedef agg::pixfmt_rgba32_pre pixfmt_pre;
-    typedef agg::renderer_base<pixfmt_pre> renderer_base_pre;
-
-    agg::rasterizer_scanline_aa<> rasterizer;
-    agg::scanline_u8  scanline;
-    agg::rendering_buffer buf((unsigned char*)target.data_.getData(),
-                              target.data_.width(),
-                              target.data_.height(),
-                              target.data_.width()*4);
-    pixfmt_pre pixf_pre(buf);
-    renderer_base_pre rb_pre(pixf_pre);
-    rasterizer.clip_box(0, 0, target.data_.width(), target.data_.height());
-    agg::rendering_buffer buf_tile(
-        (unsigned char*)source.data_.getData(),
-        source.data_.width(),
-        source.data_.height(),
-        source.data_.width() * 4);
-
-    pixfmt pixf_tile(buf_tile);
-
-    typedef agg::image_accessor_clone<pixfmt> img_accessor_type;
-    img_accessor_type ia(pixf_tile);
-
-    agg::span_allocator<color_type> sa;
+
+private:
+    raster & target_;
+    raster const& source_;
+    std::vector<warp_cell> const& cells_;
+    agg::image_filter_lut const& filter_;
+    scaling_method_e scaling_method_;
+    unsigned y0_;
+    unsigned y1_;
+};
+
+}
+
+void reproject_and_scale_raster(raster & target, raster const& source,
+                                proj_transform const& prj_trans,
+                                double offset_x, double offset_y,
+                                unsigned mesh_size,
+                                double filter_radius,
+                                scaling_method_e scaling_method,
+                                unsigned threads)
+{
+    CoordTransform tt(target.data_.width(), target.data_.height(),
+                      target.ext_, offset_x, offset_y);
+    warp_mesh_ptr mesh = projected_mesh(source, prj_trans, mesh_size);
+    unsigned const mesh_nx = mesh->nx;
+    unsigned const mesh_ny = mesh->ny;
+    std::vector<double> const& xs = mesh->xs;
+    std::vector<double> const& ys = mesh->ys;
 
     // Initialize filter
     agg::image_filter_lut filter;
@@ -146,26 +257,24 @@ void reproject_and_scale_raster(raster & target, raster const& source,
         filter.calculate(agg::image_filter_blackman(filter_radius), true); break;
     }
 
-    // Project mesh cells into target interpolating raster inside each one
-    for(j=0; j<mesh_ny-1; j++)
+    // Project mesh cells into target pixels, once for all bands
+    std::vector<warp_cell> cells;
+    cells.reserve((mesh_nx-1) * (mesh_ny-1));
+    for (unsigned j=0; j<mesh_ny-1; j++)
     {
-        for (i=0; i<mesh_nx-1; i++)
+        for (unsigned i=0; i<mesh_nx-1; i++)
         {
-            double polygon[8] = {xs(i,j), ys(i,j),
-                                 xs(i+1,j), ys(i+1,j),
-                                 xs(i+1,j+1), ys(i+1,j+1),
-                                 xs(i,j+1), ys(i,j+1)};
+            unsigned const p0 = j * mesh_nx + i;
+            unsigned const p1 = (j+1) * mesh_nx + i;
+            double polygon[8] = {xs[p0], ys[p0],
+                                 xs[p0+1], ys[p0+1],
+                                 xs[p1+1], ys[p1+1],
+                                 xs[p1], ys[p1]};
             tt.forward(polygon+0, polygon+1);
             tt.forward(polygon+2, polygon+3);
             tt.forward(polygon+4, polygon+5);
             tt.forward(polygon+6, polygon+7);
 
-            rasterizer.reset();
-            rasterizer.move_to_d(std::floor(polygon[0]), std::floor(polygon[1]));
-            rasterizer.line_to_d(std::floor(polygon[2]), std::floor(polygon[3]));
-            rasterizer.line_to_d(std::floor(polygon[4]), std::floor(polygon[5]));
-            rasterizer.line_to_d(std::floor(polygon[6]), std::floor(polygon[7]));
-
             unsigned x0 = i * mesh_size;
             unsigned y0 = j * mesh_size;
             unsigned x1 = (i+1) * mesh_size;
@@ -173,29 +282,49 @@ void reproject_and_scale_raster(raster & target, raster const& source,
             x1 = std::min(x1, source.data_.width());
             y1 = std::min(y1, source.data_.height());
             agg::trans_affine tr(polygon, x0, y0, x1, y1);
-            if (tr.is_valid())
+            if (!tr.is_valid()) continue;
+
+            warp_cell cell;
+            cell.tr = tr;
+            for (unsigned k = 0; k < 8; ++k)
             {
-                typedef agg::span_interpolator_linear<agg::trans_affine>
-                    interpolator_type;
-                interpolator_type interpolator(tr);
-
-                if (scaling_method == SCALING_NEAR) {
-                    typedef agg::span_image_filter_rgba_nn
-                        <img_accessor_type, interpolator_type>
-                        span_gen_type;
-                    span_gen_type sg(ia, interpolator);
-                    agg::render_scanlines_aa(rasterizer, scanline, rb_pre,
-                                             sa, sg);
-                } else {
-                    typedef agg::span_image_resample_rgba_affine
-                        <img_accessor_type> span_gen_type;
-                    span_gen_type sg(ia, interpolator, filter);
-                    agg::render_scanlines_aa(rasterizer, scanline, rb_pre,
-                                             sa, sg);
-                }
+                cell.polygon[k] = std::floor(polygon[k]);
             }
-
+            cell.miny = std::min(std::min(cell.polygon[1], cell.polygon[3]),
+                                 std::min(cell.polygon[5], cell.polygon[7]));
+            cell.maxy = std::max(std::max(cell.polygon[1], cell.polygon[3]),
+                                 std::max(cell.polygon[5], cell.polygon[7]));
+            cells.push_back(cell);
         }
     }
+
+    // Interpolate the raster inside each cell, in horizontal bands of the
+    // target which are clipped to their rows so they never write the same pixel
+    unsigned const height = target.data_.height();
+    unsigned bands = 1;
+#ifdef MAPNIK_THREADSAFE
+    unsigned const min_band_rows = 32;
+    bands = std::max(1u, std::min(threads, height / min_band_rows));
+#endif
+    if (bands == 1)
+    {
+        warp_band(target, source, cells, filter, scaling_method, 0, height)();
+        return;
+    }
+#ifdef MAPNIK_THREADSAFE
+    // threads are started per call rather than kept in a pool: starting and
+    // joining one costs in the order of 15us, little next to interpolating the
+    // min_band_rows or more rows it is given
+    boost::thread_group group;
+    unsigned const rows = (height + bands - 1) / bands;
+    for (unsigned y = rows; y < height; y += rows)
+    {
+        group.create_thread(warp_band(target, source, cells, filter, scaling_method,
+                                      y, std::min(y + rows, height)));
+    }
+    warp_band(target, source, cells, filter, scaling_method, 0, rows)();
+    group.join_all();
+#endif
 }
+
 }// namespace mapnik
@@ -0,0 +1,109 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2012 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/warp_mesh_cache.hpp>
+
+// boost
+#include <boost/functional/hash.hpp>
+
+namespace mapnik
+{
+
+std::size_t hash_value(warp_mesh_key const& key)
+{
+    std::size_t seed = boost::hash<std::string>()(key.source_srs);
+    boost::hash_combine(seed, key.dest_srs);
+    boost::hash_combine(seed, key.ext.minx());
+    boost::hash_combine(seed, key.ext.miny());
+    boost::hash_combine(seed, key.ext.maxx());
+    boost::hash_combine(seed, key.ext.maxy());
+    boost::hash_combine(seed, key.width);
+    boost::hash_combine(seed, key.height);
+    boost::hash_combine(seed, key.mesh_size);
+    return seed;
+}
+
+namespace {
+
+std::size_t entry_bytes(warp_mesh const& mesh)
+{
+    return sizeof(warp_mesh) + (mesh.xs.size() + mesh.ys.size()) * sizeof(double);
+}
+
+}
+
+warp_mesh_cache::warp_mesh_cache()
+    : cache_(16 * 1024 * 1024, 256) {}
+
+warp_mesh_ptr warp_mesh_cache::find(warp_mesh_key const& key)
+{
+    warp_mesh_ptr mesh;
+    cache_.find(key, mesh);
+    return mesh;
+}
+
+void warp_mesh_cache::insert(warp_mesh_key const& key, warp_mesh_ptr const& mesh)
+{
+    // zero budgets are unlimited for the underlying cache
+    if (cache_.max_bytes() == 0 || cache_.max_entries() == 0) return;
+    cache_.insert(key, mesh, entry_bytes(*mesh));
+}
+
+void warp_mesh_cache::clear()
+{
+    cache_.clear();
+}
+
+void warp_mesh_cache::set_max_bytes(std::size_t max_bytes)
+{
+    cache_.set_max_bytes(max_bytes);
+    if (max_bytes == 0) cache_.clear();
+}
+
+std::size_t warp_mesh_cache::max_bytes() const
+{
+    return cache_.max_bytes();
+}
+
+void warp_mesh_cache::set_max_entries(std::size_t max_entries)
+{
+    cache_.set_max_entries(max_entries);
+    if (max_entries == 0) cache_.clear();
+}
+
+std::size_t warp_mesh_cache::max_entries() const
+{
+    return cache_.max_entries();
+}
+
+warp_mesh_cache_stats warp_mesh_cache::stats() const
+{
+    return cache_.stats();
+}
+
+void warp_mesh_cache::reset_stats()
+{
+    cache_.reset_stats();
+}
+
+}
@@ -26,6 +26,11 @@
 
 // boost
 #include <boost/optional.hpp>
+#include <boost/cstdint.hpp>
+
+// stl
+#include <cmath>
+#include <cstring>
 
 namespace mapnik {
 
@@ -77,6 +82,166 @@ boost::optional<bool> is_known_geographic(std::string const& srs)
     return boost::optional<bool>();
 }
 
+namespace {
+
+// The approximations below only use arithmetic and integer bit
+// manipulation, without any branches or selects, so that loops over them
+// can be vectorized under the default floating point flags. Each one is
+// exact to a few ulp over the range of arguments the projections need.
+
+inline boost::uint64_t double_bits(double val)
+{
+    boost::uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(double));
+    return bits;
+}
+
+inline double bits_double(boost::uint64_t bits)
+{
+    double val;
+    std::memcpy(&val, &bits, sizeof(double));
+    return val;
+}
+
+// |x| <= pi/2, Taylor series to x^21
+inline double sin_approx(double x)
+{
+    double x2 = x * x;
+    double p = -1.9572941063391263e-20;      // -1/21!
+    p = p * x2 + 8.2206352466243295e-18;     //  1/19!
+    p = p * x2 - 2.8114572543455206e-15;     // -1/17!
+    p = p * x2 + 7.6471637318198164e-13;     //  1/15!
+    p = p * x2 - 1.6059043836821613e-10;     // -1/13!
+    p = p * x2 + 2.5052108385441720e-08;     //  1/11!
+    p = p * x2 - 2.7557319223985893e-06;     // -1/9!
+    p = p * x2 + 1.9841269841269841e-04;     //  1/7!
+    p = p * x2 - 8.3333333333333333e-03;     // -1/5!
+    p = p * x2 + 1.6666666666666667e-01;     //  1/3!
+    return x - x * x2 * p;
+}
+
+// positive normal x; ln(x) = e ln2 + ln(m) with m in [sqrt(1/2),sqrt(2)),
+// and ln(m) = 2 atanh((m-1)/(m+1)) as a series to the 21st power
+inline double log_approx(double x)
+{
+    static const boost::uint64_t sqrt_half_bits = 0x3fe6a09e667f3bcdULL;
+    static const double two52 = 4503599627370496.0;
+    // offsetting the bits first makes the mantissa wrap at sqrt(1/2)
+    // instead of 1, which splits off e and m without a compare
+    boost::uint64_t bits = double_bits(x) + (0x3ff0000000000000ULL - sqrt_half_bits);
+    double e = bits_double((bits >> 52) | 0x4330000000000000ULL) - (two52 + 1023.0);
+    double m = bits_double((bits & 0x000fffffffffffffULL) + sqrt_half_bits);
+    double f = (m - 1.0) / (m + 1.0);
+    double f2 = f * f;
+    double p = 1.0 / 21;
+    p = p * f2 + 1.0 / 19;
+    p = p * f2 + 1.0 / 17;
+    p = p * f2 + 1.0 / 15;
+    p = p * f2 + 1.0 / 13;
+    p = p * f2 + 1.0 / 11;
+    p = p * f2 + 1.0 / 9;
+    p = p * f2 + 1.0 / 7;
+    p = p * f2 + 1.0 / 5;
+    p = p * f2 + 1.0 / 3;
+    p = p * f2 + 1.0;
+    // x - x keeps NaN input from turning into a finite result
+    return e * 0.69314718055994530942 + 2.0 * f * p + (x - x);
+}
+
+// |x| <= 4; exp(x) = 2^k exp(r) with |r| <= ln2/2, Taylor series to r^13
+inline double exp_approx(double x)
+{
+    static const double round_magic = 6755399441055744.0; // 1.5 * 2^52
+    static const double ln2_hi = 6.93147180369123816490e-01;
+    static const double ln2_lo = 1.90821492927058770002e-10;
+    double kr = x * 1.44269504088896340736 + round_magic;
+    double k = kr - round_magic;
+    // the low bits of kr hold k as an integer
+    double scale = bits_double((double_bits(kr) + 1023) << 52);
+    double r = x - k * ln2_hi - k * ln2_lo;
+    double p = 1.6059043836821613e-10;       // 1/13!
+    p = p * r + 2.0876756987868099e-09;      // 1/12!
+    p = p * r + 2.5052108385441720e-08;      // 1/11!
+    p = p * r + 2.7557319223985891e-07;      // 1/10!
+    p = p * r + 2.7557319223985893e-06;      // 1/9!
+    p = p * r + 2.4801587301587302e-05;      // 1/8!
+    p = p * r + 1.9841269841269841e-04;      // 1/7!
+    p = p * r + 1.3888888888888889e-03;      // 1/6!
+    p = p * r + 8.3333333333333333e-03;      // 1/5!
+    p = p * r + 4.1666666666666667e-02;      // 1/4!
+    p = p * r + 1.6666666666666667e-01;      // 1/3!
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+    return p * scale;
+}
+
+// atan(0.4), the reduction point for atan_approx
+static const double atan_0_4 = std::atan(0.4);
+
+// |x| <= 0.92; atan(|x|) = atan(0.4) + atan((|x| - 0.4) / (1 + 0.4 |x|))
+// leaves |v| <= 0.4 for Cephes' rational approximation, and the sign
+// is put back with a bit operation
+inline double atan_approx(double x)
+{
+    static const boost::uint64_t sign_bit = 0x8000000000000000ULL;
+    boost::uint64_t bits = double_bits(x);
+    double a = bits_double(bits & ~sign_bit);
+    double v = (a - 0.4) / (1.0 + 0.4 * a);
+    double z = v * v;
+    double p = -8.750608600031904122785e-1;
+    p = p * z - 1.615753718733365076637e1;
+    p = p * z - 7.500855792314704667340e1;
+    p = p * z - 1.228866684490136173410e2;
+    p = p * z - 6.485021904942025371773e1;
+    double q = z + 2.485846490142306297962e1;
+    q = q * z + 1.650270098316988542046e2;
+    q = q * z + 4.328810604912902668951e2;
+    q = q * z + 4.853903996359136964868e2;
+    q = q * z + 1.945506571482613964425e2;
+    double r = atan_0_4 + (v + v * z * p / q);
+    return bits_double(double_bits(r) | (bits & sign_bit));
+}
+
+// clamping is a separate pass: compares followed by arithmetic keep
+// the math loops from being vectorized
+inline void clamp(double * xy, std::size_t point_count, double limit_x, double limit_y)
+{
+    for (std::size_t i = 0; i < point_count * 2; i += 2)
+    {
+        if (xy[i] > limit_x) xy[i] = limit_x;
+        else if (xy[i] < -limit_x) xy[i] = -limit_x;
+        if (xy[i + 1] > limit_y) xy[i + 1] = limit_y;
+        else if (xy[i + 1] < -limit_y) xy[i + 1] = -limit_y;
+    }
+}
+
+}
+
+// y = R ln(tan(pi/4 + lat/2)) = R/2 ln((1 + sin(lat)) / (1 - sin(lat)))
+void lonlat2merc_bulk(double * xy, std::size_t point_count)
+{
+    clamp(xy, point_count, 180, MAX_LATITUDE);
+    for (std::size_t i = 0; i < point_count * 2; i += 2)
+    {
+        xy[i] = xy[i] * MAXEXTENTby180;
+        double s = sin_approx(xy[i + 1] * D2R);
+        xy[i + 1] = 0.5 * EARTH_RADIUS * log_approx((1.0 + s) / (1.0 - s));
+    }
+}
+
+// lat = 2 atan(exp(y/R)) - pi/2 = 2 atan(tanh(y/2R))
+void merc2lonlat_bulk(double * xy, std::size_t point_count)
+{
+    clamp(xy, point_count, MAXEXTENT, MAXEXTENT);
+    for (std::size_t i = 0; i < point_count * 2; i += 2)
+    {
+        xy[i] = (xy[i] / MAXEXTENT) * 180;
+        double e = exp_approx(xy[i + 1] / EARTH_RADIUS);
+        xy[i + 1] = R2D * 2.0 * atan_approx((e - 1.0) / (e + 1.0));
+    }
+}
+
 IMPLEMENT_ENUM( well_known_srs_e, well_known_srs_strings )
 
 }
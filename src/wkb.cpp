@@ -24,7 +24,6 @@
 #include <mapnik/debug.hpp>
 #include <mapnik/global.hpp>
 #include <mapnik/wkb.hpp>
-#include <mapnik/coord_array.hpp>
 #include <mapnik/geom_util.hpp>
 #include <mapnik/feature.hpp>
 #include <mapnik/noncopyable.hpp>
@@ -35,8 +34,6 @@
 namespace mapnik
 {
 
-typedef coord_array<coord2d> CoordinateArray;
-
 struct wkb_reader : mapnik::noncopyable
 {
 private:
@@ -120,43 +117,43 @@ public:
         switch (type)
         {
         case wkbPoint:
-            read_point(paths);
+            read_point(paths, 16);
             break;
         case wkbLineString:
-            read_linestring(paths);
+            read_linestring(paths, 16);
             break;
         case wkbPolygon:
-            read_polygon(paths);
+            read_polygon(paths, 16);
             break;
         case wkbMultiPoint:
-            read_multipoint(paths);
+            read_multipoint(paths, 16);
             break;
         case wkbMultiLineString:
-            read_multilinestring(paths);
+            read_multilinestring(paths, 16);
             break;
         case wkbMultiPolygon:
-            read_multipolygon(paths);
+            read_multipolygon(paths, 16);
             break;
         case wkbGeometryCollection:
             read_collection(paths);
             break;
         case wkbPointZ:
-            read_point_xyz(paths);
+            read_point(paths, 24);
             break;
         case wkbLineStringZ:
-            read_linestring_xyz(paths);
+            read_linestring(paths, 24);
             break;
         case wkbPolygonZ:
-            read_polygon_xyz(paths);
+            read_polygon(paths, 24);
             break;
         case wkbMultiPointZ:
-            read_multipoint_xyz(paths);
+            read_multipoint(paths, 24);
             break;
         case wkbMultiLineStringZ:
-            read_multilinestring_xyz(paths);
+            read_multilinestring(paths, 24);
             break;
         case wkbMultiPolygonZ:
-            read_multipolygon_xyz(paths);
+            read_multipolygon(paths, 24);
             break;
         case wkbGeometryCollectionZ:
             read_collection(paths);
@@ -169,250 +166,164 @@ public:
 private:
 
     int read_integer()
+    {
+        int n = read_integer_at(pos_);
+        pos_ += 4;
+        return n;
+    }
+
+    int read_integer_at(unsigned pos) const
     {
         boost::int32_t n;
         if (needSwap_)
         {
-            read_int32_xdr(wkb_ + pos_, n);
+            read_int32_xdr(wkb_ + pos, n);
         }
         else
         {
-            read_int32_ndr(wkb_ + pos_, n);
+            read_int32_ndr(wkb_ + pos, n);
         }
-        pos_ += 4;
-
         return n;
     }
 
-    double read_double()
+    // reads one vertex and skips the rest of it (Z), stride is 16 or 24 bytes
+    void read_xy(double & x, double & y, unsigned stride)
     {
-        double d;
         if (needSwap_)
         {
-            read_double_xdr(wkb_ + pos_, d);
+            read_double_xdr(wkb_ + pos_, x);
+            read_double_xdr(wkb_ + pos_ + 8, y);
         }
         else
         {
-            read_double_ndr(wkb_ + pos_, d);
+            read_double_ndr(wkb_ + pos_, x);
+            read_double_ndr(wkb_ + pos_ + 8, y);
         }
-        pos_ += 8;
-
-        return d;
+        pos_ += stride;
     }
 
-    void read_coords(CoordinateArray& ar)
+    // true if count vertices of stride bytes follow the current position
+    bool has_vertices(int count, unsigned stride) const
     {
-        if (! needSwap_)
-        {
-            for (unsigned i = 0; i < ar.size(); ++i)
-            {
-                read_double_ndr(wkb_ + pos_, ar[i].x);
-                read_double_ndr(wkb_ + pos_ + 8, ar[i].y);
-                pos_ += 16; // skip XY
-            }
-        }
-        else
-        {
-            for (unsigned i=0;i<ar.size();++i)
-            {
-                read_double_xdr(wkb_ + pos_, ar[i].x);
-                read_double_xdr(wkb_ + pos_ + 8, ar[i].y);
-                pos_ += 16; // skip XY
-            }
-        }
+        return count >= 0 && pos_ <= size_ && static_cast<unsigned>(count) <= (size_ - pos_) / stride;
     }
 
-    void read_coords_xyz(CoordinateArray& ar)
+    void read_line_to(geometry_type & geom, int count, unsigned stride)
     {
-        if (! needSwap_)
+        if (count <= 0) return;
+        if (!needSwap_ && stride == 16)
         {
-            for (unsigned i = 0; i < ar.size(); ++i)
-            {
-                read_double_ndr(wkb_ + pos_, ar[i].x);
-                read_double_ndr(wkb_ + pos_ + 8, ar[i].y);
-                pos_ += 24; // skip XYZ
-            }
+            // XY in host byte order has the layout of the vertex storage
+            geom.append_vertices(wkb_ + pos_, count, SEG_LINETO);
+            pos_ += count * stride;
         }
         else
         {
-            for (unsigned i = 0; i < ar.size(); ++i)
+            double x, y;
+            for (int i = 0; i < count; ++i)
             {
-                read_double_xdr(wkb_ + pos_, ar[i].x);
-                read_double_xdr(wkb_ + pos_ + 8, ar[i].y);
-                pos_ += 24; // skip XYZ
+                read_xy(x, y, stride);
+                geom.line_to(x, y);
             }
         }
     }
 
-
-    void read_point(boost::ptr_vector<geometry_type> & paths)
-    {
-        double x = read_double();
-        double y = read_double();
-        std::auto_ptr<geometry_type> pt(new geometry_type(Point));
-        pt->move_to(x, y);
-        paths.push_back(pt);
-    }
-
-    void read_multipoint(boost::ptr_vector<geometry_type> & paths)
+    // total number of vertices in the rings that follow, 0 if the rings
+    // run past the end of the buffer
+    std::size_t count_ring_vertices(int num_rings, unsigned stride) const
     {
-        int num_points = read_integer();
-        for (int i = 0; i < num_points; ++i)
+        std::size_t total = 0;
+        unsigned pos = pos_;
+        for (int i = 0; i < num_rings; ++i)
         {
-            pos_ += 5;
-            read_point(paths);
+            if (size_ < 4 || pos > size_ - 4) return 0;
+            int num_points = read_integer_at(pos);
+            pos += 4;
+            if (num_points < 0 || static_cast<unsigned>(num_points) > (size_ - pos) / stride) return 0;
+            pos += num_points * stride;
+            total += num_points;
         }
+        return total;
     }
 
-    void read_point_xyz(boost::ptr_vector<geometry_type> & paths)
+    void read_point(boost::ptr_vector<geometry_type> & paths, unsigned stride)
     {
-        double x = read_double();
-        double y = read_double();
+        double x, y;
+        read_xy(x, y, stride);
         std::auto_ptr<geometry_type> pt(new geometry_type(Point));
-        pos_ += 8; // double z = read_double();
         pt->move_to(x, y);
         paths.push_back(pt);
     }
 
-    void read_multipoint_xyz(boost::ptr_vector<geometry_type> & paths)
+    void read_multipoint(boost::ptr_vector<geometry_type> & paths, unsigned stride)
     {
         int num_points = read_integer();
         for (int i = 0; i < num_points; ++i)
         {
             pos_ += 5;
-            read_point_xyz(paths);
+            read_point(paths, stride);
         }
     }
 
-    void read_linestring(boost::ptr_vector<geometry_type> & paths)
+    void read_linestring(boost::ptr_vector<geometry_type> & paths, unsigned stride)
     {
         int num_points = read_integer();
         if (num_points > 0)
         {
-            CoordinateArray ar(num_points);
-            read_coords(ar);
             std::auto_ptr<geometry_type> line(new geometry_type(LineString));
-            line->move_to(ar[0].x, ar[0].y);
-            for (int i = 1; i < num_points; ++i)
+            if (has_vertices(num_points, stride))
             {
-                line->line_to(ar[i].x, ar[i].y);
+                line->reserve(num_points);
             }
+            double x, y;
+            read_xy(x, y, stride);
+            line->move_to(x, y);
+            read_line_to(*line, num_points - 1, stride);
             paths.push_back(line);
         }
     }
 
-    void read_multilinestring(boost::ptr_vector<geometry_type> & paths)
+    void read_multilinestring(boost::ptr_vector<geometry_type> & paths, unsigned stride)
     {
         int num_lines = read_integer();
         for (int i = 0; i < num_lines; ++i)
         {
             pos_ += 5;
-            read_linestring(paths);
+            read_linestring(paths, stride);
         }
     }
 
-    void read_linestring_xyz(boost::ptr_vector<geometry_type> & paths)
-    {
-        int num_points = read_integer();
-        if (num_points > 0)
-        {
-            CoordinateArray ar(num_points);
-            read_coords_xyz(ar);
-            std::auto_ptr<geometry_type> line(new geometry_type(LineString));
-            line->move_to(ar[0].x, ar[0].y);
-            for (int i = 1; i < num_points; ++i)
-            {
-                line->line_to(ar[i].x, ar[i].y);
-            }
-            paths.push_back(line);
-        }
-    }
-
-    void read_multilinestring_xyz(boost::ptr_vector<geometry_type> & paths)
-    {
-        int num_lines = read_integer();
-        for (int i = 0; i < num_lines; ++i)
-        {
-            pos_ += 5;
-            read_linestring_xyz(paths);
-        }
-    }
-
-
-    void read_polygon(boost::ptr_vector<geometry_type> & paths)
+    void read_polygon(boost::ptr_vector<geometry_type> & paths, unsigned stride)
     {
         int num_rings = read_integer();
         if (num_rings > 0)
         {
             std::auto_ptr<geometry_type> poly(new geometry_type(Polygon));
+            poly->reserve(count_ring_vertices(num_rings, stride));
             for (int i = 0; i < num_rings; ++i)
             {
                 int num_points = read_integer();
                 if (num_points > 0)
                 {
-                    CoordinateArray ar(num_points);
-                    read_coords(ar);
-                    poly->move_to(ar[0].x, ar[0].y);
-                    for (int j = 1; j < num_points - 1; ++j)
+                    double x0, y0;
+                    read_xy(x0, y0, stride);
+                    poly->move_to(x0, y0);
+                    read_line_to(*poly, num_points - 2, stride);
+                    double x = x0;
+                    double y = y0;
+                    if (num_points > 1)
                     {
-                        poly->line_to(ar[j].x, ar[j].y);
+                        read_xy(x, y, stride);
                     }
-
-                    if (ar[0].x == ar[num_points-1].x &&
-                        ar[0].y == ar[num_points-1].y)
+                    // a closed ring ends with SEG_CLOSE, so it needs no set_close() pass
+                    if (x0 == x && y0 == y)
                     {
-                        poly->close(ar[num_points-1].x, ar[num_points-1].y);
+                        poly->close(x, y);
                     }
                     else
                     {
                         // leave un-closed polygon intact - don't attempt to close them
-                        poly->line_to(ar[num_points-1].x, ar[num_points-1].y);
-                    }
-                    poly->set_close();
-                }
-            }
-            if (poly->size() > 2) // ignore if polygon has less than 3 vertices
-                paths.push_back(poly);
-        }
-    }
-
-    void read_multipolygon(boost::ptr_vector<geometry_type> & paths)
-    {
-        int num_polys = read_integer();
-        for (int i = 0; i < num_polys; ++i)
-        {
-            pos_ += 5;
-            read_polygon(paths);
-        }
-    }
-
-    void read_polygon_xyz(boost::ptr_vector<geometry_type> & paths)
-    {
-        int num_rings = read_integer();
-        if (num_rings > 0)
-        {
-            std::auto_ptr<geometry_type> poly(new geometry_type(Polygon));
-            for (int i = 0; i < num_rings; ++i)
-            {
-                int num_points = read_integer();
-                if (num_points > 0)
-                {
-                    CoordinateArray ar(num_points);
-                    read_coords_xyz(ar);
-                    poly->move_to(ar[0].x, ar[0].y);
-                    for (int j = 1; j < num_points - 1; ++j)
-                    {
-                        poly->line_to(ar[j].x, ar[j].y);
-                    }
-                    if (ar[0].x == ar[num_points-1].x &&
-                        ar[0].y == ar[num_points-1].y)
-                    {
-                        poly->close(ar[num_points-1].x, ar[num_points-1].y);
-                    }
-                    else
-                    {
-                        // leave un-closed polygon intact- don't attempt to close them
-                        poly->line_to(ar[num_points-1].x, ar[num_points-1].y);
+                        poly->line_to(x, y);
                     }
                 }
             }
@@ -421,13 +332,13 @@ private:
         }
     }
 
-    void read_multipolygon_xyz(boost::ptr_vector<geometry_type> & paths)
+    void read_multipolygon(boost::ptr_vector<geometry_type> & paths, unsigned stride)
     {
         int num_polys = read_integer();
         for (int i = 0; i < num_polys; ++i)
         {
             pos_ += 5;
-            read_polygon_xyz(paths);
+            read_polygon(paths, stride);
         }
     }
 
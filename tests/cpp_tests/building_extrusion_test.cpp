@@ -0,0 +1,97 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <algorithm>
+#include <mapnik/building_extrusion.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+
+namespace {
+
+struct path_info
+{
+    path_info() : vertices(0), moves(0) {}
+    unsigned vertices;
+    unsigned moves;
+};
+
+path_info inspect(mapnik::building_extrusion::path_source path)
+{
+    path_info info;
+    double x, y;
+    path.rewind(0);
+    for (unsigned cmd = path.vertex(&x, &y); cmd != mapnik::SEG_END; cmd = path.vertex(&x, &y))
+    {
+        if (cmd == mapnik::SEG_MOVETO) ++info.moves;
+        ++info.vertices;
+    }
+    return info;
+}
+
+// screen y of the nearest point of a wall
+double wall_y(mapnik::building_extrusion const& extrusion, std::size_t i)
+{
+    double x, y;
+    double max_y = 0;
+    mapnik::building_extrusion::path_source wall = extrusion.wall(i);
+    wall.rewind(0);
+    for (unsigned cmd = wall.vertex(&x, &y); cmd != mapnik::SEG_END; cmd = wall.vertex(&x, &y))
+    {
+        max_y = std::max(max_y, y);
+    }
+    return max_y;
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::projection merc("+init=epsg:3857");
+    mapnik::proj_transform prj_trans(merc, merc);
+    mapnik::CoordTransform t(100, 100, mapnik::box2d<double>(-50, -50, 50, 50));
+    mapnik::building_extrusion extrusion;
+
+    mapnik::geometry_type square(mapnik::Polygon);
+    square.move_to(0, 0);
+    square.line_to(10, 0);
+    square.line_to(10, 10);
+    square.line_to(0, 10);
+    square.close(0, 0);
+    extrusion.build(square, 5, t, prj_trans);
+    BOOST_TEST_EQ(extrusion.wall_count(), 4u);
+    path_info wall = inspect(extrusion.wall(3));
+    BOOST_TEST_EQ(wall.moves, 1u);
+    BOOST_TEST_EQ(wall.vertices, 4u);
+    path_info roof = inspect(extrusion.roof());
+    BOOST_TEST_EQ(roof.moves, 1u);
+    BOOST_TEST_EQ(roof.vertices, 5u);
+    // ground outline, four vertical edges and the roof outline
+    path_info frame = inspect(extrusion.frame());
+    BOOST_TEST_EQ(frame.moves, 6u);
+    BOOST_TEST_EQ(frame.vertices, 18u);
+
+    // walls come back to front: the far side of the square first
+    BOOST_TEST(wall_y(extrusion, 0) < wall_y(extrusion, 1));
+    BOOST_TEST_EQ(wall_y(extrusion, 1), wall_y(extrusion, 2));
+    BOOST_TEST_EQ(wall_y(extrusion, 1), wall_y(extrusion, 3));
+
+    // the storage is reused: nothing is left of the previous building
+    mapnik::geometry_type triangle(mapnik::Polygon);
+    triangle.move_to(0, 0);
+    triangle.line_to(10, 0);
+    triangle.line_to(5, 10);
+    triangle.close(0, 0);
+    extrusion.build(triangle, 0, t, prj_trans);
+    BOOST_TEST_EQ(extrusion.wall_count(), 3u);
+    BOOST_TEST_EQ(inspect(extrusion.roof()).vertices, 4u);
+    BOOST_TEST(!extrusion.empty());
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ building extrusion: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
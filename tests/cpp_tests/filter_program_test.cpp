@@ -0,0 +1,107 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/make_shared.hpp>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_evaluator.hpp>
+#include <mapnik/filter_program.hpp>
+
+namespace {
+
+mapnik::feature_ptr make_feature(mapnik::context_ptr const& ctx, int id, std::string const& highway, int lanes)
+{
+    mapnik::transcoder tr("utf-8");
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,id));
+    feature->put("highway",tr.transcode(highway.c_str()));
+    feature->put("lanes",lanes);
+    mapnik::geometry_type * line = new mapnik::geometry_type(mapnik::LineString);
+    line->move_to(0,0);
+    line->line_to(10,10);
+    feature->add_geometry(line);
+    return feature;
+}
+
+}
+
+int main( int, char*[] )
+{
+    std::vector<std::string> filters;
+    filters.push_back("[highway]='primary'");
+    filters.push_back("[highway]='primary' and [lanes] > 2");
+    filters.push_back("[highway]='primary' or [highway]='secondary'");
+    filters.push_back("not ([highway]='primary')");
+    filters.push_back("[lanes] * 2 + 1 = 7");
+    filters.push_back("[lanes] % 2 = 1");
+    filters.push_back("[missing] = null");
+    filters.push_back("[highway].match('.*ary')");
+    filters.push_back("[highway].replace('ary','') = 'prim'");
+    filters.push_back("[mapnik::geometry_type] = linestring");
+    filters.push_back("1 + 2 = 3");
+    filters.push_back("1 > 2 or [lanes] = 3");
+    filters.push_back("[lanes] = 3 and false");
+    filters.push_back("-[lanes] < -2");
+
+    mapnik::filter_program program;
+    std::vector<mapnik::expression_ptr> exprs;
+    std::vector<mapnik::filter_program::program_id> ids;
+    for (unsigned i = 0; i < filters.size(); ++i)
+    {
+        exprs.push_back(mapnik::parse_expression(filters[i]));
+        ids.push_back(program.compile(*exprs.back()));
+    }
+
+    // constant subexpressions are folded
+    BOOST_TEST(program.is_constant(ids[10]));
+    BOOST_TEST(program.is_constant(ids[12]));
+    BOOST_TEST(!program.is_constant(ids[11]));
+
+    // identical subexpressions are shared
+    std::size_t size = program.size();
+    program.compile(*mapnik::parse_expression("[highway]='primary' and [lanes] > 2"));
+    BOOST_TEST_EQ(program.size(), size);
+
+    mapnik::context_ptr ctx = boost::make_shared<mapnik::context_type>();
+    ctx->push("highway");
+    ctx->push("lanes");
+    std::vector<mapnik::feature_ptr> features;
+    features.push_back(make_feature(ctx,1,"primary",3));
+    features.push_back(make_feature(ctx,2,"secondary",1));
+    features.push_back(make_feature(ctx,3,"residential",2));
+
+    // a second context with a different attribute order
+    mapnik::context_ptr ctx2 = boost::make_shared<mapnik::context_type>();
+    ctx2->push("lanes");
+    ctx2->push("highway");
+    features.push_back(make_feature(ctx2,4,"primary",1));
+    features.push_back(make_feature(ctx2,5,"tertiary",4));
+
+    for (unsigned f = 0; f < features.size(); ++f)
+    {
+        mapnik::feature_impl const& feature = *features[f];
+        program.bind(feature);
+        for (unsigned i = 0; i < exprs.size(); ++i)
+        {
+            bool expected = boost::apply_visitor(mapnik::evaluate<mapnik::Feature,mapnik::value_type>(feature),*exprs[i]).to_bool();
+            if (program.evaluate(ids[i]) != expected)
+            {
+                std::clog << "filter mismatch for '" << filters[i] << "' on feature " << feature.id() << "\n";
+                BOOST_TEST(false);
+            }
+        }
+    }
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ filter program: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
@@ -0,0 +1,107 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <string>
+#include <mapnik/font_engine_freetype.hpp>
+
+namespace {
+
+mapnik::char_info measure(mapnik::face_ptr const& face, double size, unsigned c)
+{
+    // a new face set per measurement, like processed_text does for every text
+    mapnik::font_face_set faces;
+    faces.add(face);
+    faces.set_character_sizes(size);
+    return faces.character_dimensions(c);
+}
+
+}
+
+int main( int, char*[] )
+{
+    std::string const face_name("DejaVu Sans Book");
+    BOOST_TEST(mapnik::freetype_engine::register_font("fonts/dejavu-fonts-ttf-2.33/ttf/DejaVuSans.ttf"));
+    mapnik::freetype_engine::clear_cache();
+
+    {
+        mapnik::freetype_engine engine;
+        BOOST_TEST(!engine.create_face("Unknown Face"));
+        mapnik::face_ptr first = engine.create_face(face_name);
+        BOOST_TEST(first);
+        BOOST_TEST(engine.create_face(face_name) == first);
+
+        // a concurrently used engine gets its own library and face, from the same buffer
+        mapnik::freetype_engine other;
+        mapnik::face_ptr second = other.create_face(face_name);
+        BOOST_TEST(second);
+        BOOST_TEST(second != first);
+
+        mapnik::font_cache_stats stats = mapnik::freetype_engine::cache_stats();
+        BOOST_TEST_EQ(stats.files, 1u);
+        BOOST_TEST(stats.bytes > 0);
+        BOOST_TEST_EQ(stats.libraries, 2u);
+        BOOST_TEST_EQ(stats.idle_libraries, 0u);
+        BOOST_TEST_EQ(stats.faces_opened, 2u);
+    }
+
+    // later engines reuse the libraries and the faces opened in them
+    {
+        mapnik::freetype_engine engine;
+        mapnik::face_ptr face = engine.create_face(face_name);
+        BOOST_TEST(face);
+        mapnik::font_cache_stats stats = mapnik::freetype_engine::cache_stats();
+        BOOST_TEST_EQ(stats.libraries, 2u);
+        BOOST_TEST_EQ(stats.idle_libraries, 1u);
+        BOOST_TEST_EQ(stats.faces_opened, 2u);
+
+        // metrics are shared between face sets of the same faces and size
+        mapnik::char_info a = measure(face, 10, 'a');
+        mapnik::char_info cached = measure(face, 10, 'a');
+        BOOST_TEST(a.width > 0);
+        BOOST_TEST_EQ(cached.width, a.width);
+        BOOST_TEST_EQ(cached.ymax, a.ymax);
+        BOOST_TEST_EQ(cached.line_height, a.line_height);
+        mapnik::char_info larger = measure(face, 20, 'a');
+        BOOST_TEST(larger.width > a.width);
+        stats = mapnik::freetype_engine::cache_stats();
+        BOOST_TEST_EQ(stats.metrics_hits, 1u);
+        BOOST_TEST_EQ(stats.metrics_misses, 2u);
+        BOOST_TEST_EQ(stats.metrics_entries, 2u);
+
+        // changing the size of a face set does not return stale dimensions
+        mapnik::font_face_set faces;
+        faces.add(face);
+        faces.set_character_sizes(10);
+        BOOST_TEST_EQ(faces.character_dimensions('a').width, a.width);
+        faces.set_character_sizes(20);
+        BOOST_TEST_EQ(faces.character_dimensions('a').width, larger.width);
+    }
+
+    // a face kept past clear_cache keeps its library and buffer
+    {
+        mapnik::face_ptr kept;
+        {
+            mapnik::freetype_engine engine;
+            kept = engine.create_face(face_name);
+        }
+        mapnik::freetype_engine::clear_cache();
+        BOOST_TEST(kept);
+        BOOST_TEST(measure(kept, 12, 'b').width > 0);
+    }
+
+    // only idle libraries are released
+    mapnik::freetype_engine::clear_cache();
+    mapnik::font_cache_stats stats = mapnik::freetype_engine::cache_stats();
+    BOOST_TEST_EQ(stats.files, 0u);
+    BOOST_TEST_EQ(stats.libraries, 0u);
+    BOOST_TEST_EQ(stats.metrics_entries, 0u);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ font cache: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
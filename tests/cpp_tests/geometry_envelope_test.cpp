@@ -0,0 +1,68 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <mapnik/geometry.hpp>
+
+namespace {
+
+// reference envelope from a full vertex scan
+template <typename Geometry>
+mapnik::box2d<double> scan(Geometry const& geom)
+{
+    mapnik::box2d<double> result;
+    double x, y;
+    unsigned cmd;
+    for (unsigned i = 0; (cmd = geom.vertex(i, &x, &y)) != mapnik::SEG_END; ++i)
+    {
+        if (cmd == mapnik::SEG_CLOSE) continue;
+        if (result.valid()) result.expand_to_include(x, y);
+        else result.init(x, y, x, y);
+    }
+    return result;
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::geometry_type empty(mapnik::Point);
+    BOOST_TEST(!empty.envelope().valid());
+
+    mapnik::geometry_type pt(mapnik::Point);
+    pt.move_to(3, -4);
+    BOOST_TEST(pt.envelope() == mapnik::box2d<double>(3, -4, 3, -4));
+
+    // kept up to date as vertices are added
+    mapnik::geometry_type poly(mapnik::Polygon);
+    poly.move_to(0, 0);
+    poly.line_to(10, 0);
+    BOOST_TEST(poly.envelope() == mapnik::box2d<double>(0, 0, 10, 0));
+    poly.line_to(10, 10);
+    poly.line_to(0, 0);
+    poly.set_close();
+    BOOST_TEST(poly.envelope() == mapnik::box2d<double>(0, 0, 10, 10));
+    double xy[] = { -5, 2, 20, 3, 4, -7 };
+    poly.move_to(1, 1);
+    poly.append_vertices(xy, 3, mapnik::SEG_LINETO);
+    // close vertices don't count towards the envelope
+    poly.close(100, 100);
+    BOOST_TEST(poly.envelope() == mapnik::box2d<double>(-5, -7, 20, 10));
+    BOOST_TEST(poly.envelope() == scan(poly));
+
+    // doesn't disturb iteration
+    double x, y;
+    poly.rewind(0);
+    poly.vertex(&x, &y);
+    poly.envelope();
+    BOOST_TEST_EQ(poly.vertex(&x, &y), unsigned(mapnik::SEG_LINETO));
+    BOOST_TEST(x == 10 && y == 0);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ geometry envelope: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
@@ -0,0 +1,99 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/make_shared.hpp>
+#include <iostream>
+#include <mapnik/glyph_cache.hpp>
+
+namespace {
+
+mapnik::glyph_bitmap_ptr make_bitmap(unsigned size)
+{
+    boost::shared_ptr<mapnik::glyph_bitmap> bitmap = boost::make_shared<mapnik::glyph_bitmap>();
+    bitmap->width = size;
+    bitmap->rows = size;
+    bitmap->buffer.resize(size * size, 255);
+    return bitmap;
+}
+
+mapnik::glyph_cache_key make_key(unsigned index, long stroke)
+{
+    mapnik::glyph_cache_key key;
+    key.face = "DejaVu Sans Book";
+    key.index = index;
+    key.size = 10 << 6;
+    key.xx = 0x10000L;
+    key.stroke = stroke;
+    return key;
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::glyph_cache & cache = mapnik::glyph_cache::instance();
+    cache.clear();
+    cache.reset_stats();
+
+    // full precision keeps the subpixel offset, rounding to the nearest step otherwise
+    long pixel, subpixel;
+    mapnik::glyph_cache::quantize(10 * 64 + 37, 64, pixel, subpixel);
+    BOOST_TEST_EQ(pixel, 10);
+    BOOST_TEST_EQ(subpixel, 37);
+    mapnik::glyph_cache::quantize(-1, 64, pixel, subpixel);
+    BOOST_TEST_EQ(pixel, -1);
+    BOOST_TEST_EQ(subpixel, 63);
+    mapnik::glyph_cache::quantize(10 * 64 + 37, 4, pixel, subpixel);
+    BOOST_TEST_EQ(pixel, 10);
+    BOOST_TEST_EQ(subpixel, 32);
+    mapnik::glyph_cache::quantize(10 * 64 + 60, 4, pixel, subpixel);
+    BOOST_TEST_EQ(pixel, 11);
+    BOOST_TEST_EQ(subpixel, 0);
+    cache.set_subpixel_steps(4);
+    cache.set_subpixel_steps(3);
+    BOOST_TEST_EQ(cache.subpixel_steps(), 4u);
+    cache.set_subpixel_steps(64);
+    BOOST_TEST_EQ(cache.subpixel_steps(), 64u);
+
+    // halos and glyphs are cached separately
+    BOOST_TEST(!cache.find(make_key(42, 0)));
+    cache.insert(make_key(42, 0), make_bitmap(8));
+    cache.insert(make_key(42, 96), make_bitmap(10));
+    mapnik::glyph_bitmap_ptr bitmap = cache.find(make_key(42, 0));
+    BOOST_TEST(bitmap && bitmap->width == 8u);
+    bitmap = cache.find(make_key(42, 96));
+    BOOST_TEST(bitmap && bitmap->width == 10u);
+
+    mapnik::glyph_cache_stats stats = cache.stats();
+    BOOST_TEST_EQ(stats.hits, 2u);
+    BOOST_TEST_EQ(stats.misses, 1u);
+    BOOST_TEST_EQ(stats.entries, 2u);
+
+    // the byte budget evicts least recently used bitmaps, zero disables the cache
+    cache.set_max_bytes(1);
+    BOOST_TEST_EQ(cache.stats().entries, 0u);
+    BOOST_TEST_EQ(cache.stats().evictions, 2u);
+    cache.set_max_bytes(0);
+    cache.insert(make_key(7, 0), make_bitmap(8));
+    BOOST_TEST(!cache.find(make_key(7, 0)));
+    cache.set_max_bytes(16 * 1024 * 1024);
+    cache.insert(make_key(7, 0), make_bitmap(8));
+    BOOST_TEST(cache.find(make_key(7, 0)));
+
+    // the budget is for the whole cache, not split between shards
+    cache.set_max_bytes(16 * 1024);
+    cache.insert(make_key(8, 0), make_bitmap(64));
+    BOOST_TEST(cache.find(make_key(8, 0)));
+    BOOST_TEST(cache.find(make_key(7, 0)));
+    cache.set_max_bytes(16 * 1024 * 1024);
+    cache.clear();
+    BOOST_TEST_EQ(cache.stats().entries, 0u);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ glyph cache: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
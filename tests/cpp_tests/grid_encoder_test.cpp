@@ -0,0 +1,108 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/make_shared.hpp>
+#include <iostream>
+#include <string>
+#include <mapnik/grid/grid.hpp>
+#include <mapnik/grid/grid_view.hpp>
+#include <mapnik/grid/grid_encoder.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+
+namespace {
+
+void fill_row(mapnik::grid & grid, int y, char const* ids)
+{
+    for (int x = 0; ids[x]; ++x)
+    {
+        grid.setPixel(x, y, ids[x] == ' ' ? mapnik::grid::base_mask : ids[x] - '0');
+    }
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::transcoder tr("utf-8");
+    mapnik::context_ptr ctx = boost::make_shared<mapnik::context_type>();
+    ctx->push("name");
+
+    mapnik::grid grid(8, 2, "__id__", 1);
+    grid.add_property_name("name");
+    mapnik::feature_ptr one(mapnik::feature_factory::create(ctx, 1));
+    one->put("name", tr.transcode("one \"quoted\""));
+    grid.add_feature(*one);
+    mapnik::feature_ptr two(mapnik::feature_factory::create(ctx, 2));
+    two->put("name", 2.5);
+    grid.add_feature(*two);
+    fill_row(grid, 0, "  11122 ");
+    fill_row(grid, 1, "22221111");
+
+    // characters in order of appearance, skipping '"'
+    mapnik::utf_grid utf;
+    mapnik::encode_utf_grid(grid, utf, 1);
+    BOOST_TEST_EQ(utf.rows.size(), 2u);
+    if (utf.rows.size() == 2)
+    {
+        BOOST_TEST_EQ(utf.rows[0], std::string("  !!!## "));
+        BOOST_TEST_EQ(utf.rows[1], std::string("####!!!!"));
+    }
+    BOOST_TEST_EQ(utf.keys.size(), 3u);
+    if (utf.keys.size() == 3)
+    {
+        BOOST_TEST_EQ(utf.keys[0], std::string(""));
+        BOOST_TEST_EQ(utf.keys[1], std::string("1"));
+        BOOST_TEST_EQ(utf.keys[2], std::string("2"));
+    }
+
+    // every second pixel of every second row
+    mapnik::encode_utf_grid(grid, utf, 2);
+    BOOST_TEST_EQ(utf.rows.size(), 1u);
+    if (utf.rows.size() == 1) BOOST_TEST_EQ(utf.rows[0], std::string(" !!#"));
+
+    std::string json;
+    mapnik::encode_utf_grid_json(grid, json, true, 1);
+    BOOST_TEST_EQ(json, std::string("{\"grid\":[\"  !!!## \",\"####!!!!\"],\"keys\":[\"\",\"1\",\"2\"],"
+                                    "\"data\":{\"1\":{\"name\":\"one \\\"quoted\\\"\"},\"2\":{\"name\":2.5}}}"));
+    json.clear();
+    mapnik::encode_utf_grid_json(grid, json, false, 2);
+    BOOST_TEST_EQ(json, std::string("{\"grid\":[\" !!#\"],\"keys\":[\"\",\"1\",\"2\"],\"data\":{}}"));
+
+    // views start counting at their own first pixel
+    mapnik::grid_view view = grid.get_view(2, 0, 4, 2);
+    mapnik::encode_utf_grid(view, utf, 1);
+    BOOST_TEST_EQ(utf.keys.size(), 2u);
+    if (utf.rows.size() == 2)
+    {
+        BOOST_TEST_EQ(utf.rows[0], std::string("   !"));
+        BOOST_TEST_EQ(utf.rows[1], std::string("!!  "));
+    }
+
+    // characters beyond ascii are utf-8 encoded
+    mapnik::grid wide(300, 1, "__id__", 1);
+    for (int x = 0; x < 300; ++x)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, x + 1));
+        wide.add_feature(*feature);
+        wide.setPixel(x, 0, x + 1);
+    }
+    mapnik::encode_utf_grid(wide, utf, 1);
+    BOOST_TEST_EQ(utf.keys.size(), 300u);
+    if (utf.rows.size() == 1)
+    {
+        // 300 characters from U+0020, skipping two: U+014D last
+        std::string const& row = utf.rows[0];
+        BOOST_TEST_EQ(row.size(), 94u + 2 * 206u);
+        BOOST_TEST_EQ(row.substr(row.size() - 2), std::string("\xC5\x8D"));
+    }
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ grid encoder: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
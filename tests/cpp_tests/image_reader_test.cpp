@@ -0,0 +1,98 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <mapnik/image_reader.hpp>
+
+namespace {
+
+std::vector<char> slurp(std::string const& file)
+{
+    std::ifstream stream(file.c_str(), std::ios::in | std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(stream),
+                             std::istreambuf_iterator<char>());
+}
+
+bool same_pixels(mapnik::image_data_32 const& a, mapnik::image_data_32 const& b,
+                 unsigned x0, unsigned y0)
+{
+    for (unsigned y = 0; y < b.height(); ++y)
+    {
+        for (unsigned x = 0; x < b.width(); ++x)
+        {
+            if (a(x0 + x, y0 + y) != b(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+// decoding from memory matches the file, and windows match the full image
+void check(std::string const& file)
+{
+    boost::scoped_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(file));
+    BOOST_TEST(reader);
+    if (!reader) return;
+    unsigned width = reader->width();
+    unsigned height = reader->height();
+    mapnik::image_data_32 full(width, height);
+    reader->read(0, 0, full);
+
+    std::vector<char> buffer = slurp(file);
+    boost::scoped_ptr<mapnik::image_reader> memory_reader(mapnik::get_image_reader(&buffer[0], buffer.size()));
+    BOOST_TEST(memory_reader);
+    if (!memory_reader) return;
+    BOOST_TEST_EQ(memory_reader->width(), width);
+    BOOST_TEST_EQ(memory_reader->height(), height);
+    BOOST_TEST_EQ(memory_reader->premultiplied_alpha(), reader->premultiplied_alpha());
+    mapnik::image_data_32 from_memory(width, height);
+    memory_reader->read(0, 0, from_memory);
+    BOOST_TEST(same_pixels(full, from_memory, 0, 0));
+
+    // readers are reused, each read starts from scratch
+    unsigned x0 = width / 3;
+    unsigned y0 = height / 4;
+    mapnik::image_data_32 window(width / 2, height / 2);
+    reader->read(x0, y0, window);
+    BOOST_TEST(same_pixels(full, window, x0, y0));
+    mapnik::image_data_32 memory_window(width / 2, height / 2);
+    memory_reader->read(x0, y0, memory_window);
+    BOOST_TEST(same_pixels(full, memory_window, x0, y0));
+}
+
+}
+
+int main( int, char*[] )
+{
+    check("tests/data/images/12_654_1580.png");
+    check("tests/data/images/13_4194_2747.png");
+    check("tests/data/images/checker.jpg");
+    check("tests/data/raster/river.tiff");
+    check("tests/data/raster/white-alpha-assoc-alpha-correct.tiff");
+
+    // unknown formats and truncated data are rejected
+    char const garbage[] = "not an image";
+    BOOST_TEST(!mapnik::get_image_reader(garbage, sizeof(garbage)));
+    std::vector<char> png = slurp("tests/data/images/12_654_1580.png");
+    try
+    {
+        boost::scoped_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(&png[0], 16));
+        mapnik::image_data_32 image(reader->width(), reader->height());
+        reader->read(0, 0, image);
+        BOOST_TEST(false);
+    }
+    catch (mapnik::image_reader_exception const&)
+    {
+    }
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ image reader: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
@@ -0,0 +1,69 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <mapnik/box2d.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/label_collision_detector.hpp>
+
+int main( int, char*[] )
+{
+    typedef mapnik::box2d<double> box_type;
+    mapnik::transcoder tr("utf-8");
+    UnicodeString main_street = tr.transcode("Main Street");
+    UnicodeString elm_street = tr.transcode("Elm Street");
+
+    mapnik::label_collision_detector4 detector(box_type(-64,-64,512+64,512+64));
+    BOOST_TEST(detector.has_placement(box_type(10,10,50,20)));
+    detector.insert(box_type(10,10,50,20), main_street);
+
+    // overlapping labels collide, whatever their text
+    BOOST_TEST(!detector.has_placement(box_type(40,15,90,25)));
+    BOOST_TEST(!detector.has_placement(box_type(40,15,90,25), elm_street, 0));
+    BOOST_TEST(detector.has_placement(box_type(60,10,100,20)));
+
+    // repeated text collides within the minimum distance only
+    BOOST_TEST(!detector.has_placement(box_type(100,10,140,20), main_street, 60));
+    BOOST_TEST(detector.has_placement(box_type(100,10,140,20), elm_street, 60));
+    BOOST_TEST(detector.has_placement(box_type(300,300,340,310), main_street, 60));
+
+    // interned ids give the same answers
+    mapnik::label_collision_detector4::text_id main_id = detector.intern(main_street);
+    BOOST_TEST(!detector.has_placement(box_type(100,10,140,20), main_id, 60));
+    BOOST_TEST_EQ(detector.find_text(main_street), main_id);
+    // texts only looked up are not interned and never repeat
+    mapnik::label_collision_detector4::text_id elm_id = detector.find_text(elm_street);
+    BOOST_TEST(detector.has_placement(box_type(100,10,140,20), elm_id, 60));
+    BOOST_TEST_EQ(detector.find_text(elm_street), elm_id);
+
+    // labels spanning several cells are found from every cell
+    detector.insert(box_type(150,150,450,160));
+    BOOST_TEST(!detector.has_point_placement(box_type(440,170,445,175), 20));
+    BOOST_TEST(detector.has_point_placement(box_type(440,200,445,205), 20));
+
+    // as with the quad_tree, labels outside the extent never collide with each other
+    detector.insert(box_type(-500,-500,-400,-400));
+    BOOST_TEST(detector.has_placement(box_type(-450,-450,-420,-420)));
+    // but are found by queries reaching into the extent
+    BOOST_TEST(!detector.has_placement(box_type(-450,-450,0,0)));
+
+    unsigned count = 0;
+    for (mapnik::label_collision_detector4::query_iterator itr = detector.begin(); itr != detector.end(); ++itr)
+    {
+        ++count;
+    }
+    BOOST_TEST_EQ(count, 3u);
+
+    detector.clear();
+    BOOST_TEST(detector.begin() == detector.end());
+    BOOST_TEST(detector.has_placement(box_type(10,10,50,20)));
+    BOOST_TEST(detector.has_placement(box_type(100,10,140,20), main_street, 60));
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ label collision detector: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
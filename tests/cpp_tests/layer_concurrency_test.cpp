@@ -0,0 +1,190 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/make_shared.hpp>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/polygon_symbolizer.hpp>
+#include <mapnik/line_symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/graphics.hpp>
+#include <mapnik/queued_featureset.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+namespace {
+
+// counts the queries run against it
+class counting_datasource : public mapnik::memory_datasource
+{
+public:
+    counting_datasource() : queries(0) {}
+
+    mapnik::featureset_ptr features(mapnik::query const& q) const
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        ++queries;
+        return mapnik::memory_datasource::features(q);
+    }
+
+    mutable unsigned queries;
+private:
+    mutable boost::mutex mutex_;
+};
+
+void produce(mapnik::feature_queue & queue, mapnik::feature_ptr feature, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (!queue.push(feature)) break;
+    }
+    queue.close();
+}
+
+mapnik::datasource_ptr make_datasource(int offset)
+{
+    mapnik::context_ptr ctx = boost::make_shared<mapnik::context_type>();
+    mapnik::datasource_ptr ds = boost::make_shared<counting_datasource>();
+    mapnik::memory_datasource * cache = dynamic_cast<mapnik::memory_datasource *>(ds.get());
+    for (int i = 0; i < 20; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,i));
+        mapnik::geometry_type * poly = new mapnik::geometry_type(mapnik::Polygon);
+        double x = -200 + i * 17 + offset;
+        double y = -180 + i * 13 - offset;
+        poly->move_to(x,y);
+        poly->line_to(x + 90,y + 10);
+        poly->line_to(x + 60,y + 85);
+        poly->line_to(x,y);
+        feature->add_geometry(poly);
+        cache->push(feature);
+    }
+    return ds;
+}
+
+void render(mapnik::Map const& m, mapnik::image_32 & buf, unsigned concurrency, std::size_t prefetch_size = 1024)
+{
+    mapnik::agg_renderer<mapnik::image_32> ren(m,buf);
+    ren.set_concurrency(concurrency);
+    ren.set_prefetch_size(prefetch_size);
+    ren.apply();
+}
+
+bool same(mapnik::image_32 const& a, mapnik::image_32 const& b)
+{
+    return std::memcmp(a.raw_data(), b.raw_data(), a.width() * a.height() * 4) == 0;
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::Map m(256,256);
+    m.set_background(mapnik::color(255,255,255));
+    for (int i = 0; i < 8; ++i)
+    {
+        std::ostringstream name;
+        name << "layer" << i;
+        mapnik::feature_type_style the_style;
+        mapnik::rule the_rule;
+        the_rule.append(mapnik::polygon_symbolizer(mapnik::color(30 * i, 255 - 30 * i, 90, 128)));
+        the_rule.append(mapnik::line_symbolizer(mapnik::color(0, 0, 0, 200), 1.5));
+        the_style.add_rule(the_rule);
+        // composited styles placing no labels are rasterized on the threads
+        if (i % 3 == 2)
+        {
+            the_style.set_comp_op(mapnik::multiply);
+        }
+        else if (i == 4)
+        {
+            the_style.set_opacity(0.6f);
+        }
+        m.insert_style(name.str(), the_style);
+        mapnik::layer lyr(name.str());
+        lyr.set_datasource(make_datasource(i * 11));
+        lyr.add_style(name.str());
+        if (i % 2 == 1)
+        {
+            // the second style queries again, or replays the features
+            // streamed for the first one if the layer caches them
+            mapnik::feature_type_style outline_style;
+            mapnik::rule outline_rule;
+            outline_rule.append(mapnik::line_symbolizer(mapnik::color(255, 0, 0, 160), 0.5));
+            outline_style.add_rule(outline_rule);
+            if (i == 1)
+            {
+                // composited after a style rendered in-line
+                outline_style.set_opacity(0.5f);
+            }
+            m.insert_style(name.str() + "-outline", outline_style);
+            lyr.add_style(name.str() + "-outline");
+            lyr.set_cache_features(i % 4 == 3);
+        }
+        m.addLayer(lyr);
+    }
+    m.zoom_to_box(mapnik::box2d<double>(-256,-256,256,256));
+
+    mapnik::image_32 serial(m.width(),m.height());
+    render(m, serial, 1);
+
+    mapnik::image_32 concurrent(m.width(),m.height());
+    render(m, concurrent, 4);
+
+    // rendering with concurrent datasource queries must be byte-identical
+    BOOST_TEST(same(serial, concurrent));
+    BOOST_TEST(serial.painted() == concurrent.painted());
+
+    // a tiny queue keeps threads blocked on layers that are not rendered yet
+    mapnik::image_32 tight(m.width(),m.height());
+    render(m, tight, 3, 1);
+    BOOST_TEST(same(serial, tight));
+
+    mapnik::image_32 unbounded(m.width(),m.height());
+    render(m, unbounded, 16, 0);
+    BOOST_TEST(same(serial, unbounded));
+
+    // streamed features are only recorded for layers caching them
+    for (unsigned i = 0; i < m.layer_count(); ++i)
+    {
+        dynamic_cast<counting_datasource &>(*m.getLayer(i).datasource()).queries = 0;
+    }
+    mapnik::image_32 requeried(m.width(),m.height());
+    render(m, requeried, 4);
+    BOOST_TEST(same(serial, requeried));
+    BOOST_TEST_EQ(dynamic_cast<counting_datasource &>(*m.getLayer(0).datasource()).queries, 1u);
+    BOOST_TEST_EQ(dynamic_cast<counting_datasource &>(*m.getLayer(1).datasource()).queries, 2u);
+    BOOST_TEST_EQ(dynamic_cast<counting_datasource &>(*m.getLayer(3).datasource()).queries, 1u);
+    BOOST_TEST_EQ(dynamic_cast<counting_datasource &>(*m.getLayer(4).datasource()).queries, 1u);
+    BOOST_TEST_EQ(dynamic_cast<counting_datasource &>(*m.getLayer(5).datasource()).queries, 2u);
+
+    // a featureset dropped before the end of the stream, e.g. because a
+    // symbolizer threw, releases the producer blocked on the full queue
+    {
+        mapnik::feature_queue_ptr queue = boost::make_shared<mapnik::feature_queue>(1);
+        mapnik::context_ptr ctx = boost::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,1));
+        boost::thread producer(boost::bind(&produce, boost::ref(*queue), feature, 100u));
+        {
+            mapnik::queued_featureset features(queue, boost::shared_ptr<mapnik::memory_datasource>());
+            BOOST_TEST(features.next());
+        }
+        producer.join();
+    }
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ layer concurrency: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
@@ -0,0 +1,83 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <string>
+#include <mapnik/mapped_memory_cache.hpp>
+
+int main( int, char*[] )
+{
+    mapnik::mapped_memory_cache & cache = mapnik::mapped_memory_cache::instance();
+    cache.clear();
+    cache.reset_stats();
+
+    std::string shp("tests/data/shp/poly.shp");
+    std::string dbf("tests/data/shp/poly.dbf");
+
+    // uncached lookups map the file without keeping it
+    BOOST_TEST(cache.find(shp, false));
+    BOOST_TEST(cache.find(shp, true));
+    BOOST_TEST(cache.find(dbf, true));
+    BOOST_TEST(cache.find(shp, true));
+    BOOST_TEST(!cache.find("tests/data/shp/does-not-exist.shp", true));
+
+    mapnik::mapped_memory_cache_stats stats = cache.stats();
+    BOOST_TEST_EQ(stats.hits, 1u);
+    BOOST_TEST_EQ(stats.misses, 4u);
+    BOOST_TEST_EQ(stats.entries, 2u);
+    BOOST_TEST_EQ(stats.evictions, 0u);
+    BOOST_TEST(stats.bytes >= 4580u + 529u);
+
+    // a budget smaller than any file evicts everything, but the
+    // caller still holds a valid region
+    boost::optional<mapnik::mapped_region_ptr> region = cache.find(shp, true);
+    BOOST_TEST(region);
+    cache.set_max_bytes(1);
+    stats = cache.stats();
+    BOOST_TEST_EQ(stats.entries, 0u);
+    BOOST_TEST_EQ(stats.bytes, 0u);
+    BOOST_TEST_EQ(stats.evictions, 2u);
+    BOOST_TEST_EQ((*region)->get_size(), 4580u);
+
+    // a region over the budget is reported as not cached
+    BOOST_TEST(!cache.insert(shp, *region));
+    BOOST_TEST_EQ(cache.stats().entries, 0u);
+
+    cache.set_max_bytes(0);
+    BOOST_TEST(cache.insert(shp, *region));
+    BOOST_TEST(!cache.insert(shp, *region));
+    cache.clear();
+    BOOST_TEST(cache.find(shp, true));
+    BOOST_TEST_EQ(cache.stats().entries, 1u);
+    cache.clear();
+    BOOST_TEST_EQ(cache.stats().entries, 0u);
+
+    // budgets are for the cache as a whole: files far larger than a
+    // sixteenth of the byte budget are kept
+    cache.set_max_bytes(8192);
+    BOOST_TEST(cache.find(shp, true));
+    BOOST_TEST(cache.find(dbf, true));
+    stats = cache.stats();
+    BOOST_TEST_EQ(stats.entries, 2u);
+    BOOST_TEST_EQ(stats.evictions, 2u);
+    BOOST_TEST(cache.find(shp, false));
+    BOOST_TEST_EQ(cache.stats().hits, 3u);
+
+    // and an entry limit below the number of shards is exact
+    cache.set_max_entries(1);
+    stats = cache.stats();
+    BOOST_TEST_EQ(stats.entries, 1u);
+    BOOST_TEST_EQ(stats.evictions, 3u);
+    BOOST_TEST(stats.bytes <= 8192u);
+    cache.set_max_entries(0);
+    cache.set_max_bytes(0);
+    cache.clear();
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ mapped memory cache: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
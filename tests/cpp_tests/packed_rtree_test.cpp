@@ -0,0 +1,110 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <mapnik/packed_rtree.hpp>
+
+namespace {
+
+// small deterministic generator, so failures reproduce
+struct lcg
+{
+    lcg() : state(12345) {}
+    double operator() (double range)
+    {
+        state = state * 1103515245u + 12345u;
+        return range * ((state >> 8) & 0xffff) / 65536.0;
+    }
+    unsigned state;
+};
+
+mapnik::box2d<double> random_box(lcg & rand)
+{
+    double x = rand(1000);
+    double y = rand(1000);
+    return mapnik::box2d<double>(x, y, x + rand(20), y + rand(20));
+}
+
+std::vector<std::size_t> brute_force(std::vector<mapnik::box2d<double> > const& boxes,
+                                     mapnik::box2d<double> const& query)
+{
+    std::vector<std::size_t> result;
+    for (std::size_t i = 0; i < boxes.size(); ++i)
+    {
+        if (query.intersects(boxes[i])) result.push_back(i);
+    }
+    return result;
+}
+
+bool same_results(mapnik::packed_rtree const& index,
+                  std::vector<mapnik::box2d<double> > const& boxes,
+                  lcg & rand)
+{
+    for (int q = 0; q < 200; ++q)
+    {
+        mapnik::box2d<double> query = random_box(rand);
+        query.pad(rand(50));
+        std::vector<std::size_t> found;
+        index.query(query, found);
+        std::sort(found.begin(), found.end());
+        if (found != brute_force(boxes, query)) return false;
+    }
+    return true;
+}
+
+}
+
+int main( int, char*[] )
+{
+    lcg rand;
+    std::vector<mapnik::box2d<double> > boxes;
+    mapnik::packed_rtree index;
+
+    // empty index
+    std::vector<std::size_t> found;
+    index.build();
+    index.query(mapnik::box2d<double>(0, 0, 1000, 1000), found);
+    BOOST_TEST(found.empty());
+
+    for (std::size_t i = 0; i < 5000; ++i)
+    {
+        boxes.push_back(random_box(rand));
+        index.insert(i, boxes.back());
+    }
+    // unpacked items are scanned
+    BOOST_TEST_EQ(index.unpacked(), 5000u);
+    BOOST_TEST(same_results(index, boxes, rand));
+
+    index.build();
+    BOOST_TEST_EQ(index.unpacked(), 0u);
+    BOOST_TEST_EQ(index.size(), 5000u);
+    BOOST_TEST(same_results(index, boxes, rand));
+
+    // items inserted after packing are found alongside packed ones
+    for (std::size_t i = 5000; i < 5100; ++i)
+    {
+        boxes.push_back(random_box(rand));
+        index.insert(i, boxes.back());
+    }
+    BOOST_TEST_EQ(index.unpacked(), 100u);
+    BOOST_TEST(same_results(index, boxes, rand));
+    index.build();
+    BOOST_TEST(same_results(index, boxes, rand));
+
+    // invalid boxes aren't stored
+    index.insert(9999, mapnik::box2d<double>());
+    BOOST_TEST_EQ(index.size(), 5100u);
+
+    index.clear();
+    BOOST_TEST_EQ(index.size(), 0u);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ packed rtree: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
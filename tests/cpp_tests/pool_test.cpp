@@ -0,0 +1,105 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+#include <mapnik/pool.hpp>
+#if defined(MAPNIK_THREADSAFE)
+#include <boost/thread/thread.hpp>
+#endif
+
+namespace {
+
+struct dummy_connection
+{
+    dummy_connection() : ok(true) {}
+    bool isOK() const { return ok; }
+    bool ok;
+};
+
+template <typename T>
+struct dummy_creator
+{
+    T* operator()() const
+    {
+        return new T;
+    }
+};
+
+typedef mapnik::Pool<dummy_connection, dummy_creator> pool_type;
+typedef boost::shared_ptr<dummy_connection> connection_ptr;
+
+#if defined(MAPNIK_THREADSAFE)
+void return_later(pool_type & pool, connection_ptr conn)
+{
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    pool.returnObject(conn);
+}
+#endif
+
+}
+
+int main( int, char*[] )
+{
+    pool_type pool(dummy_creator<dummy_connection>(), 1, 2);
+    BOOST_TEST_EQ(pool.size().first, 1u);
+
+    connection_ptr c1 = pool.borrowObject();
+    connection_ptr c2 = pool.borrowObject();
+    BOOST_TEST(c1 && c2 && c1 != c2);
+    BOOST_TEST_EQ(pool.size().second, 2u);
+    // without max_wait an exhausted pool fails right away
+    BOOST_TEST(!pool.borrowObject());
+
+    // returned objects are reused
+    pool.returnObject(c1);
+    connection_ptr c3 = pool.borrowObject();
+    BOOST_TEST(c3 == c1);
+
+    // broken objects are dropped on return and their slot reused
+    c3->ok = false;
+    pool.returnObject(c3);
+    BOOST_TEST_EQ(pool.size().second, 1u);
+    connection_ptr c4 = pool.borrowObject();
+    BOOST_TEST(c4 && c4 != c3);
+
+    // objects not borrowed from the pool are ignored
+    pool.returnObject(connection_ptr(new dummy_connection));
+    BOOST_TEST_EQ(pool.size().first, 0u);
+    BOOST_TEST_EQ(pool.size().second, 2u);
+
+#if defined(MAPNIK_THREADSAFE)
+    pool.set_max_wait(200);
+    // a borrower waits for the next returned object
+    boost::thread returner(boost::bind(&return_later, boost::ref(pool), c2));
+    connection_ptr c5 = pool.borrowObject();
+    returner.join();
+    BOOST_TEST(c5 == c2);
+
+    // and gives up after max_wait
+    pool.set_max_wait(10);
+    BOOST_TEST(!pool.borrowObject());
+
+    BOOST_TEST_EQ(pool.stats().waited, 2u);
+    BOOST_TEST_EQ(pool.stats().timeouts, 1u);
+    BOOST_TEST(pool.stats().wait_time > 0.0);
+#endif
+
+    // borrowIdleObject() neither waits nor creates objects
+    std::size_t waited = pool.stats().waited;
+    BOOST_TEST(!pool.borrowIdleObject());
+    BOOST_TEST_EQ(pool.stats().waited, waited);
+    pool.returnObject(c4);
+    BOOST_TEST(pool.borrowIdleObject() == c4);
+
+    BOOST_TEST_EQ(pool.stats().created, 3u);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ pool: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
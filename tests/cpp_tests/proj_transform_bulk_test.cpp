@@ -0,0 +1,138 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <mapnik/geometry.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/well_known_srs.hpp>
+
+namespace {
+
+// small deterministic generator, so failures reproduce
+struct lcg
+{
+    lcg() : state(12345) {}
+    double operator() (double min, double max)
+    {
+        state = state * 1103515245u + 12345u;
+        return min + (max - min) * ((state >> 8) & 0xffff) / 65536.0;
+    }
+    unsigned state;
+};
+
+void make_geometry(mapnik::geometry_type & geom, lcg & rand,
+                   double max_x, double max_y, std::vector<double> & coords)
+{
+    for (int i = 0; i < 1000; ++i)
+    {
+        double x = rand(-max_x, max_x);
+        double y = rand(-max_y, max_y);
+        if (i % 100 == 0) geom.move_to(x, y);
+        else if (i % 100 == 99) geom.close(x, y);
+        else geom.line_to(x, y);
+        coords.push_back(x);
+        coords.push_back(y);
+    }
+}
+
+// compares geom against coords transformed one point at a time
+bool same_as_pointwise(mapnik::geometry_type const& geom, std::vector<double> coords,
+                       mapnik::proj_transform const& tr, bool forward, double tolerance)
+{
+    mapnik::box2d<double> envelope;
+    for (std::size_t i = 0; i < geom.size(); ++i)
+    {
+        double x = coords[2 * i];
+        double y = coords[2 * i + 1];
+        double z = 0;
+        if (!(forward ? tr.forward(x, y, z) : tr.backward(x, y, z))) return false;
+        double gx, gy;
+        unsigned cmd = geom.vertex(i, &gx, &gy);
+        if (std::fabs(gx - x) > tolerance || std::fabs(gy - y) > tolerance) return false;
+        if (cmd == mapnik::SEG_CLOSE) continue;
+        if (envelope.valid()) envelope.expand_to_include(gx, gy);
+        else envelope.init(gx, gy, gx, gy);
+    }
+    return geom.envelope() == envelope;
+}
+
+}
+
+int main( int, char*[] )
+{
+    lcg rand;
+    mapnik::projection wgs84(mapnik::MAPNIK_LONGLAT_PROJ);
+    mapnik::projection merc(mapnik::MAPNIK_GMERC_PROJ);
+    mapnik::proj_transform tr(wgs84, merc);
+
+    // bulk approximations against the exact per point conversions,
+    // including points which get clamped
+    {
+        mapnik::geometry_type geom(mapnik::Polygon);
+        std::vector<double> coords;
+        make_geometry(geom, rand, 200, 90, coords);
+        BOOST_TEST(tr.forward(geom));
+        BOOST_TEST(same_as_pointwise(geom, coords, tr, true, 1e-6));
+        double x, y;
+        BOOST_TEST_EQ(geom.vertex(99, &x, &y), unsigned(mapnik::SEG_CLOSE));
+    }
+    {
+        mapnik::geometry_type geom(mapnik::LineString);
+        std::vector<double> coords;
+        make_geometry(geom, rand, 1.1 * mapnik::MAXEXTENT, 1.1 * mapnik::MAXEXTENT, coords);
+        BOOST_TEST(tr.backward(geom));
+        BOOST_TEST(same_as_pointwise(geom, coords, tr, false, 1e-12));
+    }
+
+    // no-op for equal projections and empty geometries
+    {
+        mapnik::proj_transform same(wgs84, wgs84);
+        mapnik::geometry_type geom(mapnik::Point);
+        BOOST_TEST(tr.forward(geom));
+        BOOST_TEST(!geom.envelope().valid());
+        geom.move_to(10, 20);
+        BOOST_TEST(same.forward(geom));
+        BOOST_TEST(geom.envelope() == mapnik::box2d<double>(10, 20, 10, 20));
+    }
+
+#ifdef MAPNIK_USE_PROJ4
+    // against proj4, with definitions which aren't recognized as well known
+    // so they go through pj_transform; both on the sphere to avoid a datum shift
+    {
+        mapnik::projection sphere_longlat("+proj=longlat +a=6378137 +b=6378137 +no_defs");
+        mapnik::projection sphere_merc("+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0.0 +k=1.0 +units=m +no_defs");
+        BOOST_TEST(!sphere_longlat.well_known() && !sphere_merc.well_known());
+        mapnik::proj_transform proj4_tr(sphere_longlat, sphere_merc);
+
+        mapnik::geometry_type geom(mapnik::Polygon);
+        mapnik::geometry_type proj4_geom(mapnik::Polygon);
+        std::vector<double> coords;
+        make_geometry(geom, rand, 180, 85, coords);
+        proj4_geom.append_vertices(&coords[0], coords.size() / 2, mapnik::SEG_LINETO);
+
+        BOOST_TEST(tr.forward(geom));
+        BOOST_TEST(same_as_pointwise(geom, coords, proj4_tr, true, 1e-6));
+        // the bulk pj_transform path matches proj4 one point at a time
+        BOOST_TEST(proj4_tr.forward(proj4_geom));
+        BOOST_TEST(same_as_pointwise(proj4_geom, coords, proj4_tr, true, 0));
+
+        std::vector<double> merc_coords(geom.coords(), geom.coords() + 2 * geom.size());
+        BOOST_TEST(tr.backward(geom));
+        BOOST_TEST(same_as_pointwise(geom, merc_coords, proj4_tr, false, 1e-12));
+        merc_coords.assign(proj4_geom.coords(), proj4_geom.coords() + 2 * proj4_geom.size());
+        BOOST_TEST(proj4_tr.backward(proj4_geom));
+        BOOST_TEST(same_as_pointwise(proj4_geom, merc_coords, proj4_tr, false, 0));
+    }
+#endif
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ proj_transform bulk: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
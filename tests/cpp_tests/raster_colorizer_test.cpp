@@ -0,0 +1,94 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/make_shared.hpp>
+#include <iostream>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <mapnik/raster.hpp>
+#include <mapnik/raster_colorizer.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+
+namespace {
+
+std::vector<float> make_values()
+{
+    std::vector<float> values;
+    for (float v = -20.0f; v < 120.0f; v += 0.37f)
+    {
+        values.push_back(v);
+        values.push_back(v); // runs of equal values
+    }
+    // exactly on the stops
+    values.push_back(0.0f);
+    values.push_back(10.0f);
+    values.push_back(50.0f);
+    values.push_back(100.0f);
+    values.push_back(-9999.0f);
+    values.push_back(std::numeric_limits<float>::quiet_NaN());
+    values.push_back(std::numeric_limits<float>::infinity());
+    values.push_back(-std::numeric_limits<float>::infinity());
+    return values;
+}
+
+// colorize() must give the same colors as get_color() for every pixel
+void check(mapnik::raster_colorizer const& colorizer, bool nodata)
+{
+    std::vector<float> values = make_values();
+    mapnik::raster_ptr raster = boost::make_shared<mapnik::raster>(mapnik::box2d<double>(0, 0, 1, 1), values.size(), 1);
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+        std::memcpy(&raster->data_.getData()[i], &values[i], sizeof(float));
+    }
+
+    mapnik::context_ptr ctx = boost::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    if (nodata) feature->put_new("NODATA", -9999.0);
+    colorizer.colorize(raster, *feature);
+
+    unsigned mismatches = 0;
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+        unsigned expected = (nodata && values[i] == -9999.0f) ? 0 : colorizer.get_color(values[i]).rgba();
+        if (raster->data_.getData()[i] != expected) ++mismatches;
+    }
+    BOOST_TEST_EQ(mismatches, 0u);
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::raster_colorizer colorizer(mapnik::COLORIZER_LINEAR, mapnik::color(10, 20, 30, 40));
+    check(colorizer, false);
+
+    colorizer.add_stop(mapnik::colorizer_stop(0, mapnik::COLORIZER_INHERIT, mapnik::color(0, 0, 255)));
+    colorizer.add_stop(mapnik::colorizer_stop(10, mapnik::COLORIZER_DISCRETE, mapnik::color(0, 255, 0, 128)));
+    colorizer.add_stop(mapnik::colorizer_stop(50, mapnik::COLORIZER_EXACT, mapnik::color(255, 0, 0)));
+    colorizer.add_stop(mapnik::colorizer_stop(50.5, mapnik::COLORIZER_LINEAR, mapnik::color(255, 255, 0)));
+    colorizer.add_stop(mapnik::colorizer_stop(100, mapnik::COLORIZER_INHERIT, mapnik::color(255, 255, 255)));
+    check(colorizer, false);
+    check(colorizer, true);
+
+    colorizer.set_default_mode(mapnik::COLORIZER_EXACT);
+    colorizer.set_epsilon(0.5f);
+    check(colorizer, true);
+
+    // stops set as a whole are not necessarily ordered
+    mapnik::colorizer_stops stops;
+    stops.push_back(mapnik::colorizer_stop(30, mapnik::COLORIZER_LINEAR, mapnik::color(0, 0, 255)));
+    stops.push_back(mapnik::colorizer_stop(5, mapnik::COLORIZER_DISCRETE, mapnik::color(0, 255, 0)));
+    stops.push_back(mapnik::colorizer_stop(60, mapnik::COLORIZER_LINEAR, mapnik::color(255, 0, 0)));
+    colorizer.set_stops(stops);
+    check(colorizer, false);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ raster colorizer: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
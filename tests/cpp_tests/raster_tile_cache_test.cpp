@@ -0,0 +1,73 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/make_shared.hpp>
+#include <iostream>
+#include <mapnik/raster_tile_cache.hpp>
+
+namespace {
+
+mapnik::raster_tile_ptr make_tile(unsigned size)
+{
+    return boost::make_shared<mapnik::image_data_32>(size, size);
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::raster_tile_cache & cache = mapnik::raster_tile_cache::instance();
+    cache.clear();
+    cache.reset_stats();
+
+    // tiles are told apart by file, position and size
+    mapnik::raster_tile_key key("hillshade.tif", 256, 0, 256, 256);
+    BOOST_TEST(!cache.find(key));
+    cache.insert(key, make_tile(256));
+    cache.insert(mapnik::raster_tile_key("hillshade.tif", 0, 0, 256, 256), make_tile(256));
+    cache.insert(mapnik::raster_tile_key("hillshade.tif", 0, 0, 512, 512), make_tile(512));
+    mapnik::raster_tile_ptr tile = cache.find(key);
+    BOOST_TEST(tile && tile->width() == 256u);
+    tile = cache.find(mapnik::raster_tile_key("hillshade.tif", 0, 0, 512, 512));
+    BOOST_TEST(tile && tile->width() == 512u);
+    BOOST_TEST(!cache.find(mapnik::raster_tile_key("ortho.tif", 256, 0, 256, 256)));
+
+    mapnik::raster_tile_cache_stats stats = cache.stats();
+    BOOST_TEST_EQ(stats.hits, 2u);
+    BOOST_TEST_EQ(stats.misses, 2u);
+    BOOST_TEST_EQ(stats.entries, 3u);
+    BOOST_TEST(stats.bytes >= (2 * 256 * 256 + 512 * 512) * 4u);
+
+    // tiles handed out stay valid after eviction
+    cache.set_max_bytes(1);
+    BOOST_TEST_EQ(cache.stats().entries, 0u);
+    BOOST_TEST_EQ(cache.stats().evictions, 3u);
+    BOOST_TEST(tile && tile->width() == 512u);
+
+    // zero disables the cache
+    cache.set_max_bytes(0);
+    cache.insert(key, make_tile(256));
+    BOOST_TEST(!cache.find(key));
+    cache.set_max_bytes(64 * 1024 * 1024);
+    cache.insert(key, make_tile(256));
+    BOOST_TEST(cache.find(key));
+
+    // the budget is for the whole cache: a whole-file tile far above a
+    // sixteenth of it is kept, along with the smaller ones
+    mapnik::raster_tile_key large("large.tif", 0, 0, 1024, 1024);
+    cache.insert(large, make_tile(1024));
+    tile = cache.find(large);
+    BOOST_TEST(tile && tile->width() == 1024u);
+    BOOST_TEST(cache.find(key));
+    BOOST_TEST_EQ(cache.stats().entries, 2u);
+    cache.clear();
+    BOOST_TEST_EQ(cache.stats().entries, 0u);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ raster tile cache: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
@@ -0,0 +1,161 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/make_shared.hpp>
+#include <iostream>
+#include <string>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/line_symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/graphics.hpp>
+#include <mapnik/rendering_stats.hpp>
+
+namespace {
+
+// 10 lines, half of them of kind 'a'
+mapnik::datasource_ptr make_datasource(double offset)
+{
+    mapnik::transcoder tr("utf-8");
+    mapnik::context_ptr ctx = boost::make_shared<mapnik::context_type>();
+    mapnik::datasource_ptr ds = boost::make_shared<mapnik::memory_datasource>();
+    mapnik::memory_datasource * cache = dynamic_cast<mapnik::memory_datasource *>(ds.get());
+    for (int i = 0; i < 10; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,i));
+        feature->put("kind",tr.transcode(i % 2 ? "b" : "a"));
+        mapnik::geometry_type * line = new mapnik::geometry_type(mapnik::LineString);
+        line->move_to(offset + i * 10, offset);
+        line->line_to(offset + i * 10 + 50, offset + 50);
+        feature->add_geometry(line);
+        cache->push(feature);
+    }
+    return ds;
+}
+
+void add_style(mapnik::Map & m, std::string const& name, std::string const& filter)
+{
+    mapnik::feature_type_style style;
+    mapnik::rule r;
+    r.set_filter(mapnik::parse_expression(filter,"utf-8"));
+    r.append(mapnik::line_symbolizer(mapnik::color(0, 0, 0), 1.0));
+    style.add_rule(r);
+    m.insert_style(name, style);
+}
+
+void render(mapnik::Map const& m, mapnik::rendering_stats * stats, unsigned concurrency)
+{
+    mapnik::image_32 buf(m.width(),m.height());
+    mapnik::agg_renderer<mapnik::image_32> ren(m,buf);
+    ren.set_concurrency(concurrency);
+    ren.set_rendering_stats(stats);
+    ren.apply();
+}
+
+void check(mapnik::rendering_stats const& stats)
+{
+    // the layer outside of the map extent is not rendered
+    BOOST_TEST_EQ(stats.layers.size(), 2u);
+    if (stats.layers.size() != 2) return;
+
+    mapnik::layer_stats const& roads = stats.layers[0];
+    BOOST_TEST_EQ(roads.name, std::string("roads"));
+    BOOST_TEST_EQ(roads.styles.size(), 2u);
+    if (roads.styles.size() == 2)
+    {
+        BOOST_TEST_EQ(roads.styles[0].name, std::string("a-only"));
+        BOOST_TEST_EQ(roads.styles[0].features_queried, 10u);
+        BOOST_TEST_EQ(roads.styles[0].features_rendered, 5u);
+        BOOST_TEST_EQ(roads.styles[1].name, std::string("all"));
+        BOOST_TEST_EQ(roads.styles[1].features_rendered, 10u);
+        // line symbolizers place no labels
+        BOOST_TEST_EQ(roads.styles[1].label_attempts, 0u);
+    }
+    BOOST_TEST_EQ(roads.features_queried(), 20u);
+    BOOST_TEST_EQ(roads.features_rendered(), 15u);
+
+    mapnik::layer_stats const& rails = stats.layers[1];
+    BOOST_TEST_EQ(rails.name, std::string("rails"));
+    BOOST_TEST_EQ(rails.features_queried(), 10u);
+    BOOST_TEST_EQ(rails.features_rendered(), 0u);
+
+    for (std::size_t i = 0; i < stats.layers.size(); ++i)
+    {
+        mapnik::layer_stats const& lyr = stats.layers[i];
+        BOOST_TEST(lyr.query_time >= 0 && lyr.render_time >= lyr.query_time);
+        BOOST_TEST(stats.total_time >= lyr.render_time);
+        for (std::size_t j = 0; j < lyr.styles.size(); ++j)
+        {
+            mapnik::style_stats const& st = lyr.styles[j];
+            BOOST_TEST(st.render_time >= st.query_time + st.symbolizer_time);
+        }
+    }
+    BOOST_TEST(stats.slowest_layer() != 0);
+    BOOST_TEST(stats.to_string().find("layer 'roads'") != std::string::npos);
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::Map m(256,256);
+    add_style(m, "a-only", "[kind]='a'");
+    add_style(m, "all", "true");
+    add_style(m, "none", "[kind]='c'");
+
+    mapnik::layer roads("roads");
+    roads.set_datasource(make_datasource(0));
+    roads.add_style("a-only");
+    roads.add_style("all");
+    m.addLayer(roads);
+
+    mapnik::layer rails("rails");
+    rails.set_datasource(make_datasource(20));
+    rails.add_style("none");
+    m.addLayer(rails);
+
+    mapnik::layer elsewhere("elsewhere");
+    elsewhere.set_datasource(make_datasource(10000));
+    elsewhere.add_style("all");
+    m.addLayer(elsewhere);
+
+    m.zoom_to_box(mapnik::box2d<double>(-10,-10,200,200));
+
+    mapnik::rendering_stats stats;
+    render(m, &stats, 1);
+    check(stats);
+
+    // stats are reset by every rendering
+    render(m, &stats, 1);
+    check(stats);
+
+    // same counts when the datasources are queried concurrently
+    render(m, &stats, 4);
+    check(stats);
+
+    // and when the layer caches its features for both styles
+    m.getLayer(0).set_cache_features(true);
+    render(m, &stats, 1);
+    check(stats);
+    render(m, &stats, 4);
+    check(stats);
+
+    // collecting nothing
+    render(m, 0, 1);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ rendering stats: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
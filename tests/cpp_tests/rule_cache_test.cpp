@@ -0,0 +1,102 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/make_shared.hpp>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_evaluator.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/rule_cache.hpp>
+
+namespace {
+
+mapnik::feature_ptr make_feature(mapnik::context_ptr const& ctx, int id, mapnik::value const& highway)
+{
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,id));
+    feature->put("highway",highway);
+    feature->put("bridge",id % 2);
+    return feature;
+}
+
+// matching rules in order, as evaluated by the expression visitor
+std::vector<std::size_t> expected_matches(std::vector<mapnik::rule> const& rules, mapnik::feature_impl const& feature)
+{
+    std::vector<std::size_t> result;
+    for (std::size_t i = 0; i < rules.size(); ++i)
+    {
+        mapnik::value_type v = boost::apply_visitor(mapnik::evaluate<mapnik::Feature,mapnik::value_type>(feature),*rules[i].get_filter());
+        if (v.to_bool()) result.push_back(i);
+    }
+    return result;
+}
+
+}
+
+int main( int, char*[] )
+{
+    char const* filters[] = {
+        "[highway]='motorway'",
+        "[highway]='trunk'",
+        "[bridge]=1",
+        "[highway]='primary'",
+        "'primary'=[highway]",
+        "[highway]='secondary' and [bridge]=1",
+        "[highway]='secondary'",
+        "[highway]='primary' or [highway]='trunk'",
+        "[highway]!='motorway'",
+        "[highway]='residential'"
+    };
+    std::vector<mapnik::rule> rules;
+    for (unsigned i = 0; i < sizeof(filters) / sizeof(filters[0]); ++i)
+    {
+        mapnik::rule r;
+        r.set_filter(mapnik::parse_expression(filters[i]));
+        rules.push_back(r);
+    }
+
+    mapnik::rule_cache rc;
+    for (std::size_t i = 0; i < rules.size(); ++i)
+    {
+        rc.add_rule(rules[i]);
+    }
+    // motorway, trunk, both primary rules, secondary and residential are dispatched
+    BOOST_TEST_EQ(rc.indexed_rules(), 6u);
+
+    mapnik::transcoder tr("utf-8");
+    mapnik::context_ptr ctx = boost::make_shared<mapnik::context_type>();
+    ctx->push("highway");
+    ctx->push("bridge");
+    std::vector<mapnik::feature_ptr> features;
+    features.push_back(make_feature(ctx,1,tr.transcode("motorway")));
+    features.push_back(make_feature(ctx,2,tr.transcode("primary")));
+    features.push_back(make_feature(ctx,3,tr.transcode("secondary")));
+    features.push_back(make_feature(ctx,4,tr.transcode("footway")));
+    features.push_back(make_feature(ctx,5,mapnik::value_integer(7)));
+    features.push_back(make_feature(ctx,6,mapnik::value_null()));
+    features.push_back(make_feature(ctx,7,tr.transcode("trunk")));
+
+    for (std::size_t f = 0; f < features.size(); ++f)
+    {
+        std::vector<std::size_t> expected = expected_matches(rules, *features[f]);
+        std::vector<std::size_t> actual;
+        rc.bind(*features[f]);
+        for (std::size_t i = rc.next_match(0); i != mapnik::rule_cache::no_match; i = rc.next_match(i + 1))
+        {
+            actual.push_back(i);
+        }
+        BOOST_TEST(actual == expected);
+    }
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ rule cache: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
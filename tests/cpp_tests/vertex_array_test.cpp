@@ -0,0 +1,87 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <mapnik/geometry.hpp>
+
+namespace {
+
+template <template <typename> class Container>
+void build(mapnik::geometry<double,Container> & geom)
+{
+    double xy[600];
+    for (int i = 0; i < 300; ++i)
+    {
+        xy[2 * i] = i;
+        xy[2 * i + 1] = -i;
+    }
+    geom.move_to(0, 0);
+    for (int i = 1; i < 100; ++i)
+    {
+        geom.line_to(i, i * 2);
+    }
+    geom.line_to(0, 0);
+    geom.set_close();
+    geom.move_to(5, 5);
+    geom.append_vertices(xy, 300, mapnik::SEG_LINETO);
+    geom.close(5, 5);
+}
+
+}
+
+int main( int, char*[] )
+{
+    typedef mapnik::geometry<double,mapnik::vertex_vector> block_geometry;
+    typedef mapnik::geometry<double,mapnik::vertex_array> array_geometry;
+
+    array_geometry pt(mapnik::Point);
+    pt.move_to(1, 2);
+    BOOST_TEST_EQ(pt.data().capacity(), 1u);
+    double x, y;
+    BOOST_TEST_EQ(pt.vertex(0, &x, &y), unsigned(mapnik::SEG_MOVETO));
+    BOOST_TEST(x == 1 && y == 2);
+    BOOST_TEST_EQ(pt.vertex(1, &x, &y), unsigned(mapnik::SEG_END));
+
+    // appending nothing to an empty geometry leaves it unallocated
+    array_geometry empty(mapnik::LineString);
+    empty.append_vertices(0, 0, mapnik::SEG_LINETO);
+    BOOST_TEST_EQ(empty.size(), 0u);
+    BOOST_TEST_EQ(empty.data().capacity(), 0u);
+
+    // same vertices and commands as the block container
+    block_geometry expected(mapnik::Polygon);
+    array_geometry actual(mapnik::Polygon);
+    build(expected);
+    build(actual);
+    BOOST_TEST_EQ(actual.size(), 403u);
+    BOOST_TEST_EQ(actual.size(), expected.size());
+    bool same = true;
+    for (unsigned i = 0; i <= actual.size(); ++i)
+    {
+        double ex, ey, ax, ay;
+        unsigned ecmd = expected.vertex(i, &ex, &ey);
+        unsigned acmd = actual.vertex(i, &ax, &ay);
+        same = same && ecmd == acmd && (ecmd == mapnik::SEG_END || (ex == ax && ey == ay));
+    }
+    BOOST_TEST(same);
+    BOOST_TEST_EQ(actual.vertex(99, &x, &y), unsigned(mapnik::SEG_LINETO));
+    BOOST_TEST_EQ(actual.vertex(100, &x, &y), unsigned(mapnik::SEG_CLOSE));
+    BOOST_TEST(actual.envelope() == expected.envelope());
+
+    // reserve sizes the storage once
+    array_geometry line(mapnik::LineString);
+    line.reserve(1000);
+    for (int i = 0; i < 1000; ++i)
+    {
+        line.line_to(i, i);
+    }
+    BOOST_TEST_EQ(line.data().capacity(), 1000u);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ vertex array: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
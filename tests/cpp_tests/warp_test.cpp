@@ -0,0 +1,95 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <cstring>
+#include <mapnik/raster.hpp>
+#include <mapnik/warp.hpp>
+#include <mapnik/warp_mesh_cache.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+
+namespace {
+
+void fill(mapnik::raster & source)
+{
+    for (unsigned y = 0; y < source.data_.height(); ++y)
+    {
+        unsigned * row = source.data_.getRow(y);
+        for (unsigned x = 0; x < source.data_.width(); ++x)
+        {
+            row[x] = 0xff000000 | ((x * 7) & 0xff) << 8 | ((y * 13) & 0xff);
+        }
+    }
+}
+
+bool same_pixels(mapnik::raster const& a, mapnik::raster const& b)
+{
+    return std::memcmp(a.data_.getData(), b.data_.getData(),
+                       a.data_.width() * a.data_.height() * 4) == 0;
+}
+
+}
+
+int main( int, char*[] )
+{
+    mapnik::projection source_prj("+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs");
+    mapnik::projection dest_prj("+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 +units=m +nadgrids=@null +no_defs");
+    // transforms from the map (dest) to the layer (source) srs
+    mapnik::proj_transform prj_trans(dest_prj, source_prj);
+
+    mapnik::raster source(mapnik::box2d<double>(5, 40, 15, 60), 300, 400);
+    fill(source);
+    mapnik::box2d<double> target_ext(source.ext_);
+    prj_trans.backward(target_ext, 20);
+
+    mapnik::warp_mesh_cache & cache = mapnik::warp_mesh_cache::instance();
+    cache.clear();
+    cache.reset_stats();
+
+    mapnik::raster serial(target_ext, 256, 256);
+    mapnik::reproject_and_scale_raster(serial, source, prj_trans, 0, 0, 16, 1.0, mapnik::SCALING_BILINEAR);
+    BOOST_TEST_EQ(cache.stats().misses, 1u);
+    BOOST_TEST_EQ(cache.stats().entries, 1u);
+
+    // the mesh is reused, and bands give the same pixels as a single pass
+    mapnik::raster banded(target_ext, 256, 256);
+    mapnik::reproject_and_scale_raster(banded, source, prj_trans, 0, 0, 16, 1.0, mapnik::SCALING_BILINEAR, 4);
+    BOOST_TEST_EQ(cache.stats().hits, 1u);
+    BOOST_TEST(same_pixels(serial, banded));
+
+    mapnik::raster serial_near(target_ext, 256, 256);
+    mapnik::reproject_and_scale_raster(serial_near, source, prj_trans, 0.5, 0.5, 16, 1.0, mapnik::SCALING_NEAR);
+    mapnik::raster banded_near(target_ext, 256, 256);
+    mapnik::reproject_and_scale_raster(banded_near, source, prj_trans, 0.5, 0.5, 16, 1.0, mapnik::SCALING_NEAR, 3);
+    BOOST_TEST(same_pixels(serial_near, banded_near));
+    BOOST_TEST_EQ(cache.stats().hits, 3u);
+
+    // another mesh size is another mesh
+    mapnik::raster coarse(target_ext, 256, 256);
+    mapnik::reproject_and_scale_raster(coarse, source, prj_trans, 0, 0, 32, 1.0, mapnik::SCALING_BILINEAR);
+    BOOST_TEST_EQ(cache.stats().entries, 2u);
+
+    cache.set_max_entries(1);
+    BOOST_TEST_EQ(cache.stats().entries, 1u);
+    BOOST_TEST_EQ(cache.stats().evictions, 1u);
+    cache.set_max_entries(256);
+
+    // meshes are accounted by size too
+    mapnik::raster fine(target_ext, 256, 256);
+    mapnik::reproject_and_scale_raster(fine, source, prj_trans, 0, 0, 8, 1.0, mapnik::SCALING_BILINEAR);
+    BOOST_TEST_EQ(cache.stats().entries, 2u);
+    std::size_t max_bytes = cache.max_bytes();
+    cache.set_max_bytes(cache.stats().bytes - 1);
+    BOOST_TEST_EQ(cache.stats().entries, 1u);
+    BOOST_TEST(cache.stats().bytes <= cache.max_bytes());
+    cache.set_max_bytes(max_bytes);
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ warp: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
@@ -0,0 +1,126 @@
+#include <boost/version.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <iostream>
+#include <string>
+#include <mapnik/wkb.hpp>
+#include <mapnik/geometry.hpp>
+
+namespace {
+
+// minimal WKB writer, xdr == big endian
+struct wkb_writer
+{
+    explicit wkb_writer(bool xdr)
+        : xdr_(xdr)
+    {
+        buf_ += static_cast<char>(xdr ? 0 : 1);
+    }
+
+    void put_bytes(char const* data, unsigned size)
+    {
+        boost::uint32_t one = 1;
+        bool big_endian_host = *reinterpret_cast<unsigned char const*>(&one) == 0;
+        if (xdr_ != big_endian_host)
+        {
+            for (unsigned i = size; i > 0; --i) buf_ += data[i - 1];
+        }
+        else
+        {
+            buf_.append(data, size);
+        }
+    }
+
+    void put_int(boost::int32_t n) { put_bytes(reinterpret_cast<char const*>(&n), 4); }
+    void put_double(double d) { put_bytes(reinterpret_cast<char const*>(&d), 8); }
+
+    void put_xy(double x, double y, bool xyz)
+    {
+        put_double(x);
+        put_double(y);
+        if (xyz) put_double(-1.0);
+    }
+
+    bool xdr_;
+    std::string buf_;
+};
+
+std::string make_linestring(bool xdr, bool xyz, int num_points)
+{
+    wkb_writer w(xdr);
+    w.put_int(xyz ? 1002 : 2);
+    w.put_int(num_points);
+    for (int i = 0; i < num_points; ++i) w.put_xy(i, i * 0.5, xyz);
+    return w.buf_;
+}
+
+// a closed outer ring and an unclosed inner ring
+std::string make_polygon(bool xdr, bool xyz)
+{
+    wkb_writer w(xdr);
+    w.put_int(xyz ? 1003 : 3);
+    w.put_int(2);
+    w.put_int(5);
+    w.put_xy(0, 0, xyz); w.put_xy(10, 0, xyz); w.put_xy(10, 10, xyz); w.put_xy(0, 10, xyz); w.put_xy(0, 0, xyz);
+    w.put_int(3);
+    w.put_xy(2, 2, xyz); w.put_xy(4, 2, xyz); w.put_xy(4, 4, xyz);
+    return w.buf_;
+}
+
+bool decode(std::string const& wkb, boost::ptr_vector<mapnik::geometry_type> & paths)
+{
+    return mapnik::geometry_utils::from_wkb(paths, wkb.data(), wkb.size());
+}
+
+}
+
+int main( int, char*[] )
+{
+    // long lines span several vertex blocks, in every byte order and dimension
+    for (int variant = 0; variant < 4; ++variant)
+    {
+        bool xdr = variant & 1;
+        bool xyz = variant & 2;
+        boost::ptr_vector<mapnik::geometry_type> paths;
+        BOOST_TEST(decode(make_linestring(xdr, xyz, 600), paths));
+        BOOST_TEST_EQ(paths.size(), 1u);
+        BOOST_TEST_EQ(paths[0].size(), 600u);
+        bool same = true;
+        for (unsigned i = 0; i < paths[0].size(); ++i)
+        {
+            double x, y;
+            unsigned cmd = paths[0].vertex(i, &x, &y);
+            same = same && cmd == (i == 0 ? mapnik::SEG_MOVETO : mapnik::SEG_LINETO);
+            same = same && x == i && y == i * 0.5;
+        }
+        BOOST_TEST(same);
+    }
+
+    for (int variant = 0; variant < 4; ++variant)
+    {
+        bool xdr = variant & 1;
+        bool xyz = variant & 2;
+        boost::ptr_vector<mapnik::geometry_type> paths;
+        BOOST_TEST(decode(make_polygon(xdr, xyz), paths));
+        BOOST_TEST_EQ(paths.size(), 1u);
+        mapnik::geometry_type const& poly = paths[0];
+        BOOST_TEST_EQ(poly.size(), 8u);
+        double x, y;
+        BOOST_TEST_EQ(poly.vertex(0, &x, &y), unsigned(mapnik::SEG_MOVETO));
+        BOOST_TEST_EQ(poly.vertex(3, &x, &y), unsigned(mapnik::SEG_LINETO));
+        BOOST_TEST(x == 0 && y == 10);
+        BOOST_TEST_EQ(poly.vertex(4, &x, &y), unsigned(mapnik::SEG_CLOSE));
+        BOOST_TEST_EQ(poly.vertex(5, &x, &y), unsigned(mapnik::SEG_MOVETO));
+        BOOST_TEST(x == 2 && y == 2);
+        BOOST_TEST_EQ(poly.vertex(7, &x, &y), unsigned(mapnik::SEG_LINETO));
+        BOOST_TEST(x == 4 && y == 4);
+    }
+
+    if (!::boost::detail::test_errors()) {
+        std::clog << "C++ wkb: \x1b[1;32m✓ \x1b[0m\n";
+#if BOOST_VERSION >= 104600
+        ::boost::detail::report_errors_remind().called_report_errors_function = true;
+#endif
+    } else {
+        return ::boost::report_errors();
+    }
+}
@@ -566,6 +566,32 @@ if 'csv' in mapnik.DatasourceCache.plugin_names():
         eq_(desc['geometry_type'],mapnik.DataGeometryType.Point)
         eq_(len(ds.all_features()),8)
 
+    def test_streaming_matches_in_memory(**kwargs):
+        for name in ['points.csv','wkt.csv','number_types.csv','geojson_double_quote_escape.csv','windows_newlines.csv']:
+            ds = get_csv_ds(name)
+            streamed = mapnik.Datasource(type='csv',file=os.path.join('../data/csv/',name),streaming=True)
+            eq_(streamed.fields(),ds.fields())
+            eq_(streamed.field_types(),ds.field_types())
+            eq_(streamed.envelope(),ds.envelope())
+            eq_(streamed.describe()['geometry_type'],ds.describe()['geometry_type'])
+            expected = ds.all_features()
+            features = streamed.all_features()
+            eq_(len(features),len(expected))
+            for feat, other in zip(features,expected):
+                eq_(feat.id(),other.id())
+                eq_(feat.attributes,other.attributes)
+                eq_(feat.geometries().to_wkt(),other.geometries().to_wkt())
+
+    def test_streaming_reads_only_requested_fields(**kwargs):
+        ds = mapnik.Datasource(type='csv',file=os.path.join('../data/csv/','points.csv'),streaming=True)
+        query = mapnik.Query(mapnik.Box2d(-1,-1,1,1))
+        query.add_property_name('label')
+        feat = ds.features(query).next()
+        eq_(feat['label'],'0,0')
+        # other fields aren't parsed
+        eq_(feat['x'],None)
+        eq_(feat['y'],None)
+
 if __name__ == "__main__":
     setup()
     [eval(run)(visual=True) for run in dir() if 'test_' in run]
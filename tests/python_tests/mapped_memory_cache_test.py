@@ -0,0 +1,42 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+from nose.tools import *
+from utilities import execution_path
+
+import os, mapnik
+
+def setup():
+    # All of the paths used are relative, if we run the tests
+    # from another directory we need to chdir()
+    os.chdir(execution_path('.'))
+
+def test_mapped_memory_cache_stats():
+    mapnik.clear_cache()
+    stats = mapnik.mapped_memory_cache_stats()
+    eq_(sorted(stats.keys()), ['bytes', 'entries', 'evictions', 'hits', 'misses'])
+    eq_(stats['entries'], 0)
+    eq_(stats['bytes'], 0)
+
+if 'shape' in mapnik.DatasourceCache.plugin_names():
+
+    def test_mapped_memory_cache_eviction():
+        mapnik.clear_cache()
+        ds = mapnik.Shapefile(file='../data/shp/poly')
+        ds.all_features()
+        stats = mapnik.mapped_memory_cache_stats()
+        # nothing is cached if the shape plugin does not memory map files
+        if stats['entries'] > 0:
+            evictions = stats['evictions']
+            mapnik.set_mapped_memory_cache_limits(max_bytes=1)
+            stats = mapnik.mapped_memory_cache_stats()
+            eq_(stats['entries'], 0)
+            eq_(stats['bytes'], 0)
+            assert stats['evictions'] > evictions
+            mapnik.set_mapped_memory_cache_limits()
+            # the datasource is still usable after its files were evicted
+            eq_(len(ds.all_features()), 10)
+
+if __name__ == "__main__":
+    setup()
+    [eval(run)() for run in dir() if 'test_' in run]
@@ -29,5 +29,31 @@ def test_add_feature():
         retrieved.append(feat)
     eq_(len(retrieved), 0)
 
+def test_indexed_queries():
+    md = mapnik.MemoryDatasource()
+    context = mapnik.Context()
+    context.push('id')
+    for i in range(100):
+        feature = mapnik.Feature(context,i)
+        feature['id'] = i
+        feature.add_geometries_from_wkt('POINT(%d %d)' % (i % 10, i // 10))
+        md.add_feature(feature)
+
+    def ids(box):
+        return [feat['id'] for feat in md.features(mapnik.Query(box))]
+
+    # features come back in the order they were added
+    eq_(ids(mapnik.Box2d(1.5,1.5,3.5,2.5)), [22,23])
+    eq_(len(ids(mapnik.Box2d(-1,-1,10,10))), 100)
+
+    # features added after the index was built are found too
+    feature = mapnik.Feature(context,100)
+    feature['id'] = 100
+    feature.add_geometries_from_wkt('LINESTRING(2 2,50 50)')
+    md.add_feature(feature)
+    eq_(ids(mapnik.Box2d(1.5,1.5,3.5,2.5)), [22,23,100])
+    eq_(ids(mapnik.Box2d(40,40,41,41)), [100])
+    eq_(len(list(md.features_at_point(mapnik.Coord(0,9)))), 1)
+
 if __name__ == "__main__":
     [eval(run)() for run in dir() if 'test_' in run]
@@ -18,6 +18,13 @@ def assert_broken_file(fname):
 def assert_good_file(fname):
     assert mapnik.Image.open(fname)
 
+def assert_broken_buffer(fname):
+    assert_raises(RuntimeError, lambda: mapnik.Image.fromstring(open(fname,'rb').read()))
+
+def assert_good_buffer(fname):
+    im = mapnik.Image.fromstring(open(fname,'rb').read())
+    eq_(im.tostring(), mapnik.Image.open(fname).tostring())
+
 def get_pngs(good):
     files = [ x for x in os.listdir(datadir) if x.endswith('.png') ]
     return [ os.path.join(datadir, x) for x in files if good != x.startswith('x') ]
@@ -30,6 +37,14 @@ def test_broken_pngs():
     for x in get_pngs(False):
         yield assert_broken_file, x
 
+def test_good_png_buffers():
+    for x in get_pngs(True):
+        yield assert_good_buffer, x
+
+def test_broken_png_buffers():
+    for x in get_pngs(False):
+        yield assert_broken_buffer, x
+
 if __name__ == "__main__":
     setup()
     [eval(run)() for run in dir() if 'test_' in run]
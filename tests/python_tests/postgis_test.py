@@ -479,6 +479,10 @@ if 'postgis' in mapnik.DatasourceCache.plugin_names() \
             t.start()
             t.join()
 
+    @raises(RuntimeError)
+    def test_negative_pool_max_wait_is_rejected():
+        mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,table='world_merc',pool_max_wait=-1)
+
     def test_that_64bit_int_fields_work():
         ds = mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,
                             table='test8')
@@ -495,6 +499,70 @@ if 'postgis' in mapnik.DatasourceCache.plugin_names() \
         eq_(feat['gid'],2)
         eq_(feat['int_field'],922337203685477580)
 
+    def test_cursor_fetches_all_features():
+        ds = mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,table='world_merc')
+        expected = [f.id() for f in ds.all_features()]
+        # batches smaller than the table, with the next one in flight
+        for cursor_size in (1, 7, 245, 1000):
+            ds_cursor = mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,table='world_merc',
+                                       cursor_size=cursor_size)
+            eq_([f.id() for f in ds_cursor.all_features()], expected)
+
+    def test_interleaved_cursors_on_one_connection():
+        # both datasources share the pool, and so the connection
+        ds1 = mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,table='world_merc',cursor_size=5)
+        ds2 = mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,table='(select * from world_merc order by gid desc) as w',
+                             cursor_size=3)
+        expected1 = [f['gid'] for f in ds1.all_features()]
+        expected2 = [f['gid'] for f in ds2.all_features()]
+        def next_gid(fs):
+            try:
+                return fs.next()['gid']
+            except StopIteration:
+                return None
+        fs1 = ds1.featureset()
+        fs2 = ds2.featureset()
+        actual1 = []
+        actual2 = []
+        while True:
+            gid1 = next_gid(fs1)
+            gid2 = next_gid(fs2)
+            if gid1 is not None: actual1.append(gid1)
+            if gid2 is not None: actual2.append(gid2)
+            if gid1 is None and gid2 is None: break
+        eq_(actual1, expected1)
+        eq_(actual2, expected2)
+
+    def test_parked_fetch_of_abandoned_cursor():
+        ds1 = mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,table='world_merc',cursor_size=5)
+        ds2 = mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,table='(select * from world_merc order by gid desc) as w',
+                             cursor_size=3)
+        expected2 = [f['gid'] for f in ds2.all_features()]
+        fs1 = ds1.featureset()
+        fs1.next()
+        # opening the second cursor parks the FETCH in flight for the first one
+        fs2 = ds2.featureset()
+        # which is then dropped without being collected
+        del fs1
+        eq_([f['gid'] for f in fs2], expected2)
+        # and leaves nothing behind on the connection
+        eq_([f['gid'] for f in ds2.all_features()], expected2)
+
+    def test_cursors_on_one_connection_read_from_threads(NUM_THREADS=4):
+        datasources = [mapnik.PostGIS(dbname=MAPNIK_TEST_DBNAME,table='world_merc',cursor_size=i + 2)
+                       for i in range(NUM_THREADS)]
+        expected = [f['gid'] for f in datasources[0].all_features()]
+        results = [None] * NUM_THREADS
+        def read(i):
+            results[i] = [f['gid'] for f in datasources[i].all_features()]
+        threads = [threading.Thread(target=read, args=(i,)) for i in range(NUM_THREADS)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        for result in results:
+            eq_(result, expected)
+
     atexit.register(postgis_takedown)
 
 if __name__ == "__main__":
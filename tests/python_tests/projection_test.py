@@ -113,6 +113,28 @@ def test_proj_transform_between_init_and_literal():
             eq_(math.fabs(coord.y - lon_lat_coord3.y) < 1,True)
             eq_(math.fabs(coord.y - lon_lat_coord4.y) < 1,True)
 
+# projections are initialized again in every thread that uses them
+def test_projection_shared_between_threads():
+    import threading
+    utm = mapnik.Projection('+init=epsg:32630')
+    merc = mapnik.Projection('+init=epsg:3857')
+    tr = mapnik.ProjTransform(utm,merc)
+    coords = [mapnik.Coord(x,y) for x in xrange(200000,800000,50000) for y in xrange(4000000,6000000,250000)]
+    expected = [tr.forward(c) for c in coords]
+    results = {}
+    def work(key):
+        results[key] = [tr.forward(c) for c in coords]
+    threads = [threading.Thread(target=work, args=(i,)) for i in range(4)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    eq_(len(results),4)
+    for projected in results.values():
+        for a,b in zip(projected,expected):
+            eq_(a.x,b.x)
+            eq_(a.y,b.y)
+    eq_(utm.expanded(),mapnik.Projection('+init=epsg:32630').expanded())
 
 if __name__ == "__main__":
     run_all(eval(x) for x in dir() if x.startswith("test_"))
@@ -336,6 +336,20 @@ def test_point_symbolizer_grid():
     utf1 = grid.encode()
     eq_(utf1,point_expected,show_grids('point-sym',utf1,point_expected))
 
+def test_encode_json():
+    width,height = 256,256
+    sym = mapnik.PointSymbolizer(mapnik.PathExpression('../data/images/dummy.png'))
+    m = create_grid_map(width,height,sym)
+    ul_lonlat = mapnik.Coord(142.30,-38.20)
+    lr_lonlat = mapnik.Coord(143.40,-38.80)
+    m.zoom_to_box(mapnik.Box2d(ul_lonlat,lr_lonlat))
+    grid = mapnik.Grid(m.width,m.height)
+    mapnik.render_layer(m,grid,layer=0,fields=['Name'])
+    eq_(json.loads(grid.encode_json()),point_expected)
+    eq_(json.loads(grid.encode_json(features=False,resolution=1)),grid.encode('utf',features=False,resolution=1))
+    view = grid.view(0,0,64,64)
+    eq_(json.loads(view.encode_json(resolution=1)),view.encode('utf',resolution=1))
+
 
 # should throw because this is a mis-usage
 # https://github.com/mapnik/mapnik/issues/1325
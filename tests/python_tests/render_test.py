@@ -191,6 +191,30 @@ def test_render_with_scale_factor():
         eq_(actual.tostring(),expected.tostring(), 'failed comparing actual (%s) and expected (%s)' % (actual_file,expected_file))
         im.save('./images/support/marker-text-line-scale-factor-%s.png' % size,'png8')
 
+if 'csv' in mapnik.DatasourceCache.plugin_names():
+    def test_render_with_stats():
+        m = mapnik.Map(256,256)
+        mapnik.load_map(m,'../data/good_maps/marker-text-line.xml')
+        m.zoom_all()
+        im = mapnik.Image(256, 256)
+        stats = mapnik.render_with_stats(m,im)
+        eq_([l['name'] for l in stats['layers']],['ellipse','line','text','frame'])
+        eq_([l['features_queried'] for l in stats['layers']],[1,2,2,4])
+        eq_([l['features_rendered'] for l in stats['layers']],[1,2,2,4])
+        eq_(stats['layers'][1]['styles'][0]['name'],'line')
+        text = stats['layers'][2]['styles'][0]
+        eq_(text['label_attempts'] > 0,True)
+        eq_(text['label_attempts'] >= text['labels_placed'],True)
+        # ignore-placement markers are not added to the collision detector
+        eq_(stats['layers'][0]['styles'][0]['labels_placed'],0)
+        for layer in stats['layers']:
+            eq_(layer['render_time'] >= layer['query_time'],True)
+            eq_(stats['total_time'] >= layer['render_time'],True)
+        # renders the same image as render()
+        expected = mapnik.Image(256, 256)
+        mapnik.render(m,expected)
+        eq_(im.tostring(),expected.tostring())
+
 if __name__ == "__main__":
     setup()
     [eval(run)() for run in dir() if 'test_' in run]